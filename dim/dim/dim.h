@@ -203,6 +203,7 @@ typedef enum { NOSWAP, SWAPS, SWAPL, SWAPD} SWAP_TYPE;
 #define DECNET			0		/* Decnet as transport layer */
 #define TCPIP			1		/* Tcpip as transport layer  */
 #define BOTH			2		/* Both protocols allowed    */
+#define SHM_PROTOCOL	0x100		/* Server offers shared memory */
 
 #define	STA_DISC		(-1)		/* Connection lost           */
 #define	STA_DATA		0		/* Data received             */
@@ -274,6 +275,37 @@ typedef struct{
 
 #define DIS_STAMPED_HEADER		32
 
+/* Shared memory transport between a server and a client on the same node:
+   the client requests it by SHM_REQUEST in the type of its DIC_PACKET, the
+   server then writes large updates into a ring of slots in a shared memory
+   segment (one per request) and sends a DIS_SHM_PACKET instead of the data.
+   The slot is valid as long as its sequence number is unchanged. */
+
+#define SHM_REQUEST		0x100000	/* Data via shared memory    */
+#define SHM_SERVICE_ID	0x40000000	/* Marks a DIS_SHM_PACKET    */
+#define SHM_N_SLOTS		8
+#define SHM_MIN_SIZE	16384		/* Smaller updates use tcpip */
+#define MAX_SHM_NAME	64
+
+typedef struct{
+	int size;
+	int service_id;
+	int time_stamp[2];
+	int quality;
+	int slot;
+	int seq;
+	int data_size;
+	char name[MAX_SHM_NAME];
+} DIS_SHM_PACKET;
+
+typedef struct{
+	char name[MAX_SHM_NAME];
+	char *address;
+	int map_size;
+	int slot_size;
+	int seq;
+} SHM_SEGMENT;
+
 /* Packet sent by the server to the name_server */
 typedef struct{
 	char service_name[MAX_NAME];
@@ -438,6 +470,7 @@ typedef struct {
 	int port;
 	int pid;
 	char *service_head;
+	int shm;
 } DIC_CONNECTION;
 
 extern DIM_NOSHARE DIC_CONNECTION *Dic_conns;
@@ -495,6 +528,8 @@ typedef struct dic_serv {
 	int time_stamp[2];
 	int quality;
     int tid;
+	int shm;
+	SHM_SEGMENT *shmp;
 } DIC_SERVICE;
 
 /* PROTOTYPES */
@@ -589,6 +624,12 @@ _DIM_PROTOE( int copy_swap_buffer_in, (FORMAT_STR *format_data, void *buff_out,
 					void *buff_in, int size) );
 _DIM_PROTOE( int get_node_name, (char *node_name) );
 
+_DIM_PROTOE( char *shm_get_slot,     (SHM_SEGMENT *segp, int size, int *slot) );
+_DIM_PROTOE( void shm_commit_slot,   (SHM_SEGMENT *segp, int slot, int size) );
+_DIM_PROTOE( char *shm_map_slot,     (SHM_SEGMENT *segp, char *name, int slot, int seq, int *size) );
+_DIM_PROTOE( int shm_check_slot,     (SHM_SEGMENT *segp, int slot, int seq) );
+_DIM_PROTOE( void shm_release,       (SHM_SEGMENT *segp, int owner) );
+
 _DIM_PROTOE( int get_dns_port_number, () );
 
 _DIM_PROTOE( int get_dns_node_name, ( char *node_name ) );
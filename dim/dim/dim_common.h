@@ -316,6 +316,8 @@ typedef enum { DIM_INFO, DIM_WARNING, DIM_ERROR, DIM_FATAL }DIM_SEVERITIES;
 
 #define DIMDNSCNERR	0x30	/* Connection to DNS failed			ERROR */
 #define DIMDNSCNEST	0x31	/* Connection to DNS established	INFO */
+
+#define DIMSHMERR	0x40	/* Shared memory error				WARNING */
 		
 #endif                         
 
@@ -51,6 +51,7 @@ _DIM_PROTOE( int dis_remove_service,   (unsigned service_id) );
 _DIM_PROTOE( void dis_send_service,    (unsigned service_id, int *buffer,
 				   int size) );
 _DIM_PROTOE( int dis_set_buffer_size,  (int size) );
+_DIM_PROTOE( void dis_set_shm,         (int flag) );
 _DIM_PROTOE( void dis_set_quality,     (unsigned service_id, int quality) );
 _DIM_PROTOE( int dis_set_timestamp,     (unsigned service_id, 
 					int secs, int millisecs) );
@@ -311,6 +311,7 @@ static void recv_rout( int conn_id, DIS_PACKET *packet, int size, int status )
 			request_dns_info(0);
 			break;
 		}
+		service_id &= ~SHM_SERVICE_ID;
 		if( (servp = (DIC_SERVICE *) id_get_ptr(service_id, SRC_DIC)))
 		{
 			if(servp->serv_id == service_id)
@@ -373,14 +374,120 @@ static void recv_rout( int conn_id, DIS_PACKET *packet, int size, int status )
 	}
 }
 
+static int is_local_node(char *node)
+{
+	static char local_node[MAX_NODE_NAME] = "";
+
+	if(!local_node[0])
+		get_node_name(local_node);
+	return(!strcmp(node, local_node));
+}
+
+/* The shared memory of the server can not be used, release the request
+   and request the service again to receive the data through tcpip */
+static void shm_fallback(DIC_SERVICE *servp)
+{
+	DIC_PACKET dic_packet;
+	int send_service();
+
+	servp->shm = -1;
+	strncpy(dic_packet.service_name, servp->serv_name, (size_t)MAX_NAME); 
+	dic_packet.type = htovl(DIM_DELETE);
+	dic_packet.service_id = (int)htovl(servp->serv_id);
+	dic_packet.size = htovl(DIC_HEADER);
+	dna_write_nowait( servp->conn_id, &dic_packet, DIC_HEADER );
+	send_service( servp->conn_id, servp );
+}
+
+/* Return the data referred to by a DIS_SHM_PACKET */
+static int *map_service_shm(DIS_SHM_PACKET *packet, DIC_SERVICE *servp, int *size)
+{
+	char str[512];
+	int *pkt_buffer;
+
+	/* References sent before falling back to tcpip */
+	if(servp->shm < 0)
+		return(0);
+	if(!servp->shmp)
+	{
+		servp->shmp = (SHM_SEGMENT *)malloc(sizeof(SHM_SEGMENT));
+		memset(servp->shmp, 0, sizeof(SHM_SEGMENT));
+	}
+	pkt_buffer = (int *)shm_map_slot(servp->shmp, packet->name,
+		vtohl(packet->slot), vtohl(packet->seq), size);
+	if(!pkt_buffer)
+	{
+		if((*size == -1) && (servp->shm == 0))
+		{
+			sprintf(str, "Client Mapping Shared Memory %s of Service %s failed, using tcpip\n",
+				packet->name, servp->serv_name);
+			error_handler(0, DIM_WARNING, DIMSHMERR, str);
+			shm_fallback(servp);
+		}
+		else
+		{
+			sprintf(str, "Client Reading Shared Memory %s: Update of Service %s lost\n",
+				packet->name, servp->serv_name);
+			error_handler(0, DIM_WARNING, DIMSHMERR, str);
+		}
+		return(0);
+	}
+	servp->shm = 1;
+	if( servp->stamped)
+	{
+		servp->time_stamp[0] = vtohl(packet->time_stamp[0]);
+		servp->time_stamp[1] = vtohl(packet->time_stamp[1]);
+		servp->quality = vtohl(packet->quality);
+	}
+	return(pkt_buffer);
+}
+
+/* The data in shared memory was overwritten while it was copied */
+static int shm_lost(DIS_SHM_PACKET *packet, DIC_SERVICE *servp)
+{
+	char str[512];
+
+	if(!packet)
+		return(0);
+	if(shm_check_slot(servp->shmp, vtohl(packet->slot), vtohl(packet->seq)))
+		return(0);
+	sprintf(str, "Client Reading Shared Memory %s: Update of Service %s lost\n",
+		packet->name, servp->serv_name);
+	error_handler(0, DIM_WARNING, DIMSHMERR, str);
+	return(1);
+}
+
+/* Buffer for updates which are not copied to the user's address directly */
+static int *get_service_buffer(int size)
+{
+	static int *buffer;
+	static int buffer_size = 0;
+
+	if(!buffer_size)
+	{
+		buffer = (int *)malloc((size_t)size);
+		buffer_size = size;
+	} 
+	else 
+	{
+		if( size > buffer_size ) 
+		{
+			free(buffer);
+			buffer = (int *)malloc((size_t)size);
+			buffer_size = size;
+		}
+	}
+	return(buffer);
+}
+
 static void execute_service(DIS_PACKET *packet, DIC_SERVICE *servp, int size)
 {
 	int format;
 	FORMAT_STR format_data_cp[MAX_NAME/4], *formatp;
-	static int *buffer;
-	static int buffer_size = 0;
+	int *buffer;
 	int add_size;
 	int *pkt_buffer, header_size;
+	DIS_SHM_PACKET *shm_packet = 0;
 
 	Current_server = servp;
 	format = servp->format;
@@ -390,7 +497,17 @@ static void execute_service(DIS_PACKET *packet, DIC_SERVICE *servp, int size)
 		for(formatp = format_data_cp; formatp->par_bytes; formatp++)
 			formatp->flags &= (short)0xFFF0;    /* NOSWAP */
 	}
-	if( servp->stamped)
+	if((unsigned)vtohl(packet->service_id) & SHM_SERVICE_ID)
+	{
+		shm_packet = (DIS_SHM_PACKET *)packet;
+		if(!(pkt_buffer = map_service_shm(shm_packet, servp, &size)))
+		{
+			Current_server = 0;
+			return;
+		}
+		header_size = 0;
+	}
+	else if( servp->stamped)
 	{
 		pkt_buffer = ((DIS_STAMPED_PACKET *)packet)->buffer;
 		header_size = DIS_STAMPED_HEADER;
@@ -427,7 +544,23 @@ static void execute_service(DIS_PACKET *packet, DIC_SERVICE *servp, int size)
 	{
 		if( size > servp->serv_size ) 
 			size = servp->serv_size; 
-		add_size = copy_swap_buffer_in(format_data_cp, 
+		if( shm_packet )
+		{
+			/* The shared memory can be overwritten while it is copied,
+			   the user's buffer is only changed if the copy is valid */
+			buffer = get_service_buffer(size + (size/2));
+			add_size = copy_swap_buffer_in(format_data_cp, 
+						 buffer, 
+						 pkt_buffer, size);
+			if( shm_lost(shm_packet, servp) )
+			{
+				Current_server = 0;
+				return;
+			}
+			memcpy(servp->serv_address, buffer, (size_t)add_size);
+		}
+		else
+			add_size = copy_swap_buffer_in(format_data_cp, 
 						 servp->serv_address, 
 						 pkt_buffer, size);
 		if( servp->user_routine )
@@ -437,24 +570,15 @@ static void execute_service(DIS_PACKET *packet, DIC_SERVICE *servp, int size)
 	{
 		if( servp->user_routine )
 		{
-			add_size = size + (size/2);
-			if(!buffer_size)
-			{
-				buffer = (int *)malloc((size_t)add_size);
-				buffer_size = add_size;
-			} 
-			else 
-			{
-				if( add_size > buffer_size ) 
-				{
-					free(buffer);
-					buffer = (int *)malloc((size_t)add_size);
-					buffer_size = add_size;
-				}
-			}
+			buffer = get_service_buffer(size + (size/2));
 			add_size = copy_swap_buffer_in(format_data_cp, 
 						 buffer, 
 						 pkt_buffer, size);
+			if( shm_lost(shm_packet, servp) )
+			{
+				Current_server = 0;
+				return;
+			}
 			(servp->user_routine)( &servp->tag, buffer, &add_size );
 		}
 	}
@@ -878,6 +1002,8 @@ DIC_SERVICE *insert_service( int type, int timeout, char *name, int *address, in
 	newp->time_stamp[1] = 0;
 	newp->quality = 0;
 	newp->def[0] = '\0';
+	newp->shm = 0;
+	newp->shmp = 0;
 #ifdef VxWorks
 	newp->tid = taskIdSelf();
 #endif
@@ -1123,6 +1249,11 @@ int release_service( DIC_SERVICE *servicep )
 */
 	if(servicep->fill_size > 0)
 		free( servicep->fill_address );
+	if(servicep->shmp)
+	{
+		shm_release(servicep->shmp, 0);
+		free(servicep->shmp);
+	}
 	if(strstr(servicep->serv_name,"/RpcOut"))
 	{
 		strcpy(name, servicep->serv_name);
@@ -1479,6 +1610,7 @@ static int handle_dns_info( DNS_DIC_PACKET *packet )
 				 (size_t)MAX_TASK_NAME);
 			dic_connp->port = port;
 			dic_connp->pid = pid;
+			dic_connp->shm = (protocol & SHM_PROTOCOL) && is_local_node(node_name);
 			if(Debug_on)
 			{
 				dim_print_date_time();
@@ -1909,6 +2041,9 @@ int send_service(int conn_id, DIC_SERVICE *servp)
 	type = servp->type;
 	if(servp->stamped)
 		type |= STAMPED;
+	if((Dic_conns[conn_id].shm) && (servp->shm >= 0) &&
+	   (servp->type != COMMAND) && (servp->type != ONCE_ONLY))
+		type |= SHM_REQUEST;
 	dic_packet->type = htovl(type);
 	dic_packet->timeout = htovl(servp->timeout);
 	dic_packet->service_id = htovl(servp->serv_id);
@@ -64,6 +64,7 @@ typedef struct req_ent {
 	int to_delete;
 	TIMR_ENT *timr_ent;
 	struct reqp_ent *reqpp;
+	SHM_SEGMENT *shmp;
 } REQUEST;
 
 typedef struct serv {
@@ -197,6 +198,27 @@ void dis_no_threads()
 	Threads_off = 1;
 }
 
+static int Shm_enabled = -1;
+
+/* Offer the shared memory transport to clients on the same node
+   (default: environment variable DIM_SHM) */
+void dis_set_shm(int flag)
+{
+	Shm_enabled = flag;
+}
+
+static int dis_get_shm()
+{
+	char *p;
+
+	if(Shm_enabled == -1)
+	{
+		p = getenv("DIM_SHM");
+		Shm_enabled = (p && p[0] && strcmp(p, "0")) ? 1 : 0;
+	}
+	return(Shm_enabled);
+}
+
 static DIS_STAMPED_PACKET *Dis_packet = 0;
 static int Dis_packet_size = 0;
 
@@ -1234,6 +1256,8 @@ dim_print_date_time();
 			ENABLE_AST
 			return(0);
 		}
+		if(dis_get_shm())
+			Protocol |= SHM_PROTOCOL;
 		Dis_first_time = 0;
 	}
 	if(dnsp->dis_first_time)
@@ -1425,6 +1449,9 @@ printf("Received Request for %s, from %d  %s@%s\n",
 		newp->timr_ent = 0;
 		newp->req_id = id_get((void *)newp, SRC_DIS);
 		newp->reqpp = 0;
+		newp->shmp = 0;
+		if((type == ONCE_ONLY) || (type == COMMAND) || !dis_get_shm())
+			newp->type &= ~SHM_REQUEST;
 		if(type == ONCE_ONLY) 
 		{
 			execute_service(newp->req_id);
@@ -1487,20 +1514,86 @@ printf("Received Request for %s, from %d  %s@%s\n",
 
 /* A timeout for a timed or monitored service occured, serve it. */
 
-int execute_service( int req_id )
+static void get_time_stamp(SERVICE *servp, int *time_stamp)
 {
-	int *buffp, size;
-	register REQUEST *reqp;
-	register SERVICE *servp;
-	char str[256], def[MAX_NAME];
-	int conn_id, last_conn_id;
-	int *pkt_buffer, header_size, aux;
+	int aux;
 #ifdef WIN32
 	struct timeb timebuf;
 #else
 	struct timeval tv;
 	struct timezone *tz;
 #endif
+
+	if(!servp->user_secs)
+	{
+#ifdef WIN32
+		ftime(&timebuf);
+		aux = timebuf.millitm;
+		time_stamp[0] = htovl(aux);
+		time_stamp[1] = htovl((int)timebuf.time);
+#else
+		tz = 0;
+	        gettimeofday(&tv, tz);
+		aux = (int)tv.tv_usec / 1000;
+		time_stamp[0] = htovl(aux);
+		time_stamp[1] = htovl((int)tv.tv_sec);
+#endif
+	}
+	else
+	{
+		aux = /*0xc0de0000 |*/ servp->user_millisecs;
+		time_stamp[0] = htovl(aux);
+		time_stamp[1] = htovl(servp->user_secs);
+	}
+}
+
+static DIS_SHM_PACKET Dis_shm_packet;
+
+/* Write the data into the shared memory segment of the request and
+   return the packet referring to it (0 if the segment is not usable) */
+static DIS_SHM_PACKET *write_service_shm(REQUEST *reqp, SERVICE *servp, int *buffp, int size)
+{
+	FORMAT_STR format_data_cp[MAX_NAME/4];
+	char *slotp;
+	int slot;
+
+	if(!reqp->shmp)
+	{
+		reqp->shmp = (SHM_SEGMENT *)malloc(sizeof(SHM_SEGMENT));
+		memset(reqp->shmp, 0, sizeof(SHM_SEGMENT));
+	}
+	if(!(slotp = shm_get_slot(reqp->shmp, size, &slot)))
+	{
+		/* Don't try again, use tcpip for this request */
+		reqp->type &= ~SHM_REQUEST;
+		return(0);
+	}
+	memcpy(format_data_cp, servp->format_data, sizeof(format_data_cp));
+	size = copy_swap_buffer_out(reqp->format, format_data_cp, 
+		slotp,
+		buffp, size);
+	shm_commit_slot(reqp->shmp, slot, size);
+	Dis_shm_packet.size = htovl((int)sizeof(DIS_SHM_PACKET));
+	Dis_shm_packet.service_id = htovl(reqp->service_id | SHM_SERVICE_ID);
+	get_time_stamp(servp, Dis_shm_packet.time_stamp);
+	Dis_shm_packet.quality = htovl(servp->quality);
+	Dis_shm_packet.slot = htovl(slot);
+	Dis_shm_packet.seq = htovl(reqp->shmp->seq);
+	Dis_shm_packet.data_size = htovl(size);
+	strcpy(Dis_shm_packet.name, reqp->shmp->name);
+	return(&Dis_shm_packet);
+}
+
+int execute_service( int req_id )
+{
+	int *buffp, size;
+	register REQUEST *reqp;
+	register SERVICE *servp;
+	char str[256], def[MAX_NAME];
+	int conn_id, last_conn_id;
+	int *pkt_buffer, header_size;
+	void *packetp = 0;
+	int packet_size;
 	FORMAT_STR format_data_cp[MAX_NAME/4];
 	int ret = 1;
 
@@ -1554,58 +1647,47 @@ printf("Updating %s for %s@%s (req_id = %d)\n",
 		reqp->delay_delete--;
 		return(0);
 	}
-	if( DIS_STAMPED_HEADER + size > Dis_packet_size ) 
+	if((reqp->type & SHM_REQUEST) && (size >= SHM_MIN_SIZE))
+		packetp = write_service_shm(reqp, servp, buffp, size);
+	if(packetp)
+		packet_size = (int)sizeof(DIS_SHM_PACKET);
+	else
 	{
-		if( Dis_packet_size )
-			free( Dis_packet );
-		Dis_packet = (DIS_STAMPED_PACKET *)malloc((size_t)(DIS_STAMPED_HEADER + size));
-		if(!Dis_packet)
+		if( DIS_STAMPED_HEADER + size > Dis_packet_size ) 
 		{
-			reqp->delay_delete--;
-			return(0);
+			if( Dis_packet_size )
+				free( Dis_packet );
+			Dis_packet = (DIS_STAMPED_PACKET *)malloc((size_t)(DIS_STAMPED_HEADER + size));
+			if(!Dis_packet)
+			{
+				reqp->delay_delete--;
+				return(0);
+			}
+			Dis_packet_size = DIS_STAMPED_HEADER + size;
 		}
-		Dis_packet_size = DIS_STAMPED_HEADER + size;
-	}
-	Dis_packet->service_id = htovl(reqp->service_id);
-	if((reqp->type & 0xFF000) == STAMPED)
-	{
-		pkt_buffer = ((DIS_STAMPED_PACKET *)Dis_packet)->buffer;
-		header_size = DIS_STAMPED_HEADER;
-		if(!servp->user_secs)
+		Dis_packet->service_id = htovl(reqp->service_id);
+		if((reqp->type & 0xFF000) == STAMPED)
 		{
-#ifdef WIN32
-			ftime(&timebuf);
-			aux = timebuf.millitm;
-			Dis_packet->time_stamp[0] = htovl(aux);
-			Dis_packet->time_stamp[1] = htovl((int)timebuf.time);
-#else
-			tz = 0;
-		        gettimeofday(&tv, tz);
-			aux = (int)tv.tv_usec / 1000;
-			Dis_packet->time_stamp[0] = htovl(aux);
-			Dis_packet->time_stamp[1] = htovl((int)tv.tv_sec);
-#endif
+			pkt_buffer = ((DIS_STAMPED_PACKET *)Dis_packet)->buffer;
+			header_size = DIS_STAMPED_HEADER;
+			get_time_stamp(servp, Dis_packet->time_stamp);
+			Dis_packet->reserved[0] = (int)htovl(0xc0dec0de);
+			Dis_packet->quality = htovl(servp->quality);
 		}
 		else
 		{
-			aux = /*0xc0de0000 |*/ servp->user_millisecs;
-			Dis_packet->time_stamp[0] = htovl(aux);
-			Dis_packet->time_stamp[1] = htovl(servp->user_secs);
+			pkt_buffer = ((DIS_PACKET *)Dis_packet)->buffer;
+			header_size = DIS_HEADER;
 		}
-		Dis_packet->reserved[0] = (int)htovl(0xc0dec0de);
-		Dis_packet->quality = htovl(servp->quality);
-	}
-	else
-	{
-		pkt_buffer = ((DIS_PACKET *)Dis_packet)->buffer;
-		header_size = DIS_HEADER;
+		memcpy(format_data_cp, servp->format_data, sizeof(format_data_cp));
+		size = copy_swap_buffer_out(reqp->format, format_data_cp, 
+			pkt_buffer,
+			buffp, size);
+		Dis_packet->size = htovl(header_size + size);
+		packetp = Dis_packet;
+		packet_size = header_size + size;
 	}
-	memcpy(format_data_cp, servp->format_data, sizeof(format_data_cp));
-	size = copy_swap_buffer_out(reqp->format, format_data_cp, 
-		pkt_buffer,
-		buffp, size);
-	Dis_packet->size = htovl(header_size + size);
-	if( !dna_write_nowait(conn_id, Dis_packet, header_size + size) ) 
+	if( !dna_write_nowait(conn_id, packetp, packet_size) ) 
 	{
 		if(Net_conns[conn_id].write_timedout)
 		{
@@ -2775,6 +2857,11 @@ int release_request(REQUEST *reqp, REQUEST_PTR *reqpp, int remove)
 	if(reqp->timr_ent)
 		dtq_rem_entry(Dis_timer_q, reqp->timr_ent);
 	id_free(reqp->req_id, SRC_DIS);
+	if(reqp->shmp)
+	{
+		shm_release(reqp->shmp, 1);
+		free(reqp->shmp);
+	}
 	free(reqp);
 	if(reqpp)
 		free(reqpp);
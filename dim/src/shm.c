@@ -0,0 +1,292 @@
+/*
+ * SHM (Shared Memory) transport of service data between a server and
+ * a client running on the same node.
+ *
+ * A segment consists of a header and SHM_N_SLOTS slots. The server
+ * writes each update into the next slot and sends only a reference
+ * (DIS_SHM_PACKET) through tcpip. The sequence number of a slot is
+ * zero while it is written, so that the client can check that the
+ * slot was not overwritten while it copied the data.
+ *
+ */
+
+#define DIMLIB
+#include <dim.h>
+
+#if defined(__unix__)
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define SHM_MAGIC		0x44494d53	/* "DIMS" */
+
+typedef struct{
+	int magic;
+	int n_slots;
+	int slot_size;
+	int reserved;
+} SHM_HEADER;
+
+typedef struct{
+	volatile int seq;
+	int size;
+	int reserved[2];
+	char buffer[8];
+} SHM_SLOT;
+
+#define SHM_SLOT_HEADER		16
+
+#if defined(__unix__)
+
+/* Segments created by this process, removed at exit */
+static SHM_SEGMENT **Shm_owned = 0;
+static int Shm_n_owned = 0;
+
+static void shm_exit_handler()
+{
+	int i;
+
+	for(i = 0; i < Shm_n_owned; i++)
+	{
+		if(Shm_owned[i])
+			shm_unlink(Shm_owned[i]->name);
+	}
+}
+
+static void add_owned(SHM_SEGMENT *segp)
+{
+	int i;
+
+	if(!Shm_owned)
+		atexit(shm_exit_handler);
+	for(i = 0; i < Shm_n_owned; i++)
+	{
+		if(!Shm_owned[i])
+		{
+			Shm_owned[i] = segp;
+			return;
+		}
+	}
+	Shm_owned = (SHM_SEGMENT **)realloc(Shm_owned, (size_t)(Shm_n_owned + 16) * sizeof(SHM_SEGMENT *));
+	memset(&Shm_owned[Shm_n_owned], 0, 16 * sizeof(SHM_SEGMENT *));
+	Shm_owned[Shm_n_owned] = segp;
+	Shm_n_owned += 16;
+}
+
+static void remove_owned(SHM_SEGMENT *segp)
+{
+	int i;
+
+	for(i = 0; i < Shm_n_owned; i++)
+	{
+		if(Shm_owned[i] == segp)
+			Shm_owned[i] = 0;
+	}
+}
+
+static SHM_SLOT *get_slot(SHM_SEGMENT *segp, int slot)
+{
+	return (SHM_SLOT *)(segp->address + sizeof(SHM_HEADER) +
+		(size_t)slot * (size_t)(SHM_SLOT_HEADER + segp->slot_size));
+}
+
+static int create_segment(SHM_SEGMENT *segp, int size)
+{
+	static int counter = 0;
+	SHM_HEADER *headp;
+	void *addr;
+	int fd, slot_size, map_size;
+
+	/* Leave some room for updates of varying size */
+	slot_size = size + size/4;
+	if(slot_size < SHM_MIN_SIZE)
+		slot_size = SHM_MIN_SIZE;
+	slot_size = (slot_size + 4095) & ~4095;
+	map_size = (int)sizeof(SHM_HEADER) + SHM_N_SLOTS * (SHM_SLOT_HEADER + slot_size);
+
+	sprintf(segp->name, "/dim.%d.%d", getpid(), ++counter);
+	fd = shm_open(segp->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+	if(fd == -1)
+		return(0);
+	if(ftruncate(fd, map_size) == -1)
+	{
+		close(fd);
+		shm_unlink(segp->name);
+		return(0);
+	}
+	addr = mmap(0, (size_t)map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED)
+	{
+		shm_unlink(segp->name);
+		return(0);
+	}
+	headp = (SHM_HEADER *)addr;
+	headp->magic = SHM_MAGIC;
+	headp->n_slots = SHM_N_SLOTS;
+	headp->slot_size = slot_size;
+	segp->address = (char *)addr;
+	segp->map_size = map_size;
+	segp->slot_size = slot_size;
+	add_owned(segp);
+	return(1);
+}
+
+/* Server: return the buffer of the next slot for an update of size bytes,
+   a new segment is created if the slots are too small */
+char *shm_get_slot(SHM_SEGMENT *segp, int size, int *slot)
+{
+	SHM_SLOT *slotp;
+
+	if((segp->address) && (size > segp->slot_size))
+		shm_release(segp, 1);
+	if(!segp->address)
+	{
+		if(!create_segment(segp, size))
+			return(0);
+	}
+	segp->seq++;
+	if(segp->seq <= 0)
+		segp->seq = 1;
+	*slot = segp->seq % SHM_N_SLOTS;
+	slotp = get_slot(segp, *slot);
+	slotp->seq = 0;
+	__sync_synchronize();
+	return(slotp->buffer);
+}
+
+/* Server: the data was written, make the slot valid */
+void shm_commit_slot(SHM_SEGMENT *segp, int slot, int size)
+{
+	SHM_SLOT *slotp;
+
+	slotp = get_slot(segp, slot);
+	slotp->size = size;
+	__sync_synchronize();
+	slotp->seq = segp->seq;
+}
+
+static int map_segment(SHM_SEGMENT *segp, char *name)
+{
+	struct stat st;
+	SHM_HEADER *headp;
+	void *addr;
+	int fd;
+
+	fd = shm_open(name, O_RDONLY, 0);
+	if(fd == -1)
+		return(0);
+	if((fstat(fd, &st) == -1) || (st.st_size < (off_t)sizeof(SHM_HEADER)))
+	{
+		close(fd);
+		return(0);
+	}
+	addr = mmap(0, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if(addr == MAP_FAILED)
+		return(0);
+	headp = (SHM_HEADER *)addr;
+	if((headp->magic != SHM_MAGIC) || (headp->n_slots != SHM_N_SLOTS) ||
+	   ((off_t)sizeof(SHM_HEADER) + SHM_N_SLOTS * (off_t)(SHM_SLOT_HEADER + headp->slot_size) > st.st_size))
+	{
+		munmap(addr, (size_t)st.st_size);
+		return(0);
+	}
+	strncpy(segp->name, name, (size_t)MAX_SHM_NAME);
+	segp->name[MAX_SHM_NAME - 1] = '\0';
+	segp->address = (char *)addr;
+	segp->map_size = (int)st.st_size;
+	segp->slot_size = headp->slot_size;
+	return(1);
+}
+
+/* Client: return the data of the given slot. The returned size is -1
+   if the segment could not be mapped and 0 if the slot is not valid
+   anymore. */
+char *shm_map_slot(SHM_SEGMENT *segp, char *name, int slot, int seq, int *size)
+{
+	SHM_SLOT *slotp;
+
+	*size = -1;
+	if((segp->address) && strncmp(segp->name, name, (size_t)MAX_SHM_NAME))
+		shm_release(segp, 0);
+	if(!segp->address)
+	{
+		if(!map_segment(segp, name))
+			return(0);
+	}
+	*size = 0;
+	if((slot < 0) || (slot >= SHM_N_SLOTS))
+		return(0);
+	slotp = get_slot(segp, slot);
+	if(slotp->seq != seq)
+		return(0);
+	__sync_synchronize();
+	*size = slotp->size;
+	if((*size < 0) || (*size > segp->slot_size))
+	{
+		*size = 0;
+		return(0);
+	}
+	return(slotp->buffer);
+}
+
+/* Client: check that the slot was not overwritten after the data was copied */
+int shm_check_slot(SHM_SEGMENT *segp, int slot, int seq)
+{
+	__sync_synchronize();
+	return(get_slot(segp, slot)->seq == seq);
+}
+
+void shm_release(SHM_SEGMENT *segp, int owner)
+{
+	if(segp->address)
+	{
+		munmap(segp->address, (size_t)segp->map_size);
+		if(owner)
+		{
+			shm_unlink(segp->name);
+			remove_owned(segp);
+		}
+	}
+	segp->address = 0;
+	segp->map_size = 0;
+	segp->slot_size = 0;
+}
+
+#else
+
+char *shm_get_slot(SHM_SEGMENT *segp, int size, int *slot)
+{
+	if(segp || size || slot){}
+	return(0);
+}
+
+void shm_commit_slot(SHM_SEGMENT *segp, int slot, int size)
+{
+	if(segp || slot || size){}
+}
+
+char *shm_map_slot(SHM_SEGMENT *segp, char *name, int slot, int seq, int *size)
+{
+	if(segp || name || slot || seq){}
+	*size = -1;
+	return(0);
+}
+
+int shm_check_slot(SHM_SEGMENT *segp, int slot, int seq)
+{
+	if(segp || slot || seq){}
+	return(0);
+}
+
+void shm_release(SHM_SEGMENT *segp, int owner)
+{
+	if(segp || owner){}
+}
+
+#endif
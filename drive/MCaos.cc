@@ -4,6 +4,8 @@
 #include <iostream>
 #include <iomanip>
 #include <math.h>
+#include <random>
+#include <algorithm>
 
 #include "Led.h"
 #include "FilterLed.h"
@@ -39,16 +41,12 @@ void MCaos::ReadResources(const char *name)
     cout << "Found " << fPositions.size() << " leds." << endl;
 }
 
-void MCaos::CalcCenters(const vector<Led> &leds, float min, float max)
+// Calculate the ring through each triple of leds and keep all rings
+// with a radius in the allowed range
+void MCaos::AddRings(const vector<Led> &leds, float min, float max)
 {
-    fRings.clear();
-
     const int nPoints = leds.size();
 
-    // A minimum of at least 3 points is mandatory!
-    if (nPoints<fMinNumberLeds || nPoints<3)
-        return;
-
 //    ofstream fout("rings.txt", ios::app);
 
     for (int i=0; i<nPoints-2; i++)
@@ -71,6 +69,98 @@ void MCaos::CalcCenters(const vector<Led> &leds, float min, float max)
             }
 }
 
+// Find the largest subset of leds which lie on a common ring (RANSAC).
+// Ring candidates are calculated from random triples of leds. Leds
+// closer than fTolerance to a candidate are counted as its inliers.
+// The search stops as soon as the best candidate found so far is
+// unlikely (<1%) to be improved by further triples.
+void MCaos::FindInliers(const vector<Led> &leds, float min, float max, vector<Led> &inliers) const
+{
+    const int nPoints = leds.size();
+
+    // Fixed seed, so that the result for a frame is reproducible
+    mt19937 rnd(nPoints);
+    uniform_int_distribution<int> dist(0, nPoints-1);
+
+    vector<char> best;
+    int nbest = 0;
+
+    const int maxiter = 20000;
+
+    int niter = maxiter;
+    for (int n=0; n<niter; n++)
+    {
+        const int i = dist(rnd);
+        const int j = dist(rnd);
+        const int k = dist(rnd);
+        if (i==j || i==k || j==k)
+            continue;
+
+        Ring ring;
+        if (!ring.CalcCenter(leds[i], leds[j], leds[k]))
+            continue;
+
+        if ((min>=0&&ring.GetR()<min) || (max>=0&&ring.GetR()>max))
+            continue;
+
+        vector<char> in(nPoints);
+
+        int cnt = 0;
+        for (int l=0; l<nPoints; l++)
+        {
+            const double d = hypot(leds[l].GetX()-ring.GetX(), leds[l].GetY()-ring.GetY());
+            if (fabs(d-ring.GetR())<fTolerance)
+            {
+                in[l] = 1;
+                cnt++;
+            }
+        }
+
+        if (cnt<=nbest)
+            continue;
+
+        nbest = cnt;
+        best.swap(in);
+
+        // Number of triples required to draw at least once a triple of
+        // inliers with a probability of 99%
+        const double w = double(nbest)/nPoints;
+        const double p = 1-w*w*w;
+
+        niter = p<=0 ? 0 : std::min(double(maxiter), ceil(log(0.01)/log(p)));
+    }
+
+    inliers.clear();
+    for (size_t l=0; l<best.size(); l++)
+        if (best[l])
+            inliers.push_back(leds[l]);
+}
+
+void MCaos::CalcCenters(const vector<Led> &leds, float min, float max)
+{
+    fRings.clear();
+
+    const int nPoints = leds.size();
+
+    // A minimum of at least 3 points is mandatory!
+    if (nPoints<fMinNumberLeds || nPoints<3)
+        return;
+
+    // For a few leds, all triples are evaluated. With many (mostly false)
+    // led candidates this would be O(n^3). Therefore, only the triples
+    // of the leds on the best ring candidate are evaluated.
+    if (nPoints<=fMaxExhaustive)
+    {
+        AddRings(leds, min, max);
+        return;
+    }
+
+    vector<Led> inliers;
+    FindInliers(leds, min, max, inliers);
+
+    AddRings(inliers, min, max);
+}
+
 int32_t MCaos::CalcRings(std::vector<Led> &leds, float min, float max)
 {
     CalcCenters(leds, min, max);
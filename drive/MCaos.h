@@ -17,17 +17,21 @@ private:
     uint16_t fSizeBox;       // Size of the search box (side length in units of pixels)
     double   fCut;           // Cleaning level (sigma above noise)
 
+    uint16_t fMaxExhaustive; // maximum number of leds for which all triples are evaluated
+    double   fTolerance;     // maximum distance of a led from a ring candidate (RANSAC)
+
     int32_t fNumDetectedRings;
 
     Ring fCenter;
     std::vector<Ring> fRings;
 
+    void AddRings(const std::vector<Led> &leds, float min, float max);
+    void FindInliers(const std::vector<Led> &leds, float min, float max, std::vector<Led> &inliers) const;
     void CalcCenters(const std::vector<Led> &leds, float min, float max);
-    int32_t CalcRings(std::vector<Led> &leds, float min=-1, float max=-1);
-    const Ring &GetCenter() const { return fCenter; }
 
 public:
-    MCaos() : fMinRadius(236.7), fMaxRadius(238.6), fSizeBox(19), fCut(3.5)
+    MCaos() : fMinRadius(236.7), fMaxRadius(238.6), fSizeBox(19), fCut(3.5),
+        fMaxExhaustive(12), fTolerance(2)
     {
     }
 
@@ -50,9 +54,16 @@ public:
     void SetMinRadius(double min) { fMinRadius=min; }
     void SetMaxRadius(double max) { fMaxRadius=max; }
 
+    void SetMaxExhaustive(uint16_t n) { fMaxExhaustive=n; }
+    void SetTolerance(double tol) { fTolerance=tol; }
+
     int32_t GetNumDetectedLEDs() const  { return fLeds.size(); }
     int32_t GetNumDetectedRings() const { return fNumDetectedRings; }
 
+    // Ring fit of already detected leds (as done by Run)
+    int32_t CalcRings(std::vector<Led> &leds, float min=-1, float max=-1);
+    const Ring &GetCenter() const { return fCenter; }
+
     Ring Run(uint8_t *img);
 };
 
@@ -611,6 +611,234 @@ AltAz MPointing::Correct(const AltAz &aa) const
     return p;
 }
 
+void MPointing::Propagate(Double_t *dalt, Double_t *daz, Double_t taa, Double_t taz, Double_t tza, Double_t tzz)
+{
+    // The derivatives of a correction term T(alt, az) with respect to
+    // the position it is applied to are added to the derivatives of
+    // the position (chain rule): d(p+T)/dc = dp/dc + dT/dp * dp/dc
+    for (int i=0; i<kNumPar; i++)
+    {
+        const Double_t a = dalt[i];
+        const Double_t z = daz[i];
+
+        dalt[i] += taa*a + taz*z;
+        daz[i]  += tza*a + tzz*z;
+    }
+}
+
+AltAz MPointing::Correct(const AltAz &aa, Double_t *dalt, Double_t *daz) const
+{
+    // Same as Correct(aa), but additionally returns the analytic
+    // derivatives of the corrected position with respect to all
+    // coefficients [rad/rad] in dalt[kNumPar] and daz[kNumPar].
+    // Every correction term is linear in its coefficient, so its
+    // derivatives are the term itself divided by the coefficient, and
+    // its dependence on the position it is applied to is propagated
+    // through the chain of corrections. Coefficients which are not part
+    // of the model (TX, MAGIC2, PX, PY, DX, DY) have zero derivatives.
+    //
+    // NEVER CHANGE Correct WITHOUT CHANGING THIS FUNCTION ACCORDINGLY!
+    for (int i=0; i<kNumPar; i++)
+    {
+        dalt[i] = 0;
+        daz[i]  = 0;
+    }
+
+    AltAz p = aa;
+
+    // ----- CRX, CRY -----
+    {
+        const Double_t s  = sin(p.Az()-p.Alt());
+        const Double_t c  = cos(p.Az()-p.Alt());
+        const Double_t ca = cos(p.Alt());
+        const Double_t ta = tan(p.Alt());
+
+        const AltAz CRX(-fCrx*s,  fCrx*c/ca);
+        const AltAz CRY(-fCry*c, -fCry*s/ca);
+
+        Propagate(dalt, daz,
+                  fCrx*c - fCry*s,                          -fCrx*c + fCry*s,
+                  fCrx*(s+c*ta)/ca + fCry*(c-s*ta)/ca,      -fCrx*s/ca - fCry*c/ca);
+
+        dalt[kCRX] += -s;   daz[kCRX] +=  c/ca;
+        dalt[kCRY] += -c;   daz[kCRY] += -s/ca;
+
+        p += CRX;
+        p += CRY;
+    }
+
+    // ----- NRX, NRY -----
+    {
+        const Double_t s = sin(p.Alt());
+        const Double_t c = cos(p.Alt());
+        const Double_t t = tan(p.Alt());
+
+        const AltAz NRX(fNrx*s, -fNrx);
+        const AltAz NRY(fNry*c, -fNry*t);
+
+        Propagate(dalt, daz, fNrx*c - fNry*s, 0, -fNry/(c*c), 0);
+
+        dalt[kNRX] += s;   daz[kNRX] += -1;
+        dalt[kNRY] += c;   daz[kNRY] += -t;
+
+        p += NRX;
+        p += NRY;
+    }
+
+    // ----- CES, CEC -----
+    {
+        const Double_t sa = sin(p.Alt());
+        const Double_t ca = cos(p.Alt());
+        const Double_t sz = sin(p.Az());
+        const Double_t cz = cos(p.Az());
+
+        const AltAz CES(-fEces*sa, -fAces*sz);
+        const AltAz CEC(-fEcec*ca, -fAcec*cz);
+
+        Propagate(dalt, daz, -fEces*ca + fEcec*sa, 0, 0, -fAces*cz + fAcec*sz);
+
+        dalt[kECES] += -sa;
+        dalt[kECEC] += -ca;
+        daz[kACES]  += -sz;
+        daz[kACEC]  += -cz;
+
+        p += CES;
+        p += CEC;
+    }
+
+    // ----- TF -----
+    {
+        const Double_t sgn = Sign(1, p.Alt());
+
+        const AltAz TF(Sign(fTf*cos(p.Alt()), p.Alt()), 0);
+
+        Propagate(dalt, daz, -sgn*fTf*sin(p.Alt()), 0, 0, 0);
+
+        dalt[kTF] += sgn*cos(p.Alt());
+
+        p += TF;
+    }
+
+    // ----- CA -----
+    {
+        const Double_t c = cos(p.Alt());
+
+        const AltAz CA(0, -fCa/c);
+
+        Propagate(dalt, daz, 0, 0, -fCa*tan(p.Alt())/c, 0);
+
+        daz[kCA] += -1/c;
+
+        p += CA;
+    }
+
+    // ----- NPAE -----
+    {
+        const Double_t c = cos(p.Alt());
+
+        const AltAz NPAE(0, -fNpae*tan(p.Alt()));
+
+        Propagate(dalt, daz, 0, 0, -fNpae/(c*c), 0);
+
+        daz[kNPAE] += -tan(p.Alt());
+
+        p += NPAE;
+    }
+
+    // ----- ANAW -----
+    {
+        // See CalcAnAw: v1 = Rx(-aw)*Ry(-an)*v
+        const Double_t sa = sin(p.Alt());
+        const Double_t ca = cos(p.Alt());
+        const Double_t sz = sin(p.Az());
+        const Double_t cz = cos(p.Az());
+
+        const Double_t sn = sin(-fAn);
+        const Double_t cn = cos(-fAn);
+        const Double_t sw = sin(-fAw);
+        const Double_t cw = cos(-fAw);
+
+        // Rotation of a vector: y-axis by -an, then x-axis by -aw
+        const auto rot = [&](const Double_t *v, Double_t *r)
+        {
+            const Double_t x = cn*v[0] + sn*v[2];
+            const Double_t z = cn*v[2] - sn*v[0];
+
+            r[0] = x;
+            r[1] = cw*v[1] - sw*z;
+            r[2] = sw*v[1] + cw*z;
+        };
+
+        const Double_t v[3]  = {  ca*cz,  ca*sz, sa };
+        const Double_t va[3] = { -sa*cz, -sa*sz, ca };
+        const Double_t vz[3] = { -ca*sz,  ca*cz,  0 };
+
+        Double_t v1[3], v1a[3], v1z[3];
+        rot(v,  v1);
+        rot(va, v1a);
+        rot(vz, v1z);
+
+        // Derivative of Ry(-an)*v is (-z, 0, x) of the rotated vector
+        const Double_t xn = cn*v[0] + sn*v[2];
+        const Double_t zn = cn*v[2] - sn*v[0];
+        const Double_t vn[3] = { -zn, 0, xn };
+
+        Double_t v1n[3];
+        v1n[0] = vn[0];
+        v1n[1] = cw*vn[1] - sw*vn[2];
+        v1n[2] = sw*vn[1] + cw*vn[2];
+
+        // Derivative of Rx(-aw)*v' is (0, z, -y) of the rotated vector
+        const Double_t v1w[3] = { 0, v1[2], -v1[1] };
+
+        // Theta and phi of the rotated vector
+        const Double_t rho2 = v1[0]*v1[0] + v1[1]*v1[1];
+        const Double_t rho  = sqrt(rho2);
+
+        const auto dtheta = [&](const Double_t *d) { return -d[2]/rho; };
+        const auto dphi   = [&](const Double_t *d) { return (v1[0]*d[1]-v1[1]*d[0])/rho2; };
+
+        const AltAz ANAW(CalcAnAw(p, -1));
+
+        // theta0 = pi/2-alt, phi0 = az
+        Propagate(dalt, daz, dtheta(v1a)+1, dtheta(v1z), dphi(v1a), dphi(v1z)-1);
+
+        dalt[kAN] += dtheta(v1n);   daz[kAN] += dphi(v1n);
+        dalt[kAW] += dtheta(v1w);   daz[kAW] += dphi(v1w);
+
+        p += ANAW;
+    }
+
+    // ----- FLOP -----
+    {
+        const AltAz FLOP(Sign(fFlop, p.Alt()), 0);
+
+        dalt[kFLOP] += Sign(1, p.Alt());
+
+        p += FLOP;
+    }
+
+    // ----- MAGIC1 -----
+    {
+        const Double_t sgn = TMath::Sign(1., sin(p.Az()));
+
+        const AltAz MAGIC1(fMagic1*sgn, 0);
+
+        dalt[kMAGIC1] += sgn;
+
+        p += MAGIC1;
+    }
+
+    // ----- I -----
+    const AltAz I(fIe, fIa);
+    p += I;
+
+    dalt[kIE] += 1;
+    daz[kIA]  += 1;
+
+    return p;
+}
+
 AltAz MPointing::CorrectBack(const AltAz &aa) const
 {
     // Correct [rad]
@@ -764,6 +992,12 @@ void MPointing::GetError(TArrayD &par) const
         par[i] *= TMath::RadToDeg();
 }
 
+void MPointing::SetError(const Double_t *err, Int_t n)
+{
+    while (n--)
+        fError[n] = err[n]/kRad2Deg;
+}
+
 TVector2 MPointing::GetDxy() const
 {
     return TVector2(fDx, fDy)*TMath::RadToDeg();
@@ -199,6 +199,7 @@ private:
 
     static Double_t Sign(Double_t val, Double_t alt);
     AltAz CalcAnAw(const AltAz &p, Int_t sign) const;
+    static void Propagate(Double_t *dalt, Double_t *daz, Double_t taa, Double_t taz, Double_t tza, Double_t tzz);
 
 public:
     MPointing() : fError(kNumPar) { Init(); Clear(); }
@@ -214,6 +215,8 @@ public:
     AltAz    Correct(const AltAz &aaz) const;
     TVector3 Correct(const TVector3 &v) const;
 
+    AltAz    Correct(const AltAz &aaz, Double_t *dalt, Double_t *daz) const;
+
     ZdAz     CorrectBack(const ZdAz &zdaz) const;
     AltAz    CorrectBack(const AltAz &aaz) const;
     TVector3 CorrectBack(const TVector3 &v) const;
@@ -270,6 +273,7 @@ public:
         GetParameters(par.GetArray());
     }
     void GetError(TArrayD &par) const;
+    void SetError(const Double_t *err, Int_t n=kNumPar);
 
     Double_t &operator[](UInt_t i) { return *fCoeff[i]; }
 
@@ -0,0 +1,526 @@
+/////////////////////////////////////////////////////////////////////////////
+//
+// TPointFit
+// =========
+//
+// Headless fit of the pointing model (MPointing) to a set of tpoints
+// (TPointStar), e.g. for batch processing or bootstrapping without
+// the Telesto GUI.
+//
+// The residual of each star is the difference between the unit vector
+// of the measured position and the unit vector of the corrected star
+// position (chord distance). For the small residuals of a pointing
+// model it is identical to the great circle distance minimized by
+// TPointGui::Fcn, but it is smooth also at zero. The sum of squares is
+// minimized by a Levenberg-Marquardt algorithm using the analytic
+// derivatives of the model (see MPointing::Correct). The normal
+// equations are accumulated in parallel over the stars.
+//
+// Bootstrapping resamples the stars (with replacement) and fits each
+// resample. The resamples are fitted concurrently, each with its own
+// copy of the model. The random number generator of each resample is
+// seeded with seed+index, so that the result does not depend on the
+// number of threads.
+//
+/////////////////////////////////////////////////////////////////////////////
+#include "TPointFit.h"
+
+#include <math.h>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <iostream>
+#include <algorithm>
+
+#include <TMath.h>
+
+#include "TPointStar.h"
+
+using namespace std;
+
+void TPointFit::Normal::Reset(size_t n)
+{
+    fJtJ.assign(n*n, 0);
+    fJtr.assign(n, 0);
+
+    fSum  = 0;
+    fRes2 = 0;
+    fCnt  = 0;
+}
+
+void TPointFit::Normal::Add(const Normal &n)
+{
+    for (size_t i=0; i<fJtJ.size(); i++)
+        fJtJ[i] += n.fJtJ[i];
+    for (size_t i=0; i<fJtr.size(); i++)
+        fJtr[i] += n.fJtr[i];
+
+    fSum  += n.fSum;
+    fRes2 += n.fRes2;
+    fCnt  += n.fCnt;
+}
+
+TPointFit::TPointFit() : fFree(MPointing::GetNumPar(), kFALSE),
+    fNumThreads(0), fMaxIter(100), fTolerance(1e-10)
+{
+    // Same default as in TPointGui: IA, IE, AN, AW, NPAE, CA, TF, TX,
+    // ECEC, ACEC, NRX, NRY
+    const Int_t def[] = { 0, 1, 3, 4, 5, 6, 7, 8, 11, 12, 13, 14 };
+    for (auto i : def)
+        fFree[i] = kTRUE;
+}
+
+void TPointFit::AddStar(const TPointStar &star)
+{
+    const AltAz raw = star.GetRawAltAz();
+
+    Star s;
+    s.fStar   = star.GetStarAltAz();
+    s.fRaw[0] = cos(raw.Alt())*cos(raw.Az());
+    s.fRaw[1] = cos(raw.Alt())*sin(raw.Az());
+    s.fRaw[2] = sin(raw.Alt());
+
+    fStars.push_back(s);
+}
+
+UInt_t TPointFit::GetNumThreads() const
+{
+    if (fNumThreads>0)
+        return fNumThreads;
+
+    const UInt_t n = thread::hardware_concurrency();
+    return n==0 ? 1 : n;
+}
+
+// --------------------------------------------------------------------------
+//
+// Accumulates the normal equations of the stars [first, last). If weights
+// is given, each star is counted weights[i] times.
+//
+void TPointFit::Accumulate(const MPointing &bend, const uint32_t *weights, size_t first, size_t last, Normal &n) const
+{
+    const size_t m = fActive.size();
+
+    n.Reset(m);
+
+    vector<Double_t> dalt(MPointing::GetNumPar());
+    vector<Double_t> daz(MPointing::GetNumPar());
+    vector<Double_t> jac(3*m);
+
+    for (size_t i=first; i<last; i++)
+    {
+        const Double_t w = weights ? weights[i] : 1;
+        if (w==0)
+            continue;
+
+        const Star &star = fStars[i];
+
+        const AltAz p = bend.Correct(star.fStar, dalt.data(), daz.data());
+
+        const Double_t sa = sin(p.Alt());
+        const Double_t ca = cos(p.Alt());
+        const Double_t sz = sin(p.Az());
+        const Double_t cz = cos(p.Az());
+
+        const Double_t u[3]  = {  ca*cz,  ca*sz, sa };
+        const Double_t ua[3] = { -sa*cz, -sa*sz, ca };
+        const Double_t uz[3] = { -ca*sz,  ca*cz,  0 };
+
+        const Double_t r[3] =
+        {
+            star.fRaw[0]-u[0],
+            star.fRaw[1]-u[1],
+            star.fRaw[2]-u[2]
+        };
+
+        // Derivatives of the residual r = raw - u
+        for (size_t k=0; k<m; k++)
+        {
+            const Int_t j = fActive[k];
+            for (int c=0; c<3; c++)
+                jac[c*m+k] = -(ua[c]*dalt[j] + uz[c]*daz[j]);
+        }
+
+        for (size_t k=0; k<m; k++)
+        {
+            for (size_t l=k; l<m; l++)
+                n.fJtJ[k*m+l] += w*(jac[k]*jac[l] + jac[m+k]*jac[m+l] + jac[2*m+k]*jac[2*m+l]);
+
+            n.fJtr[k] += w*(jac[k]*r[0] + jac[m+k]*r[1] + jac[2*m+k]*r[2]);
+        }
+
+        // Great circle distance as in TPointStar::GetResidual
+        const Double_t d   = min(1., star.fRaw[0]*u[0] + star.fRaw[1]*u[1] + star.fRaw[2]*u[2]);
+        const Double_t res = acos(d)*TMath::RadToDeg();
+
+        n.fSum  += w*(r[0]*r[0] + r[1]*r[1] + r[2]*r[2]);
+        n.fRes2 += w*res*res;
+        n.fCnt  += w;
+    }
+}
+
+// --------------------------------------------------------------------------
+//
+// Accumulates the normal equations of all stars using nthreads threads.
+//
+void TPointFit::Evaluate(const MPointing &bend, const uint32_t *weights, UInt_t nthreads, Normal &n) const
+{
+    const size_t m = fActive.size();
+
+    // Don't split up small sets, the overhead would dominate
+    const size_t nstars = fStars.size();
+    const size_t nt     = max<size_t>(1, min<size_t>(nthreads, nstars/64));
+
+    if (nt==1)
+        Accumulate(bend, weights, 0, nstars, n);
+    else
+    {
+        vector<Normal> part(nt);
+        vector<thread> threads;
+
+        for (size_t i=0; i<nt; i++)
+            threads.emplace_back(&TPointFit::Accumulate, this, cref(bend), weights,
+                                 nstars*i/nt, nstars*(i+1)/nt, ref(part[i]));
+
+        for (auto &t : threads)
+            t.join();
+
+        n = part[0];
+        for (size_t i=1; i<nt; i++)
+            n.Add(part[i]);
+    }
+
+    // Only the upper triangle was accumulated
+    for (size_t k=0; k<m; k++)
+        for (size_t l=0; l<k; l++)
+            n.fJtJ[k*m+l] = n.fJtJ[l*m+k];
+}
+
+// --------------------------------------------------------------------------
+//
+// Cholesky decomposition of the symmetric n x n matrix a (in place, the
+// lower triangle is the result). Returns kFALSE if a is not positive
+// definite.
+//
+Bool_t TPointFit::Cholesky(vector<Double_t> &a, size_t n)
+{
+    for (size_t j=0; j<n; j++)
+    {
+        Double_t d = a[j*n+j];
+        for (size_t k=0; k<j; k++)
+            d -= a[j*n+k]*a[j*n+k];
+
+        if (d<=0)
+            return kFALSE;
+
+        d = sqrt(d);
+        a[j*n+j] = d;
+
+        for (size_t i=j+1; i<n; i++)
+        {
+            Double_t s = a[i*n+j];
+            for (size_t k=0; k<j; k++)
+                s -= a[i*n+k]*a[j*n+k];
+            a[i*n+j] = s/d;
+        }
+    }
+
+    return kTRUE;
+}
+
+// --------------------------------------------------------------------------
+//
+// Solves L*L^T*x = b with the result of Cholesky (in place)
+//
+void TPointFit::Substitute(const vector<Double_t> &l, Double_t *b, size_t n)
+{
+    for (size_t i=0; i<n; i++)
+    {
+        for (size_t k=0; k<i; k++)
+            b[i] -= l[i*n+k]*b[k];
+        b[i] /= l[i*n+i];
+    }
+
+    for (size_t i=n; i-->0; )
+    {
+        for (size_t k=i+1; k<n; k++)
+            b[i] -= l[k*n+i]*b[k];
+        b[i] /= l[i*n+i];
+    }
+}
+
+// --------------------------------------------------------------------------
+//
+// Levenberg-Marquardt minimization of the active parameters of bend,
+// starting from their current values. n contains the normal equations
+// at the minimum.
+//
+Bool_t TPointFit::Minimize(MPointing &bend, const uint32_t *weights, UInt_t nthreads, Normal &n, Result &res) const
+{
+    const size_t m = fActive.size();
+
+    res.fIterations = 0;
+    res.fConverged  = kFALSE;
+
+    Evaluate(bend, weights, nthreads, n);
+
+    vector<Double_t> par(m);
+    vector<Double_t> a(m*m);
+    vector<Double_t> b(m);
+
+    Normal trial;
+
+    Double_t lambda = 1e-3;
+
+    while (res.fIterations<Int_t(fMaxIter))
+    {
+        res.fIterations++;
+
+        for (size_t i=0; i<m; i++)
+            par[i] = bend[fActive[i]];
+
+        // Increase the damping until the step decreases the sum of squares
+        Bool_t accepted = kFALSE;
+        for (; lambda<1e10; lambda *= 10)
+        {
+            a = n.fJtJ;
+            for (size_t i=0; i<m; i++)
+            {
+                a[i*m+i] *= 1+lambda;
+                b[i] = -n.fJtr[i];
+            }
+
+            if (!Cholesky(a, m))
+                continue;
+
+            Substitute(a, b.data(), m);
+
+            for (size_t i=0; i<m; i++)
+                bend[fActive[i]] = par[i]+b[i];
+
+            Evaluate(bend, weights, nthreads, trial);
+            if (trial.fSum<=n.fSum)
+            {
+                accepted = kTRUE;
+                break;
+            }
+        }
+
+        if (!accepted)
+        {
+            // No step decreases the sum anymore: we are at the minimum
+            for (size_t i=0; i<m; i++)
+                bend[fActive[i]] = par[i];
+
+            res.fConverged = kTRUE;
+            break;
+        }
+
+        const Double_t change = n.fSum-trial.fSum;
+
+        swap(n, trial);
+
+        lambda = max(lambda/10, 1e-12);
+
+        if (change<=fTolerance*n.fSum)
+        {
+            res.fConverged = kTRUE;
+            break;
+        }
+    }
+
+    // Same as TPointGui::Fcn
+    const Double_t err = 0.0043; // [deg]
+
+    res.fNumStars = Int_t(n.fCnt);
+    res.fChi2     = n.fCnt>0 ? n.fRes2/(err*err)/n.fCnt : 0;
+    res.fRms      = n.fCnt>0 ? sqrt(n.fRes2/n.fCnt) : 0;
+
+    return res.fConverged;
+}
+
+// --------------------------------------------------------------------------
+//
+// Errors [rad] of the active parameters from the covariance matrix at
+// the minimum. The variance of the residuals is estimated from the
+// data (two degrees of freedom per star).
+//
+Bool_t TPointFit::Covariance(const Normal &n, vector<Double_t> &err) const
+{
+    const size_t m = fActive.size();
+
+    err.assign(m, 0);
+
+    // Parameters which are (almost) degenerate, e.g. TF and ECEC, make
+    // the matrix singular. A small regularization of the diagonal makes
+    // their errors large instead of failing.
+    vector<Double_t> l;
+    for (Double_t eps=0; ; eps = eps==0 ? 1e-15 : eps*100)
+    {
+        if (eps>1e-6)
+            return kFALSE;
+
+        l = n.fJtJ;
+        for (size_t i=0; i<m; i++)
+            l[i*m+i] *= 1+eps;
+
+        if (Cholesky(l, m))
+            break;
+    }
+
+    const Double_t ndf = 2*n.fCnt-m;
+    const Double_t var = ndf>0 ? n.fSum/ndf : 0;
+
+    vector<Double_t> col(m);
+    for (size_t i=0; i<m; i++)
+    {
+        fill(col.begin(), col.end(), 0);
+        col[i] = 1;
+
+        Substitute(l, col.data(), m);
+
+        err[i] = sqrt(col[i]*var);
+    }
+
+    return kTRUE;
+}
+
+// --------------------------------------------------------------------------
+//
+// Fits the free parameters of bend to all stars, starting from the
+// current values of bend. The fitted values and their errors are
+// stored in bend, the errors of all other parameters are kept.
+// Free parameters on which the model does not depend are not fitted.
+//
+Bool_t TPointFit::Fit(MPointing &bend, Result &res)
+{
+    res.fChi2       = 0;
+    res.fRms        = 0;
+    res.fNumStars   = 0;
+    res.fIterations = 0;
+    res.fConverged  = kFALSE;
+
+    if (fStars.empty())
+    {
+        cout << "TPointFit::Fit: ERROR - No stars." << endl;
+        return kFALSE;
+    }
+
+    fActive.clear();
+    for (Int_t i=0; i<MPointing::GetNumPar(); i++)
+        if (fFree[i])
+            fActive.push_back(i);
+
+    const UInt_t nthreads = GetNumThreads();
+
+    Normal n;
+    Evaluate(bend, 0, nthreads, n);
+
+    vector<Int_t> active;
+    for (size_t i=0; i<fActive.size(); i++)
+    {
+        if (n.fJtJ[i*fActive.size()+i]>0)
+            active.push_back(fActive[i]);
+        else
+            cout << "TPointFit::Fit: WARNING - Model does not depend on " << bend.GetVarName(fActive[i]) << ", not fitted." << endl;
+    }
+    fActive = active;
+
+    if (fActive.empty())
+    {
+        cout << "TPointFit::Fit: ERROR - No parameters to be fitted." << endl;
+        return kFALSE;
+    }
+
+    if (!Minimize(bend, 0, nthreads, n, res))
+        cout << "TPointFit::Fit: WARNING - No convergence after " << res.fIterations << " iterations." << endl;
+
+    vector<Double_t> err;
+    if (!Covariance(n, err))
+        cout << "TPointFit::Fit: WARNING - Covariance matrix not positive definite." << endl;
+
+    TArrayD errors;
+    bend.GetError(errors);
+    for (size_t i=0; i<fActive.size(); i++)
+        errors[fActive[i]] = err[i]*TMath::RadToDeg();
+    bend.SetError(errors.GetArray());
+
+    return res.fConverged;
+}
+
+// --------------------------------------------------------------------------
+//
+// Fits num bootstrap resamples of the stars, starting from the values of
+// bend. Fit must have been called before to define the parameters to be
+// fitted. par[i] contains the parameters [deg] of the i-th resample.
+// The resamples are distributed over the threads, each resample is
+// fitted by a single thread.
+//
+Bool_t TPointFit::Bootstrap(const MPointing &bend, UInt_t num, UInt_t seed, vector<vector<Double_t>> &par) const
+{
+    if (fActive.empty() || fStars.empty())
+    {
+        cout << "TPointFit::Bootstrap: ERROR - Fit not yet done." << endl;
+        return kFALSE;
+    }
+
+    const Int_t npar = MPointing::GetNumPar();
+
+    vector<Double_t> start(npar);
+    bend.GetParameters(start.data());
+
+    par.assign(num, vector<Double_t>(npar));
+
+    const UInt_t nt = min(GetNumThreads(), num);
+
+    // The models are created here, so that no ROOT object
+    // is created in the threads
+    vector<MPointing*> models(nt);
+    for (auto &m : models)
+        m = new MPointing;
+
+    atomic<UInt_t> next(0);
+    atomic<UInt_t> failed(0);
+
+    const auto worker = [&](MPointing *model)
+    {
+        const size_t nstars = fStars.size();
+
+        vector<uint32_t> weights(nstars);
+
+        Normal n;
+        Result res;
+
+        for (UInt_t idx=next++; idx<num; idx=next++)
+        {
+            mt19937 rndm(seed+idx);
+            uniform_int_distribution<size_t> dist(0, nstars-1);
+
+            fill(weights.begin(), weights.end(), 0);
+            for (size_t i=0; i<nstars; i++)
+                weights[dist(rndm)]++;
+
+            model->SetParameters(start.data());
+
+            if (!Minimize(*model, weights.data(), 1, n, res))
+                failed++;
+
+            model->GetParameters(par[idx].data());
+        }
+    };
+
+    vector<thread> threads;
+    for (auto m : models)
+        threads.emplace_back(worker, m);
+
+    for (auto &t : threads)
+        t.join();
+
+    for (auto m : models)
+        delete m;
+
+    if (failed>0)
+        cout << "TPointFit::Bootstrap: WARNING - " << failed << " of " << num << " resamples did not converge." << endl;
+
+    return kTRUE;
+}
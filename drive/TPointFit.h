@@ -0,0 +1,86 @@
+#ifndef COSY_TPointFit
+#define COSY_TPointFit
+
+#include <vector>
+#include <stdint.h>
+
+#ifndef MARS_MPointing
+#include "MPointing.h"
+#endif
+
+class TPointStar;
+
+class TPointFit
+{
+public:
+    struct Result
+    {
+        Double_t fChi2;        // as TPointGui::Fcn: mean of (residual/0.0043deg)^2
+        Double_t fRms;         // [deg] rms of the residuals
+        Int_t    fNumStars;    // number of stars (including multiplicities)
+        Int_t    fIterations;  // number of iterations
+        Bool_t   fConverged;   // whether the fit converged
+    };
+
+private:
+    struct Star
+    {
+        AltAz    fStar;        // [rad] star position (to be corrected)
+        Double_t fRaw[3];      // unit vector of the measured position
+    };
+
+    // Normal equations of the linearized least squares problem
+    struct Normal
+    {
+        std::vector<Double_t> fJtJ; // fNumActive x fNumActive
+        std::vector<Double_t> fJtr; // fNumActive
+
+        Double_t fSum;         // sum of the squared chord distances [rad^2]
+        Double_t fRes2;        // sum of the squared residuals [deg^2]
+        Double_t fCnt;         // number of stars
+
+        void Reset(size_t n);
+        void Add(const Normal &n);
+    };
+
+    std::vector<Star> fStars;
+
+    std::vector<Bool_t> fFree;    // parameters to be fitted
+    std::vector<Int_t>  fActive;  // fitted parameters with non-zero derivatives
+
+    UInt_t   fNumThreads;  // threads for the evaluation (0: number of cores)
+    UInt_t   fMaxIter;     // maximum number of iterations
+    Double_t fTolerance;   // relative change of the sum of squares for convergence
+
+    void Accumulate(const MPointing &bend, const uint32_t *weights, size_t first, size_t last, Normal &n) const;
+    void Evaluate(const MPointing &bend, const uint32_t *weights, UInt_t nthreads, Normal &n) const;
+
+    Bool_t Minimize(MPointing &bend, const uint32_t *weights, UInt_t nthreads, Normal &n, Result &res) const;
+    Bool_t Covariance(const Normal &n, std::vector<Double_t> &err) const;
+
+    static Bool_t Cholesky(std::vector<Double_t> &a, size_t n);
+    static void   Substitute(const std::vector<Double_t> &l, Double_t *b, size_t n);
+
+    UInt_t GetNumThreads() const;
+
+public:
+    TPointFit();
+
+    void AddStar(const TPointStar &star);
+    void ClearStars() { fStars.clear(); }
+
+    size_t GetNumStars() const { return fStars.size(); }
+
+    void FixParameter(Int_t i)     { fFree[i] = kFALSE; }
+    void ReleaseParameter(Int_t i) { fFree[i] = kTRUE; }
+    Bool_t IsFree(Int_t i) const   { return fFree[i]; }
+
+    void SetNumThreads(UInt_t n)   { fNumThreads = n; }
+    void SetMaxIter(UInt_t n)      { fMaxIter = n; }
+    void SetTolerance(Double_t t)  { fTolerance = t; }
+
+    Bool_t Fit(MPointing &bend, Result &res);
+    Bool_t Bootstrap(const MPointing &bend, UInt_t num, UInt_t seed, std::vector<std::vector<Double_t>> &par) const;
+};
+
+#endif
@@ -0,0 +1,321 @@
+#include <math.h>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+
+#include <TROOT.h>
+#include <TSystem.h>
+#include <TObjArray.h>
+#include <TStopwatch.h>
+
+#include "MAGIC.h"
+
+#include "MLog.h"
+#include "MLogManip.h"
+
+#include "MArgs.h"
+
+#include "MPointing.h"
+#include "TPointStar.h"
+#include "TPointFit.h"
+
+using namespace std;
+
+static void StartUpMessage()
+{
+    gLog << all << endl;
+
+    //                1         2         3         4         5         6
+    //       123456789012345678901234567890123456789012345678901234567890
+    gLog << "========================================================" << endl;
+    gLog << "                    TPointFit - COSY"                     << endl;
+    gLog << "       Headless fit of the pointing model to tpoints"     << endl;
+    gLog << "       Compiled with ROOT v" << ROOT_RELEASE << " on <" << __DATE__ << ">" << endl;
+    gLog << "========================================================" << endl;
+    gLog << endl;
+}
+
+static void Usage()
+{
+    //                1         2         3         4         5         6         7         8
+    //       12345678901234567890123456789012345678901234567890123456789012345678901234567890
+    gLog << all << endl;
+    gLog << "Sorry the usage is:" << endl;
+    gLog << " tpointfit [options] file.txt|file.col [pointing.mod]" << endl << endl;
+    gLog << " Arguments:" << endl;
+    gLog << "   file.txt|file.col         A collection of files or a file with tpoints" << endl;
+    gLog << "   pointing.mod              A pointing model used as start values" << endl << endl;
+    gLog << " Options:" << endl;
+    gLog.Usage();
+    gLog << endl;
+    gLog << " Fit options:" << endl;
+    gLog << "   --free=IA,IE,...          Parameters to be fitted (default as in Telesto:" << endl;
+    gLog << "                             IA,IE,AN,AW,NPAE,CA,TF,TX,ECEC,ACEC,NRX,NRY)" << endl;
+    gLog << "   --zd-min=0 --zd-max=90    Range of the zenith distance of the stars [deg]" << endl;
+    gLog << "   --az-min=0 --az-max=360   Range of the azimuth of the stars [deg]" << endl;
+    gLog << "   --mag-max=10              Maximum magnitude of the stars" << endl;
+    gLog << "   --threads=0               Number of threads (0: number of cores)" << endl;
+    gLog << "   --bootstrap=0             Number of bootstrap resamples" << endl;
+    gLog << "   --seed=0                  Seed of the first bootstrap resample" << endl << endl;
+    gLog << " Output options:" << endl;
+    gLog << "   --out=pointing.mod        Write the fitted model to this file. If bootstrap" << endl;
+    gLog << "                             resamples are fitted, their standard deviations" << endl;
+    gLog << "                             are written as errors." << endl << endl;
+    gLog << "   --version, -V             Show startup message with version number" << endl;
+    gLog << "   -?, -h, --help            This help" << endl << endl;
+}
+
+// Same as TPointGui::LoadStars
+static void LoadStars(TString fname, vector<TPointStar> &stars);
+
+static void LoadCollection(TString fname, vector<TPointStar> &stars)
+{
+    ifstream fin(fname);
+    if (!fin)
+    {
+        gLog << err << "Collection '" << fname << "' not found!" << endl;
+        return;
+    }
+
+    while (1)
+    {
+        TString line;
+        line.ReadLine(fin);
+        if (!fin)
+            break;
+
+        line = line.Strip(TString::kBoth);
+        if (line[0]=='#')
+            continue;
+        if (line.Length()==0)
+            continue;
+
+        LoadStars(line, stars);
+    }
+}
+
+static void LoadStars(TString fname, vector<TPointStar> &stars)
+{
+    if (fname.EndsWith(".col"))
+    {
+        LoadCollection(fname, stars);
+        return;
+    }
+
+    const size_t size = stars.size();
+
+    ifstream fin(fname);
+
+    while (fin && fin.get()!='\n');
+    while (fin && fin.get()!='\n');
+    while (fin && fin.get()!='\n');
+    if (!fin)
+    {
+        gLog << err << "File '" << fname << "' not found!" << endl;
+        return;
+    }
+
+    TPointStar set(fname);
+
+    while (1)
+    {
+        fin >> set;  // Read data from file [deg], it is stored in [rad]
+        if (!fin)
+            break;
+
+        stars.push_back(set);
+    }
+
+    gLog << inf << "Found " << stars.size()-size;
+    gLog << " sets of coordinates in " << fname;
+    gLog << " (Total=" << stars.size() << ")" << endl;
+}
+
+int main(int argc, char **argv)
+{
+    if (!MARS::CheckRootVer())
+        return 0xff;
+
+    MLog::RedirectErrorHandler(MLog::kColor);
+
+    //
+    // Evaluate arguments
+    //
+    MArgs arg(argc, argv);
+    gLog.Setup(arg);
+
+    StartUpMessage();
+
+    if (arg.HasOnly("-V") || arg.HasOnly("--version"))
+        return 0;
+
+    if (arg.HasOnly("-?") || arg.HasOnly("-h") || arg.HasOnly("--help"))
+    {
+        Usage();
+        return 2;
+    }
+
+    const TString  kFree      = arg.GetStringAndRemove("--free=", "");
+    const Double_t kZdMin     = arg.GetFloatAndRemove("--zd-min=",   0);
+    const Double_t kZdMax     = arg.GetFloatAndRemove("--zd-max=",  90);
+    const Double_t kAzMin     = arg.GetFloatAndRemove("--az-min=",   0);
+    const Double_t kAzMax     = arg.GetFloatAndRemove("--az-max=", 360);
+    const Double_t kMagMax    = arg.GetFloatAndRemove("--mag-max=", 10);
+    const Int_t    kThreads   = arg.GetIntAndRemove("--threads=",    0);
+    const Int_t    kBootstrap = arg.GetIntAndRemove("--bootstrap=",  0);
+    const Int_t    kSeed      = arg.GetIntAndRemove("--seed=",       0);
+    const TString  kOut       = arg.GetStringAndRemove("--out=", "");
+
+    //
+    // check for the right usage of the program (number of options)
+    //
+    if (arg.GetNumOptions()>0)
+    {
+        gLog << warn << "WARNING - Unknown commandline options..." << endl;
+        arg.Print("options");
+        gLog << endl;
+        return 2;
+    }
+
+    //
+    // check for the right usage of the program (number of arguments)
+    //
+    if (arg.GetNumArguments()<1 || arg.GetNumArguments()>2)
+    {
+        gLog << warn << "WARNING - Wrong number of arguments..." << endl;
+        Usage();
+        return 2;
+    }
+
+    const TString fname = arg.GetArgumentStr(0);
+    const TString mod   = arg.GetArgumentStr(1);
+
+    MPointing bend;
+    if (!mod.IsNull() && !bend.Load(mod))
+        return 1;
+
+    TPointFit fit;
+    fit.SetNumThreads(kThreads);
+
+    if (!kFree.IsNull())
+    {
+        for (Int_t i=0; i<MPointing::GetNumPar(); i++)
+            fit.FixParameter(i);
+
+        TObjArray *arr = kFree.Tokenize(",");
+        for (Int_t j=0; j<arr->GetEntries(); j++)
+        {
+            const TString name = arr->At(j)->GetName();
+
+            Int_t i = 0;
+            while (i<MPointing::GetNumPar() && bend.GetVarName(i)!=name)
+                i++;
+
+            if (i==MPointing::GetNumPar())
+            {
+                gLog << err << "ERROR - Unknown parameter " << name << endl;
+                delete arr;
+                return 2;
+            }
+
+            fit.ReleaseParameter(i);
+        }
+        delete arr;
+    }
+
+    vector<TPointStar> stars;
+    LoadStars(fname, stars);
+
+    for (auto &set : stars)
+    {
+        if (set.GetStarZd()<kZdMin || set.GetStarZd()>kZdMax ||
+            set.GetStarAz()<kAzMin || set.GetStarAz()>kAzMax ||
+            set.GetMag()   >kMagMax)
+            continue;
+
+        fit.AddStar(set);
+    }
+
+    gLog << inf << "Using " << fit.GetNumStars() << " of " << stars.size() << " stars." << endl;
+
+    TStopwatch clock;
+
+    TPointFit::Result res;
+    const Bool_t rc = fit.Fit(bend, res);
+
+    clock.Stop();
+
+    gLog << all << endl;
+    gLog << "Fit " << (rc?"converged":"did not converge") << " after " << res.fIterations << " iterations (";
+    gLog << Form("%.3f", clock.RealTime()) << "s)" << endl;
+    gLog << "Chi^2/N = " << Form("%.3f", res.fChi2) << "  (N=" << res.fNumStars << ")" << endl;
+    gLog << "RMS     = " << Form("%.2f", res.fRms*3600) << "\"" << endl << endl;
+
+    TArrayD par, err;
+    bend.GetParameters(par);
+    bend.GetError(err);
+
+    vector<Double_t> mean(MPointing::GetNumPar());
+    vector<Double_t> sigma(MPointing::GetNumPar());
+
+    if (kBootstrap>0)
+    {
+        clock.Start();
+
+        vector<vector<Double_t>> boot;
+        fit.Bootstrap(bend, kBootstrap, kSeed, boot);
+
+        clock.Stop();
+
+        gLog << inf << kBootstrap << " bootstrap resamples fitted in ";
+        gLog << Form("%.3f", clock.RealTime()) << "s" << endl << endl;
+
+        for (Int_t i=0; i<MPointing::GetNumPar(); i++)
+        {
+            Double_t sum=0, sum2=0;
+            for (const auto &p : boot)
+            {
+                sum  += p[i];
+                sum2 += p[i]*p[i];
+            }
+
+            mean[i]  = sum/kBootstrap;
+            sigma[i] = sqrt(max(0., sum2/kBootstrap - mean[i]*mean[i]));
+        }
+    }
+
+    gLog << all;
+    gLog << " Name             Value        Error";
+    if (kBootstrap>0)
+        gLog << "    Bootstrap Mean        Sigma";
+    gLog << endl;
+
+    for (Int_t i=0; i<MPointing::GetNumPar(); i++)
+    {
+        if (!fit.IsFree(i) && par[i]==0)
+            continue;
+
+        gLog << (fit.IsFree(i) ? " " : "=") << setw(6) << left << bend.GetVarName(i) << right;
+        gLog << Form(" %+13.6f %12.6f", par[i], err[i]);
+        if (kBootstrap>0 && fit.IsFree(i))
+        {
+            gLog << Form("  %+13.6f %12.6f", mean[i], sigma[i]);
+            err[i] = sigma[i];
+        }
+        gLog << endl;
+    }
+    gLog << endl;
+
+    if (kOut.IsNull())
+        return rc ? 0 : 1;
+
+    if (kBootstrap>0)
+        bend.SetError(err.GetArray());
+
+    if (!bend.Save(kOut))
+        return 1;
+
+    gLog << inf << "Pointing model written to " << kOut << endl;
+
+    return rc ? 0 : 1;
+}
@@ -12,6 +12,14 @@
 #include "ofits.h"
 #endif
 
+#ifndef __CINT__
+#include <thread>
+#endif
+
+#if !defined(__CINT__) && defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 class DrsCalibrate
 {
 protected:
@@ -49,140 +57,201 @@ public:
         fSum2.assign(samples*channels, 0);
     }
 
-    void AddRel(const int16_t *val, const int16_t *start)
+protected:
+#if !defined(__CINT__) && defined(__SSE2__)
+    // Adds the four int32 values of x (sign extended) to sum[0..3]
+    static void Add4(int64_t *sum, const __m128i x)
     {
-        /*
-        for (size_t ch=0; ch<fNumChannels; ch++)
+        const __m128i sign = _mm_srai_epi32(x, 31);
+
+        __m128i *p = reinterpret_cast<__m128i*>(sum);
+        _mm_storeu_si128(p,   _mm_add_epi64(_mm_loadu_si128(p),   _mm_unpacklo_epi32(x, sign)));
+        _mm_storeu_si128(p+1, _mm_add_epi64(_mm_loadu_si128(p+1), _mm_unpackhi_epi32(x, sign)));
+    }
+#endif
+
+    // sum[i] += val[i] and sum2[i] += val[i]^2 for n samples. The square
+    // of an int16_t fits into an int32_t, so eight samples are processed
+    // at once with SSE2.
+    static void AddSamples(const int16_t *val, int64_t *sum, int64_t *sum2, size_t n)
+    {
+        size_t i = 0;
+#if !defined(__CINT__) && defined(__SSE2__)
+        for (; i+8<=n; i+=8)
         {
-            const int16_t &spos = start[ch];
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(val+i));
+
+            // Sign extension to int32
+            const __m128i sign = _mm_srai_epi16(v, 15);
+            Add4(sum+i,   _mm_unpacklo_epi16(v, sign));
+            Add4(sum+i+4, _mm_unpackhi_epi16(v, sign));
+
+            // Low and high 16 bit of the 32 bit squares
+            const __m128i lo = _mm_mullo_epi16(v, v);
+            const __m128i hi = _mm_mulhi_epi16(v, v);
+            Add4(sum2+i,   _mm_unpacklo_epi16(lo, hi));
+            Add4(sum2+i+4, _mm_unpackhi_epi16(lo, hi));
+        }
+#endif
+        for (; i<n; i++)
+        {
+            const int64_t v = val[i];
+
+            sum[i]  += v;
+            sum2[i] += v*v;
+        }
+    }
+
+    // The same with v = val[i]*scale - offset[i]. The products need
+    // 64 bit, so this loop is left to the compiler.
+    static void AddSamples(const int16_t *val, const int32_t *offset, const int64_t scale,
+                           int64_t *sum, int64_t *sum2, size_t n)
+    {
+        for (size_t i=0; i<n; i++)
+        {
+            const int64_t v = int64_t(val[i])*scale - offset[i];
+
+            sum[i]  += v;
+            sum2[i] += v*v;
+        }
+    }
+
+    // The following functions accumulate the channels [first, last) of
+    // one event, but do not count the event (fNumEntries). Different
+    // channels are accumulated into disjoint parts of fSum and fSum2,
+    // so disjoint channel ranges can be processed by several threads.
+    // Splitting the loops at the end of the DRS ring buffer instead of
+    // evaluating %1024 for each sample keeps them simple for the compiler.
+
+    void AddRelRange(const int16_t *val, const int16_t *start, size_t first, size_t last)
+    {
+        for (size_t ch=first; ch<last; ch++)
+        {
+            const int16_t spos = start[ch];
             if (spos<0)
                 continue;
 
             const size_t pos = ch*1024;
-            for (size_t i=0; i<1024; i++)
-            {
-                // Value is relative to trigger
-                // Abs is corresponding index relative to DRS pipeline
-                const size_t rel = pos +  i;
-                const size_t abs = pos + (spos+i)%1024;
 
-                const int64_t v = val[rel];
+            // Samples up to the end of the DRS ring buffer
+            const size_t n = spos<1024 ? 1024-spos : 0;
 
-                fSum[abs]  += v;
-                fSum2[abs] += v*v;
-            }
-        }*/
+            // Value is relative to trigger, the sums are relative to the DRS pipeline
+            AddSamples(val+pos,   fSum.data()+pos+spos, fSum2.data()+pos+spos, n);
+            AddSamples(val+pos+n, fSum.data()+pos,      fSum2.data()+pos,      1024-n);
+        }
+    }
 
-        // This version is 2.5 times faster because the compilers optimization
-        // is not biased by the evaluation of %1024
-        for (size_t ch=0; ch<fNumChannels; ch++)
+    void AddRelRange(const int16_t *val,    const int16_t *start,
+                     const int32_t *offset, const int64_t scale, size_t first, size_t last)
+    {
+        for (size_t ch=first; ch<last; ch++)
         {
-            const int16_t &spos = start[ch];
+            const int16_t spos = start[ch];
             if (spos<0)
                 continue;
 
             const size_t pos = ch*1024;
+            const size_t n   = spos<1024 ? 1024-spos : 0;
 
-            const int16_t *beg_val  = val          + pos;
-            int64_t       *beg_sum  = fSum.data()  + pos;
-            int64_t       *beg_sum2 = fSum2.data() + pos;
-
-            const int16_t *pval  = beg_val;          // val[rel]
-            int64_t       *psum  = beg_sum  + spos;  // fSum[abs]
-            int64_t       *psum2 = beg_sum2 + spos;  // fSum2[abs]
+            // Value is relative to trigger, offset and sums are relative to the DRS pipeline
+            AddSamples(val+pos,   offset+pos+spos, scale, fSum.data()+pos+spos, fSum2.data()+pos+spos, n);
+            AddSamples(val+pos+n, offset+pos,      scale, fSum.data()+pos,      fSum2.data()+pos,      1024-n);
+        }
+    }
 
-            while (psum<beg_sum+1024)
-            {
-                const int64_t v = *pval++;
+    void AddAbsRange(const int16_t *val,    const int16_t *start,
+                     const int32_t *offset, const int64_t scale, size_t first, size_t last)
+    {
+        for (size_t ch=first; ch<last; ch++)
+        {
+            const int16_t spos = start[ch];
+            if (spos<0)
+                continue;
 
-                *psum++  += v;
-                *psum2++ += v*v;
-            }
+            const size_t pos = ch*fNumSamples;
 
-            psum  = beg_sum;
-            psum2 = beg_sum2;
+            const int32_t *beg_offset = offset + ch*1024;
 
-            while (pval<beg_val+1024)
-            {
-                const int64_t v = *pval++;
+            // Samples up to the end of the DRS ring buffer
+            const size_t n = spos+fNumSamples<=1024 ? fNumSamples : (spos<1024 ? 1024-spos : 0);
 
-                *psum++  += v;
-                *psum2++ += v*v;
-            }
+            // Value and sums are relative to trigger, offset is relative to the DRS pipeline
+            AddSamples(val+pos,   beg_offset+spos, scale, fSum.data()+pos,   fSum2.data()+pos,   n);
+            AddSamples(val+pos+n, beg_offset,      scale, fSum.data()+pos+n, fSum2.data()+pos+n, fNumSamples-n);
         }
+    }
 
-        fNumEntries++;
+    // Mean and rms (scaled by scale) of the samples of the channels
+    // [first, last), see GetSampleStats(float*, float)
+    void GetSampleStatsRange(float *ptr, float scale, size_t first, size_t last) const
+    {
+        const size_t sz = fNumSamples*fNumChannels;
+
+        for (size_t i=first*fNumSamples; i<last*fNumSamples; i++)
+        {
+            ptr[i]    = scale*double(fSum[i])/fNumEntries;
+            ptr[i+sz] = scale*sqrt(double(fSum2[i]*fNumEntries - fSum[i]*fSum[i]))/fNumEntries;
+        }
     }
 
-    void AddRel(const int16_t *val,    const int16_t *start,
-                const int32_t *offset, const int64_t scale)
+public:
+    void AddRel(const int16_t *val, const int16_t *start)
     {
         /*
         for (size_t ch=0; ch<fNumChannels; ch++)
         {
-            const int16_t spos = start[ch];
+            const int16_t &spos = start[ch];
             if (spos<0)
                 continue;
 
             const size_t pos = ch*1024;
-
-            for (size_t i=0; i<fNumSamples; i++)
+            for (size_t i=0; i<1024; i++)
             {
                 // Value is relative to trigger
-                // Offset is relative to DRS pipeline
                 // Abs is corresponding index relative to DRS pipeline
                 const size_t rel = pos +  i;
                 const size_t abs = pos + (spos+i)%1024;
 
-                const int64_t v = int64_t(val[rel])*scale-offset[abs];
+                const int64_t v = val[rel];
 
                 fSum[abs]  += v;
                 fSum2[abs] += v*v;
             }
         }*/
 
-        // This version is 2.5 times faster because the compilers optimization
-        // is not biased by the evaluation of %1024
+        AddRelRange(val, start, 0, fNumChannels);
+        fNumEntries++;
+    }
+
+    void AddRel(const int16_t *val,    const int16_t *start,
+                const int32_t *offset, const int64_t scale)
+    {
+        /*
         for (size_t ch=0; ch<fNumChannels; ch++)
         {
-            const int16_t &spos = start[ch];
+            const int16_t spos = start[ch];
             if (spos<0)
                 continue;
 
             const size_t pos = ch*1024;
 
-            const int16_t *beg_val    = val          + pos;
-            const int32_t *beg_offset = offset       + pos;
-            int64_t       *beg_sum    = fSum.data()  + pos;
-            int64_t       *beg_sum2   = fSum2.data() + pos;
-
-
-            const int16_t *pval    = beg_val;            // val[rel]
-            const int32_t *poffset = beg_offset + spos;  // offset[abs]
-            int64_t       *psum    = beg_sum    + spos;  // fSum[abs]
-            int64_t       *psum2   = beg_sum2   + spos;  // fSum2[abs]
-
-            while (psum<beg_sum+1024)
+            for (size_t i=0; i<fNumSamples; i++)
             {
-                const int64_t v = int64_t(*pval++)*scale - *poffset++;
-
-                *psum++  += v;
-                *psum2++ += v*v;
-            }
-
-            psum    = beg_sum;
-            psum2   = beg_sum2;
-            poffset = beg_offset;
+                // Value is relative to trigger
+                // Offset is relative to DRS pipeline
+                // Abs is corresponding index relative to DRS pipeline
+                const size_t rel = pos +  i;
+                const size_t abs = pos + (spos+i)%1024;
 
-            while (pval<beg_val+1024)
-            {
-                const int64_t v = int64_t(*pval++)*scale - *poffset++;
+                const int64_t v = int64_t(val[rel])*scale-offset[abs];
 
-                *psum++  += v;
-                *psum2++ += v*v;
+                fSum[abs]  += v;
+                fSum2[abs] += v*v;
             }
-        }
+        }*/
 
+        AddRelRange(val, start, offset, scale, 0, fNumChannels);
         fNumEntries++;
     }
     /*
@@ -244,49 +313,7 @@ public:
             }
             }*/
 
-        // This version is 1.5 times faster because the compilers optimization
-        // is not biased by the evaluation of %1024
-        for (size_t ch=0; ch<fNumChannels; ch++)
-        {
-            const int16_t &spos = start[ch];
-            if (spos<0)
-                continue;
-
-            const size_t pos = ch*fNumSamples;
-
-            const int32_t *beg_offset = offset       + ch*1024;
-            const int16_t *beg_val    = val          + pos;
-            int64_t *beg_sum          = fSum.data()  + pos;
-            int64_t *beg_sum2         = fSum2.data() + pos;
-
-
-            const int16_t *pval    = beg_val;             // val[rel]
-            const int32_t *poffset = beg_offset + spos;   // offset[abs]
-            int64_t *psum          = beg_sum;             // fSum[rel]
-            int64_t *psum2         = beg_sum2;            // fSum2[rel]
-
-            if (spos+fNumSamples>1024)
-            {
-                while (poffset<beg_offset+1024)
-                {
-                    const int64_t v = int64_t(*pval++)*scale - *poffset++;
-
-                    *psum++  += v;
-                    *psum2++ += v*v;
-                }
-
-                poffset = beg_offset;
-            }
-
-            while (psum<beg_sum+fNumSamples)
-            {
-                const int64_t v = int64_t(*pval++)*scale - *poffset++;
-
-                *psum++  += v;
-                *psum2++ += v*v;
-            }
-        }
-
+        AddAbsRange(val, start, offset, scale, 0, fNumChannels);
         fNumEntries++;
     }
 
@@ -722,6 +749,31 @@ public:
 
         for (uint32_t i=0; i<roi-6; i++)
         {
+            // All patterns below require d54<-13 or d54>35, which is
+            // checked first (with SSE2 for four positions at once) to
+            // skip the samples without spikes. The previous positions
+            // can only have changed the samples up to ptr[i+3].
+#if !defined(__CINT__) && defined(__SSE2__)
+            if (i+3<roi-6)
+            {
+                const __m128 d = _mm_sub_ps(_mm_loadu_ps(ptr+i+5), _mm_loadu_ps(ptr+i+4));
+
+                int mask = _mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(d, _mm_set1_ps(-13)),
+                                                     _mm_cmpgt_ps(d, _mm_set1_ps( 35))));
+                if (mask==0)
+                {
+                    i += 3;
+                    continue;
+                }
+
+                for (; (mask&1)==0; mask>>=1)
+                    i++;
+            }
+#endif
+            const float d = ptr[i+5]-ptr[i+4];
+            if (d>=-13 && d<=35)
+                continue;
+
             double d10, d21, d32, d43, d54;
 
             // ============================================
@@ -784,7 +836,23 @@ public:
 
         for (float *pix=vec; pix<vec+1440*roi; pix += roi)
         {
-            for (float *ptr=pix; ptr<pix+roi-w; ptr++)
+            float *ptr = pix;
+
+#if !defined(__CINT__) && defined(__SSE2__)
+            // Four windows at once, each summed in the same order as
+            // below. The samples written are not read anymore.
+            const __m128 div = _mm_set1_ps(w);
+            for (; ptr+4<=pix+roi-w; ptr+=4)
+            {
+                __m128 sum = _mm_loadu_ps(ptr);
+                for (const float *p=ptr+1; p<ptr+w; p++)
+                    sum = _mm_add_ps(sum, _mm_loadu_ps(p));
+
+                _mm_storeu_ps(ptr, _mm_div_ps(sum, div));
+            }
+#endif
+
+            for (; ptr<pix+roi-w; ptr++)
             {
                 for (float *p=ptr+1; p<ptr+w; p++)
                     *ptr += *p;
@@ -838,19 +906,98 @@ public:
             return;
         }
 
-        std::vector<int64_t>::const_iterator it = fSum.begin();
-        std::vector<int64_t>::const_iterator i2 = fSum2.begin();
+        GetSampleStatsRange(ptr, scale, 0, fNumChannels);
+    }
 
-        while (it!=fSum.end())
+#if !defined(__CINT__) && defined(__SSE2__)
+    // Sample j of four consecutive pixels
+    static __m128 GetSample4(const float *data, uint32_t roi, uint32_t j)
+    {
+        return _mm_set_ps(data[3*roi+j], data[2*roi+j], data[roi+j], data[j]);
+    }
+
+    // Running statistics of four pixels (one in each lane) for
+    // GetPixelStats and GetPixelMax. The sums are double like in the
+    // scalar loop, the squares float. The maximum is the first sample
+    // which is larger than all previous ones.
+    struct PixelStats4
+    {
+        __m128d fSum[2];
+        __m128d fSum2[2];
+        __m128  fMax;
+        __m128i fPos;
+
+        PixelStats4(const __m128 v, uint32_t j) : fMax(v), fPos(_mm_set1_epi32(j))
         {
-            *ptr      = scale*double(*it)/fNumEntries;
-            *(ptr+sz) = scale*sqrt(double(*i2*fNumEntries - *it * *it))/fNumEntries;
+            const __m128 sq = _mm_mul_ps(v, v);
 
-            ptr++;
-            it++;
-            i2++;
+            fSum[0]  = _mm_cvtps_pd(v);
+            fSum[1]  = _mm_cvtps_pd(_mm_movehl_ps(v, v));
+            fSum2[0] = _mm_cvtps_pd(sq);
+            fSum2[1] = _mm_cvtps_pd(_mm_movehl_ps(sq, sq));
         }
-    }
+
+        void AddMax(const __m128 v, uint32_t j)
+        {
+            const __m128  gt  = _mm_cmpgt_ps(v, fMax);
+            const __m128i gti = _mm_castps_si128(gt);
+
+            fMax = _mm_or_ps(_mm_and_ps(gt, v), _mm_andnot_ps(gt, fMax));
+            fPos = _mm_or_si128(_mm_and_si128(gti, _mm_set1_epi32(j)), _mm_andnot_si128(gti, fPos));
+        }
+
+        void Add(const __m128 v, uint32_t j)
+        {
+            const __m128 sq = _mm_mul_ps(v, v);
+
+            fSum[0]  = _mm_add_pd(fSum[0],  _mm_cvtps_pd(v));
+            fSum[1]  = _mm_add_pd(fSum[1],  _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+            fSum2[0] = _mm_add_pd(fSum2[0], _mm_cvtps_pd(sq));
+            fSum2[1] = _mm_add_pd(fSum2[1], _mm_cvtps_pd(_mm_movehl_ps(sq, sq)));
+
+            AddMax(v, j);
+        }
+
+        // Adds the samples [beg, end) of the four pixels at data. Blocks
+        // of four samples are loaded per pixel and transposed.
+        template<bool max_only>
+        void AddRange(const float *data, uint32_t roi, uint32_t beg, uint32_t end)
+        {
+            uint32_t j = beg;
+            for (; j+4<=end; j+=4)
+            {
+                __m128 r0 = _mm_loadu_ps(data+0*roi+j);
+                __m128 r1 = _mm_loadu_ps(data+1*roi+j);
+                __m128 r2 = _mm_loadu_ps(data+2*roi+j);
+                __m128 r3 = _mm_loadu_ps(data+3*roi+j);
+                _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+                if (max_only)
+                {
+                    AddMax(r0, j);
+                    AddMax(r1, j+1);
+                    AddMax(r2, j+2);
+                    AddMax(r3, j+3);
+                }
+                else
+                {
+                    Add(r0, j);
+                    Add(r1, j+1);
+                    Add(r2, j+2);
+                    Add(r3, j+3);
+                }
+            }
+
+            for (; j<end; j++)
+            {
+                if (max_only)
+                    AddMax(GetSample4(data, roi, j), j);
+                else
+                    Add(GetSample4(data, roi, j), j);
+            }
+        }
+    };
+#endif
 
     static double GetPixelStats(float *ptr, const float *data, uint16_t roi, uint16_t begskip=0, uint16_t endskip=0)
     {
@@ -862,9 +1009,44 @@ public:
         const uint end = roi-beg>endskip ? roi-endskip : roi;
         const uint len = end-beg;
 
-        double max = 0;
-        double patch = 0;
-        for (uint i=0; i<1440; i++)
+        uint i=0;
+
+#if !defined(__CINT__) && defined(__SSE2__)
+        // Four pixels at once, each with the same operations in the same
+        // order as the scalar loop below
+        for (; i<1440; i+=4)
+        {
+            const float *vec = data+i*roi;
+
+            PixelStats4 stats(GetSample4(vec, roi, beg), beg);
+            stats.AddRange<false>(vec, roi, beg+1, end);
+
+            double sum[4], sum2[4];
+            _mm_storeu_pd(sum,    stats.fSum[0]);
+            _mm_storeu_pd(sum+2,  stats.fSum[1]);
+            _mm_storeu_pd(sum2,   stats.fSum2[0]);
+            _mm_storeu_pd(sum2+2, stats.fSum2[1]);
+
+            float   val[4];
+            int32_t pos[4];
+            _mm_storeu_ps(val, stats.fMax);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pos), stats.fPos);
+
+            for (uint k=0; k<4; k++)
+            {
+                sum[k]  /= len;
+                sum2[k] /= len;
+                sum2[k] -= sum[k]*sum[k];
+
+                *(ptr+0*1440+i+k) = sum[k];
+                *(ptr+1*1440+i+k) = sum2[k]<0 ? 0 : sqrt(sum2[k]);
+                *(ptr+2*1440+i+k) = val[k];
+                *(ptr+3*1440+i+k) = uint(pos[k]);
+            }
+        }
+#endif
+
+        for (; i<1440; i++)
         {
             const float *vec = data+i*roi;
 
@@ -884,19 +1066,24 @@ public:
             sum2 /= len;
             sum2 -= sum*sum;
 
+            *(ptr+0*1440+i) = sum;
+            *(ptr+1*1440+i) = sum2<0 ? 0 : sqrt(sum2);
+            *(ptr+2*1440+i) = vec[pos];
+            *(ptr+3*1440+i) = pos;
+        }
+
+        double max = 0;
+        double patch = 0;
+        for (i=0; i<1440; i++)
+        {
             if (i%9!=8)
-                patch += vec[pos];
+                patch += *(ptr+2*1440+i);
             else
             {
                 if (patch > max)
                     max = patch;
                 patch = 0;
             }
-
-            *(ptr+0*1440+i) = sum;
-            *(ptr+1*1440+i) = sum2<0 ? 0 : sqrt(sum2);
-            *(ptr+2*1440+i) = vec[pos];
-            *(ptr+3*1440+i) = pos;
         }
 
         return max/8;
@@ -907,7 +1094,22 @@ public:
         if (roi==0 || first<0 || last<0 || first>=roi || last>=roi || last<first)
             return;
 
-        for (int i=0; i<1440; i++)
+        int i=0;
+
+#if !defined(__CINT__) && defined(__SSE2__)
+        // Four pixels at once
+        for (; i<1440; i+=4)
+        {
+            const float *vec = data+i*roi;
+
+            PixelStats4 stats(GetSample4(vec, roi, first), first);
+            stats.AddRange<true>(vec, roi, first+1, last+1);
+
+            _mm_storeu_ps(max+i, stats.fMax);
+        }
+#endif
+
+        for (; i<1440; i++)
         {
             const float *beg = data+i*roi+first;
             const float *end = data+i*roi+last;
@@ -974,88 +1176,134 @@ public:
         }
     }
 
-    void AddT(const float *val, const int16_t *start, signed char edge=0)
+    // Accumulates the time marker channel of chip ch (1024 samples at
+    // val, start cell spos) without counting the event (fNumEntries).
+    // The chips are accumulated into disjoint parts of fStat.
+    void AddT(uint16_t ch, const float *val, int16_t spos, signed char edge=0)
     {
-        if (fNumSamples!=1024 || fNumChannels!=160)
+        if (spos<0)
             return;
 
-        // Rising or falling edge detection has the advantage that
-        // we are much less sensitive to baseline shifts
+        const size_t pos = ch*1024;
 
-        for (size_t ch=0; ch<160; ch++)
+        double  p_prev =  0;
+        int32_t i_prev = -1;
+
+        for (size_t i=0; i<1024-1; i++)
         {
-            const size_t tm = ch*9+8;
+            const float &v0 = val[i];  //-avg;
+            const float &v1 = val[i+1];//-avg;
 
-            const int16_t spos = start[tm];
-            if (spos<0)
+            // If edge is positive ignore all falling edges
+            if (edge>0 && v0>0)
                 continue;
 
-            const size_t pos = ch*1024;
+            // If edge is negative ignore all falling edges
+            if (edge<0 && v0<0)
+                continue;
 
-            double  p_prev =  0;
-            int32_t i_prev = -1;
+            // Check if there is a zero crossing
+            if ((v0<0 && v1<0) || (v0>0 && v1>0))
+                continue;
+
+            // Calculate the position p of the zero-crossing
+            // within the interval [rel, rel+1] relative to rel
+            // by linear interpolation.
+            const double p = v0==v1 ? 0.5 : v0/(v0-v1);
 
-            for (size_t i=0; i<1024-1; i++)
+            // If this was at least the second zero-crossing detected
+            if (i_prev>=0)
             {
-                const size_t rel = tm*1024 + i;
+                // Calculate the distance l between the
+                // current and the last zero-crossing
+                const double l = i+p - (i_prev+p_prev);
+
+                // By summation, the average length of each
+                // cell is calculated. For the first and last
+                // fraction of a cell, the fraction is applied
+                // as a weight.
+                const double w0 = 1-p_prev;
+                fStat[pos+(spos+i_prev)%1024].first  += w0*l;
+                fStat[pos+(spos+i_prev)%1024].second += w0;
+
+                for (size_t k=i_prev+1; k<i; k++)
+                {
+                    fStat[pos+(spos+k)%1024].first  += l;
+                    fStat[pos+(spos+k)%1024].second += 1;
+                }
 
-                const float &v0 = val[rel];  //-avg;
-                const float &v1 = val[rel+1];//-avg;
+                const double w1 = p;
+                fStat[pos+(spos+i)%1024].first  += w1*l;
+                fStat[pos+(spos+i)%1024].second += w1;
+            }
 
-                // If edge is positive ignore all falling edges
-                if (edge>0 && v0>0)
-                    continue;
+            // Remember this zero-crossing position
+            p_prev = p;
+            i_prev = i;
+        }
+    }
 
-                // If edge is negative ignore all falling edges
-                if (edge<0 && v0<0)
-                    continue;
+    void AddT(const float *val, const int16_t *start, signed char edge=0)
+    {
+        if (fNumSamples!=1024 || fNumChannels!=160)
+            return;
 
-                // Check if there is a zero crossing
-                if ((v0<0 && v1<0) || (v0>0 && v1>0))
-                    continue;
+        // Rising or falling edge detection has the advantage that
+        // we are much less sensitive to baseline shifts
+
+        for (size_t ch=0; ch<160; ch++)
+        {
+            const size_t tm = ch*9+8;
+            AddT(ch, val+tm*1024, start[tm], edge);
+        }
+        fNumEntries++;
+    }
 
-                // Calculate the position p of the zero-crossing
-                // within the interval [rel, rel+1] relative to rel
-                // by linear interpolation.
-                const double p = v0==v1 ? 0.5 : v0/(v0-v1);
+    // Adds the statistics of p, e.g. accumulated by another thread
+    // from different events. Both must have the same size.
+    DrsCalibrateTime &operator+=(const DrsCalibrateTime &p)
+    {
+        if (p.fNumChannels!=fNumChannels || p.fNumSamples!=fNumSamples)
+            throw std::runtime_error("DrsCalibrateTime::operator+=: size mismatch");
 
-                // If this was at least the second zero-crossing detected
-                if (i_prev>=0)
-                {
-                    // Calculate the distance l between the
-                    // current and the last zero-crossing
-                    const double l = i+p - (i_prev+p_prev);
-
-                    // By summation, the average length of each
-                    // cell is calculated. For the first and last
-                    // fraction of a cell, the fraction is applied
-                    // as a weight.
-                    const double w0 = 1-p_prev;
-                    fStat[pos+(spos+i_prev)%1024].first  += w0*l;
-                    fStat[pos+(spos+i_prev)%1024].second += w0;
-
-                    for (size_t k=i_prev+1; k<i; k++)
-                    {
-                        fStat[pos+(spos+k)%1024].first  += l;
-                        fStat[pos+(spos+k)%1024].second += 1;
-                    }
-
-                    const double w1 = p;
-                    fStat[pos+(spos+i)%1024].first  += w1*l;
-                    fStat[pos+(spos+i)%1024].second += w1;
-                }
+        for (size_t i=0; i<fStat.size(); i++)
+        {
+            fStat[i].first  += p.fStat[i].first;
+            fStat[i].second += p.fStat[i].second;
+        }
 
-                // Remember this zero-crossing position
-                p_prev = p;
-                i_prev = i;
-            }
+        fNumEntries += p.fNumEntries;
+
+        return *this;
+    }
+
+#ifndef __CINT__
+    // Calls (this->*func)(first, last) for disjoint ranges of chips in
+    // nthreads threads (0: number of cores)
+    void ForEachChip(void (DrsCalibrateTime::*func)(size_t, size_t), unsigned int nthreads)
+    {
+        if (nthreads==0)
+            nthreads = std::max(1u, std::thread::hardware_concurrency());
+
+        const size_t n = std::min<size_t>(nthreads, fNumChannels);
+        if (n<=1)
+        {
+            (this->*func)(0, fNumChannels);
+            return;
         }
-        fNumEntries++;
+
+        std::vector<std::thread> threads;
+        for (size_t i=0; i<n; i++)
+            threads.emplace_back(func, this, fNumChannels*i/n, fNumChannels*(i+1)/n);
+
+        for (auto it=threads.begin(); it!=threads.end(); it++)
+            it->join();
     }
+#endif
 
-    void FillEmptyBins()
+    void FillEmptyBins(size_t first, size_t last)
     {
-        for (int ch=0; ch<160; ch++)
+        for (size_t ch=first; ch<last; ch++)
         {
             const auto beg = fStat.begin() + ch*1024;
             const auto end = beg + 1024;
@@ -1090,6 +1338,16 @@ public:
         }
     }
 
+    // The chips are independent and can be processed by several threads
+    void FillEmptyBins(unsigned int nthreads=1)
+    {
+#ifndef __CINT__
+        ForEachChip(&DrsCalibrateTime::FillEmptyBins, nthreads);
+#else
+        FillEmptyBins(0, 160);
+#endif
+    }
+
     DrsCalibrateTime GetComplete() const
     {
         DrsCalibrateTime rc(*this);
@@ -1097,9 +1355,9 @@ public:
         return rc;
     }
 
-    void CalcResult()
+    void CalcResult(size_t first, size_t last)
     {
-        for (int ch=0; ch<160; ch++)
+        for (size_t ch=first; ch<last; ch++)
         {
             const auto beg = fStat.begin() + ch*1024;
             const auto end = beg + 1024;
@@ -1182,6 +1440,16 @@ public:
         }
     }
 
+    // The chips are independent and can be processed by several threads
+    void CalcResult(unsigned int nthreads=1)
+    {
+#ifndef __CINT__
+        ForEachChip(&DrsCalibrateTime::CalcResult, nthreads);
+#else
+        CalcResult(0, 160);
+#endif
+    }
+
     DrsCalibrateTime GetResult() const
     {
         DrsCalibrateTime rc(*this);
@@ -1206,7 +1474,6 @@ public:
         return pos-Offset(ch, pos);
     }
 
-    /*
     // See MDrsCalibrationTime
     std::string ReadFitsImp(const std::string &str)
     {
@@ -1281,10 +1548,11 @@ public:
         file.SetInt("NCH",      fNumChannels, "Number of chips");
         file.SetInt("NBTIME",   fNumEntries,  "Num of entries for time calibration");
 
-        file.WriteTableHeader("DrsCellTimes");
         if (night>0)
             file.SetInt("NIGHT", night, "Night as int");
 
+        file.WriteTableHeader("DrsCellTimes");
+
         std::vector<double> data(fNumSamples*fNumChannels*2);
 
         for (uint32_t i=0; i<fNumSamples*fNumChannels; i++)
@@ -1301,7 +1569,7 @@ public:
         }
 
         return std::string();
-    }*/
+    }
 };
 
 struct DrsCalibration
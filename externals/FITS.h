@@ -19,6 +19,9 @@
 
 #ifndef __CINT__
 #include <unordered_set>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 #endif
 
 namespace FITS
@@ -87,12 +90,62 @@ namespace FITS
         return size;
     }
 
+#ifndef __CINT__
+    // Adds (Add=true) or subtracts the DRS cell offsets cal to/from n
+    // samples of src and writes the result to dest (which can be src).
+    // Like the int16_t arithmetic of the scalar loop, the vector
+    // instructions wrap around.
+    template<bool Add>
+    inline void ApplyDrsOffsets(int16_t *dest, const int16_t *src, const int16_t *cal, uint32_t n)
+    {
+        uint32_t i = 0;
+#ifdef __SSE2__
+        for (; i+8<=n; i+=8)
+        {
+            const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src+i));
+            const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cal+i));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest+i), Add ? _mm_add_epi16(d, c) : _mm_sub_epi16(d, c));
+        }
+#endif
+        for (; i<n; i++)
+            dest[i] = Add ? src[i]+cal[i] : src[i]-cal[i];
+    }
+
+    // Adds (Add=true) or subtracts the DRS cell offsets (ZDrsCellOffsets,
+    // 1440x1024 values) to/from the roi samples of all 1440 channels of
+    // one event. The offsets are taken from the DRS ring buffer starting at
+    // the start cell of each channel. Channels with a negative start cell
+    // are copied unchanged.
+    template<bool Add>
+    inline void ApplyDrsOffsets(int16_t *dest, const int16_t *src, const int16_t *startCell, const int16_t *offsets, uint32_t roi)
+    {
+        for (uint32_t ch=0; ch<1440; ch++, dest+=roi, src+=roi, offsets+=1024)
+        {
+            if (startCell[ch]<0)
+            {
+                if (dest!=src)
+                    memcpy(dest, src, roi*sizeof(int16_t));
+                continue;
+            }
+
+            const uint32_t start = startCell[ch]%1024;
+
+            // number of samples up to the end of the ring buffer
+            const uint32_t n = start+roi>1024 ? 1024-start : roi;
+
+            ApplyDrsOffsets<Add>(dest,   src,   offsets+start, n);
+            ApplyDrsOffsets<Add>(dest+n, src+n, offsets,       roi-n);
+        }
+    }
+#endif
+
     //Identifier of the compression schemes processes
     enum CompressionProcess_t
     {
         kFactRaw       = 0x0,
         kFactSmoothing = 0x1,
-        kFactHuffman16 = 0x2
+        kFactHuffman16 = 0x2,
+        kFactRans16    = 0x3
     };
 
     //ordering of the columns / rows
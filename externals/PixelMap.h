@@ -48,11 +48,51 @@ struct PixelMapEntry
 
 class PixelMap : public std::vector<PixelMapEntry>
 {
+    // Lookup tables filled by Read(), containing the position of the
+    // corresponding entry (or -1). As long as they are empty (e.g. the
+    // entries were filled by hand) the entries are searched instead.
+    std::vector<int> fIndex;   /// Software index -> entry
+    std::vector<int> fHw;      /// Hardware index -> entry
+    std::vector<int> fHv;      /// Bias channel -> first entry
+
+    static const PixelMapEntry &Find(const std::vector<PixelMapEntry> &map, const std::vector<int> &table, int idx)
+    {
+        return idx>=0 && idx<int(table.size()) && table[idx]>=0 ? map[table[idx]] : PixelMapEntry::empty();
+    }
+
 public:
     PixelMap() : std::vector<PixelMapEntry>(1440)
     {
     }
 
+    // Fill the lookup tables from the current entries. Must be called
+    // again if entries are changed after Read()
+    void BuildIndex()
+    {
+        fIndex.assign(1440, -1);
+        fHw.assign(1440, -1);
+        fHv.assign(416, -1);
+
+        for (int i=0; i<int(size()); i++)
+        {
+            const PixelMapEntry &entry = (*this)[i];
+
+            if (entry.index>=0 && entry.index<1440 && fIndex[entry.index]<0)
+                fIndex[entry.index] = i;
+
+            if (entry.pixel()<9 && entry.patch()<4 && entry.crate()<4 && entry.cbpx>=0)
+            {
+                const int hw = entry.hw();
+                if (hw<1440 && fHw[hw]<0)
+                    fHw[hw] = i;
+            }
+
+            const int hv = entry.hv();
+            if (entry.hv_board>=0 && entry.hv_channel>=0 && hv<416 && fHv[hv]<0)
+                fHv[hv] = i;
+        }
+    }
+
     bool Read(const std::string &fname)
     {
         std::ifstream fin(fname);
@@ -101,11 +141,18 @@ public:
             (*this)[l++] = entry;
         }
 
-        return l==1440;
+        if (l!=1440)
+            return false;
+
+        BuildIndex();
+        return true;
     }
 
     const PixelMapEntry &index(int idx) const
     {
+        if (!fIndex.empty())
+            return Find(*this, fIndex, idx);
+
         for (std::vector<PixelMapEntry>::const_iterator it=begin(); it!=end(); it++)
             if (it->index==idx)
                 return *it;
@@ -117,6 +164,12 @@ public:
 
     const PixelMapEntry &cbpx(int c) const
     {
+        if (!fHw.empty())
+        {
+            const PixelMapEntry &entry = Find(*this, fHw, c<0 || c%10>8 || (c/10)%10>3 ? -1 : c%10+((c/10)%10)*9+((c/100)%10)*36+(c/1000)*360);
+            return entry.cbpx==c ? entry : PixelMapEntry::empty();
+        }
+
         for (std::vector<PixelMapEntry>::const_iterator it=begin(); it!=end(); it++)
             if (it->cbpx==c)
                 return *it;
@@ -133,11 +186,20 @@ public:
 
     const PixelMapEntry &hw(int idx) const
     {
+        if (!fHw.empty())
+            return Find(*this, fHw, idx);
+
         return cbpx(idx/360, (idx/36)%10, (idx/9)%4, idx%9);
     }
 
     const PixelMapEntry &hv(int board, int channel) const
     {
+        if (!fHv.empty())
+        {
+            const PixelMapEntry &entry = Find(*this, fHv, channel<0 || channel>31 ? -1 : channel+board*32);
+            return entry.hv_board==board ? entry : PixelMapEntry::empty();
+        }
+
         for (std::vector<PixelMapEntry>::const_iterator it=begin(); it!=end(); it++)
             if (it->hv_board==board && it->hv_channel==channel)
                 return *it;
@@ -152,6 +214,46 @@ public:
         return hv(idx/32, idx%32);
     }
 
+    // The following kernels require a map read successfully by Read()
+
+    // Reorder 1440 values from hardware to software order. The
+    // output must not overlap with the input.
+    template<typename T, typename S>
+    void HwToSw(const T *hw, S *sw) const
+    {
+        for (std::vector<PixelMapEntry>::const_iterator it=begin(); it!=end(); it++)
+            sw[it->index] = hw[it->hw()];
+    }
+
+    // Adds the values of the first 320 bias channels to the 160 trigger
+    // patches (hardware order) they belong to, each weighted with the
+    // number of pixels of the channel, i.e. the sum over the pixels of
+    // each patch of the value of their bias channel.
+    template<typename T, typename S>
+    void HvToPatchSum(const T *hv, S *sum) const
+    {
+        for (int i=0; i<320; i++)
+        {
+            const PixelMapEntry &entry = this->hv(i);
+            if (entry)
+                sum[entry.hw()/9] += hv[i]*entry.count();
+        }
+    }
+
+    // Reorder the values of the first 320 bias channels such that the
+    // two channels of each trigger patch (group 0 and 1) are consecutive
+    // in hardware order of the patches.
+    template<typename T, typename S>
+    void HvToPatchGroup(const T *hv, S *out) const
+    {
+        for (int i=0; i<320; i++)
+        {
+            const PixelMapEntry &entry = this->hv(i);
+            if (entry)
+                out[(entry.hw()/9)*2+entry.group()] = hv[i];
+        }
+    }
+
     /*
     float Vgapd(int board, int channel) const
     {
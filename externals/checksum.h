@@ -3,6 +3,11 @@
 
 #ifndef __CINT__
 #include <arpa/inet.h>
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #endif
 
 #include <stdint.h>
@@ -51,8 +56,8 @@ public:
         // Avoid overflows in carry bits
         if (len>262140) // 2^18-4
         {
-            add(buf, 262140);
-            return add(buf+262140, len-262140);
+            add(buf, 262140, big_endian);
+            return add(buf+262140, len-262140, big_endian);
         }
 
         if (len%4>0)
@@ -70,8 +75,8 @@ public:
 
         const uint16_t *sbuf = reinterpret_cast<const uint16_t *>(buf);
 
-        uint32_t *hilo  = reinterpret_cast<uint32_t*>(&buffer);
-
+        // Do not access buffer through an uint32_t* (strict aliasing)
+        uint32_t hilo[2] = { uint32_t(buffer), uint32_t(buffer>>32) };
 
         const uint16_t *end = sbuf + len/2;
 
@@ -93,11 +98,22 @@ public:
             hilo[1] += ntohs(*sbuf++);
         }*/
 
+        buffer = (uint64_t(hilo[1])<<32) | hilo[0];
+
         HandleCarryBits();
 
         return true;
     }
 
+#if !defined(__CINT__) && (defined(__AVX2__) || defined(__SSE2__))
+    static uint32_t hadd(__m128i v)
+    {
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+        v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+        return _mm_cvtsi128_si32(v);
+    }
+#endif
+
     void addLoopSwapping(const uint16_t *sbuf, const uint16_t *end, uint32_t* hilo)
     {
         /*
@@ -108,24 +124,56 @@ public:
             hilo[i%2] += ntohs(sbuf[i]); //(sbuf[i]&0xff00)>>8 | (sbuf[i]&0x00ff)<<8;
         }*/
 
-        // This is about as twice as fast as the loop above
-        // ntohs is CPU optimized, i%2 doesn't need to be computed
-        while (1)
+        // The vector loops swap the bytes of each 16-bit word and sum the
+        // words at even positions (lower half of each 32-bit lane) and odd
+        // positions (upper half) in independent 32-bit lanes. Since add()
+        // never passes more than 2^17-2 words at once, neither the lanes
+        // nor hilo can overflow, so the result is identical to the scalar
+        // loop below. Both vector loops advance by an even number of words,
+        // so the remainder always starts again with hilo[0].
+#if !defined(__CINT__) && defined(__AVX2__)
         {
-            if (sbuf==end)
-                break;
+            const __m256i mask = _mm256_set1_epi32(0xffff);
 
-            hilo[0] += ntohs(*sbuf++);
+            __m256i lo = _mm256_setzero_si256();
+            __m256i hi = _mm256_setzero_si256();
 
-            if (sbuf==end)
-                break;
+            for (; end-sbuf>=16; sbuf+=16)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sbuf));
+                v  = _mm256_or_si256(_mm256_slli_epi16(v, 8), _mm256_srli_epi16(v, 8));
+                lo = _mm256_add_epi32(lo, _mm256_and_si256(v, mask));
+                hi = _mm256_add_epi32(hi, _mm256_srli_epi32(v, 16));
+            }
 
-            hilo[1] += ntohs(*sbuf++);
+            hilo[0] += hadd(_mm_add_epi32(_mm256_castsi256_si128(lo), _mm256_extracti128_si256(lo, 1)));
+            hilo[1] += hadd(_mm_add_epi32(_mm256_castsi256_si128(hi), _mm256_extracti128_si256(hi, 1)));
         }
-    }
+#endif
 
-    void addLoop(const uint16_t *sbuf, const uint16_t *end, uint32_t* hilo)
-    {
+#if !defined(__CINT__) && (defined(__AVX2__) || defined(__SSE2__))
+        {
+            const __m128i mask = _mm_set1_epi32(0xffff);
+
+            __m128i lo = _mm_setzero_si128();
+            __m128i hi = _mm_setzero_si128();
+
+            for (; end-sbuf>=8; sbuf+=8)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(sbuf));
+                v  = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+                lo = _mm_add_epi32(lo, _mm_and_si128(v, mask));
+                hi = _mm_add_epi32(hi, _mm_srli_epi32(v, 16));
+            }
+
+            hilo[0] += hadd(lo);
+            hilo[1] += hadd(hi);
+        }
+#endif
+
+        // Remaining words (or all of them without SSE2). This is about as
+        // twice as fast as the commented loop above
+        // ntohs is CPU optimized, i%2 doesn't need to be computed
         while (1)
         {
             if (sbuf==end)
@@ -140,6 +188,13 @@ public:
         }
     }
 
+    void addLoop(const uint16_t *sbuf, const uint16_t *end, uint32_t* hilo)
+    {
+        // Note that this has always swapped the bytes as well (see RAWSUM
+        // in zofits), so it must stay bit-identical to addLoopSwapping
+        addLoopSwapping(sbuf, end, hilo);
+    }
+
     bool add(const std::vector<char> &v, bool big_endian = true)
     {
         return add(v.data(), v.size(), big_endian);
@@ -19,6 +19,7 @@ public:
         fOffsetCalibration(0),
         fOffsetStartCellData(0),
         fOffsetData(0),
+        fIdData(0),
         fNumRoi(0)
     {
         if (init())
@@ -31,6 +32,7 @@ public:
         fOffsetCalibration(0),
         fOffsetStartCellData(0),
         fOffsetData(0),
+        fIdData(0),
         fNumRoi(0)
     {
         if (init())
@@ -43,6 +45,33 @@ public:
 
 private:
 
+    // The offsets can be restored while the tile is copied from the
+    // uncompressed buffer if the data is ordered by row and the start
+    // cells of the row have already been copied
+    bool IsCalibratedInTile() const
+    {
+        return !fOffsetCalibration.empty() && fOffsetStartCellData<fOffsetData &&
+            GetColumnOrdering(fIdData)==FITS::kOrderByRow;
+    }
+
+    void CopyColumnByRow(char *buffer, const char *src, const Table::Column &col, uint32_t numRows)
+    {
+        if (col.offset!=fOffsetData || !IsCalibratedInTile())
+        {
+            zfits::CopyColumnByRow(buffer, src, col, numRows);
+            return;
+        }
+
+        // buffer points to the Data column of the first row
+        for (uint32_t i=0; i<numRows; i++, buffer+=fTable.bytes_per_row, src+=col.bytes)
+        {
+            const int16_t *startCell = reinterpret_cast<const int16_t*>(buffer - fOffsetData + fOffsetStartCellData);
+
+            FITS::ApplyDrsOffsets<true>(reinterpret_cast<int16_t*>(buffer), reinterpret_cast<const int16_t*>(src),
+                                        startCell, fOffsetCalibration.data(), fNumRoi);
+        }
+    }
+
     void StageRow(size_t row, char* dest)
     {
         zfits::StageRow(row, dest);
@@ -51,52 +80,17 @@ private:
         if (fOffsetCalibration.empty())
             return;
 
+        // Already applied while the tile was uncompressed
+        if (IsCalibratedInTile())
+            return;
+
         //re-get the pointer to the data to access the offsets
         const uint8_t offset = (row*fTable.bytes_per_row)%4;
 
         int16_t *startCell = reinterpret_cast<int16_t*>(fBufferRow.data() + offset + fOffsetStartCellData);
         int16_t *data      = reinterpret_cast<int16_t*>(fBufferRow.data() + offset + fOffsetData);
 
-         /*
-         for (uint32_t i=0; i<1440*1024; i+=1024, startCell++)
-         {
-             if (*startCell < 0)
-             {
-                 data += fNumRoi;
-                 continue;
-             }
-             for (uint32_t j=0; j<fNumRoi; j++, data++)
-                 *data += fOffsetCalibration[i + (*startCell+j)%1024];
-         }
-         */
-
-        // This version is faster because the compilers optimization
-        // is not biased by the evaluation of %1024
-        for (int ch=0; ch<1440; ch++)
-        {
-            if (startCell[ch]<0)
-            {
-                data += fNumRoi;
-                continue;
-            }
-
-            const int16_t modStart = startCell[ch] % 1024;
-            const int16_t *off = fOffsetCalibration.data() + ch*1024;
-
-            const int16_t *cal = off+modStart;
-            const int16_t *end_stride = data+fNumRoi;
-
-            if (modStart+fNumRoi>1024)
-            {
-                while (cal<off+1024)
-                    *data++ += *cal++;
-
-                cal = off;
-            }
-            while (data<end_stride)
-                *data++ += *cal++;
-        }
-
+        FITS::ApplyDrsOffsets<true>(data, data, startCell, fOffsetCalibration.data(), fNumRoi);
     }
 
     bool init()
@@ -123,6 +117,7 @@ private:
 
         fOffsetStartCellData = is->second.offset;
         fOffsetData          = it->second.offset;
+        fIdData              = it->second.id-1; // the column ids start at 1
 
         return true;
     }
@@ -200,6 +195,7 @@ private:
 
     size_t fOffsetStartCellData;
     size_t fOffsetData;
+    size_t fIdData;             ///< index of the Data column in the sorted columns (0-based)
 
     uint16_t fNumRoi;
 
@@ -316,30 +316,7 @@ class factofits : public zofits
             const int16_t* startCell = reinterpret_cast<int16_t*>(target_location + fStartCellsOffset);
             int16_t*       data      = reinterpret_cast<int16_t*>(target_location + fDataOffset);
 
-            for (uint32_t ch=0; ch<1440; ch++)
-            {
-                if (startCell[ch] < 0)
-                {
-                    data += fNumSlices;
-                    continue;
-                }
-
-                const int16_t modStart = startCell[ch]%1024;
-                const int16_t *off     = fOffsetCalibration.data() + ch*1024;
-
-                const int16_t* cal        = off+modStart;
-                const int16_t* end_stride = data+fNumSlices;
-
-                if (modStart+fNumSlices > 1024)
-                {
-                    while (cal < off+1024)
-                        *data++ -= *cal++;
-                    cal = off;
-                }
-
-                while (data<end_stride)
-                    *data++ -= *cal++;
-            }
+            FITS::ApplyDrsOffsets<false>(data, data, startCell, fOffsetCalibration.data(), fNumSlices);
         }
 
 private:
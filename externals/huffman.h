@@ -398,9 +398,12 @@ namespace Huffman
         return true;
     }
 
+    // Decodes directly into pbufout which can hold up to count symbols.
+    // On return count is the number of decoded symbols.
     inline int64_t Decode(const uint8_t *bufin,
                           size_t         bufinlen,
-                          std::vector<uint16_t> &pbufout)
+                          uint16_t      *pbufout,
+                          size_t        &count)
     {
         int64_t i = 0;
 
@@ -409,8 +412,16 @@ namespace Huffman
         memcpy(&data_count, bufin, sizeof(size_t));
         i += sizeof(size_t);
 
+        if (data_count>count)
+        {
+#ifdef __EXCEPTIONS
+            throw std::runtime_error("Number of encoded symbols exceeds size of output buffer.");
+#else
+            return -1;
+#endif
+        }
 
-        pbufout.resize(data_count);
+        count = data_count;
 
         const Decoder decoder(bufin, i);
 
@@ -421,7 +432,7 @@ namespace Huffman
 
         const uint8_t *in_ptr =
             decoder.Decode(bufin+i, bufin+bufinlen,
-                           pbufout.data(), pbufout.data()+data_count);
+                           pbufout, pbufout+data_count);
 
 #ifndef __EXCEPTIONS
         if (!in_ptr)
@@ -430,6 +441,19 @@ namespace Huffman
 
         return in_ptr-bufin;
     }
+
+    inline int64_t Decode(const uint8_t *bufin,
+                          size_t         bufinlen,
+                          std::vector<uint16_t> &pbufout)
+    {
+        // Read the number of data bytes this encoding represents.
+        size_t data_count = 0;
+        memcpy(&data_count, bufin, sizeof(size_t));
+
+        pbufout.resize(data_count);
+
+        return Decode(bufin, bufinlen, pbufout.data(), data_count);
+    }
 };
 
 #endif
@@ -0,0 +1,416 @@
+#ifndef FACT_rans
+#define FACT_rans
+
+#include <string.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+// ================================================================
+//
+// Static, order-0 range asymmetric numeral system (rANS) coder for
+// 16-bit symbols. Two interleaved 32-bit states are used, the
+// renormalization is done in 16-bit words. The frequencies are
+// normalized to 2^scale, where scale is at most 16 and is kept small
+// if possible so that the decoding table stays in the cache.
+//
+// Layout of an encoded block:
+//
+//   uint64_t  number of symbols
+//   uint8_t   scale (0: only a single symbol, which follows as uint16_t)
+//   uint32_t  number of different symbols n
+//   n x { uint16_t symbol; uint16_t frequency; }
+//   2 x uint32_t  final states of the encoder
+//   uint16_t  renormalization words
+//
+// ================================================================
+
+namespace RANS
+{
+    static const uint32_t kLow = 1<<16; // lower bound of the states
+
+    struct Symbol
+    {
+        uint16_t symbol;
+        uint16_t freq;
+        uint32_t start;
+        uint64_t count;
+
+        Symbol(uint16_t s=0, uint64_t c=0) : symbol(s), freq(0), start(0), count(c) { }
+
+        bool operator<(const Symbol &s) const { return freq > s.freq; }
+    };
+
+    inline uint8_t ceil_log2(uint64_t n)
+    {
+        uint8_t rc = 0;
+        while ((uint64_t(1)<<rc)<n)
+            rc++;
+        return rc;
+    }
+
+    // Normalize the occurances of the symbols to a total of 1<<scale.
+    // Every symbol keeps at least a frequency of one. The table is
+    // sorted by decreasing frequency afterwards.
+    inline void Normalize(std::vector<Symbol> &table, uint64_t total, uint8_t scale)
+    {
+        const uint64_t norm = uint64_t(1)<<scale;
+
+        int64_t sum = 0;
+        for (auto it=table.begin(); it!=table.end(); it++)
+        {
+            const uint64_t f = it->count*norm/total;
+            it->freq = f==0 ? 1 : f;
+            sum += it->freq;
+        }
+
+        // Most frequent symbols first, they can absorb the rounding
+        std::sort(table.begin(), table.end());
+
+        if (sum<int64_t(norm))
+            table[0].freq += norm-sum;
+
+        for (auto it=table.begin(); sum>int64_t(norm); it++)
+        {
+            if (it==table.end())
+                it = table.begin();
+
+            const int64_t n = std::min<int64_t>(sum-norm, it->freq/2);
+            it->freq -= n;
+            sum      -= n;
+        }
+
+        uint32_t start = 0;
+        for (auto it=table.begin(); it!=table.end(); it++)
+        {
+            it->start = start;
+            start += it->freq;
+        }
+    }
+
+    // Read the next word from the stream if the state dropped below kLow
+    inline bool Renormalize(uint32_t &x, const uint8_t *&in_ptr, const uint8_t *in_end)
+    {
+        if (x>=kLow)
+            return true;
+
+        if (in_ptr+2>in_end)
+            return false;
+
+        uint16_t w;
+        memcpy(&w, in_ptr, sizeof(uint16_t));
+        in_ptr += sizeof(uint16_t);
+
+        x = (x<<16) | w;
+        return true;
+    }
+
+    // Encode the symbols in reverse order of decoding. index returns the
+    // table entry of a symbol. The words are emitted in reverse order, too.
+    template<class F>
+    inline void EncodeSymbols(std::vector<uint16_t> &words, uint32_t *state, const uint16_t *bufin, size_t bufinlen,
+                              const std::vector<Symbol> &table, uint8_t scale, F index)
+    {
+        for (size_t i=bufinlen; i-->0; )
+        {
+            const Symbol &s = table[index(bufin[i])];
+
+            uint32_t &x = state[i&1];
+
+            const uint32_t xmax = uint32_t(s.freq)<<(32-scale);
+            if (x>=xmax)
+            {
+                words.push_back(x&0xffff);
+                x >>= 16;
+            }
+
+            x = ((x/s.freq)<<scale) + x%s.freq + s.start;
+        }
+    }
+
+    inline bool Encode(std::string &bufout, const uint16_t *bufin, size_t bufinlen)
+    {
+        const uint64_t count = bufinlen;
+        bufout.append((char*)&count, sizeof(uint64_t));
+
+        // Short blocks (e.g. columns ordered by column) are counted by
+        // sorting to avoid the initialization of the full histogram
+        const bool isShort = bufinlen<(1<<12);
+
+        std::vector<Symbol> table;
+        if (isShort)
+        {
+            std::vector<uint16_t> sorted(bufinlen);
+            std::copy(bufin, bufin+bufinlen, sorted.begin());
+            std::sort(sorted.begin(), sorted.end());
+
+            for (auto it=sorted.begin(); it!=sorted.end(); )
+            {
+                const auto end = std::upper_bound(it, sorted.end(), *it);
+                table.emplace_back(*it, end-it);
+                it = end;
+            }
+        }
+        else
+        {
+            std::vector<uint64_t> counts(1<<16);
+            for (const uint16_t *p=bufin; p<bufin+bufinlen; p++)
+                counts[*p]++;
+
+            for (uint32_t i=0; i<(1<<16); i++)
+                if (counts[i])
+                    table.emplace_back(i, counts[i]);
+        }
+
+        if (table.size()<2)
+        {
+            const uint8_t scale = 0;
+            bufout.append((char*)&scale, sizeof(uint8_t));
+            if (!table.empty())
+                bufout.append((char*)&table[0].symbol, sizeof(uint16_t));
+            return true;
+        }
+
+        // The decoding table has 1<<scale entries. A table which fits into
+        // the L2 cache decodes much faster, the precision is only increased
+        // if there are many different symbols. Short blocks need less.
+        const uint8_t scale = std::min<uint8_t>(16, std::max<uint8_t>(ceil_log2(table.size())+2, std::min<uint8_t>(13, ceil_log2(count))));
+
+        Normalize(table, count, scale);
+
+        const uint32_t num = table.size();
+
+        bufout.append((char*)&scale, sizeof(uint8_t));
+        bufout.append((char*)&num,   sizeof(uint32_t));
+
+        for (uint32_t i=0; i<num; i++)
+        {
+            bufout.append((char*)&table[i].symbol, sizeof(uint16_t));
+            bufout.append((char*)&table[i].freq,   sizeof(uint16_t));
+        }
+
+        std::vector<uint16_t> words;
+        words.reserve(bufinlen/2);
+
+        uint32_t state[2] = { kLow, kLow };
+
+        if (isShort)
+        {
+            // Symbols and their index into the table, sorted by symbol
+            std::vector<std::pair<uint16_t, uint16_t>> index;
+            for (uint32_t i=0; i<num; i++)
+                index.emplace_back(table[i].symbol, i);
+            std::sort(index.begin(), index.end());
+
+            EncodeSymbols(words, state, bufin, bufinlen, table, scale,
+                          [&index](uint16_t sym) { return std::lower_bound(index.begin(), index.end(), std::make_pair(sym, uint16_t(0)))->second; });
+        }
+        else
+        {
+            // Index of each symbol into the table
+            std::vector<uint16_t> index(1<<16);
+            for (uint32_t i=0; i<num; i++)
+                index[table[i].symbol] = i;
+
+            EncodeSymbols(words, state, bufin, bufinlen, table, scale,
+                          [&index](uint16_t sym) { return index[sym]; });
+        }
+
+        bufout.append((char*)state, 2*sizeof(uint32_t));
+
+        const size_t pos = bufout.size();
+        bufout.resize(pos+words.size()*sizeof(uint16_t));
+
+        std::reverse_copy(words.begin(), words.end(), reinterpret_cast<uint16_t*>(&bufout[pos]));
+
+        return true;
+    }
+
+    // Decodes directly into pbufout which can hold up to count symbols.
+    // On return count is the number of decoded symbols.
+    inline int64_t Decode(const uint8_t *bufin,
+                          size_t         bufinlen,
+                          uint16_t      *pbufout,
+                          size_t        &count)
+    {
+        const uint8_t *in_ptr = bufin;
+        const uint8_t *in_end = bufin+bufinlen;
+
+        if (bufinlen<sizeof(uint64_t)+sizeof(uint8_t))
+        {
+#ifdef __EXCEPTIONS
+            throw std::runtime_error("Unexpected end of rANS stream.");
+#else
+            return -1;
+#endif
+        }
+
+        uint64_t data_count = 0;
+        memcpy(&data_count, in_ptr, sizeof(uint64_t));
+        in_ptr += sizeof(uint64_t);
+
+        uint8_t scale = 0;
+        memcpy(&scale, in_ptr, sizeof(uint8_t));
+        in_ptr += sizeof(uint8_t);
+
+        if (data_count>count || scale>16)
+        {
+#ifdef __EXCEPTIONS
+            throw std::runtime_error(scale>16 ? "Invalid rANS scale." : "Number of encoded symbols exceeds size of output buffer.");
+#else
+            return -1;
+#endif
+        }
+
+        count = data_count;
+
+        // Size of the header which follows (the frequency table is
+        // checked once its size is known)
+        const size_t header = scale==0 ? (data_count>0 ? sizeof(uint16_t) : 0) : sizeof(uint32_t);
+        if (in_ptr+header>in_end)
+        {
+#ifdef __EXCEPTIONS
+            throw std::runtime_error("Unexpected end of rANS stream.");
+#else
+            return -1;
+#endif
+        }
+
+        if (scale==0)
+        {
+            uint16_t sym = 0;
+            if (data_count>0)
+            {
+                memcpy(&sym, in_ptr, sizeof(uint16_t));
+                in_ptr += sizeof(uint16_t);
+            }
+
+            std::fill(pbufout, pbufout+data_count, sym);
+            return in_ptr-bufin;
+        }
+
+        uint32_t num = 0;
+        memcpy(&num, in_ptr, sizeof(uint32_t));
+        in_ptr += sizeof(uint32_t);
+
+        if (num>0x10000 || in_ptr+num*2*sizeof(uint16_t)+2*sizeof(uint32_t)>in_end)
+        {
+#ifdef __EXCEPTIONS
+            throw std::runtime_error(num>0x10000 ? "Invalid rANS frequency table." : "Unexpected end of rANS stream.");
+#else
+            return -1;
+#endif
+        }
+
+        const uint32_t mask = (1<<scale)-1;
+
+        // Everything needed to decode a symbol for each slot of the
+        // cumulative distribution, so that a single lookup is needed
+        struct Slot
+        {
+            uint16_t symbol;
+            uint16_t freq;
+            uint16_t bias; // position of the slot within the symbol's range
+        };
+
+        std::vector<Slot> slots(1<<scale);
+
+        uint32_t start = 0;
+        for (uint32_t i=0; i<num; i++)
+        {
+            uint16_t sym, freq;
+            memcpy(&sym,  in_ptr,   sizeof(uint16_t));
+            memcpy(&freq, in_ptr+2, sizeof(uint16_t));
+            in_ptr += 2*sizeof(uint16_t);
+
+            if (freq==0 || start+freq>mask+1)
+            {
+#ifdef __EXCEPTIONS
+                throw std::runtime_error("Invalid rANS frequency table.");
+#else
+                return -1;
+#endif
+            }
+
+            for (uint32_t j=0; j<freq; j++)
+            {
+                Slot &slot = slots[start+j];
+                slot.symbol = sym;
+                slot.freq   = freq;
+                slot.bias   = j;
+            }
+
+            start += freq;
+        }
+
+        if (start!=mask+1)
+        {
+#ifdef __EXCEPTIONS
+            throw std::runtime_error("Invalid rANS frequency table.");
+#else
+            return -1;
+#endif
+        }
+
+        uint32_t x0, x1;
+        memcpy(&x0, in_ptr,   sizeof(uint32_t));
+        memcpy(&x1, in_ptr+4, sizeof(uint32_t));
+        in_ptr += 2*sizeof(uint32_t);
+
+        // The two states are independent of each other, so that two symbols
+        // can be decoded in parallel
+        for (size_t i=0; i<data_count; i+=2)
+        {
+            const Slot &s0 = slots[x0&mask];
+            const Slot &s1 = slots[x1&mask];
+
+            pbufout[i] = s0.symbol;
+            x0 = s0.freq*(x0>>scale) + s0.bias;
+
+            if (i+1<data_count)
+            {
+                pbufout[i+1] = s1.symbol;
+                x1 = s1.freq*(x1>>scale) + s1.bias;
+            }
+
+            // Stream words are consumed in the order of decoding
+            if (!Renormalize(x0, in_ptr, in_end) || !Renormalize(x1, in_ptr, in_end))
+            {
+#ifdef __EXCEPTIONS
+                throw std::runtime_error("Unexpected end of rANS stream.");
+#else
+                return -1;
+#endif
+            }
+        }
+
+        return in_ptr-bufin;
+    }
+
+    inline int64_t Decode(const uint8_t *bufin,
+                          size_t         bufinlen,
+                          std::vector<uint16_t> &pbufout)
+    {
+        if (bufinlen<sizeof(uint64_t)+sizeof(uint8_t))
+        {
+#ifdef __EXCEPTIONS
+            throw std::runtime_error("Unexpected end of rANS stream.");
+#else
+            return -1;
+#endif
+        }
+
+        uint64_t data_count = 0;
+        memcpy(&data_count, bufin, sizeof(uint64_t));
+
+        pbufout.resize(data_count);
+
+        size_t count = data_count;
+        return Decode(bufin, bufinlen, pbufout.data(), count);
+    }
+};
+
+#endif
@@ -10,6 +10,7 @@
 
 #include "fits.h"
 #include "huffman.h"
+#include "rans.h"
 
 #include "FITS.h"
 
@@ -78,6 +79,21 @@ protected:
         ReadBinaryRow(row, dest);
     }
 
+    // Copy one column of all rows of the current tile from the uncompressed
+    // buffer (ordered by row) to the tile buffer. Derived classes can
+    // overwrite this to process the data while it is copied.
+    virtual void CopyColumnByRow(char *buffer, const char *src, const Table::Column &col, uint32_t numRows)
+    {
+        for (char *dest=buffer; dest<buffer+numRows*fTable.bytes_per_row; dest+=fTable.bytes_per_row) // row-by-row
+        {
+            memcpy(dest, src, col.bytes);
+            src += col.bytes;  // next column
+        }
+    }
+
+    // Ordering of the column with the given index in the current tile
+    char GetColumnOrdering(size_t id) const { return fColumnOrdering[id]; }
+
 private:
 
     // Do what it takes to initialize the compressed structured
@@ -413,11 +429,8 @@ private:
                 {
                 case FITS::kOrderByRow:
                     // regular, "semi-transposed" copy
-                    for (char *dest=buffer; dest<buffer+thisRoundNumRows*fTable.bytes_per_row; dest+=fTable.bytes_per_row) // row-by-row
-                    {
-                        memcpy(dest, src, it->bytes);
-                        src += it->bytes;  // next column
-                    }
+                    CopyColumnByRow(buffer, src, *it, thisRoundNumRows);
+                    src += thisRoundNumRows*it->bytes;
                     break;
 
                 case FITS::kOrderByCol:
@@ -462,40 +475,75 @@ private:
         return numElems*sizeOfElems;
     }
 
-    // Read a bunch of data compressed with the Huffman algorithm
+    // Read a bunch of data compressed with the Huffman algorithm. The
+    // chunks are decoded directly into the destination. If requested, the
+    // inverse smoothing is applied to each chunk right after decoding
+    // while it is still in the cache (the result is identical to
+    // UnApplySMOOTHING on the whole block). numElems is the capacity
+    // of dest in 16-bit words.
     uint32_t UncompressHUFFMAN16(char*       dest,
                                  const char* src,
-                                 uint32_t    numChunks)
+                                 uint32_t    numChunks,
+                                 uint32_t    numElems,
+                                 bool        unsmooth=false)
+    {
+        return UncompressENTROPY16(dest, src, numChunks, numElems, unsmooth, Huffman::Decode);
+    }
+
+    // Read a bunch of data compressed with the rANS coder, see UncompressHUFFMAN16
+    uint32_t UncompressRANS16(char*       dest,
+                              const char* src,
+                              uint32_t    numChunks,
+                              uint32_t    numElems,
+                              bool        unsmooth=false)
+    {
+        return UncompressENTROPY16(dest, src, numChunks, numElems, unsmooth, RANS::Decode);
+    }
+
+    uint32_t UncompressENTROPY16(char*       dest,
+                                 const char* src,
+                                 uint32_t    numChunks,
+                                 uint32_t    numElems,
+                                 bool        unsmooth,
+                                 int64_t   (*decode)(const uint8_t *, size_t, uint16_t *, size_t &))
     {
-        std::vector<uint16_t> uncompressed;
+        uint16_t *data = reinterpret_cast<uint16_t*>(dest);
 
         //read compressed sizes (one per row)
         const uint32_t* compressedSizes = reinterpret_cast<const uint32_t*>(src);
         src += sizeof(uint32_t)*numChunks;
 
         //uncompress the rows, one by one
-        uint32_t sizeWritten = 0;
+        uint32_t numWritten = 0;
         for (uint32_t j=0;j<numChunks;j++)
         {
-            Huffman::Decode(reinterpret_cast<const unsigned char*>(src), compressedSizes[j], uncompressed);
+            size_t count = numElems-numWritten;
+            decode(reinterpret_cast<const unsigned char*>(src), compressedSizes[j], data+numWritten, count);
 
-            memcpy(dest, uncompressed.data(), uncompressed.size()*sizeof(uint16_t));
+            if (unsmooth)
+                UnApplySMOOTHING(reinterpret_cast<int16_t*>(data), numWritten, numWritten+count);
 
-            sizeWritten += uncompressed.size()*sizeof(uint16_t);
-            dest        += uncompressed.size()*sizeof(uint16_t);
-            src         += compressedSizes[j];
+            numWritten += count;
+            src        += compressedSizes[j];
         }
-        return sizeWritten;
+        return numWritten*sizeof(uint16_t);
     }
 
-    // Apply the inverse transform of the integer smoothing
-    uint32_t UnApplySMOOTHING(int16_t*   data,
-                              uint32_t   numElems)
+    // Apply the inverse transform of the integer smoothing to the elements
+    // [first, last) of a block. All elements before first must already be
+    // restored.
+    void UnApplySMOOTHING(int16_t* data, uint32_t first, uint32_t last)
     {
         //un-do the integer smoothing
-        for (uint32_t j=2;j<numElems;j++)
+        for (uint32_t j=first<2?2:first;j<last;j++)
             data[j] = data[j] + (data[j-1]+data[j-2])/2;
+    }
 
+    // Apply the inverse transform of the integer smoothing
+    uint32_t UnApplySMOOTHING(int16_t*   data,
+                              uint32_t   numElems)
+    {
+        UnApplySMOOTHING(data, 0, numElems);
         return numElems*sizeof(uint16_t);
     }
 
@@ -541,7 +589,25 @@ private:
                     break;
 
                 case FITS::kFactHuffman16:
-                    sizeWritten = UncompressHUFFMAN16(dest, src, numRows);
+                    // If the next step is the inverse smoothing, do it on the fly
+                    if (j>0 && processings[j-1]==FITS::kFactSmoothing)
+                    {
+                        sizeWritten = UncompressHUFFMAN16(dest, src, numRows, numRows*numCols*col.size/2, true);
+                        j--;
+                    }
+                    else
+                        sizeWritten = UncompressHUFFMAN16(dest, src, numRows, numRows*numCols*col.size/2);
+                    break;
+
+                case FITS::kFactRans16:
+                    // If the next step is the inverse smoothing, do it on the fly
+                    if (j>0 && processings[j-1]==FITS::kFactSmoothing)
+                    {
+                        sizeWritten = UncompressRANS16(dest, src, numRows, numRows*numCols*col.size/2, true);
+                        j--;
+                    }
+                    else
+                        sizeWritten = UncompressRANS16(dest, src, numRows, numRows*numCols*col.size/2);
                     break;
 
                 default:
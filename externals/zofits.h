@@ -9,6 +9,7 @@
  */
 #include "ofits.h"
 #include "huffman.h"
+#include "rans.h"
 #include "Queue.h"
 #include "MemoryManager.h"
 
@@ -18,6 +19,11 @@
 #include <unistd.h>
 #endif
 
+#ifndef __CINT__
+#include <chrono>
+#include <time.h>
+#endif
+
 #if defined(__CINT__) || !defined(__EXCEPTIONS)
 namespace std
 {
@@ -66,11 +72,12 @@ public:
             }
 
             WriteTarget() { }
-            WriteTarget(const WriteTarget &t, uint32_t sz) : tile_num(t.tile_num), size(sz), data(t.data) { }
+            WriteTarget(const WriteTarget &t, uint32_t sz, const Checksum &sum) : tile_num(t.tile_num), size(sz), data(t.data), rawsum(sum) { }
 
             uint32_t              tile_num; ///< Tile index of the data (to make sure that they are written in the correct order)
             uint32_t              size;     ///< Size to write
             std::shared_ptr<char> data;     ///< Memory block to write
+            Checksum              rawsum;   ///< RAWSUM contribution of the uncompressed tile
         };
 
 
@@ -85,15 +92,57 @@ public:
             std::shared_ptr<char> transposed_src;  ///< Transposed data
             WriteTarget           target;          ///< Compressed data
             uint32_t              num_rows;        ///< Number of rows to compress
+            uint64_t              queued;          ///< Time [us] when the tile was queued for compression
          };
 
 public:
+        /// Statistics of the compression of the current (or last) file
+        struct CompressionStats
+        {
+            uint32_t num_tiles;      ///< Number of tiles compressed
+            uint32_t rows_per_tile;  ///< Number of rows per tile
+            uint32_t num_threads;    ///< Number of compression threads available
+            uint32_t max_active;     ///< Maximum number of compression threads in use
+            uint32_t max_queued;     ///< Maximum number of tiles waiting for compression
+            uint32_t num_rows;       ///< Number of rows written so far
+            uint64_t bytes_in;       ///< Number of uncompressed bytes compressed so far
+            uint64_t bytes_out;      ///< Number of compressed bytes
+            double   queue_wait;     ///< Accumulated time the tiles waited for compression [s]
+            double   cpu_time;       ///< Accumulated cpu time used for compression [s]
+            double   row_rate;       ///< Rate at which rows have been written [Hz]
+
+            CompressionStats() : num_tiles(0), rows_per_tile(0), num_threads(0), max_active(0), max_queued(0), num_rows(0),
+                bytes_in(0), bytes_out(0), queue_wait(0), cpu_time(0), row_rate(0) { }
+        };
+
         /// static setter for the default number of threads to use. -1 means all available physical cores
         static uint32_t DefaultNumThreads(const uint32_t &_n=-2) { static uint32_t n=0; if (int32_t(_n)>-2) n=_n; return n; }
         static uint32_t DefaultMaxMemory(const uint32_t &_n=0) { static uint32_t n=1000000; if (_n>0) n=_n; return n; }
         static uint32_t DefaultMaxNumTiles(const uint32_t &_n=0) { static uint32_t n=1000; if (_n>0) n=_n; return n; }
         static uint32_t DefaultNumRowsPerTile(const uint32_t &_n=0) { static uint32_t n=100; if (_n>0) n=_n; return n; }
 
+        /// static setters for the adaptive tile size. If a maximum tile time [s] is set, the number of rows per
+        /// tile is chosen such that a tile is filled within that time at the row rate observed in the last
+        /// file. It is bound by DefaultMinNumRowsPerTile and DefaultNumRowsPerTile. 0 switches it off.
+        static uint32_t DefaultMaxTileTime(const uint32_t &_n=-1) { static uint32_t n=0; if (int32_t(_n)>=0) n=_n; return n; }
+        static uint32_t DefaultMinNumRowsPerTile(const uint32_t &_n=0) { static uint32_t n=10; if (_n>0) n=_n; return n; }
+
+        /// static storage of the row rate [Hz] observed when the last file was closed
+        static double ObservedRowRate(const double &_r=-1) { static double r=0; if (_r>=0) r=_r; return r; }
+
+        /// Number of rows per tile for the next file, see DefaultMaxTileTime
+        static uint32_t AdaptiveNumRowsPerTile()
+        {
+            const uint32_t max = DefaultNumRowsPerTile();
+            const double   num = ObservedRowRate()*DefaultMaxTileTime();
+
+            if (num<=0 || num>=max)
+                return max;
+
+            const uint32_t min = std::min(DefaultMinNumRowsPerTile(), max);
+            return num<min ? min : uint32_t(num);
+        }
+
         /// constructors
         /// @param numTiles how many data groups should be pre-reserved ?
         /// @param rowPerTile how many rows will be grouped together in a single tile
@@ -153,6 +202,11 @@ public:
             fCatalogSize      = 0;
 
             fMaxUsableMem = maxUsableMem;
+
+            fNumActiveQueues = 1;
+            fNumIdleTiles    = 0;
+            fFirstRowTime    = 0;
+            fLastRowTime     = 0;
 #ifdef __EXCEPTIONS
             fThreadsException = std::exception_ptr();
 #endif
@@ -186,6 +240,12 @@ public:
             //mark that no tile has been written so far
             fLatestWrittenTile = -1;
 
+            //start with a single compression thread, more are used when needed
+            fNumActiveQueues = 1;
+            fNumIdleTiles    = 0;
+
+            ResetStats();
+
             //no wiring error (in the writing of the data) has occured so far
             fErrno = 0;
 
@@ -328,32 +388,23 @@ public:
                 std::rethrow_exception(fThreadsException);
 #endif
 
-            //copy current row to pool or rows waiting for compression
-            char* target_location = fSmartBuffer.get() + fRealRowWidth*(fTable.num_rows%fNumRowsPerTile);
-            memcpy(target_location, ptr, fRealRowWidth);
-
-            //for now, make an extra copy of the data, for RAWSUM checksuming.
-            //Ideally this should be moved to the threads
-            //However, because the RAWSUM must be calculated before the tile is transposed, I am not sure whether
-            //one extra memcpy per row written is worse than 100 rows checksumed when the tile is full....
-            const uint32_t rawOffset = (fTable.num_rows*fRealRowWidth)%4;
-            char* buffer = fRawSumBuffer.data() + rawOffset;
-            auto ib = fRawSumBuffer.begin();
-            auto ie = fRawSumBuffer.rbegin();
-            *ib++ = 0;
-            *ib++ = 0;
-            *ib++ = 0;
-            *ib   = 0;
+            //remember when the rows were written to estimate the rate
+            //(locked, because GetStats can be called from other threads)
+            {
+                const std::lock_guard<std::mutex> lock(fStatsMutex);
 
-            *ie++ = 0;
-            *ie++ = 0;
-            *ie++ = 0;
-            *ie   = 0;
+                fLastRowTime = Now();
+                if (fTable.num_rows==0)
+                    fFirstRowTime = fLastRowTime;
 
-            memcpy(buffer, ptr, fRealRowWidth);
+                fStats.num_rows = fTable.num_rows+1;
+            }
 
-            fRawSum.add(fRawSumBuffer, false);
+            //copy current row to pool or rows waiting for compression
+            char* target_location = fSmartBuffer.get() + fRealRowWidth*(fTable.num_rows%fNumRowsPerTile);
+            memcpy(target_location, ptr, fRealRowWidth);
 
+            //the RAWSUM is calculated per tile by the compression threads (see CalcRawSum)
             fTable.num_rows++;
 
             if (fTable.num_rows % fNumRowsPerTile != 0)
@@ -363,7 +414,7 @@ public:
             }
 
             // use the least occupied queue
-            const auto imin = std::min_element(fCompressionQueues.begin(), fCompressionQueues.end());
+            const auto imin = GetNextQueue();
 
             if (!imin->emplace(InitNextCompression()))
             {
@@ -398,6 +449,7 @@ public:
             target.src            = fSmartBuffer;
             target.transposed_src = fMemPool.malloc();
             target.num_rows       = fTable.num_rows;
+            target.queued         = Now();
 
             //fill up write to disk target
             WriteTarget &write_target = target.target;
@@ -483,6 +535,10 @@ public:
                 std::rethrow_exception(fThreadsException);
 #endif
 
+            //remember the row rate for the tile size of the next file
+            if (fTable.num_rows>1 && fLastRowTime>fFirstRowTime)
+                ObservedRowRate((fTable.num_rows-1)*1e6/(fLastRowTime-fFirstRowTime));
+
             //write the last tile of data (if any)
             if (fErrno==0 && fTable.num_rows%fNumRowsPerTile!=0)
             {
@@ -634,8 +690,106 @@ public:
         uint32_t GetNumTiles() const { return fNumTiles; }
         void SetNumTiles(uint32_t num) { fNumTiles=num; }
 
+        /// Get and set the number of rows per tile. Can only be set before the file is opened.
+        uint32_t GetNumRowsPerTile() const { return fNumRowsPerTile; }
+        bool SetNumRowsPerTile(uint32_t num)
+        {
+            if (is_open() || num==0)
+            {
+#ifdef __EXCEPTIONS
+                throw std::runtime_error("Number of rows per tile must be >0 and cannot be changed after the file was opened");
+#else
+                gLog << ___err___ << "ERROR - Number of rows per tile must be >0 and cannot be changed after the file was opened" << std::endl;
+#endif
+                return false;
+            }
+
+            fNumRowsPerTile = num;
+            return true;
+        }
+
+        /// Get a copy of the compression statistics of the current file
+        CompressionStats GetStats() const
+        {
+            const std::lock_guard<std::mutex> lock(fStatsMutex);
+
+            CompressionStats stats = fStats;
+            if (stats.num_rows>1 && fLastRowTime>fFirstRowTime)
+                stats.row_rate = (stats.num_rows-1)*1e6/(fLastRowTime-fFirstRowTime);
+
+            return stats;
+        }
+
 protected:
 
+        /// Monotonic time stamp in microseconds
+        static uint64_t Now()
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        /// Cpu time consumed by the calling thread in seconds
+        static double ThreadCpuTime()
+        {
+            timespec ts;
+            clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+            return ts.tv_sec + ts.tv_nsec*1e-9;
+        }
+
+        void ResetStats()
+        {
+            const std::lock_guard<std::mutex> lock(fStatsMutex);
+
+            fFirstRowTime = 0;
+            fLastRowTime  = 0;
+
+            fStats = CompressionStats();
+            fStats.rows_per_tile = fNumRowsPerTile;
+            fStats.num_threads   = fCompressionQueues.size();
+            fStats.max_active    = fNumActiveQueues;
+        }
+
+        /// Choose the queue for the next tile. Only as many compression threads as
+        /// needed are kept busy: if all of them still have tiles to compress, one more
+        /// is used (up to the number of threads), if all of them were idle for a while
+        /// one less. This keeps the tiles in the cache of a few cores at low rates.
+        std::vector<Queue<CompressionTarget>>::iterator GetNextQueue()
+        {
+            const auto first = fCompressionQueues.begin();
+            const auto last  = first+fNumActiveQueues;
+
+            auto imin = std::min_element(first, last);
+
+            if (!imin->empty())
+            {
+                fNumIdleTiles = 0;
+                if (fNumActiveQueues<fCompressionQueues.size())
+                    imin = first + fNumActiveQueues++;
+            }
+            else
+            {
+                const bool idle = std::all_of(first, last, [](const Queue<CompressionTarget> &q) { return q.empty(); });
+                if (!idle)
+                    fNumIdleTiles = 0;
+                else
+                    if (++fNumIdleTiles>=16 && fNumActiveQueues>1)
+                    {
+                        fNumActiveQueues--;
+                        fNumIdleTiles = 0;
+                    }
+            }
+
+            uint32_t queued = 1;
+            for (auto it=first; it!=first+fNumActiveQueues; it++)
+                queued += it->size();
+
+            const std::lock_guard<std::mutex> lock(fStatsMutex);
+            fStats.max_active = std::max(fStats.max_active, fNumActiveQueues);
+            fStats.max_queued = std::max(fStats.max_queued, queued);
+
+            return imin;
+        }
+
         /// Allocates the required objects.
         void reallocateBuffers()
         {
@@ -646,7 +800,46 @@ protected:
             const size_t chunk_size = fRealRowWidth*fNumRowsPerTile + total_block_head_size + sizeof(FITS::TileHeader) + 8; //+8 for checksuming;
             fMemPool.setChunkSize(chunk_size);
             fSmartBuffer = fMemPool.malloc();
-            fRawSumBuffer.resize(fRealRowWidth + 4-fRealRowWidth%4); //for checksuming
+        }
+
+        /// Checksum of a block of uncompressed data which starts at the given
+        /// byte offset of the data stream. The incomplete words at both ends
+        /// are zero padded at their position in the stream, so that the sum
+        /// of all blocks is identical to the checksum of the whole stream.
+        /// @param src the first byte of the block
+        /// @param size the number of bytes of the block
+        /// @param offset the position of the first byte in the data stream
+        /// @return the checksum of the block
+        static Checksum CalcRawSum(const char* src, uint64_t size, uint64_t offset)
+        {
+            Checksum sum;
+
+            char pad[4];
+
+            const uint32_t shift = offset%4;
+            if (shift != 0 && size > 0)
+            {
+                const uint32_t n = std::min<uint64_t>(4-shift, size);
+
+                memset(pad, 0, 4);
+                memcpy(pad+shift, src, n);
+                sum.add(pad, 4, false);
+
+                src  += n;
+                size -= n;
+            }
+
+            const uint64_t aligned = size - size%4;
+            sum.add(src, aligned, false);
+
+            if (size%4 != 0)
+            {
+                memset(pad, 0, 4);
+                memcpy(pad, src+aligned, size%4);
+                sum.add(pad, 4, false);
+            }
+
+            return sum;
         }
 
         /// Actually does the writing to disk (and checksuming)
@@ -691,10 +884,18 @@ protected:
         /// @return number of bytes of the compressed data, or always 1 when used by the Queues
         bool CompressBuffer(const CompressionTarget& target)
         {
+            const uint64_t start = Now();
+            const double   cpu   = ThreadCpuTime();
+
             //Can't get this to work in the thread. Printed the adresses, and they seem to be correct.
             //Really do not understand what's wrong...
             //calibrate data if required
             const uint32_t thisRoundNumRows  = (target.num_rows%fNumRowsPerTile) ? target.num_rows%fNumRowsPerTile : fNumRowsPerTile;
+
+            //the RAWSUM is defined on the data before the calibration
+            const uint64_t firstRow = target.num_rows-thisRoundNumRows;
+            const Checksum rawsum   = CalcRawSum(target.src.get(), uint64_t(thisRoundNumRows)*fRealRowWidth, firstRow*fRealRowWidth);
+
             for (uint32_t i=0;i<thisRoundNumRows;i++)
             {
                 char* target_location = target.src.get() + fRealRowWidth*i;
@@ -710,9 +911,18 @@ protected:
                 //compress the buffer
                 const uint64_t compressed_size = compressBuffer(target.target.data.get(), target.transposed_src.get(), target.num_rows, target.catalog_entry);
 
+                {
+                    const std::lock_guard<std::mutex> lock(fStatsMutex);
+                    fStats.num_tiles++;
+                    fStats.bytes_in   += uint64_t(thisRoundNumRows)*fRealRowWidth;
+                    fStats.bytes_out  += compressed_size;
+                    fStats.queue_wait += (start-target.queued)*1e-6;
+                    fStats.cpu_time   += ThreadCpuTime()-cpu;
+                }
+
                 //post the result to the writing queue
                 //get a copy so that it becomes non-const
-                fWriteToDiskQueue.emplace(target.target, compressed_size);
+                fWriteToDiskQueue.emplace(target.target, compressed_size, rawsum);
 
 #ifdef __EXCEPTIONS
             }
@@ -737,6 +947,9 @@ protected:
 
             fLatestWrittenTile++;
 
+            //tiles arrive here one by one, so no lock is needed
+            fRawSum += target.rawsum;
+
 #ifdef __EXCEPTIONS
             try
             {
@@ -807,6 +1020,13 @@ protected:
                         else
                             compressedOffset += compressHUFFMAN16(dest + compressedOffset, src  + offset, fRealColumns[i].col.num, fRealColumns[i].col.size, thisRoundNumRows);
                         break;
+
+                    case FITS::kFactRans16:
+                        if (head.getOrdering() == FITS::kOrderByCol)
+                            compressedOffset += compressRANS16(dest + compressedOffset, src  + offset, thisRoundNumRows, fRealColumns[i].col.size, fRealColumns[i].col.num);
+                        else
+                            compressedOffset += compressRANS16(dest + compressedOffset, src  + offset, fRealColumns[i].col.num, fRealColumns[i].col.size, thisRoundNumRows);
+                        break;
                     }
                 }
 
@@ -818,7 +1038,8 @@ protected:
                     if (head.getProc(0) == FITS::kFactSmoothing)
                         UnApplySMOOTHING(src+offset, fRealColumns[i].col.num*thisRoundNumRows);
 
-                    FITS::Compression he;
+                    //keep the ordering, the data in src is already ordered
+                    FITS::Compression he(FITS::kFactRaw, head.getOrdering());
 
                     compressedOffset = previousOffset + he.getSizeOnDisk();
                     compressedOffset += compressUNCOMPRESSED(dest + compressedOffset, src + offset, thisRoundNumRows*fRealColumns[i].col.size*fRealColumns[i].col.num);
@@ -899,39 +1120,67 @@ protected:
         /// @return number of bytes written
         uint32_t compressHUFFMAN16(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems)
         {
-            std::string huffmanOutput;
-            uint32_t previousHuffmanSize = 0;
+            return compressENTROPY16(dest, src, numRows, sizeOfElems, numRowElems, "HUFMANN16", Huffman::Encode);
+        }
 
-            //if we have less than 2 elems to compress, Huffman encoder does not work (and has no point). Just return larger size than uncompressed to trigger the raw storage.
+        /// Do rANS encoding, same layout as the huffman encoding
+        /// @param dest the buffer that will receive the compressed data
+        /// @param src the buffer hosting the transposed data
+        /// @param numRows number of rows of data in the transposed buffer
+        /// @param sizeOfElems size in bytes of one data elements
+        /// @param numRowElems number of elements on each row
+        /// @return number of bytes written
+        uint32_t compressRANS16(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems)
+        {
+            return compressENTROPY16(dest, src, numRows, sizeOfElems, numRowElems, "RANS16", RANS::Encode);
+        }
+
+        /// Encode each of the numRowElems chunks with a 16-bit entropy coder. The
+        /// compressed sizes of the chunks are written first, followed by the chunks.
+        /// @param dest the buffer that will receive the compressed data
+        /// @param src the buffer hosting the transposed data
+        /// @param numRows number of rows of data in the transposed buffer
+        /// @param sizeOfElems size in bytes of one data elements
+        /// @param numRowElems number of elements on each row
+        /// @param name name of the compression for error messages
+        /// @param encode the encoder appending one encoded chunk to its output
+        /// @return number of bytes written
+        uint32_t compressENTROPY16(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems,
+                                   const char *name, bool (*encode)(std::string &, const uint16_t *, size_t))
+        {
+            std::string encodedOutput;
+            uint32_t previousEncodedSize = 0;
+
+            //if we have less than 2 elems to compress, the encoder does not work (and has no point). Just return larger size than uncompressed to trigger the raw storage.
             if (numRows < 2)
                 return numRows*sizeOfElems*numRowElems + 1000;
 
             if (sizeOfElems < 2 )
             {
 #ifdef __EXCEPTIONS
-                throw std::runtime_error("HUFMANN16 can only encode columns with 16-bit or longer types");
+                throw std::runtime_error(std::string(name)+" can only encode columns with 16-bit or longer types");
 #else
-                gLog << ___err___ << "ERROR - HUFMANN16 can only encode columns with 16-bit or longer types" << std::endl;
+                gLog << ___err___ << "ERROR - " << name << " can only encode columns with 16-bit or longer types" << std::endl;
                 return 0;
 #endif
             }
 
-            uint32_t huffmanOffset = 0;
+            uint32_t encodedOffset = 0;
             for (uint32_t j=0;j<numRowElems;j++)
             {
-                Huffman::Encode(huffmanOutput,
-                                reinterpret_cast<const uint16_t*>(&src[j*sizeOfElems*numRows]),
-                                numRows*(sizeOfElems/2));
-                reinterpret_cast<uint32_t*>(&dest[huffmanOffset])[0] = huffmanOutput.size() - previousHuffmanSize;
-                huffmanOffset += sizeof(uint32_t);
-                previousHuffmanSize = huffmanOutput.size();
+                encode(encodedOutput,
+                       reinterpret_cast<const uint16_t*>(&src[j*sizeOfElems*numRows]),
+                       numRows*(sizeOfElems/2));
+                reinterpret_cast<uint32_t*>(&dest[encodedOffset])[0] = encodedOutput.size() - previousEncodedSize;
+                encodedOffset += sizeof(uint32_t);
+                previousEncodedSize = encodedOutput.size();
             }
 
-            const size_t totalSize = huffmanOutput.size() + huffmanOffset;
+            const size_t totalSize = encodedOutput.size() + encodedOffset;
 
             //only copy if not larger than not-compressed size
             if (totalSize < numRows*sizeOfElems*numRowElems)
-                memcpy(&dest[huffmanOffset], huffmanOutput.data(), huffmanOutput.size());
+                memcpy(&dest[encodedOffset], encodedOutput.data(), encodedOutput.size());
 
             return totalSize;
         }
@@ -969,6 +1218,8 @@ protected:
         int32_t         fNumQueues;         ///< Current number of threads that will be used by this object
         uint64_t        fMaxUsableMem;      ///< Maximum number of bytes that can be allocated by the memory manager
         int32_t         fLatestWrittenTile; ///< Index of the last tile written to disk (for correct ordering while using several threads)
+        uint32_t        fNumActiveQueues;   ///< Number of compression threads currently in use
+        uint32_t        fNumIdleTiles;      ///< Number of tiles queued while all compression threads were idle
 
         std::vector<Queue<CompressionTarget>>     fCompressionQueues;  ///< Processing queues (=threads)
         Queue<WriteTarget, QueueMin<WriteTarget>> fWriteToDiskQueue;   ///< Writing queue (=thread)
@@ -1005,10 +1256,15 @@ protected:
         std::vector<CompressedColumn> fRealColumns;     ///< Vector hosting the columns of the file
         uint32_t                      fRealRowWidth;    ///< Width in bytes of one uncompressed row
         std::shared_ptr<char>         fSmartBuffer;     ///< Smart pointer to the buffer where the incoming rows are written
-        std::vector<char>             fRawSumBuffer;    ///< buffer used for checksuming the incoming data, before compression
 
         std::exception_ptr fThreadsException; ///< exception pointer to store exceptions coming from the threads
         int                fErrno;            ///< propagate errno to main thread
+
+        // statistics
+        CompressionStats   fStats;            ///< Compression statistics of the current file
+        mutable std::mutex fStatsMutex;       ///< Mutex protecting the statistics which are updated by the threads
+        uint64_t           fFirstRowTime;     ///< Time [us] when the first row was written (fStatsMutex)
+        uint64_t           fLastRowTime;      ///< Time [us] when the last row was written (fStatsMutex)
 };
 
 #endif
@@ -0,0 +1,99 @@
+#ifndef FACT_EventTrace
+#define FACT_EventTrace
+
+#include <memory>
+#include <vector>
+
+#include "src/FAD.h"
+
+// Bin contents of the ADC display of a single pixel. They are prepared
+// in the decoder thread, so that the GUI thread only has to hand them
+// over to the histograms (TH1::SetContent, TH1::SetError, TH2::FillN).
+// All bin arrays include the under- and overflow bin (size: nbins+2).
+struct EventTrace
+{
+    uint32_t pixel;     // Software index of the pixel
+    bool     physical;  // Samples displayed at their physical cell
+    int16_t  start;     // Start cell of the pixel (-1: not filled)
+    int      roi;       // Number of samples
+    int      nbins;     // Number of bins of the display
+
+    std::vector<double> x;      // Bin center of each sample
+    std::vector<double> y;      // Value of each sample
+    std::vector<double> adc;    // Bin contents of the samples
+
+    // Bin contents of baseline, gain and trigger offset and their
+    // rms (zero if no calibration is available or start<0)
+    std::vector<double> calib[6];
+
+    // The calibration the trace was calculated from
+    std::shared_ptr<const std::vector<float>> calibration;
+
+    bool IsValid(uint32_t p, bool phys, const std::shared_ptr<const std::vector<float>> &cal) const
+    {
+        return pixel==p && physical==phys && calibration==cal;
+    }
+};
+
+// --------------------------------------------------------------------------
+//
+// Calculates the trace of the software pixel p from the event evt and
+// the drs calibration (1440*1024*6+160*1024*2 values as published by
+// fadctrl, can be null). Each sample goes to the bin of its logical
+// or (if physical is set) physical cell, samples in front of the first
+// bin (start<0) go to the underflow bin.
+//
+inline std::shared_ptr<EventTrace> PrepareEventTrace(const EVENT &evt, uint32_t p, bool physical,
+                                                      const std::shared_ptr<const std::vector<float>> &cal)
+{
+    const std::shared_ptr<EventTrace> trace = std::make_shared<EventTrace>();
+
+    const int roi = evt.Roi;
+
+    trace->pixel       = p;
+    trace->physical    = physical;
+    trace->start       = evt.StartPix[p];
+    trace->roi         = roi;
+    trace->nbins       = physical ? 1024 : (roi>0 ? roi : 1);
+    trace->calibration = cal;
+
+    trace->x.resize(roi);
+    trace->y.resize(roi);
+    trace->adc.assign(trace->nbins+2, 0);
+
+    for (int j=0; j<6; j++)
+        trace->calib[j].assign(trace->nbins+2, 0);
+
+    const bool calibrated = cal && cal->size()>=1440*1024*6;
+
+    const int    start = trace->start;
+    const float *adc   = reinterpret_cast<const float*>(evt.Adc_Data) + p*roi;
+
+    for (int i=0; i<roi; i++)
+    {
+        const int ii  = physical ? (i+start)%1024 : i;
+        const int bin = ii<0 ? 0 : ii+1;
+
+        trace->x[i] = ii;
+        trace->y[i] = adc[i];
+
+        trace->adc[bin] += adc[i];
+
+        if (start<0 || !calibrated)
+            continue;
+
+        const float *c = cal->data() + p*1024;
+        const int    s = (start+i)%1024;
+
+        trace->calib[0][bin] = c[1440*1024*0 + s];
+        trace->calib[1][bin] = c[1440*1024*1 + s];
+        trace->calib[2][bin] = c[1440*1024*2 + s];
+        trace->calib[3][bin] = c[1440*1024*3 + s];
+        trace->calib[4][bin] = c[1440*1024*4 + i];
+        trace->calib[5][bin] = c[1440*1024*5 + i];
+    }
+
+    return trace;
+}
+
+#endif
@@ -5,6 +5,10 @@
 
 #include <iomanip>
 #include <valarray>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #include <boost/regex.hpp>
 
@@ -22,6 +26,7 @@
 #include "src/tools.h"
 #include "src/DimData.h"
 #include "externals/PixelMap.h"
+#include "EventTrace.h"
 
 #ifdef HAVE_ROOT
 #include "TROOT.h"
@@ -68,6 +73,117 @@ private:
         bool Exec() { fFunction(*this); return true; }
     };
 
+    // Decodes the updates of a service with large data in a thread of
+    // its own, so that the GUI thread only gets ready-to-use buffers.
+    // Updates which arrive while the previous one is still decoded or
+    // displayed replace each other (only the latest one is decoded)
+    // and the display is updated at most every 100ms.
+    class Decoder
+    {
+    public:
+        typedef function<void()> Display;
+        typedef function<Display(const shared_ptr<const DimData>&)> Decode;
+
+    private:
+        FactGui &fGui;
+
+        const Decode fDecode;
+
+        mutex              fMutex;
+        condition_variable fCond;
+
+        shared_ptr<const DimData> fData; // Latest update not yet decoded
+
+        bool fPending;  // Display posted to the GUI thread but not yet executed
+        bool fStop;
+
+        thread fThread;
+
+        // Executed in the GUI thread
+        void Exec(const Display &display)
+        {
+            fGui.fInHandler = true;
+            display();
+            fGui.fInHandler = false;
+
+            const lock_guard<mutex> lock(fMutex);
+            fPending = false;
+            fCond.notify_one();
+        }
+
+        void Run()
+        {
+            unique_lock<mutex> lock(fMutex);
+
+            auto next = chrono::steady_clock::now();
+
+            while (1)
+            {
+                while (!fStop && (!fData || fPending))
+                    fCond.wait(lock);
+
+                // Cap the refresh rate, updates arriving meanwhile
+                // replace fData
+                while (!fStop && chrono::steady_clock::now()<next)
+                    fCond.wait_until(lock, next);
+
+                if (fStop)
+                    break;
+
+                const shared_ptr<const DimData> data = fData;
+                fData.reset();
+
+                lock.unlock();
+                const Display display = fDecode(data);
+                lock.lock();
+
+                next = chrono::steady_clock::now()+chrono::milliseconds(100);
+
+                if (!display)
+                    continue;
+
+                fPending = true;
+
+                QApplication::postEvent(&fGui, new FunctionEvent(bind(&Decoder::Exec, this, display)));
+            }
+        }
+
+    public:
+        Decoder(FactGui &gui, const Decode &decode) : fGui(gui), fDecode(decode),
+            fPending(false), fStop(false)
+        {
+        }
+
+        ~Decoder()
+        {
+            {
+                const lock_guard<mutex> lock(fMutex);
+                fStop = true;
+                fCond.notify_one();
+            }
+
+            if (fThread.joinable())
+                fThread.join();
+        }
+
+        // Updates received before are kept until the thread is started
+        // (i.e. until the GUI, e.g. the pixel map, has been set up)
+        void Start()
+        {
+            fThread = thread(bind(&Decoder::Run, this));
+        }
+
+        // Called from the DIM thread
+        void Post(DimInfo *info)
+        {
+            const shared_ptr<const DimData> data = make_shared<DimData>(info);
+
+            const lock_guard<mutex> lock(fMutex);
+            fData = data;
+            fCond.notify_one();
+        }
+    };
+
     valarray<int8_t> fFtuStatus;
 
     PixelMap fPixelMap;
@@ -94,6 +210,10 @@ private:
     DimStampedInfo fDimFtmDynamicData;
     DimStampedInfo fDimFtmCounter;
 
+    Decoder fDecoderFadRawData;
+    Decoder fDecoderFadEventData;
+    Decoder fDecoderFadDrsCalibration;
+
     DimStampedInfo fDimFadWriteStats;
     DimStampedInfo fDimFadStartRun;
     DimStampedInfo fDimFadRuns;
@@ -943,7 +1063,14 @@ private:
         handleDac(fFadLedDac7, fFadDac7, d, 7);
     }
 
-    EVENT *fEventData;
+    shared_ptr<const DimData> fEventBuffer; // Holds the data fEventData points to
+    const EVENT *fEventData;
+
+    shared_ptr<const EventTrace> fEventTrace; // Trace of the displayed pixel in fEventData
+
+    // Pixel and mode displayed, for the decoder thread
+    atomic<uint32_t> fEventPixel;
+    atomic<bool>     fEventPhysical;
 #ifdef HAVE_ROOT
     void DrawHorizontal(TH1 *hf, double xmax, TH1 &h, double scale)
     {
@@ -1119,52 +1246,37 @@ private:
         SetLedColor(fFadLedDrsGain,     fDrsCalibGain->value()>0     ?kLedGreen:kLedGray, Time());
         SetLedColor(fFadLedDrsTrgOff,   fDrsCalibTrgOffset->value()>0?kLedGreen:kLedGray, Time());
 
-        if (d0)//fDrsCalibBaseline->value()==0  || start<0)
-            d0->Reset();
-        if (d1)//fDrsCalibGain->value()==0      || start<0)
-            d1->Reset();
-        if (d2)//fDrsCalibTrgOffset->value()==0 || start<0)
-            d2->Reset();
+        // The bin contents are usually prepared by the decoder thread,
+        // they are only recalculated if the pixel, the display mode or
+        // the calibration was changed meanwhile
+        const bool physical = fAdcPhysical->isChecked();
 
-        if (!dynamic_cast<TH2*>(h))
-            h->Reset();
-        if (d0)
-            d0->SetEntries(0);
-        if (d1)
-            d1->SetEntries(0);
-        if (d2)
-            d2->SetEntries(0);
+        fEventPixel    = p;
+        fEventPhysical = physical;
 
-        for (int i=0; i<fEventData->Roi; i++)
-        {
-            // FIXME: physcial: i -> (i+start)%1024
-            // FIXME: logical:  i ->  i
+        const shared_ptr<const vector<float>> calib = atomic_load(&fDrsCalibration);
+        if (!fEventTrace || !fEventTrace->IsValid(p, physical, calib))
+            fEventTrace = PrepareEventTrace(*fEventData, p, physical, calib);
 
-            const int ii = fAdcPhysical->isChecked() ? (i+start)%1024 : i;
+        const EventTrace &trace = *fEventTrace;
 
-            //if (dynamic_cast<TH2*>(h))
-                h->Fill(ii, reinterpret_cast<float*>(fEventData->Adc_Data)[p*fEventData->Roi+i]);
-            //else
-            //    h->SetBinContent(i+1, reinterpret_cast<float*>(fEventData->Adc_Data)[p*fEventData->Roi+i]);
-            if (start<0)
-                continue;
+        if (dynamic_cast<TH2*>(h))
+            h->FillN(trace.roi, trace.x.data(), trace.y.data(), 0);
+        else
+        {
+            h->SetContent(trace.adc.data());
+            h->SetEntries(trace.roi);
+        }
 
-            if (d0)
-            {
-                d0->SetBinContent(ii+1, fDrsCalibration[1440*1024*0 + p*1024+(start+i)%1024]);
-                d0->SetBinError(ii+1,   fDrsCalibration[1440*1024*1 + p*1024+(start+i)%1024]);
+        TH1 *dc[3] = { d0, d1, d2 };
+        for (int j=0; j<3; j++)
+        {
+            if (!dc[j])
+                continue;
 
-            }
-            if (d1)
-            {
-                d1->SetBinContent(ii+1, fDrsCalibration[1440*1024*2 + p*1024+(start+i)%1024]);
-                d1->SetBinError(ii+1,   fDrsCalibration[1440*1024*3 + p*1024+(start+i)%1024]);
-            }
-            if (d2)
-            {
-                d2->SetBinContent(ii+1, fDrsCalibration[1440*1024*4 + p*1024 + i]);
-                d2->SetBinError(ii+1,   fDrsCalibration[1440*1024*5 + p*1024 + i]);
-            }
+            dc[j]->SetContent(trace.calib[j*2].data());
+            dc[j]->SetError(trace.calib[j*2+1].data());
+            dc[j]->SetEntries(start<0 ? 0 : trace.roi);
         }
 
         // -----------------------------------------------------------
@@ -1228,17 +1340,14 @@ private:
         if (d2)
             h2.SetLineColor(d2->GetLineColor());
 
-        for (int i=0; i<fEventData->Roi; i++)
-        {
-            if (!dynamic_cast<TH2*>(h))
-                hd.Fill(h->GetBinContent(i+1));
-            if (d0)
-                h0.Fill(d0->GetBinContent(i+1));
-            if (d1)
-                h1.Fill(d1->GetBinContent(i+1));
-            if (d2)
-                h2.Fill(d2->GetBinContent(i+1));
-        }
+        if (!dynamic_cast<TH2*>(h))
+            hd.FillN(trace.roi, trace.adc.data()+1, 0);
+        if (d0)
+            h0.FillN(trace.roi, trace.calib[0].data()+1, 0);
+        if (d1)
+            h1.FillN(trace.roi, trace.calib[2].data()+1, 0);
+        if (d2)
+            h2.FillN(trace.roi, trace.calib[4].data()+1, 0);
 
         double mm = hd.GetMaximum(hd.GetEntries());
         if (h0.GetMaximum(h0.GetEntries())>mm)
@@ -1271,62 +1380,72 @@ private:
 #endif
     }
 
-    void handleFadRawData(const DimData &d)
+    // Called in the decoder thread
+    Decoder::Display decodeFadRawData(const shared_ptr<const DimData> &d)
     {
-	if (d.size()==0)
-            return;
+	if (d->size()==0)
+            return Decoder::Display();
 
-        if (fAdcStop->isChecked())
-            return;
+	const EVENT &dat = d->ref<EVENT>();
 
-	const EVENT &dat = d.ref<EVENT>();
-
-        if (d.size()<sizeof(EVENT))
+        if (d->size()<sizeof(EVENT))
         {
-            cerr << "Size mismatch in " << d.name << ": Found=" << d.size() << " Expected>=" << sizeof(EVENT) << endl;
-            return;
+            cerr << "Size mismatch in " << d->name << ": Found=" << d->size() << " Expected>=" << sizeof(EVENT) << endl;
+            return Decoder::Display();
         }
 
-        if (d.size()!=sizeof(EVENT)+dat.Roi*4*1440+dat.Roi*4*160)
+        if (d->size()!=sizeof(EVENT)+dat.Roi*4*1440+dat.Roi*4*160)
         {
-            cerr << "Size mismatch in " << d.name << ": Found=" << d.size() << " Expected=" << dat.Roi*4*1440+sizeof(EVENT) << " [roi=" << dat.Roi << "]" << endl;
-            return;
+            cerr << "Size mismatch in " << d->name << ": Found=" << d->size() << " Expected=" << dat.Roi*4*1440+sizeof(EVENT) << " [roi=" << dat.Roi << "]" << endl;
+            return Decoder::Display();
         }
 
-        delete [] reinterpret_cast<char*>(fEventData);
-        fEventData = reinterpret_cast<EVENT*>(new char[d.size()]);
-        memcpy(fEventData, d.ptr<void>(), d.size());
+        // Prepare the bins of the pixel currently displayed
+        const shared_ptr<const EventTrace> trace =
+            PrepareEventTrace(dat, fEventPixel, fEventPhysical, atomic_load(&fDrsCalibration));
 
-        DisplayEventData();
+        return bind(&FactGui::handleFadRawData, this, d, trace);
     }
 
-    void handleFadEventData(const DimData &d)
+    void handleFadRawData(const shared_ptr<const DimData> &d, const shared_ptr<const EventTrace> &trace)
     {
-        if (!CheckSize(d, 4*1440*sizeof(float)))
+        if (fAdcStop->isChecked())
             return;
 
-        if (fEventsStop->isChecked())
-            return;
+        // No copy needed, the buffer is kept until the next event
+        fEventBuffer = d;
+        fEventData   = &d->ref<EVENT>();
+        fEventTrace  = trace;
 
-        const float *ptr = d.ptr<float>();
+        DisplayEventData();
+    }
 
-        valarray<double> arr1(1440);
-        valarray<double> arr2(1440);
-        valarray<double> arr3(1440);
-        valarray<double> arr4(1440);
+    // Called in the decoder thread
+    Decoder::Display decodeFadEventData(const shared_ptr<const DimData> &d)
+    {
+        if (!CheckSize(*d, 4*1440*sizeof(float)))
+            return Decoder::Display();
 
-        for (vector<PixelMapEntry>::const_iterator it=fPixelMap.begin(); it!=fPixelMap.end(); it++)
-        {
-            arr1[it->index] = ptr[0*1440+it->hw()];
-            arr2[it->index] = ptr[1*1440+it->hw()];
-            arr3[it->index] = ptr[2*1440+it->hw()];
-            arr4[it->index] = ptr[3*1440+it->hw()];
-        }
+        const float *ptr = d->ptr<float>();
 
-        fEventCanv1->SetData(arr1);
-        fEventCanv2->SetData(arr2);
-        fEventCanv3->SetData(arr3);
-        fEventCanv4->SetData(arr4);
+        const shared_ptr<vector<valarray<double>>> arr =
+            make_shared<vector<valarray<double>>>(4, valarray<double>(1440));
+
+        for (int i=0; i<4; i++)
+            fPixelMap.HwToSw(ptr+i*1440, &(*arr)[i][0]);
+
+        return bind(&FactGui::handleFadEventData, this, arr);
+    }
+
+    void handleFadEventData(const shared_ptr<vector<valarray<double>>> &arr)
+    {
+        if (fEventsStop->isChecked())
+            return;
+
+        fEventCanv1->SetData((*arr)[0]);
+        fEventCanv2->SetData((*arr)[1]);
+        fEventCanv3->SetData((*arr)[2]);
+        fEventCanv4->SetData((*arr)[3]);
 
         fEventCanv1->updateCamera();
         fEventCanv2->updateCamera();
@@ -1334,47 +1453,57 @@ private:
         fEventCanv4->updateCamera();
     }
 
-    vector<float> fDrsCalibration;
+    // Swapped by the GUI thread, read by the decoder thread
+    shared_ptr<const vector<float>> fDrsCalibration;
+
+    struct DrsCalibrationData
+    {
+        int32_t run[4];       // roi, baseline, gain, trigger offset (-1: none)
+        vector<float> data;
+    };
 
-    void handleFadDrsCalibration(const DimData &d)
+    // Called in the decoder thread
+    Decoder::Display decodeFadDrsCalibration(const shared_ptr<const DimData> &d)
     {
         const size_t sz = 1024*1440*6+1024*160*2;
 
-        if (d.size()==0)
+        const shared_ptr<DrsCalibrationData> calib = make_shared<DrsCalibrationData>();
+
+        if (d->size()==0)
         {
-            fDrsCalibBaseline->setValue(-1);
-            fDrsCalibGain->setValue(-1);
-            fDrsCalibTrgOffset->setValue(-1);
-            fDrsCalibROI->setValue(-1);
-
-            fDrsCalibBaseline2->setValue(-1);
-            fDrsCalibGain2->setValue(-1);
-            fDrsCalibTrgOffset2->setValue(-1);
-            fDrsCalibROI2->setValue(-1);
-
-            fDrsCalibration.assign(sz, 0);
-            DisplayEventData();
-            return;
+            fill(calib->run, calib->run+4, -1);
+            calib->data.assign(sz, 0);
+
+            return bind(&FactGui::handleFadDrsCalibration, this, calib);
         }
 
-        if (!CheckSize(d, sz*sizeof(float)+4*sizeof(uint32_t)))
+        if (!CheckSize(*d, sz*sizeof(float)+4*sizeof(uint32_t)))
             // Do WHAT?
-            return;
+            return Decoder::Display();
+
+        const uint32_t *run = d->ptr<uint32_t>();
+        copy(run, run+4, calib->run);
+
+        const float *dat = d->ptr<float>(sizeof(uint32_t)*4);
+        calib->data.assign(dat, dat+sz);
 
-        const uint32_t *run = d.ptr<uint32_t>();
+        return bind(&FactGui::handleFadDrsCalibration, this, calib);
+    }
 
-        fDrsCalibROI->setValue(run[0]);
-        fDrsCalibBaseline->setValue(run[1]);
-        fDrsCalibGain->setValue(run[2]);
-        fDrsCalibTrgOffset->setValue(run[3]);
+    void handleFadDrsCalibration(const shared_ptr<DrsCalibrationData> &calib)
+    {
+        fDrsCalibROI->setValue(calib->run[0]);
+        fDrsCalibBaseline->setValue(calib->run[1]);
+        fDrsCalibGain->setValue(calib->run[2]);
+        fDrsCalibTrgOffset->setValue(calib->run[3]);
 
-        fDrsCalibROI2->setValue(run[0]);
-        fDrsCalibBaseline2->setValue(run[1]);
-        fDrsCalibGain2->setValue(run[2]);
-        fDrsCalibTrgOffset2->setValue(run[3]);
+        fDrsCalibROI2->setValue(calib->run[0]);
+        fDrsCalibBaseline2->setValue(calib->run[1]);
+        fDrsCalibGain2->setValue(calib->run[2]);
+        fDrsCalibTrgOffset2->setValue(calib->run[3]);
 
-        const float *dat = d.ptr<float>(sizeof(uint32_t)*4);
-        fDrsCalibration.assign(dat, dat+sz);
+        const shared_ptr<const vector<float>> data = make_shared<vector<float>>(move(calib->data));
+        atomic_store(&fDrsCalibration, data);
 
         DisplayEventData();
     }
@@ -3034,7 +3163,7 @@ private:
             return PostInfoHandler(&FactGui::handleFadDac);
 
         if (getInfo()==&fDimFadDrsCalibration)
-            return PostInfoHandler(&FactGui::handleFadDrsCalibration);
+            return fDecoderFadDrsCalibration.Post(getInfo());
 
         if (getInfo()==&fDimFadPrescaler)
             return PostInfoHandler(&FactGui::handleFadPrescaler);
@@ -3061,10 +3190,10 @@ private:
             return PostInfoHandler(&FactGui::handleFadStartRun);
 
 	if (getInfo()==&fDimFadRawData)
-            return PostInfoHandler(&FactGui::handleFadRawData);
+            return fDecoderFadRawData.Post(getInfo());
 
         if (getInfo()==&fDimFadEventData)
-            return PostInfoHandler(&FactGui::handleFadEventData);
+            return fDecoderFadEventData.Post(getInfo());
 
 /*
         if (getInfo()==&fDimFadSetup)
@@ -3596,6 +3725,10 @@ public:
         fDimFtmDynamicData     ("FTM_CONTROL/DYNAMIC_DATA",     (void*)NULL, 0, this),
         fDimFtmCounter         ("FTM_CONTROL/COUNTER",          (void*)NULL, 0, this),
         //-
+        fDecoderFadRawData       (*this, bind(&FactGui::decodeFadRawData,        this, placeholders::_1)),
+        fDecoderFadEventData     (*this, bind(&FactGui::decodeFadEventData,      this, placeholders::_1)),
+        fDecoderFadDrsCalibration(*this, bind(&FactGui::decodeFadDrsCalibration, this, placeholders::_1)),
+        //-
         fDimFadWriteStats      ("FAD_CONTROL/STATS",              (void*)NULL, 0, this),
         fDimFadStartRun        ("FAD_CONTROL/START_RUN",          (void*)NULL, 0, this),
         fDimFadRuns            ("FAD_CONTROL/RUNS",               (void*)NULL, 0, this),
@@ -3636,7 +3769,8 @@ public:
         fDimVersion(0),
         fFreeSpaceLogger(UINT64_MAX), fFreeSpaceData(UINT64_MAX),
         fEventData(0),
-        fDrsCalibration(1440*1024*6+160*1024*2),
+        fEventPixel(0), fEventPhysical(false),
+        fDrsCalibration(make_shared<vector<float>>(1440*1024*6+160*1024*2)),
         fTimeStamp0(0)
     {
         fClockCondFreq->addItem("--- Hz",  QVariant(-1));
@@ -4032,6 +4166,12 @@ public:
 
         // --------------------------------------------------------------------------
 
+        fDecoderFadRawData.Start();
+        fDecoderFadEventData.Start();
+        fDecoderFadDrsCalibration.Start();
+
+        // --------------------------------------------------------------------------
+
         QTimer::singleShot(1000, this, SLOT(slot_RootUpdate()));
 
         //widget->setMouseTracking(true);
@@ -4113,9 +4253,6 @@ public:
         for (map<string,DimInfo*>::iterator i=fServices.begin();
              i!=fServices.end(); i++)
             delete i->second;
-
-        // This is allocated as a chuck of chars
-        delete [] reinterpret_cast<char*>(fEventData);
     }
 };
 
@@ -69,6 +69,25 @@ function Subscription(service, callback)
      */
     this.isOpen = false;
 
+    /**
+     *
+     * If set to true, arrays in the data of an event (e.g. F:1440) are
+     * returned as typed arrays instead of Array objects. The received
+     * values are then copied in a single step, which is much faster for
+     * large arrays than converting each value. The prototype of
+     * the returned objects is Array.prototype, so that functions like
+     * reduce or forEach can still be used. Note that, in contrast to
+     * normal arrays, floats are not rounded to seven digits.
+     *
+     * @type Boolean
+     *
+     * @example
+     *     var handle = new Subscription("FEEDBACK/CALIBRATED_CURRENTS");
+     *     handle.typed = true;
+     *
+     */
+    this.typed = false;
+
     /**
      *
      * Callback in case of event reception.
@@ -0,0 +1,223 @@
+// **************************************************************************
+/** @class Astrometry
+
+@brief Batch transformation of sky coordinates with the pal routines
+
+Transforming mean (J2000) coordinates to observed coordinates (and back)
+with the pal routines requires a time dependent setup (palMappa: precession,
+nutation, Earth position and velocity; palAoppa: sidereal time, refraction
+constants) which is much more expensive than the transformation of a single
+position itself (palMapqkz/palAopqk).
+
+This class transforms arrays of positions, each with its own time. The time
+dependent parameters are calculated once per time bucket (by default ten
+minutes) for the center of the bucket. Only the sidereal time, which changes
+fast, is updated for each position (palAoppat). The annual aberration changes
+by less than 0.4" per day, so the error introduced by the buckets is far below
+0.01" for the default bucket length.
+
+The arrays are split into contiguous chunks which are processed by several
+threads. Each thread keeps its own parameters, so if the positions are (almost)
+ordered in time, the setup is done only once per bucket and thread.
+
+All angles are in radians, times are MJD (UTC). UT1-UTC and the polar motion
+are assumed to be zero (as in drivectrl). The azimuth is counted from north
+to east.
+
+@code
+   Astrometry astro;                 // Roque de los Muchachos, default weather
+   astro.MeanToObserved(n, ra, dec, mjd, zd, az);
+@endcode
+
+*/
+// **************************************************************************
+#include "Astrometry.h"
+
+#include <math.h>
+#include <thread>
+#include <algorithm>
+
+#include "pal.h"
+
+using namespace std;
+
+// --------------------------------------------------------------------------
+//
+//! The coordinates are the ones of Nova::kORM, the height and weather are
+//! the defaults of drivectrl.
+//
+Astrometry::Site::Site() :
+    lng(-(17.+53./60+26.525/3600)*M_PI/180), lat((28.+45./60+42.462/3600)*M_PI/180),
+    height(2200), temp(10), press(780), hum(0.25), wavelength(0.40), lapse(0.0065)
+{
+}
+
+// --------------------------------------------------------------------------
+//
+//! @param site
+//!     Location and atmosphere of the observatory
+//!
+//! @param bucket
+//!     Length of the time buckets in seconds
+//
+Astrometry::Astrometry(const Site &site, double bucket) : fSite(site), fNumThreads(0)
+{
+    SetBucket(bucket);
+}
+
+// --------------------------------------------------------------------------
+//
+//! Calculates the parameters of the bucket which contains mjd (if they are
+//! not yet the parameters of this bucket) for the center of the bucket.
+//
+void Astrometry::Prepare(double mjd, Params &par) const
+{
+    const int64_t bucket = floor(mjd/fBucket);
+    if (bucket==par.bucket)
+        return;
+
+    const double center = (bucket+0.5)*fBucket;
+
+    const double dtt = palDtt(center);
+    const double tdb = center + dtt/3600/24;
+
+    // Mean place to geocentric apparent
+    palMappa(2000.0, tdb, par.amprms);
+
+    // Apparent to observed place
+    palAoppa(center, 0,                                    // mjd, UT1-UTC
+             fSite.lng, fSite.lat, fSite.height,           // long, lat, height
+             0, 0,                                         // polar motion
+             273.155+fSite.temp, fSite.press, fSite.hum,   // temp, pressure, humidity
+             fSite.wavelength, fSite.lapse,                // wavelength, tropo lapse rate
+             par.aoprms);
+
+    par.bucket = bucket;
+}
+
+void Astrometry::MeanToObservedImp(size_t first, size_t last, const double *ra, const double *dec, const double *mjd, double *zd, double *az) const
+{
+    Params par;
+
+    for (size_t i=first; i<last; i++)
+    {
+        Prepare(mjd[i], par);
+
+        // Only the sidereal time is updated
+        palAoppat(mjd[i], par.aoprms);
+
+        // Mean to apparent
+        double r, d;
+        palMapqkz(ra[i], dec[i], par.amprms, &r, &d);
+
+        // Apparent to observed
+        double ha, ob_dec, ob_ra;
+        palAopqk(r, d, par.aoprms, az+i, zd+i, &ha, &ob_dec, &ob_ra);
+    }
+}
+
+void Astrometry::ObservedToMeanImp(size_t first, size_t last, const double *zd, const double *az, const double *mjd, double *ra, double *dec) const
+{
+    Params par;
+
+    for (size_t i=first; i<last; i++)
+    {
+        Prepare(mjd[i], par);
+
+        // Only the sidereal time is updated
+        palAoppat(mjd[i], par.aoprms);
+
+        // Observed to apparent
+        double r, d;
+        palOapqk("A", az[i], zd[i], par.aoprms, &r, &d);
+
+        // Apparent to mean
+        palAmpqk(r, d, par.amprms, ra+i, dec+i);
+    }
+}
+
+// --------------------------------------------------------------------------
+//
+//! Calls func(first, last) for contiguous chunks of [0, n) in several
+//! threads. Small arrays are processed in the calling thread.
+//
+template<class Func>
+void Astrometry::Run(size_t n, Func func) const
+{
+    const size_t cores = fNumThreads>0 ? fNumThreads : max(1u, thread::hardware_concurrency());
+    const size_t nt    = max<size_t>(1, min<size_t>(cores, n/256));
+
+    if (nt==1)
+    {
+        func(0, n);
+        return;
+    }
+
+    vector<thread> threads;
+    threads.reserve(nt);
+
+    for (size_t i=0; i<nt; i++)
+        threads.emplace_back(func, n*i/nt, n*(i+1)/nt);
+
+    for (auto &t : threads)
+        t.join();
+}
+
+// --------------------------------------------------------------------------
+//
+//! Transforms mean (J2000) positions to observed positions.
+//!
+//! @param n
+//!     Number of positions
+//!
+//! @param ra, dec
+//!     Mean right ascension and declination (J2000) [rad]
+//!
+//! @param mjd
+//!     Time of each position [MJD, UTC]
+//!
+//! @param zd, az
+//!     Observed zenith distance and azimuth (N=0, E=90deg) [rad]
+//
+void Astrometry::MeanToObserved(size_t n, const double *ra, const double *dec, const double *mjd, double *zd, double *az) const
+{
+    Run(n, [&](size_t first, size_t last)
+        {
+            MeanToObservedImp(first, last, ra, dec, mjd, zd, az);
+        });
+}
+
+// --------------------------------------------------------------------------
+//
+//! Transforms observed positions to mean (J2000) positions. This is the
+//! inverse of MeanToObserved.
+//
+void Astrometry::ObservedToMean(size_t n, const double *zd, const double *az, const double *mjd, double *ra, double *dec) const
+{
+    Run(n, [&](size_t first, size_t last)
+        {
+            ObservedToMeanImp(first, last, zd, az, mjd, ra, dec);
+        });
+}
+
+void Astrometry::MeanToObserved(const vector<double> &ra, const vector<double> &dec, const vector<double> &mjd,
+                                vector<double> &zd, vector<double> &az) const
+{
+    const size_t n = min(min(ra.size(), dec.size()), mjd.size());
+
+    zd.resize(n);
+    az.resize(n);
+
+    MeanToObserved(n, ra.data(), dec.data(), mjd.data(), zd.data(), az.data());
+}
+
+void Astrometry::ObservedToMean(const vector<double> &zd, const vector<double> &az, const vector<double> &mjd,
+                                vector<double> &ra, vector<double> &dec) const
+{
+    const size_t n = min(min(zd.size(), az.size()), mjd.size());
+
+    ra.resize(n);
+    dec.resize(n);
+
+    ObservedToMean(n, zd.data(), az.data(), mjd.data(), ra.data(), dec.data());
+}
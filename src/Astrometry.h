@@ -0,0 +1,68 @@
+#ifndef FACT_Astrometry
+#define FACT_Astrometry
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+class Astrometry
+{
+public:
+    /// Location and atmosphere of the observatory
+    struct Site
+    {
+        double lng;        /// [rad] Geographic longitude (east positive)
+        double lat;        /// [rad] Geographic latitude
+        double height;     /// [m]   Height above sea level
+        double temp;       /// [deg C] Ambient temperature
+        double press;      /// [hPa] Ambient pressure (0 switches off refraction)
+        double hum;        /// [0-1] Relative humidity
+        double wavelength; /// [um]  Effective wavelength
+        double lapse;      /// [K/m] Tropospheric lapse rate
+
+        /// Roque de los Muchachos with the default weather of drivectrl
+        Site();
+    };
+
+private:
+    /// Time dependent parameters of one time bucket
+    struct Params
+    {
+        int64_t bucket;      /// Index of the bucket (-1: none)
+        double  amprms[21];  /// Mean to apparent (palMappa)
+        double  aoprms[14];  /// Apparent to observed (palAoppa)
+
+        Params() : bucket(-1) { }
+    };
+
+    Site     fSite;
+    double   fBucket;      /// [d] Length of a time bucket
+    unsigned fNumThreads;  /// Number of threads (0: number of cores)
+
+    void Prepare(double mjd, Params &par) const;
+
+    void MeanToObservedImp(size_t first, size_t last, const double *ra, const double *dec, const double *mjd, double *zd, double *az) const;
+    void ObservedToMeanImp(size_t first, size_t last, const double *zd, const double *az, const double *mjd, double *ra, double *dec) const;
+
+    template<class Func>
+    void Run(size_t n, Func func) const;
+
+public:
+    Astrometry(const Site &site=Site(), double bucket=600);
+
+    /// Length of the time buckets [s] for which the time dependent parameters are cached
+    void SetBucket(double sec) { fBucket = sec/24/3600; }
+    void SetNumThreads(unsigned n) { fNumThreads = n; }
+
+    const Site &GetSite() const { return fSite; }
+
+    void MeanToObserved(size_t n, const double *ra, const double *dec, const double *mjd, double *zd, double *az) const;
+    void ObservedToMean(size_t n, const double *zd, const double *az, const double *mjd, double *ra, double *dec) const;
+
+    void MeanToObserved(const std::vector<double> &ra, const std::vector<double> &dec, const std::vector<double> &mjd,
+                        std::vector<double> &zd, std::vector<double> &az) const;
+    void ObservedToMean(const std::vector<double> &zd, const std::vector<double> &az, const std::vector<double> &mjd,
+                        std::vector<double> &ra, std::vector<double> &dec) const;
+};
+
+#endif
@@ -41,7 +41,9 @@ The opposite direction is also possible
    cout << c.GetString(pointer, size) << endl;
  \endcode
 
-Other conversion functions also exist.
+Other conversion functions also exist, e.g. GetJson() for a JSON
+representation and GetSpans() for typed views of the data block without
+any conversion.
 
 To check if the compilation of the format string was successfull
 the valid() member functio is provided.
@@ -350,65 +352,32 @@ string Converter::GetStringEol(stringstream &line) const
 
 // --------------------------------------------------------------------------
 //
-//! Converts from a binary block into a string. The type of the expected
-//! value is defined by the template parameter.
+//! Interpret n values at ptr as type T and write them (each prefixed by
+//! a whitespace) to the given stream.
 //!
-//! @param ptr
-//!     A refrenece to the pointer of the binary representation to be
-//!     interpreted. The pointer is incremented by the sizeof the type.
-//!
-//! @tparam T
-//!     Expected type
-//!
-//! @returns
-//!     The string
-//!
-template<class T>
-string Converter::GetString(const char* &ptr) const
-{
-    const T &t = *reinterpret_cast<const T*>(ptr);
-
-    ostringstream stream;
-    stream << t;
-    ptr += sizeof(T);
-
-    return stream.str();
-}
-
-template<char>
-string Converter::GetString(const char* &ptr) const
-{
-    ostringstream stream;
-    stream << (int64_t)*ptr;
-    ptr += 1;
-
-    return stream.str();
-}
-
-// --------------------------------------------------------------------------
-//
-//! Convert the pointer using GetString into a string and add it (prefixed
-//! by a whaitespace) to the given string.
-//!
-//! @param str
-//!     Reference to the string to which the ptr should be added
+//! @param out
+//!     Reference to the stream to which the values should be written
 //!
 //! @param ptr
 //!     Pointer to the binary representation. It will be incremented
-//!     according to the sze of the template argument
+//!     according to the size of the template argument
+//!
+//! @param n
+//!     Number of values
 //!
 //! @tparam T
 //!     Type as which the binary data should be interpreted
 //!
 template<class T>
-void Converter::Add(string &str, const char* &ptr) const
+void Converter::Add(ostream &out, const char* &ptr, uint32_t n) const
 {
-    str += ' ' + GetString<T>(ptr);
+    for (uint32_t i=0; i<n; i++, ptr+=sizeof(T))
+        out << ' ' << *reinterpret_cast<const T*>(ptr);
 }
 
 // --------------------------------------------------------------------------
 //
-//! Convert the pointer into a boost::any object and add it to the
+//! Convert n values at ptr into boost::any objects and add them to the
 //! provided vector
 //!
 //! @param vec
@@ -418,32 +387,37 @@ void Converter::Add(string &str, const char* &ptr) const
 //!     Pointer to the binary representation. It will be incremented
 //!     according to the size of the template argument
 //!
+//! @param n
+//!     Number of values
+//!
 //! @tparam T
 //!     Type as which the binary data should be interpreted
 //!
 template<class T>
-void Converter::Add(vector<boost::any> &vec, const char* &ptr) const
+void Converter::Add(vector<boost::any> &vec, const char* &ptr, uint32_t n) const
 {
-    vec.push_back(*reinterpret_cast<const T*>(ptr));
-    ptr += sizeof(T);
+    for (uint32_t i=0; i<n; i++, ptr+=sizeof(T))
+        vec.push_back(*reinterpret_cast<const T*>(ptr));
 }
 
 // --------------------------------------------------------------------------
 //
-//! Add the string pointed to by ptr to the given string.
+//! Write the string pointed to by ptr (prefixed by a whitespace) to the
+//! given stream.
 //!
-//! @param str
-//!     Reference to the string to which the ptr should be added
+//! @param out
+//!     Reference to the stream to which the string should be written
 //!
 //! @param ptr
 //!     Pointer to the binary representation. It will be incremented
 //!     according to the size of the template argument
 //!
-void Converter::AddString(string &str, const char* &ptr) const
+void Converter::AddString(ostream &out, const char* &ptr) const
 {
-    const string txt(ptr);
-    str += ' '+txt;
-    ptr += txt.length()+1;
+    const size_t len = strlen(ptr);
+    out << ' ';
+    out.write(ptr, len);
+    ptr += len+1;
 }
 
 // --------------------------------------------------------------------------
@@ -464,6 +438,58 @@ void Converter::AddString(vector<boost::any> &vec, const char* &ptr) const
     ptr += txt.length()+1;
 }
 
+// --------------------------------------------------------------------------
+//
+//! Compiles the format description into a flat execution plan, which
+//! can be processed without evaluating the type information of
+//! each entry again.
+//!
+//! @param list
+//!     Compiled format description
+//!
+//! @returns
+//!     The execution plan, empty if the format description is invalid.
+//!
+vector<Converter::Step> Converter::CompilePlan(const FormatList &list)
+{
+    vector<Step> plan;
+
+    // The last entry is always 'void' (marks the end)
+    if (list.empty() || list.back().first.second!=0)
+        return plan;
+
+    for (auto it=list.begin(); it!=list.end()-1; it++)
+    {
+        const type_info &t = *it->first.first;
+
+        Step step;
+        step.size  = it->first.second;
+        step.count = it->second.first;
+
+        if (t==typeid(string))
+        {
+            step.type  = 'C';
+            step.count = 0;
+        }
+        else if (t==typeid(bool))      step.type = 'B';
+        else if (t==typeid(char))      step.type = 'C';
+        else if (t==typeid(short))     step.type = 'S';
+        else if (t==typeid(int))       step.type = 'I';
+        else if (t==typeid(long))      step.type = 'L';
+        else if (t==typeid(float))     step.type = 'F';
+        else if (t==typeid(double))    step.type = 'D';
+        else if (t==typeid(long long)) step.type = 'X';
+        else if (t==typeid(O))         step.type = 'O';
+        else if (t==typeid(W))         step.type = 'W';
+        else
+            throw runtime_error("TypeId '"+string(t.name())+"' not known!");
+
+        plan.push_back(step);
+    }
+
+    return plan;
+}
+
 // --------------------------------------------------------------------------
 //
 //! Compiles the format string into fList. See Compile() for more details.
@@ -480,7 +506,7 @@ void Converter::AddString(vector<boost::any> &vec, const char* &ptr) const
 //!     understood by DIM.
 //!
 Converter::Converter(std::ostream &out, const std::string &fmt, bool strict)
-: wout(out), fFormat(Clean(fmt)), fList(Compile(out, fmt, strict))
+: wout(out), fFormat(Clean(fmt)), fList(Compile(out, fmt, strict)), fPlan(CompilePlan(fList))
 {
 }
 
@@ -499,7 +525,7 @@ Converter::Converter(std::ostream &out, const std::string &fmt, bool strict)
 //!     understood by DIM.
 //!
 Converter::Converter(const std::string &fmt, bool strict)
-: wout(cout), fFormat(Clean(fmt)), fList(Compile(fmt, strict))
+: wout(cout), fFormat(Clean(fmt)), fList(Compile(fmt, strict)), fPlan(CompilePlan(fList))
 {
 }
 
@@ -639,21 +665,21 @@ std::vector<char> Converter::GetVector(const std::string &str) const
 // --------------------------------------------------------------------------
 //
 //! Converts the provided data block into a vector of boost::any or
-//! a string.
+//! a text stream. The data is processed in a single pass through the
+//! execution plan.
 //!
 //! @tparam T
-//!     Kind of data to be returned. This can either be boost::any objects
-//!     or a string
+//!     Kind of output. This can either be a vector of boost::any
+//!     objects or a stream
 //!
-//! @returns
-//!    A vector of the given template type containing the arguments. In
-//!    case of failure an empty vector is returned.
+//! @param text
+//!     The converted arguments are added to this object
 //!
 //! @throws
 //!    std::runtime_error if the conversion was not successfull
 //!
 template<class T>
-T Converter::Get(const void *dat, size_t size) const
+void Converter::Get(T &text, const void *dat, size_t size) const
 {
     if (!valid())
         throw runtime_error("Compiled format invalid!");
@@ -663,8 +689,7 @@ T Converter::Get(const void *dat, size_t size) const
 
     const char *ptr = reinterpret_cast<const char *>(dat);
 
-    T text;
-    for (Converter::FormatList::const_iterator i=fList.begin(); i<fList.end()-1; i++)
+    for (auto i=fPlan.begin(); i!=fPlan.end(); i++)
     {
         if (ptr-size>dat)
         {
@@ -673,36 +698,32 @@ T Converter::Get(const void *dat, size_t size) const
             throw runtime_error(err.str());
         }
 
-        if (*i->first.first == typeid(string))
+        // \0-terminated string (always the last entry)
+        if (i->type=='C' && i->count==0)
         {
             if (size>0)
                 AddString(text, ptr);
             if (ptr-size<=dat)
-                return text;
+                return;
             break;
         }
 
-        // Get as many items from the input line as requested
-        for (int j=0; j<i->second.first; j++)
+        // Get as many items from the data block as requested
+        switch (i->type)
         {
-            switch (i->first.first->name()[0])
-            {
-            case 'b': Add<bool>     (text, ptr); break;
-            case 'c': Add<char>     (text, ptr); break;
-            case 's': Add<short>    (text, ptr); break;
-            case 'i': Add<int>      (text, ptr); break;
-            case 'l': Add<long>     (text, ptr); break;
-            case 'f': Add<float>    (text, ptr); break;
-            case 'd': Add<double>   (text, ptr); break;
-            case 'x': Add<long long>(text, ptr); break;
-            case 'N': AddString(text, ptr);      break;
-
-            case 'v':
-                // This should never happen!
-                throw runtime_error("Type 'void' not supported!");
-            default:
-                throw runtime_error("TypeId '"+string(i->first.first->name())+"' not known!");
-            }
+        case 'B': Add<bool>     (text, ptr, i->count); break;
+        case 'C': Add<char>     (text, ptr, i->count); break;
+        case 'S': Add<short>    (text, ptr, i->count); break;
+        case 'I': Add<int>      (text, ptr, i->count); break;
+        case 'L': Add<long>     (text, ptr, i->count); break;
+        case 'F': Add<float>    (text, ptr, i->count); break;
+        case 'D': Add<double>   (text, ptr, i->count); break;
+        case 'X': Add<long long>(text, ptr, i->count); break;
+        case 'O':
+        case 'W':
+            for (uint32_t j=0; j<i->count; j++)
+                AddString(text, ptr);
+            break;
         }
     }
 
@@ -712,13 +733,13 @@ T Converter::Get(const void *dat, size_t size) const
         err << "Data block size (" << size << ") doesn't fit format description [fmt=" << fFormat << "|size=" << GetSize() <<"]";
         throw runtime_error(err.str());
     }
-
-    return text;
 }
 
 std::vector<boost::any> Converter::GetAny(const void *dat, size_t size) const
 {
-    return Get<vector<boost::any>>(dat, size);
+    vector<boost::any> vec;
+    Get(vec, dat, size);
+    return vec;
 }
 
 std::vector<char> Converter::GetVector(const void *dat, size_t size) const
@@ -734,10 +755,220 @@ std::vector<char> Converter::GetVector(const void *dat, size_t size) const
 
 string Converter::GetString(const void *dat, size_t size) const
 {
-    const string s = Get<string>(dat, size);
+    // All values are written to a single stream in one pass
+    ostringstream text;
+    Get(text, dat, size);
+
+    const string s = text.str();
     return s.empty() ? s : s.substr(1);
 }
 
+// --------------------------------------------------------------------------
+//
+//! Splits a data block into one typed view per entry of the format
+//! without copying or converting the values. The data block is checked
+//! in the same way as by GetString and GetAny.
+//!
+//! @param dat
+//!     Pointer to the data block
+//!
+//! @param size
+//!     Size of the data block
+//!
+//! @returns
+//!     One Span per entry of the format, one per string for O and W.
+//!     The spans point into the data block.
+//!
+//! @throws
+//!    std::runtime_error if the data block doesn't fit the format
+//!
+vector<Converter::Span> Converter::GetSpans(const void *dat, size_t size) const
+{
+    if (!valid())
+        throw runtime_error("Compiled format invalid!");
+
+    if (dat==0)
+        throw runtime_error("Data pointer == NULL!");
+
+    const char *ptr = reinterpret_cast<const char *>(dat);
+    const char *end = ptr+size;
+
+    vector<Span> spans;
+    spans.reserve(fPlan.size());
+
+    for (auto i=fPlan.begin(); i!=fPlan.end(); i++)
+    {
+        if (ptr>end)
+        {
+            ostringstream err;
+            err << "Format description [fmt=" << fFormat << "|size=" << GetSize() << "] exceeds available data size (" << size << ")";
+            throw runtime_error(err.str());
+        }
+
+        // \0-terminated strings
+        const bool str = (i->type=='C' && i->count==0) || i->type=='O' || i->type=='W';
+        if (str)
+        {
+            // The trailing string is optional
+            const uint32_t n = i->count==0 ? (size>0 ? 1 : 0) : i->count;
+            for (uint32_t j=0; j<n; j++)
+            {
+                const size_t len = strnlen(ptr, end-ptr);
+                spans.push_back({ i->type, true, 1, uint32_t(len), ptr });
+                ptr += len+1;
+            }
+
+            // always the last entry
+            if (i->count==0)
+            {
+                if (ptr<=end)
+                    return spans;
+                break;
+            }
+            continue;
+        }
+
+        spans.push_back({ i->type, false, i->size, i->count, ptr });
+        ptr += i->size*i->count;
+    }
+
+    if (ptr!=end)
+    {
+        ostringstream err;
+        err << "Data block size (" << size << ") doesn't fit format description [fmt=" << fFormat << "|size=" << GetSize() <<"]";
+        throw runtime_error(err.str());
+    }
+
+    return spans;
+}
+
+namespace
+{
+    // Writes the n characters at ptr as JSON string
+    void JsonString(ostream &out, const char *ptr, size_t n)
+    {
+        out << '"';
+        for (const char *c=ptr; c<ptr+n; c++)
+        {
+            switch (*c)
+            {
+            case '"':  out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (uint8_t(*c)<0x20)
+                    out << "\\u00" << hex << setfill('0') << setw(2) << int(*c) << dec << setfill(' ');
+                else
+                    out << *c;
+            }
+        }
+        out << '"';
+    }
+
+    template<typename T>
+    void JsonValue(ostream &out, const T &val)
+    {
+        out << val;
+    }
+
+    // JSON has neither NaN nor infinity
+    template<>
+    void JsonValue<float>(ostream &out, const float &val)
+    {
+        if (isfinite(val))
+            out << val;
+        else
+            out << "null";
+    }
+
+    template<>
+    void JsonValue<double>(ostream &out, const double &val)
+    {
+        if (isfinite(val))
+            out << val;
+        else
+            out << "null";
+    }
+
+    template<>
+    void JsonValue<bool>(ostream &out, const bool &val)
+    {
+        out << (val ? "true" : "false");
+    }
+
+    // Single values are written as value, several as array
+    template<typename T>
+    void JsonValues(ostream &out, const Converter::Span &span)
+    {
+        if (span.count!=1)
+            out << '[';
+
+        for (uint32_t i=0; i<span.count; i++)
+        {
+            if (i>0)
+                out << ',';
+
+            T val;
+            memcpy(&val, span.data<char>()+i*sizeof(T), sizeof(T));
+            JsonValue(out, val);
+        }
+
+        if (span.count!=1)
+            out << ']';
+    }
+}
+
+// --------------------------------------------------------------------------
+//
+//! Converts a data block into a JSON array with one element per entry of
+//! the format (see GetSpans). Entries with a single value are written as
+//! value, all others as array. Characters (C) and strings are written as
+//! JSON string (up to the first \0), booleans as true/false and NaN or
+//! infinite values as null. Numbers are formatted as by GetString.
+//!
+//! @param dat
+//!     Pointer to the data block
+//!
+//! @param size
+//!     Size of the data block
+//!
+//! @throws
+//!    std::runtime_error if the data block doesn't fit the format
+//!
+string Converter::GetJson(const void *dat, size_t size) const
+{
+    const vector<Span> spans = GetSpans(dat, size);
+
+    ostringstream out;
+    out << '[';
+
+    for (auto it=spans.begin(); it!=spans.end(); it++)
+    {
+        if (it!=spans.begin())
+            out << ',';
+
+        switch (it->type)
+        {
+        case 'C':
+        case 'O':
+        case 'W': JsonString(out, it->data<char>(), strnlen(it->data<char>(), it->count)); break;
+        case 'B': JsonValues<bool>     (out, *it); break;
+        case 'S': JsonValues<short>    (out, *it); break;
+        case 'I': JsonValues<int>      (out, *it); break;
+        case 'L': JsonValues<long>     (out, *it); break;
+        case 'F': JsonValues<float>    (out, *it); break;
+        case 'D': JsonValues<double>   (out, *it); break;
+        case 'X': JsonValues<long long>(out, *it); break;
+        }
+    }
+
+    out << ']';
+
+    return out.str();
+}
+
 template<class T>
 Converter::Type Converter::GetType()
 {
@@ -899,8 +1130,7 @@ void Converter::ToFits(void *dest, const void *src, size_t size) const
    char       *charDest = static_cast<char*>(dest);
    const char *charSrc  = static_cast<const char*>(src);
 
-   // We skip the last element 'v'
-   for (Converter::FormatList::const_iterator i=fList.begin(); i!=fList.end()-1; i++)
+   for (auto i=fPlan.begin(); i!=fPlan.end(); i++)
    {
        /*
         // For speed reasons we don't do a check in the loop
@@ -913,28 +1143,56 @@ void Converter::ToFits(void *dest, const void *src, size_t size) const
        */
 
        // Skip strings (must be the last, so we could just skip it)
-       const char type = i->first.first->name()[0];
-       if (type=='S')
+       if (i->type=='C' && i->count==0)
        {
            charSrc += strlen(charSrc)+1;
            continue;
        }
 
-       const int s = i->first.second;      // size of element
-       const int n = i->second.first;      // number of elements
+       const uint32_t s = i->size;       // size of element
+       const uint32_t n = i->count;      // number of elements
 
        // Check if there are types with unknown sizes
        if (s==0 || n==0)
-           throw runtime_error(string("Type '")+type+"' not supported converting to FITS.");
+           throw runtime_error(string("Type '")+i->type+"' not supported converting to FITS.");
 
-       // Let the compiler do some optimization
+       // Swap the byte order of all elements of one entry in a tight loop
        switch (s)
        {
-       case 1: memcpy(charDest, charSrc, s*n); charSrc+=s*n; charDest+=s*n; break;
-       case 2: for (int j=0; j<n; j++) { reverse_copy(charSrc, charSrc+2, charDest); charSrc+=2; charDest+=2; } break;
-       case 4: for (int j=0; j<n; j++) { reverse_copy(charSrc, charSrc+4, charDest); charSrc+=4; charDest+=4; } break;
-       case 8: for (int j=0; j<n; j++) { reverse_copy(charSrc, charSrc+8, charDest); charSrc+=8; charDest+=8; } break;
+       case 1:
+           memcpy(charDest, charSrc, n);
+           break;
+       case 2:
+           for (uint32_t j=0; j<n; j++)
+           {
+               uint16_t v;
+               memcpy(&v, charSrc+2*j, 2);
+               v = __builtin_bswap16(v);
+               memcpy(charDest+2*j, &v, 2);
+           }
+           break;
+       case 4:
+           for (uint32_t j=0; j<n; j++)
+           {
+               uint32_t v;
+               memcpy(&v, charSrc+4*j, 4);
+               v = __builtin_bswap32(v);
+               memcpy(charDest+4*j, &v, 4);
+           }
+           break;
+       case 8:
+           for (uint32_t j=0; j<n; j++)
+           {
+               uint64_t v;
+               memcpy(&v, charSrc+8*j, 8);
+               v = __builtin_bswap64(v);
+               memcpy(charDest+8*j, &v, 8);
+           }
+           break;
        }
+
+       charSrc  += s*n;
+       charDest += s*n;
    }
 
    if (charDest-size!=dest/* || charSrc-size!=src*/)
@@ -951,7 +1209,7 @@ vector<string> Converter::ToStrings(const void *src/*, size_t size*/) const
 
    vector<string> rc;
 
-   for (Converter::FormatList::const_iterator i=fList.begin(); i!=fList.end(); i++)
+   for (auto i=fPlan.begin(); i!=fPlan.end(); i++)
    {
        /*
        if (charSrc-size>src)
@@ -961,26 +1219,16 @@ vector<string> Converter::ToStrings(const void *src/*, size_t size*/) const
            throw runtime_error(err.str());
        }*/
 
-       const char type = i->first.first->name()[0];
-       if (type=='v')
-           break;
-
-       if (type=='S' || type=='N')
+       // string types
+       if ((i->type=='C' && i->count==0) || i->type=='O' || i->type=='W')
        {
-           const string str(charSrc);
-           rc.push_back(str);
-           charSrc += str.length()+1;
+           const size_t len = strlen(charSrc);
+           rc.emplace_back(charSrc, len);
+           charSrc += len+1;
            continue;
        }
 
-       // string types
-       //if (string("bsilfdxc").find_first_of(type)==string::npos)
-       //    throw runtime_error(string("Type '")+type+"' not supported converting to FITS.");
-
-       const int s = i->first.second;      // size of element
-       const int n = i->second.first;      // number of elements
-
-       charSrc  += s*n;
+       charSrc += i->size*i->count;
    }
 
    return rc;
@@ -2,6 +2,7 @@
 #define FACT_Converter
 
 #include <math.h>
+#include <stdint.h>
 
 #include <vector>
 #include <iomanip>
@@ -24,13 +25,39 @@ public:
     struct O { };
     struct W { };
 
+    /// A typed view of the values of one entry of the format within a
+    /// data block (see GetSpans). Strings (C without count, O and W) are
+    /// views of their characters without the terminating \0.
+    struct Span
+    {
+        char        type;   /// DIM type (B,C,S,I,L,F,D,X,O,W)
+        bool        string; /// \0-terminated string (type C, O or W)
+        uint16_t    size;   /// Size of a single element in bytes
+        uint32_t    count;  /// Number of elements (characters of a string)
+        const void *ptr;    /// First element within the data block
+
+        template<typename T>
+            const T *data() const { return reinterpret_cast<const T*>(ptr); }
+    };
+
     static std::string Clean(std::string s);
 
 private:
     std::ostream &wout;        /// ostream to which output is redirected
 
+    /// One step of the execution plan: count elements of the given
+    /// DIM type (B,C,S,I,L,F,D,X,O,W). A 'C' with a count of zero
+    /// is a \0-terminated string.
+    struct Step
+    {
+        char     type;
+        uint16_t size;
+        uint32_t count;
+    };
+
     const std::string fFormat; /// Original format string
     const FormatList  fList;   /// Compiled format description
+    const std::vector<Step> fPlan; /// Flat execution plan compiled from fList
 
     template <class T>
         T Get(std::stringstream &line) const;
@@ -47,10 +74,7 @@ private:
     void GetBinString(std::vector<char> &v, const std::string &val) const;
     void GetBinString(std::vector<boost::any> &v, const std::string &val) const;
 
-    template<class T>
-        std::string GetString(const char *&data) const;
-    template<char>
-        std::string GetString(const char* &ptr) const;
+    static std::vector<Step> CompilePlan(const FormatList &list);
 
     template<class T>
         static Type GetType();
@@ -60,15 +84,13 @@ private:
     template <class T>
         std::vector<T> Get(const std::string &str) const;
     template <class T>
-        T Get(const void *d, size_t size) const;
-
-
+        void Get(T &out, const void *d, size_t size) const;
 
     template<class T>
-        void Add(std::string &str, const char* &ptr) const;
-    void AddString(std::string &str, const char* &ptr) const;
+        void Add(std::ostream &out, const char* &ptr, uint32_t n) const;
+    void AddString(std::ostream &out, const char* &ptr) const;
     template<class T>
-        void Add(std::vector<boost::any> &vec, const char* &ptr) const;
+        void Add(std::vector<boost::any> &vec, const char* &ptr, uint32_t n) const;
     void AddString(std::vector<boost::any> &vec, const char* &ptr) const;
 
 
@@ -94,6 +116,8 @@ public:
     std::string             GetString(const void *d, size_t size) const;
     std::vector<char>       GetVector(const void *d, size_t size) const;
     std::vector<boost::any> GetAny(const void *d, size_t size) const;
+    std::vector<Span>       GetSpans(const void *d, size_t size) const;
+    std::string             GetJson(const void *d, size_t size) const;
 
     std::vector<boost::any> GetAny(const std::string &str) const;
     std::vector<char>       GetVector(const std::string &str) const;
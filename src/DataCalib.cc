@@ -1,5 +1,9 @@
 #include "DataCalib.h"
 
+#include <thread>
+#include <functional>
+#include <condition_variable>
+
 #include "EventBuilder.h"
 #include "FitsFile.h"
 #include "DimDescriptionService.h"
@@ -8,10 +12,118 @@
 
 using namespace std;
 
+namespace
+{
+    // A fixed set of worker threads which process contiguous ranges of
+    // channels. The calling thread processes the first range itself and
+    // Run returns when all ranges are done, so the event data need not
+    // be copied.
+    class ChannelPool
+    {
+        vector<thread> fThreads;
+
+        mutex              fMutex;
+        condition_variable fCondStart;
+        condition_variable fCondDone;
+
+        function<void(size_t, size_t)> fFunc;
+
+        size_t   fNumChannels;
+        uint64_t fGeneration;   // Incremented for each call of Run
+        size_t   fPending;      // Number of workers still busy
+        bool     fStop;
+
+        void Range(size_t idx, size_t n)
+        {
+            fFunc(fNumChannels*idx/n, fNumChannels*(idx+1)/n);
+        }
+
+        void Thread(size_t idx, size_t n, uint64_t generation)
+        {
+            while (1)
+            {
+                {
+                    unique_lock<mutex> lock(fMutex);
+                    fCondStart.wait(lock, [&]{ return fStop || fGeneration!=generation; });
+                    if (fStop)
+                        return;
+
+                    generation = fGeneration;
+                }
+
+                Range(idx, n);
+
+                const lock_guard<mutex> lock(fMutex);
+                if (--fPending==0)
+                    fCondDone.notify_one();
+            }
+        }
+
+    public:
+        ChannelPool() : fNumChannels(0), fGeneration(0), fPending(0), fStop(false) { }
+        ~ChannelPool() { Stop(); }
+
+        void Stop()
+        {
+            {
+                const lock_guard<mutex> lock(fMutex);
+                fStop = true;
+            }
+            fCondStart.notify_all();
+
+            for (auto &t : fThreads)
+                t.join();
+
+            fThreads.clear();
+            fStop = false;
+        }
+
+        // n is the total number of threads including the calling thread
+        void Start(size_t n)
+        {
+            Stop();
+
+            for (size_t i=1; i<n; i++)
+                fThreads.emplace_back(&ChannelPool::Thread, this, i, n, fGeneration);
+        }
+
+        void Run(size_t nch, const function<void(size_t, size_t)> &func)
+        {
+            if (fThreads.empty())
+            {
+                func(0, nch);
+                return;
+            }
+
+            {
+                const lock_guard<mutex> lock(fMutex);
+
+                fFunc        = func;
+                fNumChannels = nch;
+                fPending     = fThreads.size();
+                fGeneration++;
+            }
+            fCondStart.notify_all();
+
+            Range(0, fThreads.size()+1);
+
+            unique_lock<mutex> lock(fMutex);
+            fCondDone.wait(lock, [this]{ return fPending==0; });
+        }
+    };
+
+    ChannelPool gPool;
+}
+
 DrsCalibration DataCalib::fData;
 bool DataCalib::fProcessing = false;
 vector<float> DataCalib::fStats(1440*1024*6+160*1024*2+4);
 
+void DataCalib::SetNumThreads(unsigned int n)
+{
+    gPool.Start(n==0 ? thread::hardware_concurrency() : n);
+}
+
 void DataCalib::Restart()
 {
     fData.Clear();
@@ -185,20 +297,43 @@ bool DataCalib::WriteEvt(const EVT_CTRL2 &evt)
 
     const EVENT &e = *evt.fEvent;
 
-    if (fData.fStep==0)
-    {
-        AddRel(e.Adc_Data, e.StartPix);
-    }
-    if (fData.fStep==1)
+    if (fData.fStep<=2)
     {
-        AddRel(e.Adc_Data, e.StartPix, fData.fOffset.data(), fData.fNumOffset);
+        // The channels are accumulated in parallel by the threads of the pool
+        gPool.Run(fNumChannels, [&](size_t first, size_t last)
+        {
+            if (fData.fStep==0)
+            {
+                AddRelRange(e.Adc_Data, e.StartPix, first, last);
+            }
+            if (fData.fStep==1)
+            {
+                AddRelRange(e.Adc_Data, e.StartPix, fData.fOffset.data(), fData.fNumOffset, first, last);
+            }
+            if (fData.fStep==2)
+            {
+                AddAbsRange(e.Adc_Data, e.StartPix, fData.fOffset.data(), fData.fNumOffset, first, last);
+            }
+        });
+
+        fNumEntries++;
     }
-    if (fData.fStep==2)
+
+    return DataWriteFits2::WriteEvt(evt);
+}
+
+void DataCalib::CalcSampleStats(float *ptr, float scale) const
+{
+    if (fNumEntries==0)
     {
-        AddAbs(e.Adc_Data, e.StartPix, fData.fOffset.data(), fData.fNumOffset);
+        GetSampleStats(ptr, scale);
+        return;
     }
 
-    return DataWriteFits2::WriteEvt(evt);
+    gPool.Run(fNumChannels, [&](size_t first, size_t last)
+    {
+        GetSampleStatsRange(ptr, scale, first, last);
+    });
 }
 
 bool DataCalib::ReadFits(const string &str, MessageImp &msg)
@@ -293,7 +428,7 @@ bool DataCalib::Close(const EVT_CTRL2 &evt)
             fData.fGain[i] = 4096*fNumEntries;
 
         // Scale ADC data from 12bit to 2000mV
-        GetSampleStats(fStats.data()+4, 2000./4096);
+        CalcSampleStats(fStats.data()+4, 2000./4096);
         reinterpret_cast<uint32_t*>(fStats.data())[1] = GetRunId();;
     }
     if (fData.fStep==1)
@@ -311,7 +446,7 @@ bool DataCalib::Close(const EVT_CTRL2 &evt)
             fData.fGain[i] *= 1024;
 
         // Scale ADC data from 12bit to 2000mV
-        GetSampleStats(fStats.data()+1024*1440*2+4, 2000./4096/fData.fNumOffset);//0.5);
+        CalcSampleStats(fStats.data()+1024*1440*2+4, 2000./4096/fData.fNumOffset);//0.5);
         reinterpret_cast<uint32_t*>(fStats.data())[2] = GetRunId();;
     }
     if (fData.fStep==2)
@@ -320,7 +455,7 @@ bool DataCalib::Close(const EVT_CTRL2 &evt)
         fData.fNumTrgOff = fNumEntries;
 
         // Scale ADC data from 12bit to 2000mV
-        GetSampleStats(fStats.data()+1024*1440*4+4, 2000./4096/fData.fNumOffset);//0.5);
+        CalcSampleStats(fStats.data()+1024*1440*4+4, 2000./4096/fData.fNumOffset);//0.5);
         reinterpret_cast<uint32_t*>(fStats.data())[0] = fNumSamples;
         reinterpret_cast<uint32_t*>(fStats.data())[3] = GetRunId();
     }
@@ -27,11 +27,19 @@ class DataCalib : public DataWriteFits2, public DrsCalibrate
 
     int GetDrsStep() const { return fData.fStep; }
 
+    void CalcSampleStats(float *ptr, float scale) const;
+
 public:
     DataCalib(const std::string &path, uint64_t night, uint32_t id, const DrsCalibration &calib, DimDescribedService &dim, DimDescribedService &runs, MessageImp &imp) : DataWriteFits2(path, night, id, calib, imp), fDim(dim), fDimRuns(runs)
     {
     }
 
+    /// Number of threads accumulating the events of the DRS calibration
+    /// runs (channel ranges, 0: number of cores). With 1 or without a call,
+    /// the events are accumulated in the writer thread. fadctrl sets it
+    /// from --drs-calib-threads (default 4).
+    static void SetNumThreads(unsigned int n);
+
     static void Restart();
     static bool ResetTrgOff(DimDescribedService &dim, DimDescribedService &runs);
     static void Update(DimDescribedService &dim, DimDescribedService &runs);
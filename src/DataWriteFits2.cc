@@ -189,7 +189,10 @@ bool DataWriteFits2::Open(const RUN_HEAD &h, const FAD::RunDescription &d)
     zofits *fits = dynamic_cast<zofits*>(fFile.get());
     if (fits)
     {
-        const uint32_t nrpt = zofits::DefaultNumRowsPerTile();
+        // Adapt the tile size to the event rate of the last run
+        // such that the data is not kept in memory for too long
+        const uint32_t nrpt = zofits::AdaptiveNumRowsPerTile();
+        fits->SetNumRowsPerTile(nrpt);
 
         // Maximum number of events if taken with 100Hz
         // (If no limit requested, maxtime is 24*60*60)
@@ -248,6 +251,16 @@ bool DataWriteFits2::Open(const RUN_HEAD &h, const FAD::RunDescription &d)
     return true;
 }
 
+// --------------------------------------------------------------------------
+//
+//! Access to the compressing writer (e.g. for its statistics),
+//! NULL if the file is not compressed
+//
+const zofits *DataWriteFits2::GetZFits() const
+{
+    return dynamic_cast<const zofits*>(fFile.get());
+}
+
 // --------------------------------------------------------------------------
 //
 //! This writes one event to the file
@@ -6,6 +6,7 @@
 #include <array>
 
 class ofits;
+class zofits;
 
 struct DrsCalibration;
 
@@ -31,6 +32,8 @@ public:
     bool WriteEvt(const EVT_CTRL2 &e);
     bool Close(const EVT_CTRL2 &);
 
+    const zofits *GetZFits() const;
+
     Time GetTstart() const { return Time(fTstart[0], fTstart[1]); }
     Time GetTstop() const  { return Time(fTstop[0],  fTstop[1]);  }
 };
@@ -8,8 +8,17 @@
 
 #include "dic.hxx"
 
+#include "DimTrace.h"
+
 namespace Dim
 {
+    // Record a sent command if tracing is enabled (see DimTrace)
+    inline void TraceCommand(const std::string &command)
+    {
+        if (DimTrace::IsEnabled())
+            DimTrace::Record(DimTrace::kCommand, command);
+    }
+
     // --------------------------------------------------------------------------
     //
     //! Simplification wrapper to send a command without data
@@ -25,10 +34,12 @@ namespace Dim
     //!
     inline bool SendCommand(const std::string &command)
     {
+        TraceCommand(command);
         return DimClient::sendCommand(command.c_str(), NULL, 0);
     }
     inline void SendCommandNB(const std::string &command)
     {
+        TraceCommand(command);
         DimClient::sendCommandNB(command.c_str(), NULL, 0);
     }
 
@@ -57,23 +68,27 @@ namespace Dim
     template<typename T>
         inline bool SendCommand(const std::string &command, const T &t)
     {
+        TraceCommand(command);
         return DimClient::sendCommand(command.c_str(), const_cast<T*>(&t), sizeof(t));
     }
 
     template<>
         inline bool SendCommand(const std::string &command, const std::string &t)
     {
+        TraceCommand(command);
         return DimClient::sendCommand(command.c_str(), const_cast<char*>(t.c_str()), t.length()+1);
     }
 
     template<typename T>
         inline bool SendCommand(const std::string &command, const std::vector<T> &v)
     {
+        TraceCommand(command);
         return DimClient::sendCommand(command.c_str(), const_cast<char*>(v.data()), v.size()*sizeof(T));
     }
 
     inline bool SendCommand(const std::string &command, const void *d, size_t s)
     {
+        TraceCommand(command);
         return DimClient::sendCommand(command.c_str(), const_cast<void*>(d), s);
     }
 
@@ -82,23 +97,27 @@ namespace Dim
     template<typename T>
         inline void SendCommandNB(const std::string &command, const T &t)
     {
+        TraceCommand(command);
         DimClient::sendCommandNB(command.c_str(), const_cast<T*>(&t), sizeof(t));
     }
 
     template<>
         inline void SendCommandNB(const std::string &command, const std::string &t)
     {
+        TraceCommand(command);
         DimClient::sendCommandNB(command.c_str(), const_cast<char*>(t.c_str()), t.length()+1);
     }
 
     template<typename T>
         inline void SendCommandNB(const std::string &command, const std::vector<T> &v)
     {
+        TraceCommand(command);
         DimClient::sendCommandNB(command.c_str(), const_cast<T*>(v.data()), v.size()*sizeof(T));
     }
 
     inline void SendCommandNB(const std::string &command, const void *d, size_t s)
     {
+        TraceCommand(command);
         DimClient::sendCommandNB(command.c_str(), const_cast<void*>(d), s);
     }
 }
@@ -37,6 +37,7 @@ The description should contain as many descriptions as format chunks, e.g.
 
 #include "dis.hxx"
 #include "Time.h"
+#include "DimTrace.h"
 
 using namespace std;
 
@@ -155,6 +156,10 @@ void DimDescribedService::setTime()
 int DimDescribedService::Update(const Time &t)
 {
     setTime(t);
+
+    if (DimTrace::IsEnabled() && DimTrace::IsTraced(getName()))
+        DimTrace::Record(DimTrace::kUpdate, getName(), DimTrace::GetStamp(t));
+
     return updateService();
 }
 
@@ -0,0 +1,345 @@
+// **************************************************************************
+/** @class DimTrace
+
+@brief Opt-in tracing of the latencies within the DIM control loop
+
+Closed loops (e.g. trigger rates from the FTM to ratecontrol and back to
+the FTM) pass through several programs. To find out where the time is
+spent, each program can record every service update, reception of an
+update or command, sent command and handled event into a trace file
+(enabled with the --trace option of the programs).
+
+Updates are identified by the name of the service and their time stamp,
+which is distributed by DIM together with the data. Therefore no
+additional information has to be transmitted and the records of the
+sending and the receiving program can be matched offline. DIM transmits
+the time stamp with a resolution of one millisecond, so the time stamps
+identifying an update or event are truncated to full milliseconds on
+both sides (see GetStamp). While an event
+is handled, all updates and commands issued by the same thread refer to
+the event (name and time stamp) as their cause. This allows to
+reconstruct the causal chains through several programs.
+
+The trace file is memory mapped and used as a ring buffer of fixed size
+records (see DimTrace::Header and DimTrace::Entry), so that it is always
+up-to-date even if the program crashes. The sequence number of each
+record gives the order of the records.
+
+In addition, histograms of the latencies are published by the service
+SERVER/LATENCY every ten seconds. Bin i contains latencies between 2^i
+and 2^(i+1) microseconds, the first bin all latencies below 2us. The
+delivery latencies are calculated from the truncated time stamps and
+have a resolution of one millisecond. The LATENCY services themselves
+are not traced.
+
+*/
+// **************************************************************************
+#include "DimTrace.h"
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Time.h"
+#include "DimDescriptionService.h"
+
+using namespace std;
+
+int                DimTrace::fFd      = -1;
+DimTrace::Header  *DimTrace::fHeader  = 0;
+DimTrace::Entry   *DimTrace::fEntries = 0;
+
+atomic<uint64_t> DimTrace::fCount(0);
+atomic<uint32_t> DimTrace::fBins[DimTrace::kNumHops][DimTrace::kNumBins];
+
+thread_local const DimTrace::Cause *DimTrace::fCause = 0;
+
+namespace
+{
+    DimDescribedService *gService = 0;
+
+    thread             gThread;
+    mutex              gMutex;
+    condition_variable gCond;
+    bool               gStop = false;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Sets this instance as the cause of all records written by this thread
+//! until it is destroyed.
+//!
+//! @param name
+//!     Name of the event being handled
+//!
+//! @param origin
+//!     Time stamp of the event [us]
+//
+DimTrace::Cause::Cause(const string &name, uint64_t origin)
+    : fName(name), fOrigin(origin), fPrev(DimTrace::fCause)
+{
+    DimTrace::fCause = this;
+}
+
+DimTrace::Cause::~Cause()
+{
+    DimTrace::fCause = fPrev;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Creates (or overwrites) the trace file and maps it into memory. From
+//! now on, IsEnabled() returns true.
+//!
+//! @param filename
+//!     Name of the trace file
+//!
+//! @param capacity
+//!     Number of records in the ring buffer
+//!
+//! @returns
+//!     false if the file could not be created or mapped (errno is set)
+//
+bool DimTrace::Open(const string &filename, uint64_t capacity)
+{
+    Close();
+
+    if (capacity==0)
+        return true;
+
+    const size_t size = sizeof(Header)+capacity*sizeof(Entry);
+
+    fFd = open(filename.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0644);
+    if (fFd<0)
+        return false;
+
+    if (ftruncate(fFd, size)<0)
+    {
+        close(fFd);
+        fFd = -1;
+        return false;
+    }
+
+    void *ptr = mmap(NULL, size, PROT_READ|PROT_WRITE, MAP_SHARED, fFd, 0);
+    if (ptr==MAP_FAILED)
+    {
+        close(fFd);
+        fFd = -1;
+        return false;
+    }
+
+    fHeader = static_cast<Header*>(ptr);
+    memcpy(fHeader->magic, "FACTTRC1", 8);
+    fHeader->capacity = capacity;
+    fHeader->count    = 0;
+
+    fCount = 0;
+    for (int i=0; i<kNumHops; i++)
+        for (uint32_t j=0; j<kNumBins; j++)
+            fBins[i][j] = 0;
+
+    fEntries = reinterpret_cast<Entry*>(fHeader+1);
+
+    return true;
+}
+
+void DimTrace::Close()
+{
+    Unpublish();
+
+    if (!fHeader)
+        return;
+
+    const size_t size = sizeof(Header)+fHeader->capacity*sizeof(Entry);
+
+    fEntries = 0;
+
+    munmap(fHeader, size);
+    close(fFd);
+
+    fHeader = 0;
+    fFd     = -1;
+}
+
+// --------------------------------------------------------------------------
+//
+//! @returns
+//!     the current time in microseconds since 1970
+//
+uint64_t DimTrace::Now()
+{
+    timeval tv;
+    gettimeofday(&tv, NULL);
+    return uint64_t(tv.tv_sec)*1000000+tv.tv_usec;
+}
+
+// --------------------------------------------------------------------------
+//
+//! @returns
+//!     the given time in microseconds since 1970, 0 if it is not valid
+//
+uint64_t DimTrace::GetTime(const Time &t)
+{
+    return t.IsValid() ? uint64_t(t.Time_t())*1000000+t.us() : 0;
+}
+
+// --------------------------------------------------------------------------
+//
+//! @returns
+//!     the given time in microseconds since 1970 truncated to full
+//!     milliseconds as transmitted by DIM, 0 if it is not valid
+//
+uint64_t DimTrace::GetStamp(const Time &t)
+{
+    return t.IsValid() ? uint64_t(t.Time_t())*1000000+t.ms()*1000 : 0;
+}
+
+// --------------------------------------------------------------------------
+//
+//! @returns
+//!     false for the LATENCY services published by DimTrace, which
+//!     would otherwise trace themselves
+//
+bool DimTrace::IsTraced(const string &service)
+{
+    static const string suffix = "/LATENCY";
+    return service.length()<suffix.length() ||
+        service.compare(service.length()-suffix.length(), suffix.length(), suffix)!=0;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Writes a record into the next slot of the ring buffer. The event
+//! currently handled by this thread (if any) is stored as its cause.
+//!
+//! @param type
+//!     Type of the record
+//!
+//! @param name
+//!     Name of the service, command or event (truncated to 43 characters)
+//!
+//! @param origin
+//!     Time stamp of the update or event [us]
+//!
+//! @param duration
+//!     Duration of the handling of an event [us]
+//
+void DimTrace::Record(type_t type, const string &name, uint64_t origin, uint32_t duration)
+{
+    if (!fEntries)
+        return;
+
+    const uint64_t seq = ++fCount;
+
+    Entry &entry = fEntries[(seq-1)%fHeader->capacity];
+
+    // Mark the record as being written
+    entry.seq      = 0;
+
+    entry.time     = Now();
+    entry.origin   = origin;
+    entry.type     = type;
+    entry.duration = duration;
+
+    strncpy(entry.name, name.c_str(), sizeof(entry.name)-1);
+    entry.name[sizeof(entry.name)-1] = 0;
+
+    if (fCause)
+    {
+        entry.cause = fCause->fOrigin;
+        strncpy(entry.causename, fCause->fName.c_str(), sizeof(entry.causename)-1);
+        entry.causename[sizeof(entry.causename)-1] = 0;
+    }
+    else
+    {
+        entry.cause = 0;
+        entry.causename[0] = 0;
+    }
+
+    entry.seq = seq;
+
+    if (seq>fHeader->count)
+        fHeader->count = seq;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Fills a latency into the histogram of the given hop.
+//!
+//! @param hop
+//!     Histogram to be filled
+//!
+//! @param latency
+//!     Latency in microseconds. Negative values (e.g. due to clocks which
+//!     are not synchronized) are counted in the first bin.
+//
+void DimTrace::Fill(hop_t hop, int64_t latency)
+{
+    if (!fEntries)
+        return;
+
+    const uint32_t bin = latency<2 ? 0 : 63-__builtin_clzll(latency);
+    fBins[hop][bin<kNumBins ? bin : kNumBins-1]++;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Creates the service SERVER/LATENCY and a thread which updates it every
+//! ten seconds with the current histograms. Does nothing if tracing is
+//! not enabled.
+//!
+//! @param server
+//!     Name of the server
+//
+void DimTrace::Publish(const string &server)
+{
+    if (!fEntries || gService)
+        return;
+
+    gService = new DimDescribedService(server+"/LATENCY", "I:32;I:32;I:32",
+                                       "Histograms of latencies (enabled with --trace), bin i counts latencies between 2^i and 2^(i+1) us"
+                                       "|Delivery[cnt]:Time stamp of a service update to its reception"
+                                       "|Queue[cnt]:Reception of an event to the start of its handling"
+                                       "|Execution[cnt]:Duration of the handling of an event");
+
+    gStop = false;
+    gThread = thread([]()
+    {
+        unique_lock<mutex> lock(gMutex);
+        while (!gStop)
+        {
+            uint32_t data[kNumHops][kNumBins];
+            for (int i=0; i<kNumHops; i++)
+                for (uint32_t j=0; j<kNumBins; j++)
+                    data[i][j] = fBins[i][j];
+
+            gService->setData(data, sizeof(data));
+            gService->Update();
+
+            gCond.wait_for(lock, chrono::seconds(10));
+        }
+    });
+}
+
+void DimTrace::Unpublish()
+{
+    if (!gService)
+        return;
+
+    {
+        const lock_guard<mutex> lock(gMutex);
+        gStop = true;
+        gCond.notify_one();
+    }
+
+    gThread.join();
+
+    delete gService;
+    gService = 0;
+}
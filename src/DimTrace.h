@@ -0,0 +1,99 @@
+#ifndef FACT_DimTrace
+#define FACT_DimTrace
+
+#include <string>
+#include <atomic>
+#include <stdint.h>
+
+class Time;
+
+class DimTrace
+{
+public:
+    enum type_t
+    {
+        kUpdate = 1,      /// A service was updated
+        kReceived,        /// A service update was received
+        kCommand,         /// A command was sent
+        kCommandReceived, /// A command was received
+        kExecuted,        /// An event was handled by the state machine
+    };
+
+    enum hop_t
+    {
+        kDelivery = 0,    /// Time stamp of a service update to its reception
+        kQueue,           /// Reception of an event to the start of its handling
+        kExecution,       /// Duration of the handling of an event
+        kNumHops
+    };
+
+    static const uint32_t kNumBins = 32;
+
+    // Layout of the trace file (all records have a fixed size, the file
+    // is used as a ring buffer): Header, Entry[capacity]
+    struct Header
+    {
+        char     magic[8];   /// "FACTTRC1"
+        uint64_t capacity;   /// Number of records in the file
+        uint64_t count;      /// Number of records written so far
+        uint64_t reserved[5];
+    };
+
+    struct Entry
+    {
+        uint64_t seq;           /// Sequence number (starting at 1, 0: unused)
+        uint64_t time;          /// Time of the record [us since 1970]
+        uint64_t origin;        /// Time stamp of the update or event [us], 0: unknown
+        uint64_t cause;         /// Time stamp of the event being handled [us], 0: none
+        uint32_t type;          /// type_t
+        uint32_t duration;      /// Duration of the handling [us]
+        char     name[44];      /// Name of the service, command or event
+        char     causename[44]; /// Name of the event being handled
+    };
+
+    // The event currently handled by this thread. All records written
+    // while an instance exists refer to it as their cause.
+    class Cause
+    {
+        friend class DimTrace;
+
+        const std::string fName;
+        const uint64_t    fOrigin;
+        const Cause      *fPrev;
+
+    public:
+        Cause(const std::string &name, uint64_t origin);
+        ~Cause();
+    };
+
+private:
+    static int          fFd;
+    static Header      *fHeader;
+    static Entry       *fEntries;
+
+    static std::atomic<uint64_t> fCount;
+    static std::atomic<uint32_t> fBins[kNumHops][kNumBins];
+
+    static thread_local const Cause *fCause;
+
+public:
+    static bool Open(const std::string &filename, uint64_t capacity);
+    static void Close();
+
+    static bool IsEnabled() { return fEntries!=0; }
+
+    static uint64_t Now();
+    static uint64_t GetTime(const Time &t);
+    static uint64_t GetStamp(const Time &t);
+    static uint64_t GetStamp() { return Now()/1000*1000; }
+
+    static bool IsTraced(const std::string &service);
+
+    static void Record(type_t type, const std::string &name, uint64_t origin=0, uint32_t duration=0);
+    static void Fill(hop_t hop, int64_t latency);
+
+    static void Publish(const std::string &server);
+    static void Unpublish();
+};
+
+#endif
@@ -42,7 +42,7 @@ using namespace std;
 //!
 //
 Event::Event(const string &name, const string &fmt) :
-    fName(name), fFormat(fmt), fTime(Time::none), fQoS(0), fEmpty(true)
+    fName(name), fFormat(fmt), fTime(Time::none), fReceived(Time::none), fQoS(0), fEmpty(true)
 {
 }
 
@@ -58,7 +58,7 @@ Event::Event(const string &name, const string &fmt) :
 Event::Event(const EventImp &evt) : EventImp(evt),
 fName(evt.GetName()), fFormat(evt.GetFormat()),
 fData(evt.GetText(), evt.GetText()+evt.GetSize()), fTime(evt.GetTime()),
-fQoS(evt.GetQoS()), fEmpty(evt.IsEmpty())
+fReceived(), fQoS(evt.GetQoS()), fEmpty(evt.IsEmpty())
 {
     const size_t pos = fName.find_first_of('/');
     if (pos!=string::npos)
@@ -82,7 +82,7 @@ fQoS(evt.GetQoS()), fEmpty(evt.IsEmpty())
 //
 Event::Event(const EventImp &evt, const char *ptr, size_t siz) : EventImp(evt),
 fName(evt.GetName()), fFormat(evt.GetFormat()),
-fData(ptr, ptr+siz), fTime(evt.GetTime()), fQoS(evt.GetQoS()), fEmpty(ptr==0)
+fData(ptr, ptr+siz), fTime(evt.GetTime()), fReceived(), fQoS(evt.GetQoS()), fEmpty(ptr==0)
 {
     const size_t pos = fName.find_first_of('/');
     if (pos!=string::npos)
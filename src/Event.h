@@ -13,11 +13,12 @@ private:
     std::vector<char> fData;  /// Data associated with this event
 
     Time  fTime;              /// Time stamp
+    Time  fReceived;          /// Time the event was queued
     int   fQoS;               /// Quality of service
     bool  fEmpty;             /// Empty is true if received event was a NULL pointer
 
 public:
-    Event() : fQoS(0), fEmpty(true) { }
+    Event() : fReceived(Time::none), fQoS(0), fEmpty(true) { }
     /// Constructs an event as a combination of an EventImp and a DimCommand
     Event(const std::string &name, const std::string &fmt="");
     /// Copy constructor
@@ -39,6 +40,8 @@ public:
 
     /// Return reference to a time stamp
     Time GetTime() const { return fTime; }
+    /// Return the time the event was queued
+    Time GetReceived() const { return fReceived; }
     /// Return Quality of Service
     int  GetQoS() const  { return fQoS; }
     /// Return if event is not just zero size but empty
@@ -7,6 +7,10 @@
 #include <cstdarg>
 #include <list>
 #include <queue>
+#include <atomic>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
 #include <functional> // std::bind
 
 #include <boost/algorithm/string/join.hpp>
@@ -78,6 +82,8 @@ size_t g_maxMem;                //maximum memory allowed for buffer
 
 uint16_t g_evtTimeout;           // timeout (sec) for one event
 
+uint16_t g_statInterval;         // interval (sec) for the statistics of the processing stages
+
 FACT_SOCK g_port[NBOARDS];      // .addr=string of IP-addr in dotted-decimal "ddd.ddd.ddd.ddd"
 
 uint gi_NumConnect[NBOARDS];    //4 crates * 10 boards
@@ -804,12 +810,155 @@ uint64_t reportIncomplete(const shared_ptr<EVT_CTRL2> &evt, const char *txt)
 // ==========================================================================
 // ==========================================================================
 
+namespace Stats
+{
+    // Stages of the processing chain, each of them runs in its own thread
+    enum
+    {
+        kRead = 0,  // Reading and event building (mainloop)
+        kProc,      // Event check (primaryQueue)
+        kWrite,     // Writing (secondaryQueue)
+        kCalib,     // Calibration and processing (processingQueue1)
+        kNumStages
+    };
+
+    const char *names[kNumStages] = { "read", "check", "write", "calib" };
+
+    atomic<uint64_t> cpu[kNumStages];   // CPU time [ns] used in the current interval
+
+    size_t maxQueue[kNumStages];        // Maximum queue size in the current interval
+
+    mutex mtx;
+    vector<float> latency;              // Reception of the first packet until written [ms]
+
+    uint64_t CpuTime()
+    {
+        timespec ts;
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+        return uint64_t(ts.tv_sec)*1000000000+ts.tv_nsec;
+    }
+
+    // Adds the CPU time used by the calling thread during its lifetime
+    // to the given stage. Reading the clock is skipped if disabled.
+    class Timer
+    {
+        const int      fStage;
+        const uint64_t fStart;
+
+    public:
+        Timer(int stage) : fStage(stage), fStart(g_statInterval ? CpuTime() : 0) { }
+        ~Timer()
+        {
+            if (fStart)
+                cpu[fStage] += CpuTime()-fStart;
+        }
+    };
+
+    void Latency(const timeval &tv)
+    {
+        if (!g_statInterval)
+            return;
+
+        timeval now;
+        gettimeofday(&now, NULL);
+
+        const float ms = (now.tv_sec-tv.tv_sec)*1000. + (now.tv_usec-tv.tv_usec)/1000.;
+
+        const lock_guard<mutex> lock(mtx);
+        latency.push_back(ms);
+    }
+
+    void Reset()
+    {
+        for (int i=0; i<kNumStages; i++)
+        {
+            cpu[i] = 0;
+            maxQueue[i] = 0;
+        }
+
+        const lock_guard<mutex> lock(mtx);
+        latency.clear();
+    }
+
+    // Called once a second by the mainloop. Every g_statInterval seconds
+    // the event rate, the CPU usage of each stage, the maximum queue
+    // sizes and percentiles of the latency are printed.
+    void Fill(time_t now, const size_t (&queue)[kNumStages])
+    {
+        static time_t   start   = 0;
+        static uint64_t cpuRead = 0;
+
+        if (!g_statInterval)
+        {
+            start = 0;
+            return;
+        }
+
+        for (int i=0; i<kNumStages; i++)
+            maxQueue[i] = max(maxQueue[i], queue[i]);
+
+        const uint64_t cpuNow = CpuTime();
+        if (start==0)
+        {
+            start   = now;
+            cpuRead = cpuNow;
+            Reset();
+            return;
+        }
+
+        if (now-start<g_statInterval)
+            return;
+
+        cpu[kRead] += cpuNow-cpuRead;
+
+        vector<float> lat;
+        {
+            const lock_guard<mutex> lock(mtx);
+            lat.swap(latency);
+        }
+
+        const double dt = now-start;
+
+        ostringstream msg;
+        msg << fixed << setprecision(1);
+        msg << "Stats: " << lat.size() << " evts in " << now-start << "s [" << lat.size()/dt << "Hz]";
+
+        if (!lat.empty())
+        {
+            sort(lat.begin(), lat.end());
+            msg << ", latency [ms]: 50%=" << lat[lat.size()*50/100];
+            msg << " 90%=" << lat[lat.size()*90/100];
+            msg << " 99%=" << lat[lat.size()*99/100];
+            msg << " max=" << lat.back();
+        }
+
+        msg << ", CPU [%]:";
+        for (int i=0; i<kNumStages; i++)
+            msg << " " << names[i] << "=" << cpu[i]/dt/1e7;
+
+        msg << ", max. queue:";
+        for (int i=0; i<kNumStages; i++)
+            msg << " " << names[i] << "=" << maxQueue[i];
+
+        factOut(MessageImp::kInfo, msg.str().c_str());
+
+        start   = now;
+        cpuRead = cpuNow;
+
+        Reset();
+    }
+}
+
+// ==========================================================================
+// ==========================================================================
+
 bool proc1(const shared_ptr<EVT_CTRL2> &);
 
 Queue<shared_ptr<EVT_CTRL2>> processingQueue1(bind(&proc1, placeholders::_1));
 
 bool proc1(const shared_ptr<EVT_CTRL2> &evt)
 {
+    const Stats::Timer timer(Stats::kCalib);
     applyCalib(*evt, processingQueue1.size());
     return true;
 }
@@ -819,6 +968,8 @@ bool proc1(const shared_ptr<EVT_CTRL2> &evt)
 // (e.g. runOpen+runInfo, runClose+runInfo, evtWrite+evtInfo)
 bool writeEvt(const shared_ptr<EVT_CTRL2> &evt)
 {
+    const Stats::Timer timer(Stats::kWrite);
+
     //const shared_ptr<RUN_CTRL2> &run = evt->runCtrl;
     RUN_CTRL2 &run = *evt->runCtrl;
 
@@ -860,6 +1011,8 @@ bool writeEvt(const shared_ptr<EVT_CTRL2> &evt)
         rc1 = runWrite(*evt);
         if (!rc1)
             factPrintf(MessageImp::kError, "Writing event %d for run %d failed (runWrite)", evt->evNum, evt->runNum);
+
+        Stats::Latency(evt->time);
     }
 
     // File not open... no need to close or to check for close
@@ -900,6 +1053,8 @@ Queue<shared_ptr<EVT_CTRL2>> secondaryQueue(bind(&writeEvt, placeholders::_1));
 
 bool procEvt(const shared_ptr<EVT_CTRL2> &evt)
 {
+    const Stats::Timer timer(Stats::kProc);
+
     RUN_CTRL2 &run = *evt->runCtrl;
 
     bool check = true;
@@ -1487,6 +1642,9 @@ bool mainloop(READ_STRUCT *rd)
 
         Memory::max_inuse = 0;
 
+        const size_t queues[Stats::kNumStages] = { gj.bufNew, gj.bufEvt, gj.bufWrite, gj.bufProc };
+        Stats::Fill(actTime, queues);
+
         // =================================================================
 
         // This is a fake event to trigger possible run-closing conditions once a second
@@ -26,6 +26,7 @@ namespace std
 extern int  g_reset     ;  //>0 = reset different levels of eventbuilder
 extern size_t g_maxMem  ;  //maximum memory allowed for buffer
 extern uint16_t g_evtTimeout;  //timeout (sec) for one event
+extern uint16_t g_statInterval; //interval (sec) for the statistics of the processing stages (0=off)
 
 extern FACT_SOCK g_port[NBOARDS] ;  // .port = baseport, .addr=string of IP-addr in dotted-decimal "ddd.ddd.ddd.ddd"
 
@@ -25,6 +25,8 @@
 
 #include "DataWriteFits2.h"
 
+#include "externals/zofits.h"
+
 namespace ba = boost::asio;
 namespace bs = boost::system;
 namespace fs = boost::filesystem;
@@ -90,6 +92,7 @@ private:
     //DimDescribedService fDimStatistics2;
     DimDescribedService fDimFileFormat;
     DimDescribedService fDimIncomplete;
+    DimDescribedService fDimCompression;
 
     struct EventData
     {
@@ -106,6 +109,7 @@ private:
     Queue<vector<char>>                             fQueueRawData;
     Queue<tuple<Time,uint32_t,EventData/*array<float,1440*4>*/>> fQueueEventData;
     Queue<tuple<Time, array<uint32_t,40>, array<int16_t,160>>> fQueueTempRefClk;
+    Queue<pair<Time,zofits::CompressionStats>>      fQueueCompression;
 
     string   fPath;
     uint32_t fNightAsInt;
@@ -296,6 +300,18 @@ public:
                                                            "|relBytes[int]:Relative number of total bytes received (received - released)"),
         fDimFileFormat("FAD_CONTROL/FILE_FORMAT",          "S:1", "|format[int]:Current file format"),
         fDimIncomplete("FAD_CONTROL/INCOMPLETE",           "X:1", "|incomplete[bits]:bit_index=c*10+b. board b(0..3) in crate c(0..9)"),
+        fDimCompression("FAD_CONTROL/COMPRESSION",         "I:1;I:1;I:1;I:1;I:1;X:1;X:1;F:1;F:1;F:1",
+                                                           "Compression statistics of the current or last zfits file"
+                                                           "|tiles[int]:Number of tiles compressed"
+                                                           "|rows[int]:Number of rows per tile"
+                                                           "|threads[int]:Number of compression threads available"
+                                                           "|active[int]:Maximum number of compression threads in use"
+                                                           "|queued[int]:Maximum number of tiles waiting for compression"
+                                                           "|bytes_in[byte]:Number of uncompressed bytes"
+                                                           "|bytes_out[byte]:Number of compressed bytes"
+                                                           "|wait[ms]:Average time a tile waited for compression"
+                                                           "|cpu[ms]:Average cpu time used to compress a tile"
+                                                           "|rate[Hz]:Rate at which events were written"),
         // It is important to instantiate them after the DimServices
         fQueueStatistics1(std::bind(&EventBuilderWrapper::UpdateDimStatistics1, this, placeholders::_1)),
         fQueueProcHeader( std::bind(&EventBuilderWrapper::procHeader,           this, placeholders::_1)),
@@ -305,6 +321,7 @@ public:
         fQueueRawData(    std::bind(&EventBuilderWrapper::UpdateDimRawData,     this, placeholders::_1)),
         fQueueEventData(  std::bind(&EventBuilderWrapper::UpdateDimEventData,   this, placeholders::_1)),
         fQueueTempRefClk( std::bind(&EventBuilderWrapper::UpdateDimTempRefClk,  this, placeholders::_1)),
+        fQueueCompression(std::bind(&EventBuilderWrapper::UpdateDimCompression, this, placeholders::_1)),
         fNightAsInt(0), fRunInProgress(-1),
         fMaxEvent(make_pair(-FLT_MAX, EventData()/*array<float,1440*4>()*/))
     {
@@ -372,6 +389,10 @@ public:
     {
         g_evtTimeout = to;
     }
+    void SetStatInterval(uint16_t sec) const
+    {
+        g_statInterval = sec;
+    }
 
     void StartThread(const vector<tcp::endpoint> &addr)
     {
@@ -556,6 +577,47 @@ public:
         return true;
     }
 
+    bool UpdateDimCompression(const pair<Time,zofits::CompressionStats> &stat)
+    {
+        const zofits::CompressionStats &s = stat.second;
+
+        struct Stats
+        {
+            uint32_t tiles;
+            uint32_t rows;
+            uint32_t threads;
+            uint32_t active;
+            uint32_t queued;
+            uint64_t bytes_in;
+            uint64_t bytes_out;
+            float    wait;
+            float    cpu;
+            float    rate;
+        } __attribute__((__packed__));
+
+        const Stats data =
+        {
+            s.num_tiles, s.rows_per_tile, s.num_threads, s.max_active, s.max_queued,
+            s.bytes_in, s.bytes_out,
+            float(s.num_tiles ? s.queue_wait*1000/s.num_tiles : 0),
+            float(s.num_tiles ? s.cpu_time*1000/s.num_tiles : 0),
+            float(s.row_rate)
+        };
+
+        fDimCompression.setData(&data, sizeof(Stats));
+        fDimCompression.Update(stat.first);
+
+        return true;
+    }
+
+    void UpdateCompression(const Time &time=Time())
+    {
+        const DataWriteFits2 *file = dynamic_cast<DataWriteFits2*>(fFile.get());
+        const zofits *fits = file ? file->GetZFits() : 0;
+        if (fits)
+            fQueueCompression.emplace(time, fits->GetStats());
+    }
+
     bool runOpen(const EVT_CTRL2 &evt)
     {
         const uint32_t night = evt.runCtrl->night;
@@ -659,6 +721,7 @@ public:
         {
             fQueueEvents.emplace(newt, fNumEvts);
             fQueueTrigger.emplace(newt, 'w', e.triggerCounter);
+            UpdateCompression(newt);
             oldt = newt;
         }
 
@@ -678,6 +741,9 @@ public:
         // Close the file
         const bool rc = fFile->Close(evt);
 
+        // The statistics are complete only after closing
+        UpdateCompression();
+
         fLastClosed = fFile->GetRunId();
 
         ostringstream str;
@@ -55,6 +55,7 @@ public:
     virtual size_t      GetSize() const { return 0; }
 
     virtual Time GetTime() const { return Time::None; }
+    virtual Time GetReceived() const { return Time::None; }
     virtual int  GetQoS() const  { return 0; }
     virtual bool IsEmpty() const { return GetData()==0; }
 
@@ -1258,10 +1258,11 @@ Handle<Value> InterpreterV8::Convert(char type, const char* &ptr)
         {
             // Remove the "imprecision" effect coming from casting a float to
             // a double and then showing it with double precision
-            ostringstream val;
-            val << setprecision(7) << *reinterpret_cast<const float*>(ptr);
+            // (identical to setprecision(7), but without a stream)
+            char val[32];
+            snprintf(val, 32, "%.7g", *reinterpret_cast<const float*>(ptr));
             ptr += 4;
-            return Number::New(stod(val.str()));
+            return Number::New(strtod(val, NULL));
         }
     case 'D':  { Handle<Value> v=Number::New(*reinterpret_cast<const double*>(ptr)); ptr+=8; return v; }
     case 'I':
@@ -1297,14 +1298,147 @@ Handle<Value> InterpreterV8::FuncClose(const Arguments &args)
         fReverseMap.erase(it);
     }
 
+    fDecoders.erase(*str);
+
     args.This()->Set(String::New("isOpen"), Boolean::New(false), ReadOnly);
 
     return handle_scope.Close(Boolean::New(JsUnsubscribe(*str)));
 }
 
-Handle<Value> InterpreterV8::ConvertEvent(const EventImp *evt, uint64_t counter, const char *str)
+// Copies cnt values into a buffer managed by an external array, so that
+// only a single copy is done instead of creating a JavaScript value for
+// every single element. The object behaves like a typed array. Array.prototype
+// is set as prototype so that functions like reduce or forEach still work.
+Handle<Value> InterpreterV8::ConvertTyped(char type, const char* &ptr, uint32_t cnt)
+{
+    ExternalArrayType atype;
+    uint32_t sz;
+
+    switch (type)
+    {
+    case 'F': atype = kExternalFloatArray;         sz = 4; break;
+    case 'D': atype = kExternalDoubleArray;        sz = 8; break;
+    case 'I':
+    case 'L': atype = kExternalUnsignedIntArray;   sz = 4; break;
+    case 'S': atype = kExternalUnsignedShortArray; sz = 2; break;
+    case 'C': atype = kExternalUnsignedByteArray;  sz = 1; break;
+    default:
+        return Handle<Value>();
+    }
+
+    Handle<Object> arr = Object::New();
+    if (arr.IsEmpty())
+        return Undefined();
+
+    char *buf = new char[cnt*sz];
+    memcpy(buf, ptr, cnt*sz);
+    ptr += cnt*sz;
+
+    arr->SetIndexedPropertiesToExternalArrayData(buf, atype, cnt);
+    arr->Set(String::New("length"), Integer::NewFromUnsigned(cnt), ReadOnly);
+    arr->SetPrototype(Array::New()->GetPrototype());
+
+    // The buffer is released when the object is garbage collected
+    Persistent<Object> handle = Persistent<Object>::New(arr);
+    handle.MakeWeak(buf, FreeTyped);
+
+    V8::AdjustAmountOfExternalAllocatedMemory(cnt*sz);
+
+    return arr;
+}
+
+void InterpreterV8::FreeTyped(Persistent<Value> obj, void *ptr)
+{
+    const HandleScope handle_scope;
+
+    const Handle<Object> arr = obj->ToObject();
+
+    uint32_t sz = 1;
+    switch (arr->GetIndexedPropertiesExternalArrayDataType())
+    {
+    case kExternalDoubleArray:        sz = 8; break;
+    case kExternalFloatArray:
+    case kExternalUnsignedIntArray:   sz = 4; break;
+    case kExternalUnsignedShortArray: sz = 2; break;
+    default: break;
+    }
+
+    V8::AdjustAmountOfExternalAllocatedMemory(-int(sz*arr->GetIndexedPropertiesExternalArrayDataLength()));
+
+    delete [] static_cast<char*>(ptr);
+
+    obj.Dispose();
+    obj.Clear();
+}
+
+// Returns the decoder of the service. It is compiled again if the format
+// has changed or as long as no description was available yet.
+const InterpreterV8::EventDecoder &InterpreterV8::GetDecoder(const string &service, const string &format)
+{
+    const auto it = fDecoders.find(service);
+    if (it!=fDecoders.end() && it->second.format==format && it->second.named)
+        return it->second;
+
+    const vector<Description> vec = JsDescription(service);
+
+    typedef boost::char_separator<char> separator;
+    const boost::tokenizer<separator> tokenizer(format, separator(";:"));
+
+    const vector<string> tok(tokenizer.begin(), tokenizer.end());
+
+    EventDecoder decoder;
+    decoder.format = format;
+    decoder.named  = vec.size()>0;
+
+    size_t pos = 1;
+    for (auto it=tok.begin(); it<tok.end(); it++, pos++)
+    {
+        EventDecoder::Element el;
+
+        el.type = (*it)[0];
+        it++;
+
+        el.name = pos<vec.size() ? vec[pos].name : "";
+        if (tok.size()==1)
+            el.name = "data";
+
+        // Get element size
+        el.size = 1;
+        switch (el.type)
+        {
+        case 'X':
+        case 'D': el.size = 8; break;
+        case 'F':
+        case 'I':
+        case 'L': el.size = 4; break;
+        case 'S': el.size = 2; break;
+        case 'C': el.size = 1; break;
+        }
+
+        // Check if format has a number attached (throws if invalid)
+        el.count = it==tok.end() ? 0 : stoi(it->c_str());
+
+        decoder.elements.push_back(el);
+    }
+
+    return fDecoders[service] = decoder;
+}
+
+Handle<Value> InterpreterV8::ConvertEvent(const EventImp *evt, uint64_t counter, const char *str, bool typed)
 {
-    const vector<Description> vec = JsDescription(str);
+    // It seems a copy is required either in the boost which comes with
+    // Ubuntu 16.04 or in gcc5 ?!
+    const string fmt = evt->GetFormat();
+
+    const EventDecoder *decoder = 0;
+    try
+    {
+        decoder = &GetDecoder(str, fmt);
+    }
+    catch (...)
+    {
+        return Exception::Error(String::New(("Format string conversion '"+fmt+"' failed.").c_str()));
+    }
 
     Handle<Object> ret = fTemplateEvent->GetFunction()->NewInstance();//Object::New();
     if (ret.IsEmpty())
@@ -1315,7 +1449,7 @@ Handle<Value> InterpreterV8::ConvertEvent(const EventImp *evt, uint64_t counter,
         return Undefined();
 
     ret->Set(String::New("name"),    String::New(str),              ReadOnly);
-    ret->Set(String::New("format"),  String::New(evt->GetFormat().c_str()), ReadOnly);
+    ret->Set(String::New("format"),  String::New(fmt.c_str()),      ReadOnly);
     ret->Set(String::New("qos"),     Integer::New(evt->GetQoS()),   ReadOnly);
     ret->Set(String::New("size"),    Integer::New(evt->GetSize()),  ReadOnly);
     ret->Set(String::New("counter"), Integer::New(counter),         ReadOnly);
@@ -1329,7 +1463,7 @@ Handle<Value> InterpreterV8::ConvertEvent(const EventImp *evt, uint64_t counter,
     // obj!==undefined, length==0:    names for event available
     // obj!==undefined, obj.length>0: names available, data received
     Handle<Object> named = Object::New();
-    if (vec.size()>0)
+    if (decoder->named)
         ret->Set(String::New("obj"), named, ReadOnly);
 
     // If no event was received (usually a disconnection event in
@@ -1342,22 +1476,19 @@ Handle<Value> InterpreterV8::ConvertEvent(const EventImp *evt, uint64_t counter,
     // data===undefined: no data received
     // data===null:      event received, but no data
     // data.length>0:    event received, contains data
-    if (evt->GetSize()==0 || evt->GetFormat().empty())
+    if (evt->GetSize()==0 || fmt.empty())
     {
         ret->Set(String::New("data"), Null(), ReadOnly);
         return ret;
     }
 
-    // It seems a copy is required either in the boost which comes with
-    // Ubuntu 16.04 or in gcc5 ?!
-    const string fmt = evt->GetFormat();
-
-    typedef boost::char_separator<char> separator;
-    const boost::tokenizer<separator> tokenizer(fmt, separator(";:"));
+    const vector<EventDecoder::Element> &elements = decoder->elements;
 
-    const vector<string> tok(tokenizer.begin(), tokenizer.end());
+    // A format with a single type without number (e.g. "F") returns
+    // the data directly, everything else (e.g. "F:1") an array
+    const bool single = elements.size()==1 && elements[0].count==0;
 
-    Handle<Object> arr = tok.size()>1 ? Array::New() : ret;
+    Handle<Object> arr = single ? ret : Array::New();
     if (arr.IsEmpty())
         return Undefined();
 
@@ -1366,83 +1497,71 @@ Handle<Value> InterpreterV8::ConvertEvent(const EventImp *evt, uint64_t counter,
 
     try
     {
-        size_t pos = 1;
-        for (auto it=tok.begin(); it<tok.end() && ptr<end; it++, pos++)
+        size_t pos = 0;
+        for (auto it=elements.begin(); it!=elements.end() && ptr<end; it++, pos++)
         {
-            char type = (*it)[0];
-            it++;
-
-            string name = pos<vec.size() ? vec[pos].name : "";
-            if (tok.size()==1)
-                name = "data";
-
-            // Get element size
-            uint32_t sz = 1;
-            switch (type)
-            {
-            case 'X':
-            case 'D': sz = 8; break;
-            case 'F':
-            case 'I':
-            case 'L': sz = 4; break;
-            case 'S': sz = 2; break;
-            case 'C': sz = 1; break;
-            }
+            const uint32_t sz = it->size;
 
             // Check if no number is attached if the size of the
             // received data is consistent with the format string
-            if (it==tok.end() && (end-ptr)%sz>0)
-                return Exception::Error(String::New(("Number of received bytes ["+to_string(evt->GetSize())+"] does not match format ["+evt->GetFormat()+"]").c_str()));
+            if (it->count==0 && (end-ptr)%sz>0)
+                return Exception::Error(String::New(("Number of received bytes ["+to_string(evt->GetSize())+"] does not match format ["+fmt+"]").c_str()));
 
-            // Check if format has a number attached.
             // If no number is attached calculate number of elements
-            const uint32_t cnt = it==tok.end() ? (end-ptr)/sz : stoi(it->c_str());
+            const uint32_t cnt = it->count==0 ? (end-ptr)/sz : it->count;
 
             // is_str: Array of type C but unknown size (String)
             // is_one: Array of known size, but size is 1 (I:1)
-            const bool is_str = type=='C' && it==tok.end();
-            const bool is_one = cnt==1    && it!=tok.end();
+            const bool is_str = it->type=='C' && it->count==0;
+            const bool is_one = it->count==1;
 
             Handle<Value> v;
 
             if (is_str)
                 v = String::New(ptr);
             if (is_one)
-                v = Convert(type, ptr);
+                v = Convert(it->type, ptr);
 
-            // Array of known (I:5) or unknown size (I), but no string
+            // Array of known (I:5) or unknown size (I), but no string.
+            // As typed array if requested and the data is complete.
             if (!is_str && !is_one)
             {
-                Handle<Object> a = Array::New(cnt);
-                if (a.IsEmpty())
-                    return Undefined();
+                if (typed && ptr+size_t(cnt)*sz<=end)
+                    v = ConvertTyped(it->type, ptr, cnt);
 
-                for (uint32_t i=0; i<cnt; i++)
-                    a->Set(i, Convert(type, ptr));
+                if (v.IsEmpty())
+                {
+                    Handle<Object> a = Array::New(cnt);
+                    if (a.IsEmpty())
+                        return Undefined();
+
+                    for (uint32_t i=0; i<cnt; i++)
+                        a->Set(i, Convert(it->type, ptr));
 
-                v = a;
+                    v = a;
+                }
             }
 
-            if (tok.size()>1)
-                arr->Set(pos-1, v);
+            if (!single)
+                arr->Set(pos, v);
             else
                 ret->Set(String::New("data"), v, ReadOnly);
 
-            if (!name.empty())
+            if (!it->name.empty())
             {
-                const Handle<String> n = String::New(name.c_str());
+                const Handle<String> n = String::New(it->name.c_str());
                 named->Set(n, v);
             }
         }
 
-        if (tok.size()>1)
+        if (!single)
             ret->Set(String::New("data"), arr, ReadOnly);
 
         return ret;
     }
     catch (...)
     {
-        return Exception::Error(String::New(("Format string conversion '"+evt->GetFormat()+"' failed.").c_str()));
+        return Exception::Error(String::New(("Format string conversion '"+fmt+"' failed.").c_str()));
     }
 }
 /*
@@ -1488,6 +1607,7 @@ Handle<Value> InterpreterV8::FuncGetData(const Arguments &args)
     const Handle<String> object = String::New("obj");
 
     const String::AsciiValue name(args.Holder()->Get(String::New("name")));
+    const bool typed = args.Holder()->Get(String::New("typed"))->BooleanValue();
 
     TryCatch exception;
 
@@ -1499,7 +1619,7 @@ Handle<Value> InterpreterV8::FuncGetData(const Arguments &args)
         const EventImp *evt = p.second;
         if (evt)
         {
-            const Handle<Value> val = ConvertEvent(evt, p.first, *name);
+            const Handle<Value> val = ConvertEvent(evt, p.first, *name, typed);
             if (val->IsNativeError())
                 return ThrowException(val);
 
@@ -1587,7 +1707,9 @@ void InterpreterV8::JsHandleEvent(const EventImp &evt, uint64_t cnt, const strin
     const int id = V8::GetCurrentThreadId();
     fThreadIds.insert(id);
 
-    Handle<Value> ret = ConvertEvent(&evt, cnt, service.c_str());
+    const bool typed = obj->Get(String::New("typed"))->BooleanValue();
+
+    Handle<Value> ret = ConvertEvent(&evt, cnt, service.c_str(), typed);
     if (ret->IsObject())
         Handle<Function>::Cast(val)->Call(obj, 1, &ret);
 
@@ -1832,6 +1954,7 @@ Handle<Value> InterpreterV8::FuncSubscription(const Arguments &args)
     self->Set(String::New("close"),  FunctionTemplate::New(WrapClose)->GetFunction(),    ReadOnly);
     self->Set(String::New("name"),   String::New(*str), ReadOnly);
     self->Set(String::New("isOpen"), Boolean::New(true));
+    self->Set(String::New("typed"),  Boolean::New(false));
 
     if (args.Length()==2)
         self->Set(String::New("onchange"), args[1]);
@@ -49,6 +49,28 @@ class InterpreterV8
     // Interrupt handler
     v8::Persistent<v8::Object> fInterruptCallback;
 
+    // Decoding plan of the events of a service. It is compiled from
+    // the format string and the description of the service once, so
+    // that neither has to be parsed again with every event.
+    struct EventDecoder
+    {
+        struct Element
+        {
+            char        type;
+            uint32_t    size;   // Size of a single value in bytes
+            uint32_t    count;  // Number of values (0: not given by the format)
+            std::string name;   // Name from the description (if any)
+        };
+
+        std::string format;
+        bool named;             // Whether a description is available
+
+        std::vector<Element> elements;
+    };
+
+    // Lookup table for the decoders of all subscribed services
+    std::map<std::string, EventDecoder> fDecoders;
+
     static v8::Handle<v8::FunctionTemplate> fTemplateLocal;
     static v8::Handle<v8::FunctionTemplate> fTemplateSky;
     static v8::Handle<v8::FunctionTemplate> fTemplateEvent;
@@ -173,7 +195,10 @@ class InterpreterV8
     }
 
     static v8::Handle<v8::Value> Convert(char type, const char* &ptr);
-    v8::Handle<v8::Value> ConvertEvent(const EventImp *evt, uint64_t, const char *str);
+    static v8::Handle<v8::Value> ConvertTyped(char type, const char* &ptr, uint32_t cnt);
+    static void FreeTyped(v8::Persistent<v8::Value> obj, void *ptr);
+    const EventDecoder &GetDecoder(const std::string &service, const std::string &format);
+    v8::Handle<v8::Value> ConvertEvent(const EventImp *evt, uint64_t, const char *str, bool typed=false);
 #endif
 
     v8::Handle<v8::Value> HandleInterruptImp(std::string, uint64_t);
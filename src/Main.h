@@ -31,6 +31,7 @@ namespace Main
             ("dns",        var<string>("localhost"), "Dim nameserver (overwites DIM_DNS_NODE environment variable)")
             ("port",       var<uint16_t>(DNS_PORT),  "Port to connect to dim nameserver.")
             ("host",       var<string>(""),          "Address with which the Dim nameserver can connect to this host (overwites DIM_HOST_NODE environment variable)")
+            ("dim-shm",    var<bool>()->implicit_value(true), "Send large service updates to clients on the same host through shared memory (default: DIM_SHM environment variable)")
             ("log,l",      var<string>(n.filename().string()), "Name of local log-file")
             ("logpath",    var<string>(n.parent_path().string()),  "Path to log-files")
             ("no-log",     po_switch(),    "Supress log-file")
@@ -41,6 +42,7 @@ namespace Main
             ("exec,e",     vars<string>(), "Execute one or more scrips at startup ('file:N' - start at label N)")
             ("arg:*",      var<string>(),  "Arguments for script execution with --exc, e.g. --arg:ra='12.5436'")
             ("home",       var<string>(),  "Path to home directory (used as default for logpath if standard log files not writable)")
+            ("trace",      var<uint32_t>(), "Trace the latencies of the DIM control loop into a ring buffer with the given number of records (program.trace)")
             ("quit",       po_switch(),    "Quit after startup");
         ;
 
@@ -60,6 +62,7 @@ namespace Main
             "  program.evt:   A log of all executed of skipped events\n"
             "  program.his:   The history accessible by Pg-up/dn\n"
             "  program.log:   All output piped to the log-stream\n"
+            "  program.trace: Records of all updates, commands and events (only with --trace)\n"
             << endl;
     }
 
@@ -90,6 +93,8 @@ namespace Main
     int execute(Configuration &conf, bool dummy=false)
     {
         Dim::Setup(conf.Get<string>("dns"), conf.Get<string>("host"), conf.Get<uint16_t>("port"));
+        if (conf.Has("dim-shm"))
+            dis_set_shm(conf.Get<bool>("dim-shm"));
 
         // -----------------------------------------------------------------
         const fs::path program(conf.GetName());
@@ -161,6 +166,13 @@ namespace Main
                 win << kYellow << "WARNING - Couldn't open log-file " << (path/file).string() << ": " << strerror(errno) << endl;
         }
 
+        if (conf.Has("trace"))
+        {
+            const fs::path file = path/(prgname+".trace");
+            if (!DimTrace::Open(file.string(), conf.Get<uint32_t>("trace")))
+                win << kYellow << "WARNING - Couldn't open trace-file " << file.string() << ": " << strerror(errno) << endl;
+        }
+
         S io_service(wout);
 
         const Time now;
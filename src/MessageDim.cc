@@ -78,11 +78,14 @@ bool MessageDimTX::UpdateService(const tuple<Time,string,int> &data)
 //! If sending of the message failed a message is written to the
 //! logging stream stored in MessageImp. It is intentionally not
 //! output through Update to make it look different than usual
-//! transmitted messages.
+//! transmitted messages. Repetitions which were suppressed by
+//! MessageImp::Write are not transmitted either.
 //
 int MessageDimTX::Write(const Time &t, const string &txt, int qos)
 {
-    MessageImp::Write(t, txt, qos);
+    if (MessageImp::Write(t, txt, qos)<0)
+        return 0;
+
     fMsgQueue.emplace(t, txt, qos);
     return 1;
 }
@@ -26,7 +26,7 @@ public:
 
     void SetDebug(bool b=true) { fDebug=b; }
 
-    bool MessageQueueEmpty() const { return fMsgQueue.empty(); }
+    bool MessageQueueEmpty() const { return fMsgQueue.empty() && MessageImp::MessageQueueEmpty(); }
 };
 
 
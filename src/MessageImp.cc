@@ -7,6 +7,16 @@
 Overwriting the Write() member function allows to change the look and
 feel and also the target of the messages issued through a MessageImp
 
+The output to the stream is asynchronous: Messages are only queued by
+the calling thread and formatted and written by a single writer thread
+shared by all instances, so that threads issuing messages at a high
+rate (e.g. error paths of the event builder) never wait for the output.
+If more than kMaxQueue messages are waiting, new messages are dropped
+and the number of dropped messages is reported as soon as the queue
+has been processed. Warnings and errors which are repeated identically
+by the same thread are counted instead of being written, the number of
+repetitions is reported with the next different message.
+
 **/
 // **************************************************************************
 #include "MessageImp.h"
@@ -14,13 +24,147 @@ feel and also the target of the messages issued through a MessageImp
 #include <stdarg.h>
 
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
 
 #include "tools.h"
 #include "Time.h"
 #include "WindowLog.h"
 
+#include "../externals/Queue.h"
+
 using namespace std;
 
+namespace
+{
+    struct Entry
+    {
+        ostream *out;
+        Time     time;
+        string   txt;
+        int      severity;
+
+        Entry(ostream *o, const Time &t, const string &s, int sev) : out(o), time(t), txt(s), severity(sev) { }
+    };
+
+    // Last warning or error issued by this thread
+    struct Repeat
+    {
+        ostream *out;
+        Time     time;
+        string   txt;
+        int      severity;
+        uint32_t count;
+
+        Repeat() : out(0), time(Time::none), severity(0), count(0) { }
+    };
+
+    thread_local Repeat gRepeat;
+
+    void Print(ostream &out, const Time &time, const string &txt, int severity)
+    {
+        switch (severity)
+        {
+        case MessageImp::kMessage: out << kDefault       << " -> "; break;
+        case MessageImp::kComment: out << kDefault       << " #> "; break;
+        case MessageImp::kInfo:    out << kGreen         << " I> "; break;
+        case MessageImp::kWarn:    out << kYellow        << " W> "; break;
+        case MessageImp::kError:
+        case MessageImp::kAlarm:   out << kRed           << " E> "; break;
+        case MessageImp::kFatal:   out << kRed << kBlink << " !> "; break;
+        case MessageImp::kDebug:   out << kBlue          << "    "; break;
+        default:                   out << kBold          << " >> "; break;
+        }
+        out << time.GetAsStr("%H:%M:%S.%f") << " - " << txt << endl;
+    }
+
+    // Set in the writer thread to avoid that it waits for itself
+    thread_local bool gIsWriter = false;
+
+    class Writer
+    {
+    public:
+        static const size_t kMaxQueue = 100000;
+
+    private:
+        atomic<size_t> fPending;
+        atomic<size_t> fDropped;
+
+        mutex              fMutex;
+        condition_variable fCond;
+
+        Queue<Entry> fQueue;
+
+        bool Process(const Entry &e)
+        {
+            gIsWriter = true;
+
+            Print(*e.out, e.time, e.txt, e.severity);
+
+            const size_t dropped = fDropped.exchange(0);
+            if (dropped>0)
+                Print(*e.out, Time(), to_string(dropped)+" messages dropped (too many messages in the output queue)", MessageImp::kWarn);
+
+            if (--fPending==0)
+            {
+                const lock_guard<mutex> lock(fMutex);
+                fCond.notify_all();
+            }
+
+            return true;
+        }
+
+    public:
+        static atomic<bool> fDestroyed;
+
+        Writer() : fPending(0), fDropped(0),
+            fQueue(bind(&Writer::Process, this, placeholders::_1))
+        {
+        }
+
+        // Process all queued messages before the streams are gone
+        ~Writer()
+        {
+            fQueue.wait();
+            fDestroyed = true;
+        }
+
+        void Post(ostream &out, const Time &time, const string &txt, int severity)
+        {
+            if (fPending>=kMaxQueue)
+            {
+                fDropped++;
+                return;
+            }
+
+            fPending++;
+            if (!fQueue.emplace(&out, time, txt, severity))
+                fPending--;
+        }
+
+        void Flush()
+        {
+            if (gIsWriter)
+                return;
+
+            unique_lock<mutex> lock(fMutex);
+            while (fPending>0)
+                fCond.wait(lock);
+        }
+
+        bool Empty() const { return fPending==0; }
+    };
+
+    atomic<bool> Writer::fDestroyed(false);
+
+    // Returns 0 during static destruction after the writer is gone
+    Writer *GetWriter()
+    {
+        static Writer writer;
+        return Writer::fDestroyed ? 0 : &writer;
+    }
+}
+
 // --------------------------------------------------------------------------
 //
 //! Stores a reference to the given ostream in fOut. This is the stream to
@@ -35,8 +179,13 @@ using namespace std;
 //!
 //! @param out
 //!    ostream to which the output should be redirected
+//!
+//! @param sync
+//!    Write the messages directly instead of through the writer thread and
+//!    do not suppress repetitions, e.g. for a short-living ostringstream
+//!    which is read right after Write()
 //
-MessageImp::MessageImp(ostream &out) : fOut(out), fLastMjd(0)
+MessageImp::MessageImp(ostream &out, bool sync) : fOut(out), fLastMjd(0), fSync(sync)
 {
 }
 
@@ -110,28 +259,84 @@ int MessageImp::WriteImp(const Time &time, const string &txt, int severity)
     if (severity==kAlarm && txt.length()==0)
         return 0;
 
+    Writer *writer = fSync ? 0 : GetWriter();
+    if (writer)
+    {
+        writer->Post(fOut, time, txt, severity);
+        return 0;
+    }
+
+    // Synchronous output or output during static destruction
     static mutex mtx;
     const lock_guard<mutex> guard(mtx);
 
-    switch (severity)
-    {
-    case kMessage: fOut << kDefault       << " -> "; break;
-    case kComment: fOut << kDefault       << " #> "; break;
-    case kInfo:    fOut << kGreen         << " I> "; break;
-    case kWarn:    fOut << kYellow        << " W> "; break;
-    case kError:
-    case kAlarm:   fOut << kRed           << " E> "; break;
-    case kFatal:   fOut << kRed << kBlink << " !> "; break;
-    case kDebug:   fOut << kBlue          << "    "; break;
-    default:       fOut << kBold          << " >> "; break;
-    }
-    fOut << time.GetAsStr("%H:%M:%S.%f") << " - " << txt << endl;
+    Print(fOut, time, txt, severity);
 
     return 0;
 }
 
+// --------------------------------------------------------------------------
+//
+//! Queues the number of repetitions of the last warning or error of the
+//! calling thread (if any) and resets it.
+//!
+//! @param time
+//!    The time assigned to the message
+//
+void MessageImp::PostRepetitions(const Time &time)
+{
+    Repeat &rep = gRepeat;
+    if (rep.count==0)
+        return;
+
+    // The stream is long-living (e.g. the console) while the
+    // MessageImp which issued the message might be gone
+    const string msg = "Last message repeated "+to_string(rep.count)+" times";
+
+    Writer *writer = GetWriter();
+    if (writer)
+        writer->Post(*rep.out, time, msg, rep.severity);
+    rep.count = 0;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Writes a line with the date whenever the date has changed since the
+//! last message and the message itself through WriteImp.
+//!
+//! Warnings, errors and fatal errors which are identical to the previous
+//! message of the calling thread within ten seconds are counted instead
+//! (not in synchronous mode).
+//!
+//! @returns
+//!    -1 if the message was suppressed as repetition, 0 otherwise
+//
 int MessageImp::Write(const Time &time, const string &txt, int severity)
 {
+    Repeat &rep = gRepeat;
+
+    const bool check = !fSync && severity>=kWarn && severity<=kFatal;
+    if (check && rep.out==&fOut && rep.severity==severity && rep.txt==txt &&
+        time>=rep.time && (time-rep.time).total_seconds()<10)
+    {
+        rep.count++;
+        return -1;
+    }
+
+    if (!fSync)
+        PostRepetitions(time);
+
+    if (check)
+    {
+        rep.out      = &fOut;
+        rep.time     = time;
+        rep.txt      = txt;
+        rep.severity = severity;
+    }
+    else
+        if (!fSync) // synchronous messages do not affect the repetitions
+            rep.out = 0;
+
     const uint32_t mjd = time.Mjd();
 
     if (fLastMjd != mjd)
@@ -143,6 +348,33 @@ int MessageImp::Write(const Time &time, const string &txt, int severity)
     return 0;
 }
 
+// --------------------------------------------------------------------------
+//
+//! @returns
+//!    true if all messages have been written by the writer thread
+//
+bool MessageImp::MessageQueueEmpty() const
+{
+    const Writer *writer = GetWriter();
+    return !writer || writer->Empty();
+}
+
+// --------------------------------------------------------------------------
+//
+//! Waits until all messages have been written by the writer thread.
+//! Called before the stream is accessed directly through Out() to keep
+//! the order of the output. The number of suppressed repetitions of the
+//! last warning or error of the calling thread is written first.
+//
+void MessageImp::Flush()
+{
+    PostRepetitions(Time());
+
+    Writer *writer = GetWriter();
+    if (writer)
+        writer->Flush();
+}
+
 // --------------------------------------------------------------------------
 //
 //! Calls Write with the current time the message text and the severity.
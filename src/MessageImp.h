@@ -26,12 +26,14 @@ public:
 private:
     std::ostream &fOut; /// The ostream to which by default Write redirects its output
     uint32_t fLastMjd;  /// Mjd of last message
+    bool     fSync;     /// Write directly instead of through the writer thread
 
     int WriteImp(const Time &time, const std::string &txt, int qos=kMessage);
+    static void PostRepetitions(const Time &time);
 
 public:
-    MessageImp(std::ostream &out=std::cout);
-    virtual ~MessageImp() { }
+    MessageImp(std::ostream &out=std::cout, bool sync=false);
+    virtual ~MessageImp() { if (!fSync) Flush(); }
 
     virtual void IndicateStateChange(const Time &, const std::string &) { }
     void StateChanged(const Time &time, const std::string &server, const std::string &msg, int state);
@@ -69,10 +71,11 @@ public:
     int Fatal(const std::ostringstream &str)   { return Fatal(str.str());   }
     int Comment(const std::ostringstream &str) { return Comment(str.str()); }
 
-    std::ostream &operator()() const { return fOut; }
-    std::ostream &Out() const { return fOut; }
+    std::ostream &operator()() const { Flush(); return fOut; }
+    std::ostream &Out() const { Flush(); return fOut; }
 
-    virtual bool MessageQueueEmpty() const { return true; }
+    static void Flush();
+    virtual bool MessageQueueEmpty() const;
 };
 
 #endif
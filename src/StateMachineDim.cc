@@ -21,6 +21,7 @@ stopped.
 
 #include "EventDim.h"
 #include "ServiceDim.h"
+#include "DimTrace.h"
 
 using namespace std;
 
@@ -71,6 +72,13 @@ StateMachineDim::StateMachineDim(ostream &out, const std::string &name)
     //    fSrvVersion((name+"/VERSION").c_str(), const_cast<int&>(fVersion)),
 {
     SetDefaultStateNames();
+
+    DimTrace::Publish(name);
+}
+
+StateMachineDim::~StateMachineDim()
+{
+    DimTrace::Unpublish();
 }
 
 // --------------------------------------------------------------------------
@@ -170,6 +178,17 @@ void StateMachineDim::infoHandler()
 
     const EventImp *evt = dynamic_cast<EventImp*>(inf);
 
+    if (evt && DimTrace::IsEnabled() && DimTrace::IsTraced(inf->getName()))
+    {
+        // The time stamp of the update identifies its origin. It is only
+        // known to a millisecond, so the reception time is truncated as well
+        const uint64_t origin = DimTrace::GetStamp(evt->GetTime());
+
+        DimTrace::Record(DimTrace::kReceived, inf->getName(), origin);
+        if (origin)
+            DimTrace::Fill(DimTrace::kDelivery, int64_t(DimTrace::GetStamp()-origin));
+    }
+
     if (HasEvent(evt))
         PostEvent(*evt);
 }
@@ -199,6 +218,9 @@ void StateMachineDim::commandHandler()
 
     const EventImp *evt = dynamic_cast<EventImp*>(cmd);
 
+    if (DimTrace::IsEnabled())
+        DimTrace::Record(DimTrace::kCommandReceived, cmd->getName());
+
     if (HasEvent(evt))
         PostEvent(*evt);
 }
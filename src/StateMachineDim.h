@@ -94,6 +94,7 @@ protected:
 
 public:
     StateMachineDim(std::ostream &out=std::cout, const std::string &name="DEFAULT");
+    ~StateMachineDim();
 
     /// Redirect our own logging to fLog
     int Write(const Time &time, const std::string &txt, int qos=kMessage);
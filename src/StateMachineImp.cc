@@ -85,6 +85,7 @@
 
 #include "WindowLog.h"
 #include "Converter.h"
+#include "DimTrace.h"
 
 #include "tools.h"
 
@@ -901,8 +902,30 @@ bool StateMachineImp::HandleEvent(const EventImp &evt)
         return true;
     }
 
-    return HandleNewState(evt.ExecFunc(), &evt,
-                          "by ExecFunc function-call");
+    if (!DimTrace::IsEnabled())
+        return HandleNewState(evt.ExecFunc(), &evt,
+                              "by ExecFunc function-call");
+
+    const uint64_t start  = DimTrace::Now();
+    const uint64_t origin = DimTrace::GetStamp(evt.GetTime());
+    const uint64_t queued = DimTrace::GetTime(evt.GetReceived());
+
+    if (queued)
+        DimTrace::Fill(DimTrace::kQueue, int64_t(start-queued));
+
+    int rc;
+    {
+        // Everything sent while the event is handled refers to it
+        const DimTrace::Cause cause(evt.GetName(), origin);
+        rc = evt.ExecFunc();
+    }
+
+    const uint64_t dur = DimTrace::Now()-start;
+
+    DimTrace::Fill(DimTrace::kExecution, dur);
+    DimTrace::Record(DimTrace::kExecuted, evt.GetName(), origin, dur);
+
+    return HandleNewState(rc, &evt, "by ExecFunc function-call");
 }
 
 // --------------------------------------------------------------------------
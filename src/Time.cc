@@ -133,6 +133,25 @@ Time::Time(short year, unsigned char month, unsigned char day,
 {
 }
 
+// --------------------------------------------------------------------------
+//
+//! Construct a Time from a string in the extended iso format
+//! (see Time::iso), e.g. 2013-01-02T03:04:05.6
+//!
+//! @param str
+//!    The time as a string. If it cannot be evaluated, the Time is
+//!    invalid.
+//!
+Time::Time(const string &str)
+{
+    if (Parse(str.c_str(), iso.ptr))
+        return;
+
+    stringstream stream;
+    stream << str;
+    stream >> Time::iso >> *this;
+}
+
 // --------------------------------------------------------------------------
 //
 //! Set the Time object to a given MJD. Note that this involves
@@ -239,6 +258,12 @@ double Time::RootTime() const
 //
 string Time::GetAsStr(const char *format) const
 {
+    char buf[128];
+
+    const size_t n = Format(buf, sizeof(buf), format);
+    if (n>0)
+        return string(buf, n);
+
     stringstream out;
     out << Time::fmt(format) << *this;
     return out.str();
@@ -252,9 +277,7 @@ string Time::GetAsStr(const char *format) const
 //
 string Time::Iso() const
 {
-    stringstream out;
-    out << Time::iso << *this;
-    return out.str();
+    return GetAsStr(iso.ptr);
 }
 
 // --------------------------------------------------------------------------
@@ -272,12 +295,220 @@ string Time::Iso() const
 //!
 void Time::SetFromStr(const string &str, const char *format)
 {
+    if (Parse(str.c_str(), format))
+        return;
+
     // FIXME: exception handline
     stringstream stream;
     stream << str;
     stream >> Time::fmt(format) >> *this;
 }
 
+// --------------------------------------------------------------------------
+//
+//! Writes the time formatted as defined in format into the given buffer
+//! without the use of streams and locales. The result is identical to
+//! GetAsStr(). The supported conversions are %Y, %m, %d, %H, %M, %S, %f
+//! (fraction of seconds), %F (fraction of seconds including the dot, if
+//! not zero), %q (time zone, always empty) and %%.
+//!
+//! @param buf
+//!    Buffer to which the result is written (terminated by a \0)
+//!
+//! @param size
+//!    Size of the buffer
+//!
+//! @param format
+//!    format description of the string to be returned
+//!
+//! @returns
+//!    The number of characters written (without the terminating \0).
+//!    0 if the format contains a conversion which is not supported,
+//!    the buffer is too small or the time is invalid, then GetAsStr()
+//!    must be used instead.
+//
+size_t Time::Format(char *buf, size_t size, const char *format) const
+{
+    if (is_special() || !format || size==0)
+        return 0;
+
+    const boost::gregorian::date::ymd_type ymd = date().year_month_day();
+    const time_duration tod = time_of_day();
+
+    const int digits = time_duration::num_fractional_digits();
+    const int64_t frac = tod.fractional_seconds();
+
+    char *ptr = buf;
+    char *end = buf+size-1;
+
+    // Write a number with the given number of digits
+    const auto put = [&](uint64_t val, int n)
+    {
+        if (ptr+n>end)
+            return false;
+
+        for (int i=n-1; i>=0; i--)
+        {
+            ptr[i] = '0'+val%10;
+            val /= 10;
+        }
+        ptr += n;
+        return true;
+    };
+
+    for (const char *c=format; *c; c++)
+    {
+        if (*c!='%')
+        {
+            if (ptr==end)
+                return 0;
+            *ptr++ = *c;
+            continue;
+        }
+
+        bool rc = true;
+        switch (*++c)
+        {
+        case 'Y': rc = put(ymd.year,          4); break;
+        case 'm': rc = put(ymd.month,         2); break;
+        case 'd': rc = put(ymd.day,           2); break;
+        case 'H': rc = put(tod.hours(),       2); break;
+        case 'M': rc = put(tod.minutes(),     2); break;
+        case 'S': rc = put(tod.seconds(),     2); break;
+        case 'f': rc = put(frac,         digits); break;
+        case 'q': break;
+        case 'F':
+            if (frac==0)
+                break;
+            if (ptr==end)
+                return 0;
+            *ptr++ = '.';
+            rc = put(frac, digits);
+            break;
+        case '%':
+            rc = ptr<end;
+            if (rc)
+                *ptr++ = '%';
+            break;
+        default:
+            return 0;
+        }
+
+        if (!rc)
+            return 0;
+    }
+
+    *ptr = 0;
+
+    return ptr-buf;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Sets the time from a string formatted as defined in format without
+//! the use of streams and locales. It accepts only a subset of what
+//! SetFromStr() accepts, but where it succeeds, the result is identical.
+//! The supported conversions are %Y (four digits), %m, %d, %H, %M, %S
+//! (two digits each), %F (optional dot followed by at least one digit),
+//! %q (nothing or Z) and %%. The whole string must be consumed.
+//!
+//! @param str
+//!    The time as a string
+//!
+//! @param format
+//!    format description of the string
+//!
+//! @returns
+//!    whether the string could be evaluated. If not, the time is
+//!    unchanged and SetFromStr() must be used instead.
+//
+bool Time::Parse(const char *str, const char *format)
+{
+    if (!str || !format)
+        return false;
+
+    int Y=-1, m=-1, d=-1, H=0, M=0, S=0;
+    int64_t frac = 0;
+    int nfrac = 0;
+
+    const int digits = time_duration::num_fractional_digits();
+
+    // Read exactly n digits
+    const auto get = [&](int &val, int n)
+    {
+        val = 0;
+        for (int i=0; i<n; i++, str++)
+        {
+            if (*str<'0' || *str>'9')
+                return false;
+            val = val*10 + *str-'0';
+        }
+        return true;
+    };
+
+    for (const char *c=format; *c; c++)
+    {
+        if (*c!='%')
+        {
+            if (*str++!=*c)
+                return false;
+            continue;
+        }
+
+        bool rc = true;
+        switch (*++c)
+        {
+        case 'Y': rc = get(Y, 4); break;
+        case 'm': rc = get(m, 2); break;
+        case 'd': rc = get(d, 2); break;
+        case 'H': rc = get(H, 2); break;
+        case 'M': rc = get(M, 2); break;
+        case 'S': rc = get(S, 2); break;
+        case 'q':
+            if (*str=='Z')
+                str++;
+            break;
+        case 'F':
+            if (*str!='.')
+                break;
+            str++;
+            rc = *str>='0' && *str<='9';
+            for (; *str>='0' && *str<='9'; str++)
+                if (nfrac<digits)
+                {
+                    frac = frac*10 + *str-'0';
+                    nfrac++;
+                }
+            break;
+        case '%':
+            rc = *str++=='%';
+            break;
+        default:
+            return false;
+        }
+
+        if (!rc)
+            return false;
+    }
+
+    if (*str!=0)
+        return false;
+
+    // Everything which is not in the valid range is left to boost
+    if (Y<1400 || Y>9999 || m<1 || m>12 || d<1 || H>23 || M>59 || S>59)
+        return false;
+
+    if (d>boost::gregorian::gregorian_calendar::end_of_month_day(Y, m))
+        return false;
+
+    // Fill the fraction up to the full number of digits
+    for (int i=nfrac; i<digits; i++)
+        frac *= 10;
+
+    *this = ptime(boost::gregorian::date(Y, m, d), time_duration(H, M, S, frac));
+    return true;
+}
+
 string Time::MinutesTo(const Time &time) const
 {
     ostringstream str;
@@ -18,6 +18,7 @@ class _time_format
 {
     friend std::ostream &operator<<(std::ostream &out, const _time_format &f);
     friend std::istream &operator>>(std::istream &in,  const _time_format &f);
+    friend class Time;
 private:
     const char *ptr; /// pointer given to the iostreams
 
@@ -68,17 +69,16 @@ public:
          unsigned char h=0, unsigned char m=0, unsigned char s=0,
          unsigned int us=0);
     Time(double mjd) { Mjd(mjd); }
-    Time(const std::string &str)
-    {
-        std::stringstream stream;
-        stream << str;
-        stream >> Time::iso >> *this;
-    }
+    Time(const std::string &str);
 
     // Convesion from and to a string
     std::string GetAsStr(const char *fmt="%Y-%m-%d %H:%M:%S") const;
     void SetFromStr(const std::string &str, const char *fmt="%Y-%m-%d %H:%M:%S");
 
+    // Conversion from and to a string without streams (subset of formats)
+    size_t Format(char *buf, size_t size, const char *fmt="%Y-%m-%d %H:%M:%S") const;
+    bool Parse(const char *str, const char *fmt="%Y-%m-%d %H:%M:%S");
+
     std::string Iso() const;
 
     // Conversion to and from MJD
@@ -0,0 +1,212 @@
+#ifndef FACT_Visibility
+#define FACT_Visibility
+
+// Visibility check of a source as done by the scheduler for incoming
+// alerts. It is shared with gcn to measure the latency of the alert
+// path (see gcn --replay).
+
+#include <map>
+#include <vector>
+
+#include "Time.h"
+#include "Prediction.h"
+
+enum VisibilityCriterion
+{
+    kMoonMin,
+    kMoonMax,
+    kSunMax,
+    kZenithMax,
+    kCurrentMax,
+    kThresholdMax,
+};
+
+struct VisibilityConditions : std::map<VisibilityCriterion, float>
+{
+    VisibilityConditions()
+    {
+        operator[](kMoonMin)      =  10;
+        operator[](kMoonMax)      = 170;
+        operator[](kSunMax)       = -12;
+        operator[](kZenithMax)    =  75;
+        operator[](kCurrentMax)   = 110;
+        operator[](kThresholdMax) =  10;
+    }
+};
+
+// Positions of sun and moon for the next 24h in steps of one minute.
+// They do not depend on the source, and the calculation of the position
+// of the moon is the most time consuming part of the visibility check.
+// Therefore, they are calculated in advance and only interpolated when an
+// alert arrives.
+class SolarTable
+{
+    struct Entry
+    {
+        Nova::EquPosn sun;
+        Nova::EquPosn moon;
+        double disk;
+        double dist;
+        Nova::RstTime rst;   // Astronomical twilight
+    };
+
+    double fStart;           // JD of the first entry
+    std::vector<Entry> fEntries;
+
+    static double Interpolate(double a, double b, double f, double wrap=0)
+    {
+        if (wrap>0 && fabs(b-a)>wrap/2)
+            b += a>b ? wrap : -wrap;
+
+        const double rc = a + f*(b-a);
+        return wrap>0 ? fmod(rc+wrap, wrap) : rc;
+    }
+
+public:
+    static constexpr double kStep = 1./24/60; // [d]
+
+    // Calculate the table for 24h starting at jd. This takes a while
+    // (mainly the position of the moon), so it should not be done where
+    // alerts have to be processed.
+    SolarTable(const double &jd) : fStart(floor(jd/kStep)*kStep), fEntries(24*60+1)
+    {
+        for (size_t i=0; i<fEntries.size(); i++)
+        {
+            const double t = fStart + i*kStep;
+
+            Entry &entry = fEntries[i];
+            entry.sun  = Nova::GetSolarEquCoords(t);
+            entry.moon = Nova::GetLunarEquCoords(t, 0.01);
+            entry.disk = Nova::GetLunarDisk(t);
+            entry.dist = Nova::GetLunarEarthDist(t);
+            entry.rst  = Nova::GetSolarRst(t, -12);
+        }
+    }
+
+    // @returns whether the table covers less than the next 12h
+    bool NeedsUpdate(const double &jd) const
+    {
+        return jd<fStart || jd+0.5>=fStart+(fEntries.size()-1)*kStep;
+    }
+
+    // Fill sun and moon properties at the given time
+    // @returns false if the time is not covered by the table
+    bool Get(const double &jd, Nova::SolarObjects &obj, Nova::RstTime &rst) const
+    {
+        const double idx = (jd-fStart)/kStep;
+        if (fEntries.size()<2 || idx<0 || idx>=fEntries.size()-1)
+            return false;
+
+        const size_t i = size_t(idx);
+        const double f = idx-i;
+
+        const Entry &e0 = fEntries[i];
+        const Entry &e1 = fEntries[i+1];
+
+        obj.fJD = jd;
+
+        obj.fSunEqu.ra   = Interpolate(e0.sun.ra,   e1.sun.ra,   f, 360);
+        obj.fSunEqu.dec  = Interpolate(e0.sun.dec,  e1.sun.dec,  f);
+        obj.fMoonEqu.ra  = Interpolate(e0.moon.ra,  e1.moon.ra,  f, 360);
+        obj.fMoonEqu.dec = Interpolate(e0.moon.dec, e1.moon.dec, f);
+
+        obj.fSunHrz  = Nova::GetHrzFromEqu(obj.fSunEqu,  jd);
+        obj.fMoonHrz = Nova::GetHrzFromEqu(obj.fMoonEqu, jd);
+
+        obj.fMoonDisk  = Interpolate(e0.disk, e1.disk, f);
+        obj.fEarthDist = Interpolate(e0.dist, e1.dist, f);
+
+        rst = f<0.5 ? e0.rst : e1.rst;
+
+        return true;
+    }
+};
+
+struct CheckVisibility
+{
+    VisibilityConditions conditions;
+
+    // Output
+    Nova::SolarObjects solarobj;
+    Nova::ZdAzPosn position;
+    Nova::RstTime rst_sun;
+    Nova::RstTime rst_obj;
+
+    int vis_obj = -1;
+
+    double moon_dist   = -1;
+    double current     = -1;
+    double threshold   = -1;
+
+    bool valid_zd        = false;
+    bool valid_current   = false;
+    bool valid_sun       = false;
+    bool valid_moon      = false;
+    bool valid_threshold = false;
+
+    bool visible       = false; // And of all the above except valid_threshold
+
+    void calc(const Nova::EquPosn &equ, const double &jd, const SolarTable *table=0)
+    {
+        if (!table || !table->Get(jd, solarobj, rst_sun))
+        {
+            solarobj  = Nova::SolarObjects(jd);
+            rst_sun   = Nova::GetSolarRst(jd, -12);
+        }
+
+        position  = Nova::GetHrzFromEqu(equ, jd);
+        moon_dist = Nova::GetAngularSeparation(equ, solarobj.fMoonEqu);
+        vis_obj   = Nova::GetObjectRst(rst_obj, equ, jd, 90-conditions[kZenithMax]);
+
+        current   = FACT::PredictI(solarobj, equ);
+
+        const double ratio = pow(cos(position.zd*M_PI/180), -2.664);
+
+        threshold = position.zd<90 ? ratio*pow(current/6.2, 0.394) : -1;
+
+        valid_moon      = moon_dist>conditions[kMoonMin] && moon_dist<conditions[kMoonMax];
+        valid_zd        = position.zd<conditions[kZenithMax];
+        valid_sun       = solarobj.fSunHrz.alt<conditions[kSunMax];
+        valid_current   = current<conditions[kCurrentMax];
+        valid_threshold = threshold>0 && threshold<conditions[kThresholdMax];
+
+        visible = valid_moon && valid_zd && valid_sun && valid_current;
+    }
+
+    CheckVisibility(const VisibilityConditions &cond, const Nova::EquPosn &equ, const double &jd) : conditions(cond)
+    {
+        calc(equ, jd);
+    }
+
+    CheckVisibility(const VisibilityConditions &cond, const Nova::EquPosn &equ) : conditions(cond)
+    {
+        calc(equ, Time().JD());
+    }
+
+    CheckVisibility(const VisibilityConditions &cond, const double &ra, const double &dec, const double &jd): conditions(cond)
+    {
+        Nova::EquPosn equ;
+        equ.ra  = ra;
+        equ.dec = dec;
+        calc(equ, jd);
+    }
+
+    CheckVisibility(const VisibilityConditions &cond, const double &ra, const double &dec) : conditions(cond)
+    {
+        Nova::EquPosn equ;
+        equ.ra  = ra;
+        equ.dec = dec;
+        calc(equ, Time().JD());
+    }
+
+    // The table is optional, without it the full calculation is done
+    CheckVisibility(const VisibilityConditions &cond, const double &ra, const double &dec, const SolarTable *table) : conditions(cond)
+    {
+        Nova::EquPosn equ;
+        equ.ra  = ra;
+        equ.dec = dec;
+        calc(equ, Time().JD(), table);
+    }
+};
+
+#endif
@@ -2,6 +2,7 @@
 
 #include "pal.h"
 #include "nova.h"
+#include "Astrometry.h"
 #include "tools.h"
 #include "Time.h"
 #include "Configuration.h"
@@ -40,6 +41,7 @@ void SetupConfiguration(Configuration &conf)
         ("ra",             var<double>(),             "Right ascension of the source (use together with --dec)")
         ("dec",            var<double>(),             "Declination of the source (use together with --ra)")
         ("focal-dist",     var<double>(4889.),        "Focal distance of the camera in millimeter")
+        ("pal",            po_switch(),               "Calculate the positions with the pal routines of the Pointing library (precession, nutation, aberration and refraction as in drivectrl) instead of libnova")
         ;
 
     po::options_description debug("Debug options");
@@ -80,6 +82,11 @@ void PrintUsage()
         "`X` and `Y` coordinate of the source in the camera plane is calculated. "
         "The result can then be filled into a database."
         "\n\n"
+        "By default, the positions are calculated with libnova. With --pal, the "
+        "pal routines of the Pointing library are used instead (precession, "
+        "nutation, aberration and refraction, as in drivectrl). All events are "
+        "then transformed in a single batch."
+        "\n\n"
         "The table to be filled or updated should contain the following columns:\n"
         "   - FileId INT UNSIGNED NOT NULL\n"
         "   - EvtNumber INT UNSIGNED NOT NULL\n"
@@ -169,6 +176,7 @@ int main(int argc, const char* argv[])
     const uint32_t file         = conf.Get<uint32_t>("file");
 
     const double   focal_dist   = conf.Get<double>("focal-dist");
+    const bool     use_pal      = conf.Get<bool>("pal");
 
     const bool     print_meta   = conf.Get<bool>("print-meta");
     const bool     print_insert = conf.Get<bool>("print-insert");
@@ -334,157 +342,120 @@ int main(int argc, const char* argv[])
     //obs.lng *= M_PI/180;
     //obs.lat *= M_PI/180;
 
-    ostringstream ins;
-    ins << setprecision(16);
+    // Fetch all events first, so that their positions can be calculated
+    // in a single batch
+    vector<uint32_t> events;
+    vector<double>   times;
 
-    size_t count = 0;
     while (auto row=res1.fetch_row())
     {
-        count++;
-
-        const uint32_t event     = row[0];
         const uint32_t mjd       = row[1];
         const int64_t  millisec  = row[2];
 
-        /*
-         // ============================ Mars ================================
-
-        TVector3 pos;  // pos: source position
-        TVector3 pos0;  // pos: source position
-
-        pos.SetMagThetaPhi(1, M_PI/2-source_dec, source_ra);
-        pos0.SetMagThetaPhi(1, M_PI/2-point_dec, point_ra);
-
-        const double ut = (nanosec/1e6+millisec)/(24*3600000);
-
-        // Julian centuries since J2000.
-        const double t = (ut -(51544.5-mjd)) / 36525.0;
-
-        // GMST at this UT1
-        const double r1 = 24110.54841+(8640184.812866+(0.093104-6.2e-6*t)*t)*t;
-        const double r2 = 86400.0*ut;
-
-        const double sum = (r1+r2)/(3600*24);
-
-        double gmst = fmod(sum, 1) * 2*M_PI;
-
-        MRotation conv;
-        conv.RotateZ(gmst + obs.lng);
-        conv.RotateY(obs.lat-M_PI/2);
-        conv.RotateZ(M_PI);
-
-        pos  *= conv;
-        pos0 *= conv;
+        events.push_back(row[0]);
+        times.push_back(mjd+millisec/1000./3600/24);
+    }
 
-        pos.RotateZ(-pos0.Phi());
-        pos.RotateY(-pos0.Theta());
-        pos.RotateZ(-M_PI/2); // exchange x and y
-        pos *= -focal_dist/pos.Z();
+    if (connection.errnum())
+    {
+        cerr << "SQL error fetching row: " << connection.error() << endl;
+        return 4;
+    }
 
-        TVector2 v = pos.XYvector();
+    const size_t count = events.size();
 
-        //if (fDeviation)
-        //    v -= fDeviation->GetDevXY()/fGeom->GetConvMm2Deg();
+    // Observed positions of the source (zd, az) and of the pointing
+    // position (zd0, az0) [rad]
+    vector<double> zd(count), az(count), zd0(count), az0(count);
 
-        //cout << v.X() << " " << v.Y() << " " << v.Mod()*mm2deg << '\n';
-        */
+    if (use_pal)
+    {
+        // ============================ Pointing ============================
 
-        // ================================= Nova ===============================
+        const Astrometry astro;
 
-        Nova::ZdAzPosn ppos  = Nova::GetHrzFromEqu(source, 2400000.5+mjd+millisec/1000./3600/24);
-        Nova::ZdAzPosn ppos0 = Nova::GetHrzFromEqu(point,  2400000.5+mjd+millisec/1000./3600/24);
+        astro.MeanToObserved(vector<double>(count, source_ra*M_PI/12), vector<double>(count, source_dec*M_PI/180), times, zd,  az);
+        astro.MeanToObserved(vector<double>(count, point_ra *M_PI/12), vector<double>(count, point_dec *M_PI/180), times, zd0, az0);
+    }
+    else
+    {
+        // ============================== Nova ==============================
 
-        TVector3 pos;
-        TVector3 pos0;
-        pos.SetMagThetaPhi( 1, ppos.zd *M_PI/180, ppos.az *M_PI/180);
-        pos0.SetMagThetaPhi(1, ppos0.zd*M_PI/180, ppos0.az*M_PI/180);
+        for (size_t i=0; i<count; i++)
+        {
+            const Nova::ZdAzPosn ppos  = Nova::GetHrzFromEqu(source, 2400000.5+times[i]);
+            const Nova::ZdAzPosn ppos0 = Nova::GetHrzFromEqu(point,  2400000.5+times[i]);
 
-        pos.RotateZ(-pos0.Phi());
-        pos.RotateY(-pos0.Theta());
-        pos.RotateZ(-M_PI/2); // exchange x and y
-        pos *= -focal_dist/pos.Z();
+            zd[i]  = ppos.zd *M_PI/180;
+            az[i]  = ppos.az *M_PI/180;
+            zd0[i] = ppos0.zd*M_PI/180;
+            az0[i] = ppos0.az*M_PI/180;
+        }
+    }
 
-        TVector2 v = pos.XYvector();
+    /*
+     // ============================ Mars ================================
 
-        //cout << v.X() << " " << v.Y() << " " << v.Mod()*mm2deg << '\n';
+    TVector3 pos;  // pos: source position
+    TVector3 pos0;  // pos: source position
 
-        /*
-        // =============================== Slalib ==========================
-        const double height = 2200;
-        const double temp   = 10;
-        const double hum    = 0.25;
-        const double press  = 780;
+    pos.SetMagThetaPhi(1, M_PI/2-source_dec, source_ra);
+    pos0.SetMagThetaPhi(1, M_PI/2-point_dec, point_ra);
 
-        const double _mjd = mjd+millisec/1000./3600/24;
+    const double ut = (nanosec/1e6+millisec)/(24*3600000);
 
-        const double dtt = palDtt(_mjd);  // 32.184 + 35
+    // Julian centuries since J2000.
+    const double t = (ut -(51544.5-mjd)) / 36525.0;
 
-        const double tdb = _mjd + dtt/3600/24;
-        const double dut = 0;
+    // GMST at this UT1
+    const double r1 = 24110.54841+(8640184.812866+(0.093104-6.2e-6*t)*t)*t;
+    const double r2 = 86400.0*ut;
 
-        // prepare calculation: Mean Place to geocentric apperent
-        // (UTC would also do, except for the moon?)
-        double fAmprms[21];
-        palMappa(2000.0, tdb, fAmprms);        // Epoche, TDB
+    const double sum = (r1+r2)/(3600*24);
 
-        // prepare: Apperent to observed place
-        double fAoprms[14];
-        palAoppa(_mjd, dut,                    // mjd, Delta UT=UT1-UTC
-                 obs.lng, obs.lat, height,     // long, lat, height
-                 0, 0,                         // polar motion x, y-coordinate (radians)
-                 273.155+temp, press, hum,     // temp, pressure, humidity
-                 0.40, 0.0065,                 // wavelength, tropo lapse rate
-                 fAoprms);
+    double gmst = fmod(sum, 1) * 2*M_PI;
 
-        // ---- Mean to apparent ----
-        double r=0, d=0;
-        palMapqkz(point_ra, point_dec, fAmprms, &r, &d);
+    MRotation conv;
+    conv.RotateZ(gmst + obs.lng);
+    conv.RotateY(obs.lat-M_PI/2);
+    conv.RotateZ(M_PI);
 
-        double _zd, _az, ha, ra, dec;
-        // -- apparent to observed --
-        palAopqk(r, d, fAoprms,
-                 &_az,  // observed azimuth (radians: N=0,E=90) [-pi,   pi]
-                 &_zd,  // observed zenith distance (radians)   [-pi/2, pi/2]
-                 &ha,   // observed hour angle (radians)
-                 &dec,  // observed declination (radians)
-                 &ra);  // observed right ascension (radians)
+    pos  *= conv;
+    pos0 *= conv;
 
-        //cout << _zd*180/M_PI << " " << _az*180/M_PI << endl;
+    pos.RotateZ(-pos0.Phi());
+    pos.RotateY(-pos0.Theta());
+    pos.RotateZ(-M_PI/2); // exchange x and y
+    pos *= -focal_dist/pos.Z();
 
-        pos0.SetMagThetaPhi(1, _zd, _az);
+    TVector2 v = pos.XYvector();
 
-        r=0, d=0;
-        palMapqkz(source_ra, source_dec, fAmprms, &r, &d);
+    //if (fDeviation)
+    //    v -= fDeviation->GetDevXY()/fGeom->GetConvMm2Deg();
 
-        // -- apparent to observed --
-        palAopqk(r, d, fAoprms,
-                 &_az,  // observed azimuth (radians: N=0,E=90) [-pi, pi]
-                 &_zd,  // observed zenith distance (radians)   [-pi/2, pi/2]
-                 &ha,   // observed hour angle (radians)
-                 &dec,  // observed declination (radians)
-                 &ra);  // observed right ascension (radians)
+    //cout << v.X() << " " << v.Y() << " " << v.Mod()*mm2deg << '\n';
+    */
 
-        pos.SetMagThetaPhi(1, _zd, _az);
+    ostringstream ins;
+    ins << setprecision(16);
 
-        //cout << _zd*180/M_PI << " " << _az*180/M_PI << endl;
+    for (size_t i=0; i<count; i++)
+    {
+        TVector3 pos;
+        TVector3 pos0;
+        pos.SetMagThetaPhi( 1, zd[i],  az[i]);
+        pos0.SetMagThetaPhi(1, zd0[i], az0[i]);
 
         pos.RotateZ(-pos0.Phi());
         pos.RotateY(-pos0.Theta());
         pos.RotateZ(-M_PI/2); // exchange x and y
         pos *= -focal_dist/pos.Z();
 
-        v = pos.XYvector();
+        const TVector2 v = pos.XYvector();
 
         //cout << v.X() << " " << v.Y() << " " << v.Mod()*mm2deg << '\n';
-        */
-
-        ins << "( " << file << ", " << event << ", " << v.X() << ", " << v.Y() << " ),\n";
-    }
 
-    if (connection.errnum())
-    {
-        cerr << "SQL error fetching row: " << connection.error() << endl;
-        return 4;
+        ins << "( " << file << ", " << events[i] << ", " << v.X() << ", " << v.Y() << " ),\n";
     }
 
     if (verbose>0)
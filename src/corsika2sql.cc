@@ -1,5 +1,8 @@
+#include <thread>
+#include <atomic>
+
 #include <boost/regex.hpp>
-#include <boost/algorithm/string/replace.hpp>
+#include <boost/filesystem.hpp>
 
 #include "Database.h"
 
@@ -10,6 +13,7 @@
 #include "Configuration.h"
 
 using namespace std;
+namespace fs = boost::filesystem;
 
 // ------------------------------------------------------------------------
 
@@ -22,8 +26,11 @@ void SetupConfiguration(Configuration &conf)
          ->required()
 #endif
          , "Database link as in\n\tuser:password@server[:port]/database[?compress=0|1].")
-        ("file",           var<string>()->required(),   "Corsika Input Card")
+        ("file",           vars<string>()->required(),  "Corsika Input Card(s) or directories containing input cards")
+        ("regex",          var<string>(""),             "Only process files in directories whose name matches the regular expression")
         ("force",          po_switch(),                 "Force processing even if there is no database connection")
+        ("batch",          var<uint32_t>(uint32_t(1000)), "Maximum number of input cards inserted with a single query (in a single transaction)")
+        ("threads,j",      var<uint32_t>(uint32_t(0)),  "Number of threads reading the input cards (0: number of cores)")
         ;
 
     po::options_description debug("Debug options");
@@ -34,7 +41,7 @@ void SetupConfiguration(Configuration &conf)
         ;
 
     po::positional_options_description p;
-    p.add("file",  1); // The 1st positional options (n=1)
+    p.add("file", -1); // All positional options
 
     conf.AddOptions(control);
     conf.AddOptions(debug);
@@ -45,8 +52,14 @@ void PrintUsage()
 {
     cout <<
         "corsika2sql - Fill a Corsika Input Card into a SQL table\n"
-        "\n\n"
-        "Usage: corsika2sql input-card [-u URI] [options]\n"
+        "\n"
+        "Any number of input cards can be given. For directories, all regular "
+        "files in the directory are processed (if given, only those matching "
+        "--regex). The input cards are read by several threads. The data of up "
+        "to --batch input cards is written with a single query per table "
+        "within a single transaction.\n"
+        "\n"
+        "Usage: corsika2sql input-card [input-card ...] [-u URI] [options]\n"
         "\n"
         ;
     cout << endl;
@@ -79,6 +92,212 @@ bool ShowWarnings(Database &connection)
 }
 
 
+struct Card
+{
+    string file;
+    string runnr;
+
+    vector<string> columns;     // columns of CorsikaSetup
+    vector<string> values;      // corresponding values
+    vector<string> seeds;       // rows of CorsikaSeed (without RUNNR and idx)
+    vector<string> telescopes;  // rows of CorsikaTelescope (without RUNNR)
+
+    string error;
+};
+
+bool ParseCard(Card &card, const map<string, uint16_t> &fields)
+{
+    ifstream fin(card.file);
+    if (!fin)
+    {
+        card.error = "Could not open "+card.file+": "+strerror(errno);
+        return false;
+    }
+
+    string buf;
+    while (getline(fin, buf))
+    {
+        // Remove multiple spaces
+        string line;
+        for (auto c=buf.cbegin(); c!=buf.cend(); c++)
+            if (*c!=' ' || line.empty() || *line.rbegin()!=' ')
+                line += *c;
+
+        vector<string> vec = Tools::Split(Tools::Trim(line), " ");
+
+        const auto it = fields.find(vec[0]);
+        if (it==fields.end())
+            continue;
+
+        const uint16_t N = ::max<uint16_t>(1, it->second);
+
+        if (N<vec.size()-1)
+        {
+            card.error = "Size mismatch: "+vec[0]+" "+to_string(N)+"<"+to_string(vec.size()-1);
+            return false;
+        }
+
+        if (vec[0]=="SEED")
+        {
+            card.seeds.emplace_back("'"+vec[1]+"','"+vec[2]+"','"+vec[3]+"'");
+            continue;
+        }
+        if (vec[0]=="TELESCOPE")
+        {
+            const auto tel = atoi((vec.size()>5?vec[5]:"0").c_str());
+            card.telescopes.emplace_back("'"+vec[1]+"','"+vec[2]+"','"+vec[3]+"','"+vec[4]+"',"+to_string(tel));
+            continue;
+        }
+        if (vec[0]=="RUNNR")
+            card.runnr = vec[1];
+
+        for (int i=1; i<N+1; i++)
+        {
+            if (vec[i]=="T")
+                vec[i]="1";
+            if (vec[i]=="F")
+                vec[i]="0";
+        }
+
+        if (it->second==0)
+        {
+            card.columns.emplace_back("`"+vec[0]+"`");
+            card.values.emplace_back("'"+vec[1]+"'");
+        }
+        else
+        {
+            for (int i=1; i<N+1; i++)
+            {
+                card.columns.emplace_back("`"+vec[0]+"["+to_string(i-1)+"]`");
+                card.values.emplace_back("'"+vec[i]+"'");
+            }
+        }
+    }
+
+    return true;
+}
+
+bool Execute(Database &connection, const string &query, const uint16_t &verbose)
+{
+    try
+    {
+        const mysqlpp::SimpleResult res =
+            connection.query(query).execute();
+
+        if (verbose>0 && res.info())
+            cout << res.info() << '\n' << endl;
+    }
+    catch (const exception &e)
+    {
+        cerr << query << "\n\n";
+        cerr << "SQL query (" << query.length() << " bytes) failed:\n" << e.what() << endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Inserts the data of all cards with a single query per table (cards
+// with different columns need a query of their own)
+int InsertBatch(Database &connection, const vector<const Card*> &batch, const bool &noinsert, const uint16_t &verbose, const bool &print_insert)
+{
+    // -------------------------------------------------------------------------
+    // insert card data into table
+
+    map<vector<string>, vector<string>> setup;
+
+    vector<string> seeds;
+    vector<string> telescopes;
+
+    vector<string> seedruns;
+    vector<string> telruns;
+
+    for (auto card=batch.cbegin(); card!=batch.cend(); card++)
+    {
+        const Card &c = **card;
+
+        setup[c.columns].emplace_back(boost::join(c.values, ","));
+
+        if (!c.seeds.empty())
+            seedruns.push_back(c.runnr);
+
+        int i=0;
+        for (auto it=c.seeds.cbegin(); it!=c.seeds.cend(); it++)
+            seeds.emplace_back(c.runnr+","+to_string(i++)+","+*it);
+
+        if (!c.telescopes.empty())
+            telruns.push_back(c.runnr);
+
+        for (auto it=c.telescopes.cbegin(); it!=c.telescopes.cend(); it++)
+            telescopes.emplace_back(c.runnr+","+*it);
+    }
+
+    for (auto it=setup.cbegin(); it!=setup.cend(); it++)
+    {
+        const string query1 =
+            "REPLACE CorsikaSetup ("+boost::join(it->first, ",")+") VALUES ("+boost::join(it->second, "),(")+")";
+
+        if (!noinsert && !Execute(connection, query1, verbose))
+            return 3;
+
+        if (print_insert)
+            cout << query1 << endl;
+
+        if (!ShowWarnings(connection))
+            return 4;
+    }
+
+    // -------------------------------------------------------------------------
+    // insert seed data into table
+
+    if (!seeds.empty())
+    {
+        const string query2 =
+            "INSERT CorsikaSeed (RUNNR,idx,`SEED[0]`,`SEED[1]`,`SEED[2]`) VALUES ("+boost::join(seeds, "),(")+")";
+
+        if (!noinsert)
+        {
+            if (!Execute(connection, "DELETE FROM CorsikaSeed WHERE RUNNR IN ("+boost::join(seedruns, ",")+")", verbose))
+                return 5;
+
+            if (!Execute(connection, query2, verbose))
+                return 5;
+        }
+
+        if (print_insert)
+            cout << query2 << endl;
+
+        if (!ShowWarnings(connection))
+            return 6;
+    }
+
+    // -------------------------------------------------------------------------
+    // insert telescope data into table
+
+    if (!telescopes.empty())
+    {
+        const string query2 =
+            "INSERT CorsikaTelescope (RUNNR,X,Y,Z,R,ID) VALUES ("+boost::join(telescopes, "),(")+")";
+
+        if (!noinsert)
+        {
+            if (!Execute(connection, "DELETE FROM CorsikaTelescope WHERE RUNNR IN ("+boost::join(telruns, ",")+")", verbose))
+                return 5;
+
+            if (!Execute(connection, query2, verbose))
+                return 5;
+        }
+
+        if (print_insert)
+            cout << query2 << endl;
+
+        if (!ShowWarnings(connection))
+            return 6;
+    }
+
+    return 0;
+}
+
 int main(int argc, const char* argv[])
 {
     Time start;
@@ -92,7 +311,8 @@ int main(int argc, const char* argv[])
 
     // ----------------------------- Evaluate options --------------------------
     const string   uri          = conf.Get<string>("uri");
-    const string   file         = conf.Get<string>("file");
+    const vector<string> files  = conf.Vec<string>("file");
+    const string   regex        = conf.Get<string>("regex");
 
     const bool     print_insert = conf.Get<bool>("print-insert");
 
@@ -100,6 +320,9 @@ int main(int argc, const char* argv[])
     const bool     noinsert     = conf.Get<bool>("no-insert");
     const uint16_t verbose      = conf.Get<uint16_t>("verbose");
 
+    const uint32_t batchsize    = ::max<uint32_t>(1, conf.Get<uint32_t>("batch"));
+    const uint32_t numthreads   = conf.Get<uint32_t>("threads");
+
     // -------------------------------------------------------------------------
     // Checking for database connection
 
@@ -146,195 +369,103 @@ int main(int argc, const char* argv[])
     fields["TELESCOPE"] = 5;
 
     // -------------------------------------------------------------------------
-    // evaluate input card
-
-    vector<string> insert;
-    vector<string> seeds;
-    vector<string> telescopes;
-
-    string runnr;;
-    string buf;
+    // collect input cards
 
-    ifstream fin(file);
+    const boost::regex expr(regex.empty() ? ".*" : regex);
 
-    while (getline(fin, buf))
+    vector<Card> cards;
+    for (auto it=files.cbegin(); it!=files.cend(); it++)
     {
-        string line = buf;
-        while (1)
+        if (!fs::is_directory(*it))
         {
-            boost::replace_all(buf, "  ", " ");
-            if (line==buf)
-                break;
-            line = buf;
-        }
-
-        vector<string> vec = Tools::Split(Tools::Trim(line), " ");
-
-        const auto it = fields.find(vec[0]);
-        if (it==fields.end())
-        {
-            //if (verbose>1)
-            //cout << "Not found: " << vec[0] << " " << vec.size()-1 << endl;
+            cards.emplace_back();
+            cards.back().file = *it;
             continue;
         }
 
-        const uint16_t N = ::max<uint16_t>(1, it->second);
+        vector<string> list;
+        for (fs::directory_iterator dir(*it); dir!=fs::directory_iterator(); dir++)
+            if (fs::is_regular_file(dir->status()) && boost::regex_match(dir->path().filename().string(), expr))
+                list.push_back(dir->path().string());
 
-        if (N<vec.size()-1)
-        {
-            //if (verbose>1)
-            cerr << "Size mismatch: " << vec[0] << " " << N << "<" << vec.size()-1 << endl;
-            return 2;
-        }
-
-        if (vec[0]=="SEED")
-        {
-            seeds.emplace_back("'"+vec[1]+"','"+vec[2]+"','"+vec[3]+"'");
-            continue;
-        }
-        if (vec[0]=="TELESCOPE")
-        {
-            const auto tel = atoi((vec.size()>5?vec[5]:"0").c_str());
-            telescopes.emplace_back("'"+vec[1]+"','"+vec[2]+"','"+vec[3]+"'"+"'"+vec[4]+"',"+to_string(tel));
-            continue;
-        }
-        if (vec[0]=="RUNNR")
-            runnr = vec[1];
-
-        for (int i=1; i<N+1; i++)
-        {
-            if (vec[i]=="T")
-                vec[i]="1";
-            if (vec[i]=="F")
-                vec[i]="0";
-        }
+        sort(list.begin(), list.end());
 
-        if (it->second==0)
-            insert.emplace_back("`"+vec[0]+"`='"+vec[1]+"'");
-        else
+        for (auto name=list.cbegin(); name!=list.cend(); name++)
         {
-            for (int i=1; i<N+1; i++)
-                insert.emplace_back("`"+vec[0]+"["+to_string(i-1)+"]`='"+vec[i]+"'");
+            cards.emplace_back();
+            cards.back().file = *name;
         }
     }
 
-    cout << "RUNNR=" << runnr << " => " << file << endl;
+    if (verbose>0 && cards.size()>1)
+        cout << "Reading " << cards.size() << " input cards..." << endl;
 
     // -------------------------------------------------------------------------
-    // insert card data into table
+    // evaluate input cards
 
-    const string query1 =
-        "REPLACE CorsikaSetup SET "+boost::join(insert, ",");
+    uint32_t nthreads = numthreads==0 ? thread::hardware_concurrency() : numthreads;
+    if (nthreads<1)
+        nthreads = 1;
+    if (nthreads>cards.size())
+        nthreads = cards.size();
 
-    try
-    {
-        if (!noinsert)
-        {
-            const mysqlpp::SimpleResult res1 =
-                connection.query(query1).execute();
+    atomic<size_t> next(0);
 
-            if (verbose>0 && res1.info())
-                cout << res1.info() << '\n' << endl;
-        }
-    }
-    catch (const exception &e)
+    const auto parse = [&]()
     {
-        cerr << query1 << "\n\n";
-        cerr << "SQL query (" << query1.length() << " bytes) failed:\n" << e.what() << endl;
-        return 3;
-    }
+        for (size_t i=next++; i<cards.size(); i=next++)
+            ParseCard(cards[i], fields);
+    };
 
-    if (print_insert)
-        cout << query1 << endl;
+    vector<thread> threads;
+    for (uint32_t i=1; i<nthreads; i++)
+        threads.emplace_back(parse);
 
-    if (!ShowWarnings(connection))
-        return 4;
+    parse();
 
-    // -------------------------------------------------------------------------
-    // insert seed data into table
+    for (auto it=threads.begin(); it!=threads.end(); it++)
+        it->join();
 
-    if (!seeds.empty())
+    for (auto it=cards.cbegin(); it!=cards.cend(); it++)
     {
-        int i=0;
-        for (auto it=seeds.begin(); it!=seeds.end(); it++)
-            it->insert(0, runnr+","+to_string(i++)+",");
-
-        const string query2 =
-            "INSERT CorsikaSeed (RUNNR,idx,`SEED[0]`,`SEED[1]`,`SEED[2]`) VALUES ("+boost::join(seeds, "),(")+")";
-
-        try
-        {
-
-            const mysqlpp::SimpleResult res2a =
-                connection.query("DELETE FROM CorsikaSeed WHERE RUNNR="+runnr).execute();
-
-            if (verbose>0)
-                cout << res2a.info() << '\n' << endl;
-
-            if (!noinsert)
-            {
-                const mysqlpp::SimpleResult res2b =
-                    connection.query(query2).execute();
-
-                if (verbose>0)
-                    cout << res2b.info() << '\n' << endl;
-            }
-        }
-        catch (const exception &e)
+        if (!it->error.empty())
         {
-            cerr << query2 << "\n\n";
-            cerr << "SQL query (" << query2.length() << " bytes) failed:\n" << e.what() << endl;
-            return 5;
+            cerr << it->error << endl;
+            return 2;
         }
 
-        if (print_insert)
-            cout << query2 << endl;
-
-        if (!ShowWarnings(connection))
-            return 6;
+        cout << "RUNNR=" << it->runnr << " => " << it->file << endl;
     }
 
     // -------------------------------------------------------------------------
-    // insert telescope data into table
+    // insert card data into tables
 
-    if (!telescopes.empty())
+    for (auto it=cards.cbegin(); it!=cards.cend(); )
     {
-        for (auto it=telescopes.begin(); it!=telescopes.end(); it++)
-            it->insert(0, runnr+",");
-
-        const string query2 =
-            "INSERT CorsikaTelescope (RUNNR,X,Y,Z,R,ID) VALUES ("+boost::join(telescopes, "),(")+")";
+        // A run number must not appear twice in a batch, otherwise the
+        // rows of the second card would be deleted together with the first
+        vector<const Card*> batch;
+        set<string> runs;
 
-        try
+        for (; it!=cards.cend() && batch.size()<batchsize; it++)
         {
+            if (!runs.insert(it->runnr).second)
+                break;
 
-            const mysqlpp::SimpleResult res2a =
-                connection.query("DELETE FROM CorsikaTelescope WHERE RUNNR="+runnr).execute();
-
-            if (verbose>0)
-                cout << res2a.info() << '\n' << endl;
-
-            if (!noinsert)
-            {
-                const mysqlpp::SimpleResult res2b =
-                    connection.query(query2).execute();
-
-                if (verbose>0)
-                    cout << res2b.info() << '\n' << endl;
-            }
-        }
-        catch (const exception &e)
-        {
-            cerr << query2 << "\n\n";
-            cerr << "SQL query (" << query2.length() << " bytes) failed:\n" << e.what() << endl;
-            return 5;
+            batch.push_back(&*it);
         }
 
-        if (print_insert)
-            cout << query2 << endl;
+        // Roll back everything if any query fails
+        unique_ptr<mysqlpp::Transaction> trans;
+        if (!noinsert)
+            trans.reset(new mysqlpp::Transaction(connection));
 
-        if (!ShowWarnings(connection))
-            return 6;
+        const int rc = InsertBatch(connection, batch, noinsert, verbose, print_insert);
+        if (rc)
+            return rc;
+
+        if (trans)
+            trans->commit();
     }
 
     // -------------------------------------------------------------------------
@@ -1,3 +1,11 @@
+#include <thread>
+#include <functional>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <boost/regex.hpp>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/join.hpp>
@@ -11,13 +19,251 @@
 #include <TFile.h>
 #include <TTree.h>
 #include <TError.h>
-#include <TObjArray.h>
 
 using namespace std;
 namespace fs = boost::filesystem;
 
 // ------------------------------------------------------------------------
 
+// Identical to stof (leading whitespaces are skipped, trailing characters
+// are ignored, out of range values fail), but without allocation in
+// the usual case. std::from_chars for floats is not available in C++11.
+bool ToFloat(const char *beg, const char *end, float &val)
+{
+    char buf[64];
+    string str;
+
+    const char *ptr = buf;
+
+    const size_t len = end-beg;
+    if (len<sizeof(buf))
+    {
+        memcpy(buf, beg, len);
+        buf[len] = 0;
+    }
+    else
+    {
+        str.assign(beg, end);
+        ptr = str.c_str();
+    }
+
+    char *stop = 0;
+
+    errno = 0;
+    val = strtof(ptr, &stop);
+
+    return stop!=ptr && errno!=ERANGE;
+}
+
+// Splits [beg;end[ into fields and calls func(first, last) for each of
+// them. Consecutive delimiters are treated as a single one (as
+// TString::Tokenize does). Returns the number of fields.
+template<class F>
+size_t Tokenize(const char *beg, const char *end, const bool *delim, F func)
+{
+    size_t n = 0;
+
+    const char *ptr = beg;
+    while (1)
+    {
+        while (ptr<end && delim[uint8_t(*ptr)])
+            ptr++;
+
+        if (ptr==end)
+            break;
+
+        const char *first = ptr;
+        while (ptr<end && !delim[uint8_t(*ptr)])
+            ptr++;
+
+        func(first, ptr);
+        n++;
+    }
+
+    return n;
+}
+
+// Replaces empty fields by zeros, as previously done by regular
+// expressions: in each pass a zero is inserted between non-overlapping
+// pairs of consecutive delimiters and before (after) a delimiter at the
+// beginning (end) of the line. Runs of more than two delimiters
+// therefore need more than one pass.
+void FillEmpty(string &out, const char *beg, const char *end, const bool *delim, size_t passes)
+{
+    string in;
+
+    out.assign(beg, end);
+    for (size_t i=0; i<passes; i++)
+    {
+        in.swap(out);
+        out.clear();
+
+        const size_t len = in.size();
+
+        bool changed = false;
+        for (size_t j=0; j<len; j++)
+        {
+            out += in[j];
+            if (j+1<len && delim[uint8_t(in[j])] && delim[uint8_t(in[j+1])])
+            {
+                out += '0';
+                out += in[++j];
+                changed = true;
+            }
+        }
+
+        if (!out.empty() && delim[uint8_t(out[0])])
+        {
+            out.insert(0, 1, '0');
+            changed = true;
+        }
+
+        if (!out.empty() && delim[uint8_t(out[out.size()-1])])
+        {
+            out += '0';
+            changed = true;
+        }
+
+        if (!changed)
+            break;
+    }
+}
+
+// Returns the next line (as read by TString::ReadLine which skips all
+// leading whitespaces and with trailing blanks removed). Returns false
+// if no further line is available.
+bool NextLine(const char *&ptr, const char *end, const char *&first, const char *&last)
+{
+    while (ptr<end && isspace(*ptr))
+        ptr++;
+
+    if (ptr==end)
+        return false;
+
+    first = ptr;
+
+    const char *eol = static_cast<const char*>(memchr(ptr, '\n', end-ptr));
+    last = eol ? eol : end;
+    ptr  = eol ? eol+1 : end;
+
+    while (last>first && last[-1]==' ')
+        last--;
+
+    return true;
+}
+
+// Appends up to size bytes from the stream to the part [ptr;end) of the
+// buffer which has not yet been processed. This part is moved to the
+// beginning of the buffer first. Afterwards, ptr and end point to the
+// new contents of the buffer. Returns false if nothing could be read.
+bool ReadBlock(istream &in, string &buffer, const char *&ptr, const char *&end, size_t size)
+{
+    const size_t keep = end-ptr;
+    if (keep>0 && ptr!=buffer.data())
+        memmove(&buffer[0], ptr, keep);
+
+    buffer.resize(keep+size);
+    in.read(&buffer[keep], size);
+    buffer.resize(keep+in.gcount());
+
+    ptr = buffer.data();
+    end = ptr+buffer.size();
+
+    return in.gcount()>0;
+}
+
+// A part of the input (starting and ending at line boundaries)
+// which is converted by its own thread
+struct Chunk
+{
+    const char *beg;
+    const char *end;
+
+    vector<float> data;   // numcol values for each valid row
+    size_t lines;         // number of lines (incl. comments)
+
+    int    error;         // exit code in case of an error
+    size_t errline;       // line of the error (within the chunk)
+    string errtext;       // error message (up to the line number)
+    string errsuffix;     // error message (after the line number)
+
+    Chunk(const char *b, const char *e) : beg(b), end(e), lines(0), error(0), errline(0) { }
+};
+
+void ParseChunk(Chunk &chunk, size_t numcol, const bool *delim, size_t passes, bool detectnull)
+{
+    const char *ptr = chunk.beg;
+    const char *first, *last;
+
+    chunk.data.reserve((chunk.end-chunk.beg)/(4*numcol+1)*numcol);
+
+    string filled;
+
+    while (NextLine(ptr, chunk.end, first, last))
+    {
+        chunk.lines++;
+
+        if (*first=='#')
+            continue;
+
+        if (passes>0)
+        {
+            FillEmpty(filled, first, last, delim, passes);
+            first = filled.data();
+            last  = first+filled.size();
+        }
+
+        const size_t offset = chunk.data.size();
+        chunk.data.resize(offset+numcol);
+
+        float *vec = chunk.data.data()+offset;
+
+        size_t col = 0;
+        size_t failed = numcol;
+        string field;
+
+        const size_t n = Tokenize(first, last, delim,
+                                  [&](const char *b, const char *e)
+                                  {
+                                      if (col<numcol && failed==numcol)
+                                      {
+                                          if (detectnull && e-b==4 && memcmp(b, "NULL", 4)==0)
+                                              vec[col] = 0;
+                                          else
+                                              if (!ToFloat(b, e, vec[col]))
+                                              {
+                                                  failed = col;
+                                                  field.assign(b, e);
+                                              }
+                                      }
+                                      col++;
+                                  });
+
+        if (n!=numcol || failed<numcol)
+        {
+            ostringstream err;
+            err << string(first, last) << '\n';
+
+            if (n!=numcol)
+            {
+                err << "Column count [" << n << "] mismatch in line ";
+                chunk.errsuffix = "!";
+                chunk.error = 7;
+            }
+            else
+            {
+                err << "Conversion of field " << failed << " '" << field << "' in line ";
+                chunk.errsuffix = " failed!";
+                chunk.error = 8;
+            }
+
+            chunk.errline = chunk.lines;
+            chunk.errtext = err.str();
+            chunk.data.resize(offset);
+            return;
+        }
+    }
+}
 
 // ------------------------------------------------------------------------
 
@@ -37,6 +283,7 @@ void SetupConfiguration(Configuration &conf)
         ("null",           po_switch(),               "Enable detection of NULL and replace it with 0")
         ("empty",          po_switch(),               "Enable detection of empty fields (two immediately consecutive delimiters) and replace them with 0")
         ("dry-run",        po_switch(),               "Do not create or manipulate any output file")
+        ("threads,j",      var<uint32_t>(uint32_t(0)),"Number of threads converting the input (0: number of cores)")
         ("verbose,v",      var<uint16_t>(1),          "Verbosity (0: quiet, 1: default, 2: more, 3, ...)")
         ;
 
@@ -155,6 +402,7 @@ int main(int argc, const char* argv[])
     const string delimiter       = conf.Get<string>("delimiter");
 
     const uint16_t verbose       = conf.Get<uint16_t>("verbose");
+    const uint32_t numthreads    = conf.Get<uint32_t>("threads");
 //    const int64_t  first         = conf.Get<int64_t>("first");
 //    const int64_t  max           = conf.Get<int64_t>("max");
 
@@ -185,45 +433,102 @@ int main(int argc, const char* argv[])
 
     cout << "Reading from '" << file << "'.\n";
 
-    ifstream ifs(file.c_str());
+    // Regular files are mapped into memory, everything else
+    // (e.g. stdin) is read in blocks and converted while reading
+    string input;
+    ifstream fin;
+    istream *in = 0;
+
+    const char *data = 0;
+    size_t fsize = 0;
+    bool mapped = false;
 
-    istream &fin = file=="-" ? cin : ifs;
-    if (!fin.good())
+    if (file=="-")
+        in = &cin;
+    else
     {
-        cerr << file << ": " << strerror(errno) << endl;
-        return 1;
+        const int fd = open(file.c_str(), O_RDONLY);
+
+        struct stat st;
+        if (fd<0 || fstat(fd, &st)<0)
+        {
+            cerr << file << ": " << strerror(errno) << endl;
+            return 1;
+        }
+
+        fsize = st.st_size;
+        if (S_ISREG(st.st_mode) && fsize>0)
+        {
+            void *ptr = mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (ptr==MAP_FAILED)
+            {
+                cerr << file << ": " << strerror(errno) << endl;
+                return 1;
+            }
+
+            madvise(ptr, fsize, MADV_SEQUENTIAL);
+            data   = static_cast<const char*>(ptr);
+            mapped = true;
+        }
+        else
+        {
+            fin.open(file.c_str());
+            in = &fin;
+            fsize = 0;
+        }
+
+        close(fd);
     }
 
-    TString buf;
-    buf.ReadLine(fin);
-    if (!fin)
+    const char *end = data+fsize;
+
+    const char *ptr = data;
+
+    // Read from the stream until the first line is complete
+    while (in)
+    {
+        const char *beg = ptr;
+        while (beg<end && isspace(*beg))
+            beg++;
+
+        if (memchr(beg, '\n', end-beg) || !ReadBlock(*in, input, ptr, end, 1024*1024))
+            break;
+    }
+
+    if (in)
+        data = ptr;
+
+    // Lookup table for the delimiters
+    bool delim[256] = { };
+    for (auto it=delimiter.begin(); it!=delimiter.end(); it++)
+        delim[uint8_t(*it)] = true;
+
+    const char *first, *last;
+    if (!NextLine(ptr, end, first, last))
     {
         cerr << file << ": " << strerror(errno) << endl;
         return 2;
     }
 
-    buf = buf.Strip(TString::kBoth);
-    TObjArray *title = buf.Tokenize(delimiter);
-    if (title->GetEntries()==0)
+    vector<string> title;
+    Tokenize(first, last, delim, [&title](const char *b, const char *e) { title.emplace_back(b, e); });
+    if (title.size()==0)
     {
         cerr << "First line empty." << endl;
         return 3;
     }
 
-    if (title->At(0)->GetName()[0]=='#')
-    {
-        title->RemoveAt(0);
-        title->Compress();
-    }
+    if (title[0][0]=='#')
+        title.erase(title.begin());
 
-    const auto numcol = title->GetEntries();
+    const size_t numcol = title.size();
 
     if (verbose>0)
         cout << "Found " << numcol << " columns." << endl;
 
     if (noheader)
     {
-        fin.seekg(0);
+        ptr = data;
         if (verbose>0)
             cout << "No header line interpreted." << endl;
     }
@@ -294,9 +599,9 @@ int main(int argc, const char* argv[])
     const auto rename = conf.GetWildcardOptions("rename.*");
 
     vector<float> vec(numcol);
-    for (int i=0; i<numcol; i++)
+    for (size_t i=0; i<numcol; i++)
     {
-        string col = noheader ? Tools::Form("col%d", i) : title->At(i)->GetName();
+        string col = noheader ? Tools::Form("col%d", int(i)) : title[i];
 
         if (verbose>1)
             cout << "Column: " << col;
@@ -327,86 +632,109 @@ int main(int argc, const char* argv[])
             it[0]->Branch(col.c_str(), vec.data()+i);
     }
 
-    delete title;
-
     // -------------------------------------------------------------------------
 
+    // Fill only branches for which an adress was set
+    // If we fill the tree, we get empty entries at the
+    // end of the already written branches
+    vector<vector<TBranch*>> branches(ttree.size());
+    for (size_t i=0; i<ttree.size(); i++)
+    {
+        TIter NextBranch(ttree[i]->GetListOfBranches());
+        TBranch *b=0;
+        while ((b=static_cast<TBranch*>(NextBranch())))
+            if (b->GetAddress())
+                branches[i].push_back(b);
+    }
+
+    uint32_t nthreads = numthreads==0 ? thread::hardware_concurrency() : numthreads;
+    if (nthreads<1)
+        nthreads = 1;
+
+    // Number of passes to replace empty fields by zeros (one for
+    // each delimiter which is not a whitespace)
+    const size_t passes = detectempty ? delimiter.size()-count(delimiter.begin(), delimiter.end(), ' ') : 0;
+
+    // Size of the part of the input converted by a single thread at once
+    const size_t chunksize = 16*1024*1024;
+
     size_t line = 0;
     size_t valid = 0;
 
-    while (1)
+    // A stream is converted in blocks of one chunk per thread. Only
+    // complete lines are converted until the end of the stream is reached.
+    for (bool more=in!=0; ; )
     {
-        buf.ReadLine(fin);
-        if (!fin)
-            break;
+        const char *avail = end;
+        if (more)
+        {
+            const char *eol = static_cast<const char*>(memrchr(ptr, '\n', end-ptr));
+            avail = eol ? eol+1 : ptr;
+        }
 
-        line++;
+        while (ptr<avail)
+        {
+            // Split the next part of the input at line boundaries
+            // into one chunk per thread
+            vector<Chunk> chunks;
+            for (uint32_t i=0; i<nthreads && ptr<avail; i++)
+            {
+                const char *stop = ptr+min<size_t>(chunksize, avail-ptr);
+                if (stop<avail)
+                {
+                    const char *eol = static_cast<const char*>(memchr(stop, '\n', avail-stop));
+                    stop = eol ? eol+1 : avail;
+                }
 
-        buf = buf.Strip(TString::kBoth);
-        if (buf.IsNull() || buf[0]=='#')
-            continue;
+                chunks.emplace_back(ptr, stop);
+                ptr = stop;
+            }
 
-        if (detectempty)
-        {
-            string delim = delimiter;
+            if (chunks.size()==1)
+                ParseChunk(chunks[0], numcol, delim, passes, detectnull);
+            else
+            {
+                vector<thread> threads;
+                for (auto it=chunks.begin(); it!=chunks.end(); it++)
+                    threads.emplace_back(ParseChunk, ref(*it), numcol, delim, passes, detectnull);
 
+                for (auto it=threads.begin(); it!=threads.end(); it++)
+                    it->join();
+            }
 
-            for (size_t i=0; i<delimiter.size(); i++)
-                if (delimiter[i]!=' ')
+            // Filling the trees is not thread safe, the chunks are processed
+            // in the order of the input
+            for (auto it=chunks.begin(); it!=chunks.end(); it++)
+            {
+                for (auto v=it->data.cbegin(); v!=it->data.cend(); v+=numcol)
                 {
-                    boost::regex rexpr1("(["+delimiter+"])(["+delimiter+"])");
-                    buf = boost::regex_replace(string(buf.Data()), rexpr1, "\\10\\2");
+                    copy(v, v+numcol, vec.begin());
 
-                    boost::regex rexpr2("^(["+delimiter+"])");
-                    buf = boost::regex_replace(string(buf.Data()), rexpr2, "0\\1");
+                    const size_t index = split.index(valid++);
 
-                    boost::regex rexpr3("(["+delimiter+"])$");
-                    buf = boost::regex_replace(string(buf.Data()), rexpr3, "\\10");
+                    for (auto b=branches[index].begin(); b!=branches[index].end(); b++)
+                        (*b)->Fill();
                 }
-        }
 
-        TObjArray *arr = buf.Tokenize(delimiter);
-        if (arr->GetEntries()!=numcol)
-        {
-            cerr << buf << endl;
-            cerr << "Column count [" << arr->GetEntries() << "] mismatch in line " << line+1 << "!" << endl;
-            return 7;
-        }
-
-        for (int i=0; i<numcol; i++)
-        {
-            try
-            {
-                if (detectnull && arr->At(i)->GetName()==string("NULL"))
+                if (it->error)
                 {
-                    vec[i] = 0;
-                    continue;
+                    cerr << it->errtext << line+it->errline+1 << it->errsuffix << endl;
+                    return it->error;
                 }
 
-                vec[i] = stof(arr->At(i)->GetName());
-            }
-            catch (const exception &e)
-            {
-                cerr << buf << endl;
-                cerr << "Conversion of field " << i << " '" << arr->At(i)->GetName() << "' in line " << line+1 <<  " failed!" << endl;
-                return 8;
+                line += it->lines;
             }
         }
 
-        delete arr;
-
-        const size_t index = split.index(valid++);
+        if (!more)
+            break;
 
-        // Fill only branches for which an adress was set
-        // If we fill the tree, we get empty entries at the
-        // end of the already written branches
-        TIter NextBranch(ttree[index]->GetListOfBranches());
-        TBranch *b=0;
-        while ((b=static_cast<TBranch*>(NextBranch())))
-            if (b->GetAddress())
-                b->Fill();
+        more = ReadBlock(*in, input, ptr, end, nthreads*chunksize);
     }
 
+    if (mapped)
+        munmap(const_cast<char*>(data), fsize);
+
     for (auto it=ttree.begin(); it!=ttree.end(); it++)
     {
         TIter NextBranch((*it)->GetListOfBranches());
@@ -199,7 +199,7 @@ private:
      ************************************************/
     /// ofstream for the NightlyLogfile
     ofstream fNightlyLogFile;
-    /// Log stream to fNightlyLogFile
+    /// Log stream to fNightlyLogFile (synchronous, the file is also accessed directly)
     MessageImp fNightlyLogImp;
     /// ofstream for the Nightly report file
 //    ofstream fNightlyReportFile;
@@ -494,7 +494,7 @@ int DataLogger::Write(const Time&time, const std::string& txt, int qos)
     else if (shouldBackLog)
     {
              ostringstream str;
-             MessageImp mimp(str);
+             MessageImp mimp(str, true); // synchronous, str is read right away
              mimp.Write(time, ss.str(), qos);
              backLogBuffer.push_back(str.str());
          }
@@ -911,7 +911,7 @@ void DataLogger::RemoveOldestRunNumber()
 //!Setup the allows states, configs and transitions for the data logger
 //
 DataLogger::DataLogger(ostream &out) : StateMachineDim(out, "DATA_LOGGER"),
-fNightlyLogImp(fNightlyLogFile), fFilesStats("DATA_LOGGER", *this)
+fNightlyLogImp(fNightlyLogFile, true), fFilesStats("DATA_LOGGER", *this)
 {
     shouldBackLog = true;
 
@@ -0,0 +1,266 @@
+#include <atomic>
+#include <thread>
+#include <iomanip>
+#include <iostream>
+
+#include <boost/filesystem.hpp>
+
+#include "Configuration.h"
+
+#include "Time.h"
+#include "factfits.h"
+#include "externals/DrsCalib.h"
+
+using namespace std;
+
+void SetupConfiguration(Configuration &conf)
+{
+    po::options_description control("DRS time calibration");
+    control.add_options()
+        ("file",        var<string>(),              "Data file of a DRS time calibration run (roi 1024, fits or fits.fz)")
+        ("drs",         var<string>(),              "DRS calibration file (drs.fits) to calibrate the time marker channels with")
+        ("out,o",       var<string>(),              "Output file for the time calibration (DrsCellTimes)")
+        ("force,f",     po_switch(),                "Force overwriting an existing output file")
+        ("edge",        var<int16_t>(int16_t(0)),   "Zero crossings to be used (1: rising edges, -1: falling edges, 0: both)")
+        ("max,m",       var<size_t>(size_t(0)),     "Maximum number of events to be processed (0: all)")
+        ("threads,j",   var<uint32_t>(uint32_t(0)), "Number of threads reading and processing the events (0: number of cores)")
+        ("quiet,q",     po_switch(),                "Do not print the progress")
+        ;
+
+    po::positional_options_description p;
+    p.add("file", 1); // The 1st positional options
+    p.add("drs",  1); // The 2nd positional options
+    p.add("out",  1); // The 3rd positional options
+
+    conf.AddOptions(control);
+    conf.SetArgumentPositions(p);
+}
+
+void PrintUsage()
+{
+    cout <<
+        "drstimecalib - Calculate the DRS time calibration from a drs-time run\n"
+        "\n"
+        "The time marker channel of each DRS chip is calibrated with the given "
+        "DRS calibration file. The zero crossings of its signal are then used "
+        "to determine the relative width of each cell of the DRS ring buffer "
+        "(see DrsCalibrateTime).\n"
+        "\n"
+        "The file is read by several threads in parallel. Each thread reads "
+        "complete tiles of a compressed file with its own reader and "
+        "accumulates its events separately. The accumulated statistics are "
+        "merged at the end. The progress is printed once per second.\n"
+        "\n"
+        "Usage: drstimecalib [-j threads] file.fits[.fz] drs.fits out.fits\n";
+    cout << endl;
+}
+
+void PrintHelp()
+{
+}
+
+// ------------------------------------------------------------------------
+
+// Reads the rows [first, last) of the file, calibrates the time marker
+// channels and accumulates them into calib. cnt counts the processed events.
+void Process(const string &fname, const DrsCalibration &drs, size_t first, size_t last,
+             signed char edge, DrsCalibrateTime &calib, atomic<size_t> &cnt)
+{
+    factfits file(fname);
+    if (!file)
+        throw runtime_error("Opening "+fname+" failed: "+strerror(errno));
+
+    vector<int16_t> data(1440*1024);
+    vector<int16_t> cell(1440);
+
+    file.SetPtrAddress("Data",          data.data(), data.size());
+    file.SetPtrAddress("StartCellData", cell.data(), cell.size());
+
+    vector<float> vec(1024);
+
+    for (size_t row=first; row<last; row++)
+    {
+        if (!file.GetRow(row))
+            throw runtime_error("Reading row "+to_string(row)+" of "+fname+" failed.");
+
+        for (uint16_t ch=0; ch<160; ch++)
+        {
+            const size_t tm = ch*9+8;
+
+            DrsCalibrate::ApplyCh(vec.data(), data.data()+tm*1024, cell[tm], 1024,
+                                  drs.fOffset.data()+tm*1024, drs.fNumOffset,
+                                  drs.fGain.data()  +tm*1024, drs.fNumGain);
+
+            calib.AddT(ch, vec.data(), cell[tm], edge);
+        }
+
+        calib.fNumEntries++;
+        cnt++;
+    }
+}
+
+int main(int argc, const char **argv)
+{
+    Configuration conf(argv[0]);
+    conf.SetPrintUsage(PrintUsage);
+    SetupConfiguration(conf);
+
+    if (!conf.DoParse(argc, argv, PrintHelp))
+        return 127;
+
+    if (!conf.Has("file") || !conf.Has("drs") || !conf.Has("out"))
+    {
+        cerr << "Input file, DRS calibration file and output file are required." << endl;
+        return 1;
+    }
+
+    const string fname   = conf.Get<string>("file");
+    const string drsname = conf.Get<string>("drs");
+    const string oname   = conf.Get<string>("out");
+
+    const signed char edge = conf.Get<int16_t>("edge");
+    const bool quiet = conf.Get<bool>("quiet");
+
+    if (!conf.Get<bool>("force") && boost::filesystem::exists(oname))
+    {
+        cerr << "File '" << oname << "' already exists (use --force to overwrite)." << endl;
+        return 2;
+    }
+
+    // ------------------------ DRS calibration -------------------------
+
+    DrsCalibration drs;
+
+    const string msg = drs.ReadFitsImp(drsname);
+    if (!msg.empty())
+    {
+        cerr << msg << endl;
+        return 3;
+    }
+
+    // ------------------------ Input file -------------------------------
+
+    factfits file(fname);
+    if (!file)
+    {
+        cerr << "Opening " << fname << " failed: " << strerror(errno) << endl;
+        return 4;
+    }
+
+    if (file.GetUInt("NROI")!=1024)
+    {
+        cerr << "Region of interest of " << fname << " is " << file.GetUInt("NROI") << ", 1024 required." << endl;
+        return 4;
+    }
+
+    const size_t maxevt = conf.Get<size_t>("max");
+    const size_t nrows  = maxevt>0 && maxevt<file.GetNumRows() ? maxevt : file.GetNumRows();
+    const size_t night  = file.HasKey("NIGHT") ? file.GetUInt("NIGHT") : 0;
+
+    if (nrows==0)
+    {
+        cerr << "No events in " << fname << endl;
+        return 4;
+    }
+
+    // The rows are distributed to the threads in complete tiles, so that
+    // no tile has to be decompressed twice
+    const size_t tile   = file.HasKey("ZTILELEN") ? max(size_t(1), size_t(file.GetUInt("ZTILELEN"))) : 1;
+    const size_t ntiles = (nrows+tile-1)/tile;
+
+    uint32_t nthreads = conf.Get<uint32_t>("threads");
+    if (nthreads==0)
+        nthreads = thread::hardware_concurrency();
+    if (nthreads==0 || nthreads>ntiles)
+        nthreads = ntiles==0 ? 1 : ntiles;
+
+    // ------------------------ Processing -------------------------------
+
+    // One accumulator per thread
+    vector<DrsCalibrateTime> calib(nthreads);
+    vector<exception_ptr>    except(nthreads);
+
+    atomic<size_t>   cnt(0);   // Number of processed events
+    atomic<uint32_t> done(0);  // Number of finished threads
+
+    const Time start;
+
+    vector<thread> threads;
+    for (uint32_t i=0; i<nthreads; i++)
+    {
+        const size_t r0 = min(nrows, ntiles*i/nthreads*tile);
+        const size_t r1 = min(nrows, ntiles*(i+1)/nthreads*tile);
+
+        threads.emplace_back([&, i, r0, r1]()
+        {
+            try
+            {
+                Process(fname, drs, r0, r1, edge, calib[i], cnt);
+            }
+            catch (...)
+            {
+                except[i] = current_exception();
+            }
+            done++;
+        });
+    }
+
+    // Publish the progress once per second while the threads are running
+    cout << fixed;
+    for (int n=1; done<nthreads; n++)
+    {
+        this_thread::sleep_for(chrono::milliseconds(100));
+        if (quiet || n%10!=0)
+            continue;
+
+        const double sec = Time().UnixTime()-start.UnixTime();
+        cout << "\r" << setprecision(0) << setw(3) << 100.*cnt/nrows << "% [" << cnt << "/" << nrows << "] ";
+        cout << setprecision(1) << cnt/sec << " evts/s" << flush;
+    }
+
+    for (auto it=threads.begin(); it!=threads.end(); it++)
+        it->join();
+
+    if (!quiet)
+        cout << endl;
+
+    for (auto it=except.begin(); it!=except.end(); it++)
+    {
+        if (!*it)
+            continue;
+
+        try
+        {
+            rethrow_exception(*it);
+        }
+        catch (const exception &e)
+        {
+            cerr << e.what() << endl;
+            return 5;
+        }
+    }
+
+    // Merge the accumulators in the order of the rows
+    for (uint32_t i=1; i<nthreads; i++)
+        calib[0] += calib[i];
+
+    // Cells which were not covered in every event get the average
+    // cell width of their chip (like GetComplete) before the offsets
+    // are calculated
+    calib[0].FillEmptyBins(nthreads);
+    calib[0].CalcResult(nthreads);
+
+    const double sec = Time().UnixTime()-start.UnixTime();
+    cout << "Processed " << calib[0].fNumEntries << " events in " << setprecision(1) << sec << "s with " << nthreads << " threads." << endl;
+
+    const string err = calib[0].WriteFitsImp(oname, night);
+    if (!err.empty())
+    {
+        cerr << err << endl;
+        return 6;
+    }
+
+    cout << "Time calibration written to '" << oname << "'" << endl;
+
+    return 0;
+}
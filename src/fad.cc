@@ -44,6 +44,8 @@ public:
         vec.push_back(ptr);
     }
 
+    void Post(uint32_t triggerid);
+
     void Remove(tcp_connection *ptr)
     {
         vec.erase(find(vec.begin(), vec.end(), ptr));
@@ -59,6 +61,9 @@ class tcp_connection : public ba::ip::tcp::socket, public boost::enable_shared_f
 public:
     static Trigger fTrigger;
 
+    static uint32_t fJitter;     // Maximum random delay of the data [us]
+    static bool     fStaticData; // Send the same data with every event
+
     const int fBoardId;
 
     double   fStartTime;
@@ -92,8 +97,26 @@ public:
     }
     void PostTrigger(uint32_t triggerid)
     {
-        if (fTriggerEnabled)
+        if (!fTriggerEnabled)
+            return;
+
+        if (fJitter==0)
+        {
             get_io_service().post(boost::bind(&tcp_connection::SendData, this, triggerid));
+            return;
+        }
+
+        // Delay the data of each board randomly to simulate the
+        // different transmission times of the boards
+        const boost::shared_ptr<ba::deadline_timer> timer(new ba::deadline_timer(get_io_service()));
+        timer->expires_from_now(boost::posix_time::microseconds(int64_t(fJitter)*rand()/RAND_MAX));
+        timer->async_wait(boost::bind(&tcp_connection::SendDelayedData, shared_from_this(), timer, triggerid, dummy::error));
+    }
+
+    void SendDelayedData(boost::shared_ptr<ba::deadline_timer>, uint32_t triggerid, const bs::error_code &ec)
+    {
+        if (ec!=ba::error::basic_errors::operation_aborted && is_open())
+            SendData(triggerid);
     }
 
     // Callback when writing was successfull or failed
@@ -129,6 +152,8 @@ public:
 
     deque<vector<uint16_t>> fOutQueue;
 
+    vector<vector<int16_t>> fData; // Data of all channels if fStaticData is set
+
     void SendData(uint32_t triggerid)
     {
         if (fOutQueue.size()>3)
@@ -168,10 +193,26 @@ public:
         vector<uint16_t> evtbuf;
         evtbuf.reserve(sz);
 
+        fData.resize(kNumChannels);
+
         for (int i=0; i<kNumChannels; i++)
         {
             fChHeader[i].fStartCell = int64_t(1023)*rand()/RAND_MAX;
 
+            // Generating the data is expensive, reuse them if requested
+            // to reach the rates needed to test the event builder
+            if (fStaticData && fData[i].size()==fChHeader[i].fRegionOfInterest)
+            {
+                const vector<uint16_t> buf = fChHeader[i].HtoN();
+
+                evtbuf.insert(evtbuf.end(), buf.begin(), buf.end());
+                evtbuf.insert(evtbuf.end(), fData[i].begin(), fData[i].end());
+
+                fHeader.fPackageLength += sizeof(ChannelHeader)/2;
+                fHeader.fPackageLength += fChHeader[i].fRegionOfInterest;
+                continue;
+            }
+
              vector<int16_t> data(fChHeader[i].fRegionOfInterest, -1024+0x42+i/9+fHeader.fDac[1]/32);
 
             for (int ii=0; ii<fChHeader[i].fRegionOfInterest; ii++)
@@ -191,6 +232,9 @@ public:
                     data[ii] += rndm*exp(-0.5*(ii-p)*(ii-p)/25); // sigma=10
             }
 
+            if (fStaticData)
+                fData[i] = data;
+
             const vector<uint16_t> buf = fChHeader[i].HtoN();
 
             evtbuf.insert(evtbuf.end(), buf.begin(), buf.end());
@@ -491,18 +535,64 @@ public:
     }
 };
 
-Trigger tcp_connection::fTrigger;
+Trigger  tcp_connection::fTrigger;
+uint32_t tcp_connection::fJitter     = 0;
+bool     tcp_connection::fStaticData = false;
+
+void Trigger::Post(uint32_t triggerid)
+{
+    for (vector<tcp_connection*>::iterator it=vec.begin();
+         it!=vec.end(); it++)
+        (*it)->PostTrigger(triggerid);
+}
 
 void Trigger::commandHandler()
 {
     if (!getCommand())
         return;
 
-    for (vector<tcp_connection*>::iterator it=vec.begin();
-         it!=vec.end(); it++)
-        (*it)->PostTrigger(getCommand()->getInt());
+    Post(getCommand()->getInt());
 }
 
+// ------------------------------------------------------------------------
+
+// Triggers all boards with a fixed rate. Together with a null writer
+// of the event builder this allows to measure the sustained event rate.
+class RateTrigger
+{
+    ba::deadline_timer fTimer;
+
+    const boost::posix_time::time_duration fPeriod;
+
+    uint32_t fTriggerId;
+
+    void Schedule()
+    {
+        // The next trigger is scheduled relative to the last one
+        // to keep the average rate even if a trigger is late
+        fTimer.expires_at(fTimer.expires_at()+fPeriod);
+        fTimer.async_wait(boost::bind(&RateTrigger::HandleTimer, this, dummy::error));
+    }
+
+    void HandleTimer(const bs::error_code &ec)
+    {
+        if (ec==ba::error::basic_errors::operation_aborted)
+            return;
+
+        tcp_connection::fTrigger.Post(++fTriggerId);
+
+        Schedule();
+    }
+
+public:
+    RateTrigger(ba::io_service &ioservice, double rate) : fTimer(ioservice),
+        fPeriod(boost::posix_time::microseconds(int64_t(1000000/rate))), fTriggerId(0)
+    {
+        fTimer.expires_from_now(boost::posix_time::seconds(0));
+        Schedule();
+    }
+};
+
 
 class tcp_server
 {
@@ -605,6 +695,9 @@ void SetupConfiguration(::Configuration &conf)
         ("dns",       var<string>("localhost"), "Dim nameserver host name (Overwites DIM_DNS_NODE environment variable)")
         ("port,p",    var<uint16_t>(4000), "")
         ("num,n",     var<uint16_t>(40),   "")
+        ("rate",      var<double>(0.),     "Rate [Hz] with which all boards with enabled trigger line send events (0: only on FAD/TRIGGER)")
+        ("jitter",    var<uint32_t>(uint32_t(0)), "Maximum random delay [us] with which each board sends the data of a trigger")
+        ("static-data", po_bool(),         "Generate the data only once per region-of-interest and send it with every event (to reach high rates)")
         ;
 
     po::positional_options_description p;
@@ -655,6 +748,9 @@ int main(int argc, const char **argv)
         const uint16_t n = conf.Get<uint16_t>("num");
         uint16_t port = conf.Get<uint16_t>("port");
 
+        tcp_connection::fJitter     = conf.Get<uint32_t>("jitter");
+        tcp_connection::fStaticData = conf.Get<bool>("static-data");
+
         vector<shared_ptr<tcp_server>> servers;
 
         for (int i=0; i<n; i++)
@@ -665,6 +761,12 @@ int main(int argc, const char **argv)
             port += 8;
         }
 
+        const double rate = conf.Get<double>("rate");
+
+        shared_ptr<RateTrigger> trigger;
+        if (rate>0)
+            trigger = make_shared<RateTrigger>(io_service, rate);
+
         //  ba::add_service(io_service, &server);
         //  server.add_service(...);
         //cout << "Run..." << flush;
@@ -1946,6 +1946,14 @@ public:
             (bind(&StateMachineFAD::SetupZFits, this, placeholders::_1, zofits::DefaultNumRowsPerTile))
             ("Set the number of rows which are compressed into one tile"
              "|num[int]:Number of rows per tile");
+        T::AddEvent("SET_ZFITS_DEFAULT_MIN_ROWS_PER_TILE", "S")
+            (bind(&StateMachineFAD::SetupZFits, this, placeholders::_1, zofits::DefaultMinNumRowsPerTile))
+            ("Set the minimum number of rows per tile when the tile size is adapted to the event rate"
+             "|num[int]:Minimum number of rows per tile");
+        T::AddEvent("SET_ZFITS_DEFAULT_MAX_TILE_TIME", "S")
+            (bind(&StateMachineFAD::SetupZFits, this, placeholders::_1, zofits::DefaultMaxTileTime))
+            ("Adapt the number of rows per tile to the event rate of the last run, such that a tile is filled within the given time"
+             "|time[s]:Maximum time to fill a tile (0 to switch off)");
 
 
         T::AddEvent("ADD_ADDRESS", "C", FAD::State::kOffline)
@@ -2042,10 +2050,16 @@ public:
             zofits::DefaultMaxNumTiles(conf.Get<uint32_t>("zfits.num-tiles"));
         if (conf.Has("zfits.num-rows"))
             zofits::DefaultNumRowsPerTile(conf.Get<uint32_t>("zfits.num-rows"));
+        if (conf.Has("zfits.min-rows"))
+            zofits::DefaultMinNumRowsPerTile(conf.Get<uint32_t>("zfits.min-rows"));
+        if (conf.Has("zfits.max-tile-time"))
+            zofits::DefaultMaxTileTime(conf.Get<uint32_t>("zfits.max-tile-time"));
 
         // ---------- Setup event builder ---------
         SetMaxMemory(conf.Get<unsigned int>("max-mem"));
         SetEventTimeout(conf.Get<uint16_t>("event-timeout"));
+        SetStatInterval(conf.Get<uint16_t>("stat-interval"));
+        DataCalib::SetNumThreads(conf.Get<uint16_t>("drs-calib-threads"));
 
         if (!InitRunNumber(conf.Get<string>("destination-folder")))
             return 1;
@@ -2232,15 +2246,19 @@ void SetupConfiguration(Configuration &conf)
     builder.add_options()
         ("max-mem",            var<unsigned int>(100), "Maximum memory the event builder thread is allowed to consume for its event buffer")
         ("event-timeout",      var<uint16_t>(30),      "After how many seconds is an event considered to be timed out? (<=0: disabled)")
+        ("stat-interval",      var<uint16_t>(uint16_t(0)), "Interval in seconds in which event rate, CPU usage and queue sizes of the processing stages and the latency percentiles are printed (0: disabled)")
+        ("drs-calib-threads",  var<uint16_t>(4),       "Number of threads accumulating the events of the DRS calibration runs (0: number of cores, 1: in the writer thread)")
         ("destination-folder", var<string>(""),        "Destination folder (base folder) for the event builder binary data files.")
         ;
 
     po::options_description zfits("FITS compression options");
     zfits.add_options()
-        ("zfits.num-threads", var<int32_t>(),  "Number of threads to spawn writing compressed FITS files")
-        ("zfits.max-mem",     var<uint32_t>(), "Maximum amount of memory to be allocated by FITS compression in MB")
-        ("zfits.num-tiles",   var<uint32_t>(), "Maximum number of tiles in the catalog")
-        ("zfits.num-rows",    var<uint32_t>(), "Maximum number of rows per tile")
+        ("zfits.num-threads",   var<int32_t>(),  "Number of threads to spawn writing compressed FITS files")
+        ("zfits.max-mem",       var<uint32_t>(), "Maximum amount of memory to be allocated by FITS compression in MB")
+        ("zfits.num-tiles",     var<uint32_t>(), "Maximum number of tiles in the catalog")
+        ("zfits.num-rows",      var<uint32_t>(), "Maximum number of rows per tile")
+        ("zfits.min-rows",      var<uint32_t>(), "Minimum number of rows per tile if the tile size is adapted to the event rate")
+        ("zfits.max-tile-time", var<uint32_t>(), "If set, the number of rows per tile is adapted to the event rate of the last run such that a tile is filled within this time [s]")
         ;
 
     po::options_description runtype("Run type configuration");
@@ -448,6 +448,9 @@ class CompressedFitsWriter : public CompressedFitsFile
         /// Specific compression functions
         uint32_t compressUNCOMPRESSED(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems);
         uint32_t      compressHUFFMAN(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems);
+        uint32_t         compressRANS(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems);
+        uint32_t      compressENTROPY(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems,
+                                      const char* name, bool (*encode)(string&, const uint16_t*, size_t));
         uint32_t    compressSMOOTHMAN(char* dest, char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems);
         uint32_t       applySMOOTHING(char* dest, char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems);
 
@@ -1244,32 +1247,44 @@ uint32_t CompressedFitsWriter::compressUNCOMPRESSED(char* dest, const char* src,
  ****************************************************************/
 uint32_t CompressedFitsWriter::compressHUFFMAN(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems)
 {
-    string huffmanOutput;
-    uint32_t previousHuffmanSize = 0;
+    return compressENTROPY(dest, src, numRows, sizeOfElems, numRowElems, "HUFMANN", Huffman::Encode);
+}
+
+uint32_t CompressedFitsWriter::compressRANS(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems)
+{
+    return compressENTROPY(dest, src, numRows, sizeOfElems, numRowElems, "RANS", RANS::Encode);
+}
+
+//Same layout for all 16-bit entropy coders: the compressed sizes of the chunks, followed by the chunks
+uint32_t CompressedFitsWriter::compressENTROPY(char* dest, const char* src, uint32_t numRows, uint32_t sizeOfElems, uint32_t numRowElems,
+                                               const char* name, bool (*encode)(string&, const uint16_t*, size_t))
+{
+    string encodedOutput;
+    uint32_t previousEncodedSize = 0;
     if (numRows < 2)
-    {//if we have less than 2 elems to compress, Huffman encoder does not work (and has no point). Just return larger size than uncompressed to trigger the raw storage.
+    {//if we have less than 2 elems to compress, the encoder does not work (and has no point). Just return larger size than uncompressed to trigger the raw storage.
         return numRows*sizeOfElems*numRowElems + 1000;
     }
     if (sizeOfElems < 2 )
     {
-        cout << "Fatal ERROR: HUFMANN can only encode short or longer types" << endl;
+        cout << "Fatal ERROR: " << name << " can only encode short or longer types" << endl;
         return 0;
     }
-    uint32_t huffmanOffset = 0;
+    uint32_t encodedOffset = 0;
     for (uint32_t j=0;j<numRowElems;j++)
     {
-        Huffman::Encode(huffmanOutput,
-                        reinterpret_cast<const uint16_t*>(&src[j*sizeOfElems*numRows]),
-                        numRows*(sizeOfElems/2));
-        reinterpret_cast<uint32_t*>(&dest[huffmanOffset])[0] = huffmanOutput.size() - previousHuffmanSize;
-        huffmanOffset += sizeof(uint32_t);
-        previousHuffmanSize = huffmanOutput.size();
+        encode(encodedOutput,
+               reinterpret_cast<const uint16_t*>(&src[j*sizeOfElems*numRows]),
+               numRows*(sizeOfElems/2));
+        reinterpret_cast<uint32_t*>(&dest[encodedOffset])[0] = encodedOutput.size() - previousEncodedSize;
+        encodedOffset += sizeof(uint32_t);
+        previousEncodedSize = encodedOutput.size();
     }
-    const size_t totalSize = huffmanOutput.size() + huffmanOffset;
+    const size_t totalSize = encodedOutput.size() + encodedOffset;
 
     //only copy if not larger than not-compressed size
     if (totalSize < numRows*sizeOfElems*numRowElems)
-        memcpy(&dest[huffmanOffset], huffmanOutput.data(), huffmanOutput.size());
+        memcpy(&dest[encodedOffset], encodedOutput.data(), encodedOutput.size());
 
     return totalSize;
 }
@@ -1335,6 +1350,12 @@ uint64_t CompressedFitsWriter::compressBuffer(uint32_t threadIndex)
                     else
                         compressedOffset += compressHUFFMAN(&(_compressedBuffer[threadIndex][compressedOffset]), &(_transposedBuffer[threadIndex][offset]), _columns[i].numElems(), _columns[i].sizeOfElems(),  thisRoundNumRows);
                 break;
+                case FITS::kFactRans16:
+                    if (head.ordering == FITS::kOrderByCol)
+                        compressedOffset += compressRANS(&(_compressedBuffer[threadIndex][compressedOffset]), &(_transposedBuffer[threadIndex][offset]), thisRoundNumRows, _columns[i].sizeOfElems(), _columns[i].numElems());
+                    else
+                        compressedOffset += compressRANS(&(_compressedBuffer[threadIndex][compressedOffset]), &(_transposedBuffer[threadIndex][offset]), _columns[i].numElems(), _columns[i].sizeOfElems(),  thisRoundNumRows);
+                break;
                 default:
                     cout << "ERROR: Unkown compression sequence entry: " << sequence[i] << endl;
                 break;
@@ -1469,6 +1490,7 @@ void printHelp()
             "AMPLITUDE\n"
             "HUFFMAN\n"
             "SMOOTHMAN\n"
+            "SMOOTHRANS (smoothing and rANS instead of huffman encoding)\n"
             "INT_WAVELET\n"
             "\n"
             "--quiet removes any textual output, except error messages\n"
@@ -1573,7 +1595,7 @@ int main(int argc, const char** argv)
         }
         string comp = columnsCompression[i].substr(pos+1);
         if (comp != "UNCOMPRESSED" && comp != "AMPLITUDE" && comp != "HUFFMAN" &&
-            comp != "SMOOTHMAN" && comp != "INT_WAVELET")
+            comp != "SMOOTHMAN" && comp != "SMOOTHRANS" && comp != "INT_WAVELET")
         {
             cout << "Unkown compression scheme requested (" << comp << "). Aborting." << endl;
             return -1;
@@ -10,6 +10,8 @@
 #include <float.h>
 
 #include <map>
+#include <thread>
+#include <memory>
 #include <fstream>
 
 #include <boost/regex.hpp>
@@ -22,6 +24,7 @@
 #include "TFile.h"
 #include "TTree.h"
 #include "TFormula.h"
+#include "TROOT.h"
 #endif
 
 using namespace std;
@@ -60,6 +63,33 @@ struct minMaxStruct
 
         numValues++;
     }
+
+    minMaxStruct &operator+=(const minMaxStruct &s)
+    {
+        average   += s.average;
+        squared   += s.squared;
+        numValues += s.numValues;
+
+        if (s.min<min)
+            min = s.min;
+
+        if (s.max>max)
+            max = s.max;
+
+        return *this;
+    }
+};
+
+// Row selection (--filter). Every thread needs its own instance.
+struct RowFilter
+{
+#ifdef HAVE_ROOT
+    TFormula select;
+    vector<Double_t> data;
+#endif
+    bool enabled;
+
+    RowFilter() : enabled(false) { }
 };
 
 
@@ -67,7 +97,10 @@ class FitsDumper : public factfits
 {
 private:
     string fFilename;
+    string fTablename;
     bool fStream;
+    bool fAutoCal;
+    uint32_t fNumThreads;
 
     // Convert CCfits::ValueType into a human readable string
     string ValueTypeToStr(char type) const;
@@ -89,9 +122,19 @@ private:
     ///Display the selected columns values VS time
     int  Dump(ostream &, const vector<string> &, const vector<MyColumn> &, const string &, size_t, size_t, const string &, Configuration &);
     void DumpRoot(ostream &, const vector<string> &, const string &, size_t, size_t, const string &);
-    void DumpMinMax(ostream &, const vector<MyColumn> &, size_t, size_t, bool);
+    void DumpMinMax(ostream &, const vector<MyColumn> &, const string &, size_t, size_t, bool);
     void DumpStats(ostream &, const vector<MyColumn> &, const string &, size_t, size_t);
 
+    void InitFilter(RowFilter &, const string &, const vector<MyColumn> &) const;
+    bool Select(RowFilter &, const vector<MyColumn> &, size_t) const;
+
+    uint32_t GetNumThreads(size_t, size_t) const;
+
+    template<class F>
+    void ReadRows(const vector<MyColumn> &, RowFilter &, size_t, size_t, uint32_t, F &);
+    template<class F>
+    void ProcessRows(const vector<MyColumn> &, const string &, size_t, size_t, uint32_t, F &);
+
 public:
     FitsDumper(const string &fname, const string &tablename);
 
@@ -105,7 +148,8 @@ public:
 //! @param out
 //!        the ostream where to redirect the outputs
 //
-FitsDumper::FitsDumper(const string &fname, const string &tablename) : factfits(fname, tablename), fFilename(fname), fStream(false)
+FitsDumper::FitsDumper(const string &fname, const string &tablename) : factfits(fname, tablename),
+    fFilename(fname), fTablename(tablename), fStream(false), fAutoCal(false), fNumThreads(1)
 {
 }
 
@@ -854,23 +898,187 @@ void FitsDumper::DumpRoot(ostream &, const vector<string> &, const string &, siz
 #endif
 }
 
+// --------------------------------------------------------------------------
+//
+//! Compile the filter. The parameters are the row number followed by
+//! all selected elements of all columns (same as in Dump)
+//
+#ifdef HAVE_ROOT
+void FitsDumper::InitFilter(RowFilter &filter, const string &expr, const vector<MyColumn> &cols) const
+#else
+void FitsDumper::InitFilter(RowFilter &filter, const string &, const vector<MyColumn> &) const
+#endif
+{
+#ifdef HAVE_ROOT
+    if (expr.empty())
+        return;
+
+    if (filter.select.Compile(expr.c_str()))
+        throw runtime_error("Syntax Error: TFormula::Compile failed for '"+expr+"'");
+
+    size_t num = 0;
+    for (auto it=cols.begin(); it!=cols.end(); it++)
+        num += it->last-it->first+1;
 
-void FitsDumper::DumpMinMax(ostream &fout, const vector<MyColumn> &cols, size_t first, size_t limit, bool fNoZeroPlease)
+    filter.data.resize(num+1);
+    filter.enabled = true;
+#endif
+}
+
+#ifdef HAVE_ROOT
+bool FitsDumper::Select(RowFilter &filter, const vector<MyColumn> &cols, size_t row) const
+#else
+bool FitsDumper::Select(RowFilter &filter, const vector<MyColumn> &, size_t) const
+#endif
 {
-    vector<minMaxStruct> statData(cols.size());
+    if (!filter.enabled)
+        return true;
 
-    // Loop over all columns in our list of requested columns
-    const size_t last = limit ? first + limit : size_t(-1);
+#ifdef HAVE_ROOT
+    size_t p = 0;
+
+    filter.data[p++] = row;
 
+    for (auto it=cols.begin(); it!=cols.end(); it++)
+        for (uint32_t i=it->first; i<=it->last; i++, p++)
+            filter.data[p] = GetDouble(*it, i);
+
+    return filter.select.EvalPar(0, filter.data.data())>=0.5;
+#else
+    return true;
+#endif
+}
+
+// --------------------------------------------------------------------------
+//
+//! Number of threads to be used for reading the rows. In stream mode the
+//! number of rows is unknown, so the file can only be read sequentially.
+//
+uint32_t FitsDumper::GetNumThreads(size_t first, size_t limit) const
+{
+    if (fStream || first>=GetNumRows())
+        return 1;
+
+    const size_t rows = limit==0 || GetNumRows()-first<limit ? GetNumRows()-first : limit;
+
+    uint32_t n = fNumThreads;
+    if (n==0)
+        n = thread::hardware_concurrency();
+
+    // Not worth the overhead of opening the file several times
+    if (n>rows/1000)
+        n = rows/1000;
+
+    return n<1 ? 1 : n;
+}
+
+// --------------------------------------------------------------------------
+//
+//! Read all rows from first up to (excluding) last and call proc(id, cols)
+//! for each row which passes the filter
+//
+template<class F>
+void FitsDumper::ReadRows(const vector<MyColumn> &cols, RowFilter &filter, size_t first, size_t last, uint32_t id, F &proc)
+{
     while (GetRow(first++, !fStream))
     {
         const size_t row = GetRow();
         if ((!fStream && row==GetNumRows()) || row==last)
             break;
 
-        auto statsIt = statData.begin();
+        if (Select(filter, cols, first-1))
+            proc(id, cols);
+    }
+}
 
-        for (auto it=cols.begin(); it!=cols.end(); it++, statsIt++)
+// --------------------------------------------------------------------------
+//
+//! Splits the requested rows into num contiguous ranges, each of which is
+//! read by its own thread with an independent reader of the same table
+//! (a fits file object is not thread safe). proc(id, cols) is called with
+//! the index of the thread and the columns as they are set up for its
+//! reader. Results must therefore be accumulated per thread and merged
+//! afterwards. The ranges are ordered by the thread index.
+//
+template<class F>
+void FitsDumper::ProcessRows(const vector<MyColumn> &cols, const string &expr, size_t first, size_t limit, uint32_t num, F &proc)
+{
+    // Compile all filters in advance, TFormula::Compile is not thread safe
+    vector<RowFilter> filters(num);
+    for (auto it=filters.begin(); it!=filters.end(); it++)
+        InitFilter(*it, expr, cols);
+
+    if (num==1)
+    {
+        ReadRows(cols, filters[0], first, limit ? first + limit : size_t(-1), 0, proc);
+        return;
+    }
+
+#ifdef HAVE_ROOT
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,0,0)
+    ROOT::EnableThreadSafety();
+#endif
+#endif
+
+    const size_t last = limit==0 || GetNumRows()-first<limit ? GetNumRows() : first+limit;
+
+    vector<shared_ptr<FitsDumper>> readers;
+    vector<vector<MyColumn>> columns(num, cols);
+
+    for (uint32_t i=0; i<num; i++)
+    {
+        readers.emplace_back(make_shared<FitsDumper>(fFilename, fTablename));
+        if (!*readers.back())
+            throw runtime_error("Opening "+fFilename+" failed: "+strerror(errno));
+
+        if (fAutoCal)
+            readers.back()->resetCalibration();
+
+        for (auto it=columns[i].begin(); it!=columns[i].end(); it++)
+            it->ptr = readers.back()->SetPtrAddress(it->name);
+    }
+
+    vector<exception_ptr> except(num);
+
+    vector<thread> threads;
+    for (uint32_t i=0; i<num; i++)
+    {
+        const size_t r0 = first + (last-first)*i/num;
+        const size_t r1 = first + (last-first)*(i+1)/num;
+
+        threads.emplace_back([&, i, r0, r1]()
+        {
+            try
+            {
+                readers[i]->ReadRows(columns[i], filters[i], r0, r1, i, proc);
+            }
+            catch (...)
+            {
+                except[i] = current_exception();
+            }
+        });
+    }
+
+    for (auto it=threads.begin(); it!=threads.end(); it++)
+        it->join();
+
+    for (auto it=except.begin(); it!=except.end(); it++)
+        if (*it)
+            rethrow_exception(*it);
+}
+
+void FitsDumper::DumpMinMax(ostream &fout, const vector<MyColumn> &cols, const string &filter, size_t first, size_t limit, bool fNoZeroPlease)
+{
+    const uint32_t nthreads = GetNumThreads(first, limit);
+
+    // One set of accumulators per thread
+    vector<vector<minMaxStruct>> stats(nthreads, vector<minMaxStruct>(cols.size()));
+
+    auto proc = [&](uint32_t id, const vector<MyColumn> &columns)
+    {
+        auto statsIt = stats[id].begin();
+
+        for (auto it=columns.begin(); it!=columns.end(); it++, statsIt++)
         {
             if ((it->name=="UnixTimeUTC" || it->name=="PCTime") && it->first==0 && it->last==1)
             {
@@ -892,7 +1100,14 @@ void FitsDumper::DumpMinMax(ostream &fout, const vector<MyColumn> &cols, size_t
                 statsIt->add(cValue);
             }
         }
-    }
+    };
+
+    ProcessRows(cols, filter, first, limit, nthreads, proc);
+
+    vector<minMaxStruct> &statData = stats[0];
+    for (uint32_t i=1; i<nthreads; i++)
+        for (size_t j=0; j<cols.size(); j++)
+            statData[j] += stats[i][j];
 
     // okay. So now I've got ALL the data, loaded.
     // let's do the summing and averaging in a safe way (i.e. avoid overflow
@@ -940,15 +1155,10 @@ void displayStats(vector<char> &array, ostream& out)
 
     T *val = reinterpret_cast<T*>(array.data());
 
-    sort(val, val+numElems);
+    const auto mm = minmax_element(val, val+numElems);
 
-    out << "Min: " << double(val[0]) << '\n';
-    out << "Max: " << double(val[numElems-1]) << '\n';
-
-    if (numElems%2 == 0)
-        out << "Med: " << (double(val[numElems/2-1]) + double(val[numElems/2]))/2 << '\n';
-    else
-        out << "Med: " << double(val[numElems/2]) << '\n';
+    out << "Min: " << double(*mm.first) << '\n';
+    out << "Max: " << double(*mm.second) << '\n';
 
     long double avg = 0;
     long double rms = 0;
@@ -959,6 +1169,15 @@ void displayStats(vector<char> &array, ostream& out)
         rms += v*v;
     }
 
+    // A full sort is not needed for the median
+    T *med = val+numElems/2;
+    nth_element(val, med, val+numElems);
+
+    if (numElems%2 == 0)
+        out << "Med: " << (double(*max_element(val, med)) + double(*med))/2 << '\n';
+    else
+        out << "Med: " << double(*med) << '\n';
+
     avg /= numElems;
     rms /= numElems;
     rms -= avg*avg;
@@ -969,70 +1188,43 @@ void displayStats(vector<char> &array, ostream& out)
     out << "Rms: " << rms << endl;
 }
 
-#ifdef HAVE_ROOT
 void FitsDumper::DumpStats(ostream &fout, const vector<MyColumn> &cols, const string &filter, size_t first, size_t limit)
-#else
-void FitsDumper::DumpStats(ostream &fout, const vector<MyColumn> &cols, const string &, size_t first, size_t limit)
-#endif
 {
-#ifdef HAVE_ROOT
-    TFormula select;
-    if (!filter.empty() && select.Compile(filter.c_str()))
-        throw runtime_error("Syntax Error: TFormula::Compile failed for '"+filter+"'");
-#endif
-
-    // Loop over all columns in our list of requested columns
-    vector<vector<char>> statData;
+    const uint32_t num = GetNumThreads(first, limit);
 
     const size_t rows = limit==0 || GetNumRows()<limit ? GetNumRows() : limit;
 
-    for (auto it=cols.begin(); it!=cols.end(); it++)
-        statData.emplace_back(vector<char>(it->col.size*rows*(it->last-it->first+1)));
-
-#ifdef HAVE_ROOT
-    size_t num = 0;
-    for (auto it=cols.begin(); it!=cols.end(); it++)
-        num += it->last-it->first+1;
-
-    vector<Double_t> data(num+1);
-#endif
-
-    // Loop over all columns in our list of requested columns
-    const size_t last = limit ? first + limit : size_t(-1);
-
-    uint64_t counter = 0;
-
-    while (GetRow(first++, !fStream))
+    // One buffer per thread and column, the buffers are concatenated
+    // in the order of the threads which is the order of the rows
+    vector<vector<vector<char>>> data(num, vector<vector<char>>(cols.size()));
+    for (uint32_t i=0; i<num; i++)
     {
-        const size_t row = GetRow();
-        if ((!fStream && row==GetNumRows()) || row==last)
-            break;
+        auto statsIt = data[i].begin();
+        for (auto it=cols.begin(); it!=cols.end(); it++, statsIt++)
+            statsIt->reserve(it->col.size*(rows/num+1)*(it->last-it->first+1));
+    }
 
-#ifdef HAVE_ROOT
-        if (!filter.empty())
+    auto proc = [&](uint32_t id, const vector<MyColumn> &columns)
+    {
+        auto statsIt = data[id].begin();
+        for (auto it=columns.begin(); it!=columns.end(); it++, statsIt++)
         {
-            size_t p = 0;
-
-            data[p++] = first-1;
-
-            for (auto it=cols.begin(); it!=cols.end(); it++)
-                for (uint32_t i=it->first; i<=it->last; i++, p++)
-                    data[p] = GetDouble(*it, i);
-
-            if (select.EvalPar(0, data.data())<0.5)
-                continue;
+            const char *src = reinterpret_cast<const char*>(it->ptr) + it->first*it->col.size;
+            const size_t sz = (it->last-it->first+1)*it->col.size;
+            statsIt->insert(statsIt->end(), src, src+sz);
         }
-#endif
+    };
 
-        auto statsIt = statData.begin();
-        for (auto it=cols.begin(); it!=cols.end(); it++, statsIt++)
+    ProcessRows(cols, filter, first, limit, num, proc);
+
+    vector<vector<char>> &statData = data[0];
+    for (uint32_t i=1; i<num; i++)
+    {
+        for (size_t j=0; j<cols.size(); j++)
         {
-            const char *src = reinterpret_cast<const char*>(it->ptr);
-            const size_t sz = (it->last-it->first+1)*it->col.size;
-            memcpy(statsIt->data()+counter*sz, src+it->first*it->col.size, sz);
+            statData[j].insert(statData[j].end(), data[i][j].begin(), data[i][j].end());
+            vector<char>().swap(data[i][j]);
         }
-
-        counter++;
     }
 
     auto statsIt = statData.begin();
@@ -1043,9 +1235,6 @@ void FitsDumper::DumpStats(ostream &fout, const vector<MyColumn> &cols, const st
             fout << ':' << it->last;
         fout << "]\n";
 
-        const size_t sz = (it->last-it->first+1)*it->col.size;
-        statsIt->resize(counter*sz);
-
         switch (it->col.type)
         {
         case 'L':
@@ -1083,9 +1272,11 @@ void FitsDumper::DumpStats(ostream &fout, const vector<MyColumn> &cols, const st
 //
 int FitsDumper::Exec(Configuration& conf)
 {
-    fStream = conf.Get<bool>("stream");
+    fStream     = conf.Get<bool>("stream");
+    fAutoCal    = conf.Get<bool>("autocal");
+    fNumThreads = conf.Get<uint32_t>("threads");
 
-    if (conf.Get<bool>("autocal"))
+    if (fAutoCal)
         resetCalibration();
 
     if (conf.Get<bool>("list"))
@@ -1189,7 +1380,7 @@ int FitsDumper::Exec(Configuration& conf)
 
     if (conf.Get<bool>("minmax"))
     {
-        DumpMinMax(fout, cols, first, limit, conf.Get<bool>("nozero"));
+        DumpMinMax(fout, cols, filter, first, limit, conf.Get<bool>("nozero"));
         return 0;
     }
 
@@ -1297,10 +1488,11 @@ void SetupConfiguration(Configuration& conf)
         ("first",       var<size_t>(size_t(0)), "First number of row to read")
         ("limit",       var<size_t>(size_t(0)), "Limit for the maximum number of rows to read (0=unlimited)")
         ("tablename,t", var<string>(""),        "Name of the table to open. If not specified, first binary table is opened")
+        ("threads,j",   var<uint32_t>(uint32_t(0)), "Number of threads reading the file for --stat and --minmax (0: number of cores, ignored with --stream)")
         ("autocal",     po_switch(),            "This option can be used to skip the application of the noise calibration when reading back a compressed fits file. This is identical in using zfits instead of factfits.")
 #ifdef HAVE_ROOT
         ("root,r",      po_switch(),            "Enable root mode")
-        ("filter,f",    var<string>(""),        "Filter to restrict the selection of events (e.g. '[0]>10 && [0]<20';  does not work with stat and minmax yet)")
+        ("filter,f",    var<string>(""),        "Filter to restrict the selection of events (e.g. '[0]>10 && [0]<20')")
         ("overwrite",   po_switch(),            "Force overwriting an existing root file ('RECREATE')")
         ("update",      po_switch(),            "Update an existing root file ('UPDATE') or an existing tree with more data.")
         ("compression", var<uint16_t>(1),       "zlib compression level for the root file")
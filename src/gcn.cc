@@ -20,7 +20,9 @@
 #include "HeadersGCN.h"
 #include "HeadersToO.h"
 
-#include <QtXml/QDomDocument>
+#include "Visibility.h"
+
+#include <QXmlStreamReader>
 
 namespace ba    = boost::asio;
 namespace bs    = boost::system;
@@ -31,6 +33,152 @@ using namespace GCN;
 
 // ------------------------------------------------------------------------
 
+// Single pass parser for the subset of a VOEvent which is evaluated. No
+// document tree is built. The text and the attributes of the first
+// occurrence of each element are stored by their path relative to the
+// root element (e.g. "Who/Author/shortName" or "WhereWhen/.../Position2D@unit")
+// and all Param elements below What by their name.
+class VOEvent
+{
+    string fRoot;
+    string fRole;
+
+    map<string, string> fElements;
+    map<string, string> fParams;
+
+    string fError;
+
+public:
+    bool Parse(const char *xml)
+    {
+        fRoot.clear();
+        fRole.clear();
+        fElements.clear();
+        fParams.clear();
+        fError.clear();
+
+        QXmlStreamReader reader(xml);
+        reader.setNamespaceProcessing(false);
+
+        // Elements currently open: path, text and whether it is the
+        // first occurrence of this path
+        struct Level
+        {
+            string path;
+            string text;
+            bool   first;
+        };
+
+        vector<Level> levels;
+
+        while (!reader.atEnd())
+        {
+            switch (reader.readNext())
+            {
+            case QXmlStreamReader::StartElement:
+                {
+                    const string tag = reader.qualifiedName().toString().toStdString();
+                    const QXmlStreamAttributes attr = reader.attributes();
+
+                    if (fRoot.empty())
+                    {
+                        fRoot = tag;
+                        fRole = attr.value("role").toString().toStdString();
+                        levels.push_back({ "", "", false });
+                        break;
+                    }
+
+                    const string name = levels.size()<=1 ? tag : levels.back().path+"/"+tag;
+
+                    const bool first = fElements.find(name)==fElements.end();
+                    if (first)
+                    {
+                        fElements[name];
+                        for (const auto &a : attr)
+                            fElements.emplace(name+"@"+a.qualifiedName().toString().toStdString(),
+                                              a.value().toString().toStdString());
+                    }
+
+                    if (tag=="Param" && name.compare(0, 5, "What/")==0)
+                        fParams.emplace(attr.value("name").toString().toStdString(),
+                                        attr.value("value").toString().toStdString());
+
+                    levels.push_back({ name, "", first });
+                }
+                break;
+
+            case QXmlStreamReader::Characters:
+                if (!levels.empty() && levels.back().first)
+                    levels.back().text += reader.text().toString().toStdString();
+                break;
+
+            case QXmlStreamReader::EndElement:
+                if (levels.empty())
+                    break;
+
+                // Only the text of the leaves is evaluated, so the text
+                // of the children is not added to their parents
+                if (levels.back().first)
+                    fElements[levels.back().path] = levels.back().text;
+
+                levels.pop_back();
+                break;
+
+            default:
+                break;
+            }
+        }
+
+        if (reader.hasError())
+        {
+            fError = reader.errorString().toStdString()+" [line "+to_string(reader.lineNumber())+"]";
+            return false;
+        }
+
+        if (fRoot.empty())
+        {
+            fError = "No root element";
+            return false;
+        }
+
+        return true;
+    }
+
+    const string &GetError() const { return fError; }
+
+    const string &Root() const { return fRoot; }
+    const string &Role() const { return fRole; }
+
+    bool Has(const string &path) const
+    {
+        return fElements.find(path)!=fElements.end();
+    }
+
+    string Get(const string &path) const
+    {
+        const auto it = fElements.find(path);
+        return it==fElements.end() ? "" : it->second;
+    }
+
+    string GetParamValue(const string &name) const
+    {
+        const auto it = fParams.find(name);
+        return it==fParams.end() ? "" : it->second;
+    }
+
+    void Print(ostream &out) const
+    {
+        out << fRoot << " [" << fRole << "]\n";
+        for (const auto &e : fElements)
+            if (!e.second.empty())
+                out << " " << e.first << " = " << e.second << '\n';
+        for (const auto &p : fParams)
+            out << " Param[" << p.first << "] = " << p.second << '\n';
+    }
+};
+
+// ------------------------------------------------------------------------
+
 class ConnectionGCN : public Connection
 {
 private:
@@ -49,26 +197,23 @@ private:
 
     Time fLastKeepAlive;
 
-    QString GetParamValue(const QDomElement &what, const string &name)
-    {
-        const QDomNodeList param = what.elementsByTagName("Param");
-        for (int i=0; i<param.count(); i++)
-        {
-            const QDomElement elem = param.at(i).toElement();
-            if (elem.attribute("name").toStdString()==name)
-                return elem.attribute("value");
-        }
+    VOEvent fEvent;
 
-        return "";
-    }
+    Time fRxTime;      // Time the current message was received
+    bool fDryRun;      // Do neither send nor archive alerts (replay)
+
+    shared_ptr<const SolarTable> fSolarTable; // Replay: Visibility check as in the scheduler
+
+    vector<int64_t> fLatency; // Reception to decision of each ToO [us]
+    size_t          fVisible; // Replay: Number of visible ToOs
 
-    GCN::PaketPtr GetType(const QDomElement &what)
+    GCN::PaketPtr GetType(const VOEvent &voe)
     {
-        const auto value = GetParamValue(what, "Packet_Type");
-        if (value.isEmpty())
+        const string value = voe.GetParamValue("Packet_Type");
+        if (value.empty())
             return GCN::PaketTypes.end();
 
-        const uint16_t val = value.toUInt();
+        const uint16_t val = atoi(value.c_str());
 
         const auto it = GCN::PaketTypes.find(val);
 
@@ -79,13 +224,13 @@ private:
 
     }
 
-    int ProcessXml(const QDomElement &root)
+    int ProcessXml(const VOEvent &voe)
     {
-        if (root.isNull())
+        if (voe.Root().empty())
             return -255;
 
-        const string role = root.attribute("role", "").toStdString();
-        const string trn  = root.tagName().toStdString();
+        const string &role = voe.Role();
+        const string &trn  = voe.Root();
 
         // A full description can be found at http://voevent.dc3.com/schema/default.html
 
@@ -93,18 +238,16 @@ private:
         {
             if (role=="iamalive")
             {
-                const QDomElement orig = root.firstChildElement("Origin");
-                const QDomElement time = root.firstChildElement("TimeStamp");
-                if (orig.isNull() || time.isNull())
+                if (!voe.Has("Origin") || !voe.Has("TimeStamp"))
                     return -254;
 
-                fLastKeepAlive = Time(time.text().toStdString());
+                fLastKeepAlive = Time(voe.Get("TimeStamp"));
 
                 if (fIsVerbose)
                 {
                     Out() << Time().GetAsStr() << " ----- " << trn << " [" << role << "] -----" << endl;
-                    Out() << " " << time.tagName().toStdString() << " = " << fLastKeepAlive.GetAsStr() << '\n';
-                    Out() << " " << orig.tagName().toStdString() << " = " << orig.text().toStdString() << '\n';
+                    Out() << " TimeStamp = " << fLastKeepAlive.GetAsStr() << '\n';
+                    Out() << " Origin = " << voe.Get("Origin") << '\n';
                     Out() << endl;
                 }
 
@@ -114,42 +257,38 @@ private:
             return false;
         }
 
-        ofstream fout("gcn.stream", ios::app);
-        fout << "------------------------------------------------------------------------------\n" << fRxData.data() << endl;
+        if (!fDryRun)
+        {
+            ofstream fout("gcn.stream", ios::app);
+            fout << "------------------------------------------------------------------------------\n" << fRxData.data() << endl;
+        }
 
         if (trn=="voe:VOEvent")
         {
             // WHAT: http://gcn.gsfc.nasa.gov/tech_describe.html
-            const QDomElement who  = root.firstChildElement("Who");
-            const QDomElement what = root.firstChildElement("What");
-            const QDomElement when = root.firstChildElement("WhereWhen");
-            //const QDomElement how  = root.firstChildElement("How");
-            //const QDomElement why  = root.firstChildElement("Why");
-            //const QDomElement cite = root.firstChildElement("Citations");
-            //const QDomElement desc = root.firstChildElement("Description");
-            //const QDomElement ref  = root.firstChildElement("Reference");
-            if (who.isNull() || what.isNull() || when.isNull())
+            // How, Why, Citations, Description and Reference are not evaluated
+            if (!voe.Has("Who") || !voe.Has("What") || !voe.Has("WhereWhen"))
                 return -253;
 
-            const auto ptype = GetType(what);
-
-            const QDomElement date   = who.firstChildElement("Date");
-            const QDomElement author = who.firstChildElement("Author");
-            const QDomElement sname  = author.firstChildElement("shortName");
-            const QDomElement desc   = what.firstChildElement("Description");
-
-            const QDomElement obsdat = when.firstChildElement("ObsDataLocation");
-            const QDomElement obsloc = obsdat.firstChildElement("ObservationLocation");
-            const QDomElement coord  = obsloc.firstChildElement("AstroCoords");
-
-            const QDomElement time   = coord.firstChildElement("Time").firstChildElement("TimeInstant").firstChildElement("ISOTime");
-            const QDomElement pos2d  = coord.firstChildElement("Position2D");
-            const QDomElement name1  = pos2d.firstChildElement("Name1");
-            const QDomElement name2  = pos2d.firstChildElement("Name2");
-            const QDomElement val2   = pos2d.firstChildElement("Value2");
-            const QDomElement c1     = val2.firstChildElement("C1");
-            const QDomElement c2     = val2.firstChildElement("C2");
-            const QDomElement errad  = pos2d.firstChildElement("Error2Radius");
+            const auto ptype = GetType(voe);
+
+            const string coord = "WhereWhen/ObsDataLocation/ObservationLocation/AstroCoords";
+            const string pos2d = coord+"/Position2D";
+
+            const bool has_date   = voe.Has("Who/Date");
+            const bool has_author = voe.Has("Who/Author");
+            const bool has_sname  = voe.Has("Who/Author/shortName");
+            const bool has_desc   = voe.Has("What/Description");
+            const bool has_obsdat = voe.Has("WhereWhen/ObsDataLocation");
+            const bool has_obsloc = voe.Has("WhereWhen/ObsDataLocation/ObservationLocation");
+            const bool has_coord  = voe.Has(coord);
+            const bool has_time   = voe.Has(coord+"/Time/TimeInstant/ISOTime");
+            const bool has_pos2d  = voe.Has(pos2d);
+            const bool has_name1  = voe.Has(pos2d+"/Name1");
+            const bool has_val2   = voe.Has(pos2d+"/Value2");
+            const bool has_c1     = voe.Has(pos2d+"/Value2/C1");
+            const bool has_c2     = voe.Has(pos2d+"/Value2/C2");
+            const bool has_errad  = voe.Has(pos2d+"/Error2Radius");
 
             const auto &id = ptype->first;
 
@@ -167,33 +306,33 @@ private:
 
             // Required keywords
             vector<string> missing;
-            if (date.isNull())
+            if (!has_date)
                 missing.emplace_back("Date");
-            if (author.isNull())
+            if (!has_author)
                 missing.emplace_back("Author");
-            if (sname.isNull() && !is_gw && !no_sn)
+            if (!has_sname && !is_gw && !no_sn)
                 missing.emplace_back("shortName");
-            if (obsdat.isNull())
+            if (!has_obsdat)
                 missing.emplace_back("ObsDataLocation");
-            if (obsloc.isNull())
+            if (!has_obsloc)
                 missing.emplace_back("ObservationLocation");
-            if (coord.isNull())
+            if (!has_coord)
                 missing.emplace_back("AstroCoords");
-            if (time.isNull())
+            if (!has_time)
                 missing.emplace_back("Time/TimeInstant/ISOTime");
-            if (pos2d.isNull() && !is_gw)
+            if (!has_pos2d && !is_gw)
                 missing.emplace_back("Position2D");
-            if (name1.isNull() && !is_gw)
+            if (!has_name1 && !is_gw)
                 missing.emplace_back("Name1");
-            if (name1.isNull() && !is_gw)
+            if (!has_name1 && !is_gw)
                 missing.emplace_back("Name2");
-            if (val2.isNull() && !is_gw)
+            if (!has_val2 && !is_gw)
                 missing.emplace_back("Value2");
-            if (c1.isNull() && !is_gw)
+            if (!has_c1 && !is_gw)
                 missing.emplace_back("C1");
-            if (c2.isNull() && !is_gw)
+            if (!has_c2 && !is_gw)
                 missing.emplace_back("C2");
-            if (errad.isNull() && !is_gw)
+            if (!has_errad && !is_gw)
                 missing.emplace_back("Error2Radius");
 
             if (!missing.empty())
@@ -269,20 +408,20 @@ private:
             // case 111:
             // case 112:
             // case 115:
-            //     name = GetParamValue(what, "TRIGGER_NUM").toStdString();
+            //     name = voe.GetParamValue("TRIGGER_NUM");
             //     break;
             // 
             // case 123:
-            //     name = GetParamValue(what, "REF_NUM").toStdString();
+            //     name = voe.GetParamValue("REF_NUM");
             //     break;
 
             case 125:
-                name = GetParamValue(what, "SourceName").toStdString();
+                name = voe.GetParamValue("SourceName");
                 prefix = false;
                 break;
 
             case 140:
-                name = GetParamValue(what, "TrigID").toStdString();
+                name = voe.GetParamValue("TrigID");
                 if (name[0]=='-')
                     name.erase(name.begin());
                 break;
@@ -290,8 +429,8 @@ private:
             case 157:
             case 158:
                 {
-                    const string event_id = GetParamValue(what, "event_id").toStdString();
-                    const string run_id   = GetParamValue(what, "run_id").toStdString();
+                    const string event_id = voe.GetParamValue("event_id");
+                    const string run_id   = voe.GetParamValue("run_id");
                     name = event_id+"_"+run_id;
                     break;
                 }
@@ -300,8 +439,8 @@ private:
             case 173:
             case 174:
                 {
-                    const string run_id   = GetParamValue(what, "run_id").toStdString();
-                    const string event_id = GetParamValue(what, "event_id").toStdString();
+                    const string run_id   = voe.GetParamValue("run_id");
+                    const string event_id = voe.GetParamValue("event_id");
                     name = run_id+"_"+event_id;
                     break;
                 }
@@ -312,7 +451,7 @@ private:
                 // case 119:
                 // case 129:
             default:
-                name = GetParamValue(what, "TrigID").toStdString();
+                name = voe.GetParamValue("TrigID");
             }
 
             if (name.empty() || name=="0")
@@ -327,14 +466,14 @@ private:
 
             // ----------------------------------------------------------------
 
-            const string unit = pos2d.attribute("unit").toStdString();
+            const string unit = voe.Get(pos2d+"@unit");
 
-            const double ra  = c1.text().toDouble();
-            const double dec = c2.text().toDouble();
-            const double err = errad.text().toDouble();
+            const double ra  = atof(voe.Get(pos2d+"/Value2/C1").c_str());
+            const double dec = atof(voe.Get(pos2d+"/Value2/C2").c_str());
+            const double err = atof(voe.Get(pos2d+"/Error2Radius").c_str());
 
-            const string n1 = name1.text().toStdString();
-            const string n2 = name2.text().toStdString();
+            const string n1 = voe.Get(pos2d+"/Name1");
+            const string n2 = voe.Get(pos2d+"/Name2");
 
             const bool has_coordinates = n1=="RA" && n2=="Dec" && unit=="deg" && ra!=0 && dec!=0;
 
@@ -401,16 +540,43 @@ private:
                 memcpy(dim.data(),                      &data,        sizeof(ToO::DataGRB));
                 memcpy(dim.data()+sizeof(ToO::DataGRB), name.c_str(), name.size());
 
-                Dim::SendCommandNB("SCHEDULER/GCN", dim);
-                Info("Sent ToO '"+name+"' ["+role+"]");
+                // In a replay, the decision of the scheduler whether
+                // the source is visible is taken here instead
+                bool visible = false;
+                if (!fDryRun)
+                    Dim::SendCommandNB("SCHEDULER/GCN", dim);
+                else
+                {
+                    const CheckVisibility check(VisibilityConditions(), ra, dec, fSolarTable.get());
+                    visible = check.visible;
+                    if (visible)
+                        fVisible++;
+                }
+
+                // Time from the creation of the notice and from the
+                // reception of the message to the decision
+                const Time now;
+                const Time date(voe.Get("Who/Date"));
+
+                ostringstream msg;
+                if (fDryRun)
+                    msg << "Checked ToO '" << name << "' [" << role << "] (" << (visible?"visible":"not visible") << ") after ";
+                else
+                    msg << "Sent ToO '" << name << "' [" << role << "] after ";
+                msg << (now-fRxTime).total_microseconds() << "us";
+                if (date.IsValid())
+                    msg << " (" << (now-date).total_milliseconds()/1000. << "s since notice)";
+                Info(msg);
+
+                fLatency.push_back((now-fRxTime).total_microseconds());
             }
 
-            Out() << Time(date.text().toStdString()).GetAsStr() << " ----- " << sname.text().toStdString() << " [" << role << "]\n";
-            if (!desc.isNull())
-                Out() << "[" << desc.text().toStdString()  << "]\n";
+            Out() << Time(voe.Get("Who/Date")).GetAsStr() << " ----- " << voe.Get("Who/Author/shortName") << " [" << role << "]\n";
+            if (has_desc)
+                Out() << "[" << voe.Get("What/Description")  << "]\n";
             Out() << name << " [" << paket.name << ":" << id << "]: " << paket.description << endl;
             Out() << left;
-            Out() << "  " << setw(5) << "TIME" << "= " << Time(time.text().toStdString()).GetAsStr() << '\n';
+            Out() << "  " << setw(5) << "TIME" << "= " << Time(voe.Get(coord+"/Time/TimeInstant/ISOTime")).GetAsStr() << '\n';
             Out() << "  " << setw(5) << n1     << "= " << ra  << unit << '\n';
             Out() << "  " << setw(5) << n2     << "= " << dec << unit << '\n';
             Out() << "  " << setw(5) << "ERR"  << "= " << err << unit << '\n';
@@ -476,6 +642,8 @@ private:
             return;
         }
 
+        fRxTime = Time();
+
         if (fDebugRx)
         {
             Out() << "------------------------------------------------------\n";
@@ -483,10 +651,9 @@ private:
             Out() << "------------------------------------------------------" << endl;
         }
 
-        QDomDocument doc;
-        if (!doc.setContent(QString(fRxData.data()), false))
+        if (!fEvent.Parse(fRxData.data()))
         {
-            Warn("Parsing of xml failed [0].");
+            Warn("Parsing of xml failed [0]: "+fEvent.GetError());
             Out() << "------------------------------------------------------\n";
             Out() << fRxData.data() << '\n';
             Out() << "------------------------------------------------------" << endl;
@@ -495,9 +662,13 @@ private:
         }
 
         if (fDebugRx)
-            Out() << "Parsed:\n-------\n" << doc.toString().toStdString() << endl;
+        {
+            Out() << "Parsed:\n-------\n";
+            fEvent.Print(Out());
+            Out() << endl;
+        }
 
-        const int rc = ProcessXml(doc.documentElement());
+        const int rc = ProcessXml(fEvent);
         if (rc<0)
         {
             Warn("Parsing of xml failed [1].");
@@ -532,7 +703,7 @@ private:
         if (!rc)
         {
             Out() << "------------------------------------------------------\n";
-            Out() << doc.toString().toStdString() << '\n';
+            Out() << fRxData.data() << '\n';
             Out() << "------------------------------------------------------" << endl;
         }
 
@@ -554,11 +725,93 @@ private:
 
 public:
     ConnectionGCN(ba::io_service& ioservice, MessageImp &imp) : Connection(ioservice, imp()),
-        fIsVerbose(false), fDebugRx(false), fLastKeepAlive(Time::none)
+        fIsVerbose(false), fDebugRx(false), fLastKeepAlive(Time::none), fDryRun(false), fVisible(0)
     {
         SetLogStream(&imp);
     }
 
+    // Process the alerts archived in a gcn.stream file as if they had
+    // just been received, but without sending or archiving them. Instead
+    // of sending a ToO to the scheduler, its visibility check (with the
+    // default conditions) is done here. The time from the reception of
+    // each alert to this decision is reported. The positions of sun and
+    // moon are tabulated in advance as in the scheduler. Scheduling the
+    // ToO in the database is not included.
+    int Replay(const string &filename)
+    {
+        ifstream fin(filename);
+        if (!fin)
+        {
+            Error("Opening '"+filename+"' failed: "+strerror(errno));
+            return 1;
+        }
+
+        fSolarTable = make_shared<const SolarTable>(Time().JD());
+
+        fDryRun  = true;
+        fVisible = 0;
+        fLatency.clear();
+
+        size_t cnt = 0;
+        size_t err = 0;
+
+        string entry;
+        string line;
+        while (1)
+        {
+            const bool eof = !getline(fin, line);
+
+            if (eof || line.compare(0, 10, "----------")==0)
+            {
+                if (entry.find('<')!=string::npos)
+                {
+                    fRxData.assign(entry.begin(), entry.end());
+                    fRxData.push_back(0);
+
+                    fRxTime = Time();
+
+                    if (!fEvent.Parse(fRxData.data()))
+                    {
+                        Warn("Parsing of alert #"+to_string(cnt)+" failed: "+fEvent.GetError());
+                        err++;
+                    }
+                    else
+                        if (ProcessXml(fEvent)<0)
+                        {
+                            Warn("Evaluation of alert #"+to_string(cnt)+" failed.");
+                            err++;
+                        }
+
+                    cnt++;
+                }
+
+                entry.clear();
+
+                if (eof)
+                    break;
+
+                continue;
+            }
+
+            entry += line;
+            entry += '\n';
+        }
+
+        fDryRun = false;
+
+        ostringstream msg;
+        msg << "Replayed " << cnt << " alerts (" << err << " failed), " << fLatency.size() << " ToOs (" << fVisible << " visible now)";
+        if (!fLatency.empty())
+        {
+            sort(fLatency.begin(), fLatency.end());
+            msg << ", reception to decision [us]: median=" << fLatency[fLatency.size()/2];
+            msg << " max=" << fLatency.back();
+        }
+        Info(msg);
+
+        return 0;
+    }
+
     void SetVerbose(bool b)
     {
         fIsVerbose = b;
@@ -730,6 +983,9 @@ public:
 
         fGCN.SetURI(conf.Get<string>("schedule-database"));
 
+        if (conf.Has("replay"))
+            return fGCN.Replay(conf.Get<string>("replay"));
+
         return -1;
     }
 };
@@ -752,6 +1008,7 @@ void SetupConfiguration(Configuration &conf)
         ("addr,a",        vars<string>(),  "Network addresses of GCN server")
         ("quiet,q",       po_bool(true),  "Disable printing contents of all received messages (except dynamic data) in clear text.")
         ("schedule-database", var<string>(), "Database link as in\n\tuser:password@server[:port]/database[?compress=0|1].")
+        ("replay",        var<string>(), "Evaluate the alerts archived in the given file (e.g. gcn.stream) without sending them, check their visibility as the scheduler does, report the reception-to-decision latency and exit.")
         ;
 
     conf.AddOptions(control);
@@ -496,12 +496,7 @@ private:
         // of 320. The effect on the median should be negligible anyhow.
         vector<double> vec(160);
         for (auto it=fCurrentsVec.begin(); it!=fCurrentsVec.end(); it++)
-            for (int i=0; i<320; i++)
-            {
-                const PixelMapEntry &hv = fMap.hv(i);
-                if (hv)
-                    vec[hv.hw()/9] += it->second[i]*hv.count();
-            }
+            fMap.HvToPatchSum(it->second.data(), vec.data());
 
         //fThresholdMin = max(uint16_t(36.0833*pow(avg, 0.638393)+184.037), fThresholdReference);
         //fThresholdMin = max(uint16_t(42.4*pow(avg, 0.642)+182), fThresholdReference);
@@ -9,6 +9,10 @@
 #include "Time.h"
 #include "Splitting.h"
 #include "FileEntry.h"
+#include "Queue.h"
+
+#include <future>
+#include <atomic>
 
 #include <TROOT.h>
 #include <TSystem.h>
@@ -59,6 +63,7 @@ void SetupConfiguration(Configuration &conf)
         ("ignore",        vars<string>(),              "Ignore the given columns")
         ("null,n",        po_switch(),                 "Redirect the root output file to /dev/null (mainly for debugging purposes, e.g. performance studies)")
         ("no-fill",       po_switch(),                 "Do not fill events into the root file (mainly for debugging purposes, e.g. performance studies)")
+        ("threads,j",     var<uint32_t>(uint32_t(0)),  "Number of threads converting the fetched rows (0: number of cores)")
         ;
 
     po::positional_options_description p;
@@ -465,10 +470,208 @@ int finish(Database &connection, const uint16_t &verbose, const bool &profiling,
 
 }
 
+// ------------------------------------------------------------------------
+
+// The rows are fetched from the server by the main thread in blocks. The
+// blocks are converted by a fixed pool of threads and written by a single
+// thread in the order in which they have been fetched. The reference
+// counting of mysqlpp (e.g. of the field names and the field contents)
+// is not thread safe. Therefore, the main thread copies the contents of
+// the fields into the block and the converting thread creates its own
+// mysqlpp::String from them.
+struct Block
+{
+    size_t           nrows;      // number of rows
+    string           data;       // contents of all fields of all rows
+    vector<size_t>   length;     // length of each field in data
+    vector<bool>     isnull;     // field is NULL
+
+    vector<uint64_t> values;     // converted value of each column of each row
+    vector<bool>     valid;      // row contains no NULL field (or --ignore-null)
+    string           text;       // ascii representation (--display, --write)
+    vector<size_t>   eol;        // end of each row in text
+
+    promise<double>  done;       // set by the converting thread
+    future<double>   converted;  // time needed for the conversion
+
+    Block() : nrows(0) { }
+
+    // Copy the contents of the fields of a row
+    void Add(const mysqlpp::Row &row)
+    {
+        for (size_t i=0; i<row.size(); i++)
+        {
+            const mysqlpp::String &col = row[i];
+            if (col.length()>0)
+                data.append(col.data(), col.length());
+            length.push_back(col.length());
+            isnull.push_back(col.is_null());
+        }
+        nrows++;
+    }
+
+    void Clear()
+    {
+        nrows = 0;
+        data.clear();
+        length.clear();
+        isnull.clear();
+    }
+};
+
+// Number of bytes written to the branch address by the conversion
+size_t GetSize(const FileEntry::BasicType_t &type, const bool &accurate)
+{
+    switch (type)
+    {
+    case FileEntry::kBool:
+    case FileEntry::kInt8:
+    case FileEntry::kUInt8:    return accurate ? 1 : sizeof(double);
+    case FileEntry::kInt16:
+    case FileEntry::kUInt16:   return accurate ? 2 : sizeof(double);
+    case FileEntry::kFloat:
+    case FileEntry::kInt32:
+    case FileEntry::kUInt32:
+    case FileEntry::kTime:     return accurate ? 4 : sizeof(double);
+    case FileEntry::kDecimal:
+    case FileEntry::kNumeric:
+    case FileEntry::kDouble:
+    case FileEntry::kInt64:
+    case FileEntry::kUInt64:
+    case FileEntry::kDate:
+    case FileEntry::kDateTime: return 8;
+    default:
+        return 0;
+    }
+}
+
 template<typename T>
-void Convert(FileEntry::Container &container, const mysqlpp::String &col)
+void Convert(uint64_t &val, const mysqlpp::String &col)
 {
-    *reinterpret_cast<T*>(container.ptr) = static_cast<T>(col);
+    *reinterpret_cast<T*>(&val) = static_cast<T>(col);
+}
+
+double ConvertBlock(Block &block, const vector<FileEntry::BasicType_t> &types, const vector<mysqlpp::FieldType> &fields,
+                    const bool &accurate, const bool &ignorenull, const string &delimiter)
+{
+    const auto start = chrono::steady_clock::now();
+
+    const size_t ncols = types.size();
+    const size_t nrows = block.nrows;
+
+    block.values.resize(nrows*ncols);
+    block.valid.assign(nrows, false);
+    block.text.clear();
+    block.eol.clear();
+
+    ostringstream rtxt;
+
+    const char *ptr = block.data.data();
+
+    for (size_t i=0; i<nrows; i++)
+    {
+        // The fields of this row (owned by this thread)
+        vector<mysqlpp::String> row;
+        row.reserve(ncols);
+        for (size_t idx=0; idx<ncols; idx++)
+        {
+            const size_t n = i*ncols+idx;
+            row.emplace_back(ptr, block.length[n], fields[idx], block.isnull[n]);
+            ptr += block.length[n];
+        }
+
+        // Same as mysqlpp::Row::value_list with mysqlpp::do_nothing
+        if (!delimiter.empty())
+        {
+            for (size_t idx=0; idx<ncols; idx++)
+            {
+                if (idx>0)
+                    rtxt << delimiter;
+                rtxt << row[idx];
+            }
+            block.eol.push_back(rtxt.tellp());
+        }
+
+        uint64_t *val = block.values.data()+i*ncols;
+
+        size_t idx=0;
+        for (auto col=row.begin(); col!=row.end(); col++, idx++)
+        {
+            if (!ignorenull && col->is_null())
+                break;
+
+            if (accurate)
+            {
+                // Do an accurate type conversion
+                switch (types[idx])
+                {
+                case FileEntry::kBool:   Convert<bool>    (val[idx], *col); break;
+                case FileEntry::kFloat:  Convert<float>   (val[idx], *col); break;
+                case FileEntry::kDecimal:
+                case FileEntry::kNumeric:
+                case FileEntry::kDouble: Convert<double>  (val[idx], *col); break;
+                case FileEntry::kUInt64: Convert<uint64_t>(val[idx], *col); break;
+                case FileEntry::kInt64:  Convert<int64_t> (val[idx], *col); break;
+                case FileEntry::kUInt32: Convert<uint32_t>(val[idx], *col); break;
+                case FileEntry::kInt32:  Convert<int32_t> (val[idx], *col); break;
+                case FileEntry::kUInt16: Convert<uint16_t>(val[idx], *col); break;
+                case FileEntry::kInt16:  Convert<int16_t> (val[idx], *col); break;
+                case FileEntry::kUInt8:  Convert<uint8_t> (val[idx], *col); break;
+                case FileEntry::kInt8:
+                case FileEntry::kDate:
+                    val[idx] = static_cast<time_t>(mysqlpp::Date(*col));
+                    break;
+                case FileEntry::kDateTime:
+                    val[idx] = static_cast<time_t>(mysqlpp::DateTime(*col));
+                    break;
+                case FileEntry::kTime:
+                    *reinterpret_cast<uint32_t*>(val+idx) = static_cast<time_t>(mysqlpp::Time(*col));
+                    break;
+                default:
+                    break;
+                }
+            }
+            else
+            {
+                // Convert everything to double, no matter what...
+                switch (types[idx])
+                {
+                case FileEntry::kBool:
+                case FileEntry::kFloat:
+                case FileEntry::kDecimal:
+                case FileEntry::kNumeric:
+                case FileEntry::kDouble:
+                case FileEntry::kUInt64:
+                case FileEntry::kInt64:
+                case FileEntry::kUInt32:
+                case FileEntry::kInt32:
+                case FileEntry::kUInt16:
+                case FileEntry::kInt16:
+                case FileEntry::kUInt8:
+                case FileEntry::kInt8:
+                    Convert<double>(val[idx], *col);
+                    break;
+                case FileEntry::kDate:
+                    *reinterpret_cast<double*>(val+idx) = static_cast<time_t>(mysqlpp::Date(*col));
+                    break;
+                case FileEntry::kDateTime:
+                    *reinterpret_cast<double*>(val+idx) = static_cast<time_t>(mysqlpp::DateTime(*col));
+                    break;
+                case FileEntry::kTime:
+                    *reinterpret_cast<double*>(val+idx) = static_cast<time_t>(mysqlpp::Time(*col));
+                    break;
+                default:
+                    break;
+                }
+            }
+        }
+
+        block.valid[i] = idx==row.size();
+    }
+
+    block.text = rtxt.str();
+
+    return chrono::duration<double>(chrono::steady_clock::now()-start).count();
 }
 
 
@@ -502,6 +705,7 @@ int main(int argc, const char* argv[])
     const bool     accurate    = conf.Get<bool>("accurate");
     const uint16_t verbose     = conf.Get<uint16_t>("verbose");
     const uint16_t compression = conf.Get<uint16_t>("compression");
+    const uint32_t numthreads  = conf.Get<uint32_t>("threads");
     const string   delimiter   = conf.Has("delimiter") ? conf.Get<string>("delimiter") : "\t";
 
     const bool copy_all        = conf.Get<bool>("copy-all");
@@ -1002,103 +1206,187 @@ int main(int argc, const char* argv[])
 
     // ---------------------- Fill TTree with DB data --------------------------
 
+    vector<FileEntry::BasicType_t> types;
+    vector<size_t> sizes;
+    for (auto it=container.cbegin(); it!=container.cend(); it++)
+    {
+        types.push_back(it->type);
+        sizes.push_back(GetSize(it->type, accurate));
+    }
+
+    uint32_t nthreads = numthreads==0 ? thread::hardware_concurrency() : numthreads;
+    if (nthreads<1)
+        nthreads = 1;
+
+    vector<mysqlpp::FieldType> fields;
+    for (size_t i=0; i<row.size(); i++)
+        fields.push_back(row[i].type());
+
+    // Blocks which are currently not in use. Blocks are only reused
+    // after they have been written, this limits the memory consumption.
+    list<shared_ptr<Block>> unused;
+    for (uint32_t i=0; i<nthreads+2; i++)
+        unused.emplace_back(make_shared<Block>());
+
+    const bool astext = display || !fout.empty();
+
+    mutex mtx;
+    condition_variable cond;
+
     size_t count = 0;
     size_t skip  = 0;
-    do
-    {
-        size_t index = split.index(count++);
 
-        ostringstream rtxt;
-        if (display || !fout.empty())
-            rtxt << row.value_list(delimiter.c_str(), mysqlpp::do_nothing);
+    atomic<size_t> written(0);
 
-        if (display)
-            cout << rtxt.str() << '\n';
-        if (!fout.empty())
-            fout[index] << rtxt.str() << '\n';
+    double tconv  = 0;
+    double twrite = 0;
 
-        size_t idx=0;
-        for (auto col=row.begin(); col!=row.end(); col++, idx++)
+    string error;
+    atomic<bool> failed(false);
+
+    Queue<shared_ptr<Block>> writer(
+        [&](const shared_ptr<Block> &block)
         {
-            if (!ignorenull && col->is_null())
+            try
             {
-                skip++;
-                break;
+                if (error.empty())
+                {
+                    tconv += block->converted.get();
+
+                    const auto start = chrono::steady_clock::now();
+
+                    size_t beg = 0;
+                    for (size_t i=0; i<block->nrows; i++)
+                    {
+                        const size_t index = split.index(count++);
+
+                        if (display || !fout.empty())
+                        {
+                            const size_t end = block->eol[i];
+
+                            if (display)
+                                cout.write(block->text.data()+beg, end-beg) << '\n';
+                            if (!fout.empty())
+                                fout[index].write(block->text.data()+beg, end-beg) << '\n';
+
+                            beg = end;
+                        }
+
+                        if (!block->valid[i])
+                        {
+                            skip++;
+                            continue;
+                        }
+
+                        // Assign to the memory allocated as branch-address
+                        const uint64_t *val = block->values.data()+i*types.size();
+                        for (size_t idx=0; idx<types.size(); idx++)
+                            memcpy(container[idx].ptr, val+idx, sizes[idx]);
+
+                        if (!nofill)
+                            ttree[index]->Fill();
+                    }
+
+                    twrite += chrono::duration<double>(chrono::steady_clock::now()-start).count();
+
+                    written += block->nrows;
+                }
+            }
+            catch (const exception &e)
+            {
+                error  = e.what();
+                failed = true;
             }
 
-            if (accurate)
+            const lock_guard<mutex> lock(mtx);
+            unused.push_back(block);
+            cond.notify_one();
+
+            return true;
+        });
+
+    // The pool of threads converting the blocks, each of them gets the
+    // blocks in turn
+    vector<unique_ptr<Queue<shared_ptr<Block>>>> converters;
+    for (uint32_t i=0; i<nthreads; i++)
+        converters.emplace_back(new Queue<shared_ptr<Block>>(
+            [&](const shared_ptr<Block> &block)
             {
-                // Do an accurate type conversion and assign to the memory allocated as branch-address
-                switch (container[idx].type)
+                try
                 {
-                case FileEntry::kBool:   Convert<bool>    (container[idx], *col); break;
-                case FileEntry::kFloat:  Convert<float>   (container[idx], *col); break;
-                case FileEntry::kDecimal:
-                case FileEntry::kNumeric:
-                case FileEntry::kDouble: Convert<double>  (container[idx], *col); break;
-                case FileEntry::kUInt64: Convert<uint64_t>(container[idx], *col); break;
-                case FileEntry::kInt64:  Convert<int64_t> (container[idx], *col); break;
-                case FileEntry::kUInt32: Convert<uint32_t>(container[idx], *col); break;
-                case FileEntry::kInt32:  Convert<int32_t> (container[idx], *col); break;
-                case FileEntry::kUInt16: Convert<uint16_t>(container[idx], *col); break;
-                case FileEntry::kInt16:  Convert<int16_t> (container[idx], *col); break;
-                case FileEntry::kUInt8:  Convert<uint8_t> (container[idx], *col); break;
-                case FileEntry::kInt8:   
-                case FileEntry::kDate:
-                    *reinterpret_cast<uint64_t*>(container[idx].ptr) = static_cast<time_t>(mysqlpp::Date(*col));
-                    break;
-                case FileEntry::kDateTime:
-                    *reinterpret_cast<uint64_t*>(container[idx].ptr) = static_cast<time_t>(mysqlpp::DateTime(*col));
-                    break;
-                case FileEntry::kTime:
-                    *reinterpret_cast<uint32_t*>(container[idx].ptr) = static_cast<time_t>(mysqlpp::Time(*col));
-                    break;
-                default:
-                    break;
+                    block->done.set_value(ConvertBlock(*block, types, fields, accurate, ignorenull, astext ? delimiter : ""));
                 }
-            }
-            else
-            {
-                // Convert everything to double, no matter what... and assign to the memory allocated as branch-address
-                switch (container[idx].type)
+                catch (...)
                 {
-                case FileEntry::kBool:
-                case FileEntry::kFloat:
-                case FileEntry::kDecimal:
-                case FileEntry::kNumeric:
-                case FileEntry::kDouble:
-                case FileEntry::kUInt64:
-                case FileEntry::kInt64:
-                case FileEntry::kUInt32:
-                case FileEntry::kInt32:
-                case FileEntry::kUInt16:
-                case FileEntry::kInt16:
-                case FileEntry::kUInt8:
-                case FileEntry::kInt8:
-                    Convert<double>(container[idx], *col);
-                    break;
-                case FileEntry::kDate:
-                    *reinterpret_cast<double*>(container[idx].ptr) = static_cast<time_t>(mysqlpp::Date(*col));
-                    break;
-                case FileEntry::kDateTime:
-                    *reinterpret_cast<double*>(container[idx].ptr) = static_cast<time_t>(mysqlpp::DateTime(*col));
-                    break;
-                case FileEntry::kTime:
-                    *reinterpret_cast<double*>(container[idx].ptr) = static_cast<time_t>(mysqlpp::Time(*col));
-                    break;
-                default:
-                    break;
+                    block->done.set_exception(current_exception());
                 }
-            }
+                return true;
+            }));
+
+    // Number of rows fetched at once and converted by a single thread
+    const size_t blocksize = 10000;
+
+    double tfetch  = 0;
+    size_t fetched = 0;
+    size_t nblocks = 0;
+
+    bool printed = false;
+    auto progress = chrono::steady_clock::now();
+
+    do
+    {
+        shared_ptr<Block> block;
+        {
+            unique_lock<mutex> lock(mtx);
+            while (unused.empty())
+                cond.wait(lock);
+
+            block = unused.front();
+            unused.pop_front();
         }
 
-        if (idx==row.size() && !nofill)
-            ttree[index]->Fill();
+        const auto start = chrono::steady_clock::now();
+
+        block->Clear();
+
+        while (row && block->nrows<blocksize)
+        {
+            block->Add(row);
+            row = res.fetch_row();
+        }
 
-        row = res.fetch_row();
+        const auto now = chrono::steady_clock::now();
 
+        tfetch  += chrono::duration<double>(now-start).count();
+        fetched += block->nrows;
 
-    } while (row);
+        block->done      = promise<double>();
+        block->converted = block->done.get_future();
+
+        converters[nblocks++ % nthreads]->post(block);
+        writer.post(block);
+
+        if (verbose>0 && !display && now-progress>chrono::seconds(1))
+        {
+            cout << "\r" << fetched << " rows fetched, " << written << " rows written..." << flush;
+            progress = now;
+            printed  = true;
+        }
+
+    } while (row && !failed);
+
+    for (auto it=converters.begin(); it!=converters.end(); it++)
+        (*it)->wait();
+    writer.wait();
+
+    if (printed)
+        cout << "\r" << string(60, ' ') << '\r' << flush;
+
+    if (!error.empty())
+    {
+        cerr << "Conversion of row failed: " << error << endl;
+        return 14;
+    }
 
     // -------------------------------------------------------------------------
 
@@ -1113,6 +1401,12 @@ int main(int argc, const char* argv[])
 
         for (size_t i=0; i<ttree.size(); i++)
             cout << ttree[i]->GetEntries() << " rows filled into tree #" << i << "." << endl;
+
+        // Throughput of the individual stages (the conversion time
+        // is summed over all threads)
+        cout << "Fetching:   " << Tools::Fractional(tfetch) << "s (" << Tools::Scientific(tfetch>0?count/tfetch:0) << " rows/s)\n";
+        cout << "Conversion: " << Tools::Fractional(tconv)  << "s (" << Tools::Scientific(tconv >0?count/tconv :0) << " rows/s, " << nthreads << " thread(s))\n";
+        cout << "Writing:    " << Tools::Fractional(twrite) << "s (" << Tools::Scientific(twrite>0?count/twrite:0) << " rows/s)" << endl;
     }
 
     for (auto it=ttree.begin(); it!=ttree.end(); it++)
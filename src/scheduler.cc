@@ -1,4 +1,6 @@
-#include "Prediction.h"
+#include "Visibility.h"
+
+#include <future>
 
 #include <boost/algorithm/string/join.hpp>
 
@@ -21,103 +23,6 @@ using namespace Nova;
 
 // -----------------------------------------------------------------------
 
-enum VisibilityCriterion
-{
-    kMoonMin,
-    kMoonMax,
-    kSunMax,
-    kZenithMax,
-    kCurrentMax,
-    kThresholdMax,
-};
-
-struct VisibilityConditions : map<VisibilityCriterion, float>
-{
-    VisibilityConditions()
-    {
-        operator[](kMoonMin)      =  10;
-        operator[](kMoonMax)      = 170;
-        operator[](kSunMax)       = -12;
-        operator[](kZenithMax)    =  75;
-        operator[](kCurrentMax)   = 110;
-        operator[](kThresholdMax) =  10;
-    }
-};
-
-struct CheckVisibility
-{
-    VisibilityConditions conditions;
-
-    // Output
-    Nova::SolarObjects solarobj;
-    Nova::ZdAzPosn position;
-    Nova::RstTime rst_sun;
-    Nova::RstTime rst_obj;
-
-    int vis_obj = -1;
-
-    double moon_dist   = -1;
-    double current     = -1;
-    double threshold   = -1;
-
-    bool valid_zd        = false;
-    bool valid_current   = false;
-    bool valid_sun       = false;
-    bool valid_moon      = false;
-    bool valid_threshold = false;
-
-    bool visible       = false; // And of all the above except valid_threshold
-
-    void calc(const Nova::EquPosn &equ, const double &jd)
-    {
-        solarobj  = Nova::SolarObjects(jd);
-        position  = Nova::GetHrzFromEqu(equ, jd);
-        moon_dist = Nova::GetAngularSeparation(equ, solarobj.fMoonEqu);
-        rst_sun   = Nova::GetSolarRst(jd, -12);
-        vis_obj   = Nova::GetObjectRst(rst_obj, equ, jd, 90-conditions[kZenithMax]);
-
-        current   = FACT::PredictI(solarobj, equ);
-
-        const double ratio = pow(cos(position.zd*M_PI/180), -2.664);
-
-        threshold = position.zd<90 ? ratio*pow(current/6.2, 0.394) : -1;
-
-        valid_moon      = moon_dist>conditions[kMoonMin] && moon_dist<conditions[kMoonMax];
-        valid_zd        = position.zd<conditions[kZenithMax];
-        valid_sun       = solarobj.fSunHrz.alt<conditions[kSunMax];
-        valid_current   = current<conditions[kCurrentMax];
-        valid_threshold = threshold>0 && threshold<conditions[kThresholdMax];
-
-        visible = valid_moon && valid_zd && valid_sun && valid_current;
-    }
-
-    CheckVisibility(const VisibilityConditions &cond, const Nova::EquPosn &equ, const double &jd) : conditions(cond)
-    {
-        calc(equ, jd);
-    }
-
-    CheckVisibility(const VisibilityConditions &cond, const Nova::EquPosn &equ) : conditions(cond)
-    {
-        calc(equ, Time().JD());
-    }
-
-    CheckVisibility(const VisibilityConditions &cond, const double &ra, const double &dec, const double &jd): conditions(cond)
-    {
-        Nova::EquPosn equ;
-        equ.ra  = ra;
-        equ.dec = dec;
-        calc(equ, jd);
-    }
-
-    CheckVisibility(const VisibilityConditions &cond, const double &ra, const double &dec) : conditions(cond)
-    {
-        Nova::EquPosn equ;
-        equ.ra  = ra;
-        equ.dec = dec;
-        calc(equ, Time().JD());
-    }
-};
-
 /*
 
  * Visibility check
@@ -413,6 +318,8 @@ class StateMachineToO : public StateMachineDim
 {
 private:
     map<uint16_t, VisibilityConditions> fVisibilityCriteria;
+    shared_ptr<const SolarTable> fSolarTable;                // Used for the alerts
+    future<shared_ptr<const SolarTable>> fSolarTableNext;   // Calculated in the background
 
     string   fUri;
     Database fConnection;
@@ -1131,7 +1038,7 @@ private:
         // The []-operator automatically creates a default entry if not yet existing
         auto &conditions = fVisibilityCriteria[grb.type];
 
-        const CheckVisibility check(conditions, grb.ra, grb.dec);
+        const CheckVisibility check(conditions, grb.ra, grb.dec, fSolarTable.get());
 
         Info("Sun altitude:  "+Tools::Form("%5.1f\u00b0   ", check.solarobj.fSunHrz.alt)+(check.valid_sun?"OK    ":"failed")+Tools::Form(" [alt < %5.1f\u00b0]", conditions[kSunMax]));
         if (check.valid_sun)
@@ -1275,6 +1182,24 @@ private:
     int Execute()
     {
         Time now;
+
+        // The positions of sun and moon take a while to calculate. To
+        // not delay the processing of alerts, this is done in a separate
+        // thread, until then the old table (or the full calculation) is used
+        if (fSolarTableNext.valid())
+        {
+            if (fSolarTableNext.wait_for(chrono::seconds(0))==future_status::ready)
+            {
+                fSolarTable = fSolarTableNext.get();
+                Info("Positions of sun and moon calculated for the next 24h.");
+            }
+        }
+        else
+        {
+            if (!fSolarTable || fSolarTable->NeedsUpdate(now.JD()))
+                fSolarTableNext = async(launch::async, [](double jd) { return make_shared<const SolarTable>(jd); }, now.JD());
+        }
+
         if (now>fKeepAliveDeadline)
         {
             static int ernum = 0;
@@ -1,4 +1,7 @@
-#include <boost/regex.hpp>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "Time.h"
 #include "tools.h"
@@ -20,6 +23,7 @@ void SetupConfiguration(Configuration &conf)
         ("verbose,v", var<int16_t>()->implicit_value(true)->default_value(8), "Verbosity level (0:only fatal errors, 8:everything)")
         ("color,c",   po_switch(), "Process a file which already contains color codes")
         ("strip,s",   po_switch(), "Strip color codes completely")
+        ("no-index",  po_switch(), "Do neither read nor write a time index (<file>.idx) to speed up time range queries")
         ;
 
     po::positional_options_description p;
@@ -46,6 +50,11 @@ void PrintUsage()
         "e.g. 20111016 a log with the name /fact/aux/2011/10/16/20111016.log "
         "is read.\n"
         "\n"
+        "If a time range is given, a time index is written next to the "
+        "log-file (<file>.idx). It is used by subsequent calls to skip all "
+        "parts of the file outside of the time range and is extended "
+        "automatically if the file has grown.\n"
+        "\n"
         "Usage: showlog [-c] [-vN] [-b start] [-e end] [file1 ...]\n"
         "  or:  showlog [-c] [-vN] [-b start] [-e end] YYYYMMDD\n";
     cout << endl;
@@ -65,14 +74,250 @@ void PrintHelp()
 }
 
 
-void showlog(string fname, const Time &tbeg, const Time &tend, int16_t severity, bool color, bool strip)
+// ------------------------------------------------------------------------
+
+// Skips up to three digits, at least one, starting at pos
+// @returns the position after the digits or 0 if there is none
+size_t SkipDigits(const string &buffer, size_t pos)
+{
+    size_t n = 0;
+    while (n<3 && pos+n<buffer.size() && isdigit(buffer[pos+n]))
+        n++;
+
+    return n==0 ? 0 : pos+n;
+}
+
+// Remove color codes (e.g. "\x1B[31m" or "\x1B[1;31m") in place. These
+// are the codes matched by the regular expression
+// \x1B\[[0-9]{1,3}(;[0-9]{1,3})?[a-zA-Z] used before, i.e. a plain
+// "\x1B[m" is kept. This is much faster than a regular expression.
+void StripColors(string &buffer)
+{
+    if (buffer.find('\x1B')==string::npos)
+        return;
+
+    const size_t len = buffer.size();
+
+    size_t out = 0;
+    for (size_t i=0; i<len; i++)
+    {
+        if (buffer[i]=='\x1B' && i+1<len && buffer[i+1]=='[')
+        {
+            size_t j = SkipDigits(buffer, i+2);
+            if (j>0 && j<len && buffer[j]==';')
+            {
+                const size_t k = SkipDigits(buffer, j+1);
+                if (k>0)
+                    j = k;
+            }
+
+            if (j>0 && j<len && isalpha(buffer[j]))
+            {
+                i = j;
+                continue;
+            }
+        }
+
+        buffer[out++] = buffer[i];
+    }
+
+    buffer.resize(out);
+}
+
+// Returns the time of day in microseconds of a line of the form
+// " I> 20:00:12.123456 - text" or -1 if no time stamp could be found
+int64_t GetTimeOfDay(const string &buffer)
+{
+    if (buffer.size()<=18)
+        return -1;
+
+    const char *p = buffer.c_str()+4;
+
+    for (int i=0; i<8; i++)
+        if (i%3==2 ? p[i]!=':' : !isdigit(p[i]))
+            return -1;
+
+    const int64_t h = (p[0]-'0')*10 + (p[1]-'0');
+    const int64_t m = (p[3]-'0')*10 + (p[4]-'0');
+    const int64_t s = (p[6]-'0')*10 + (p[7]-'0');
+
+    if (h>23 || m>59 || s>60)
+        return -1;
+
+    int64_t us = 0;
+    if (p[8]=='.')
+    {
+        int64_t scale = 100000;
+        for (int i=9; i<15 && isdigit(p[i]); i++, scale/=10)
+            us += (p[i]-'0')*scale;
+    }
+
+    return ((h*60+m)*60+s)*1000000 + us;
+}
+
+// Removes the color codes from the line (if requested) and returns its
+// time of day (see GetTimeOfDay). It is used for the output and for the
+// index, so that both see the same time stamps.
+int64_t PrepareLine(string &buffer, bool strip)
+{
+    if (strip)
+        StripColors(buffer);
+
+    return GetTimeOfDay(buffer);
+}
+
+// ------------------------------------------------------------------------
+
+// The time index is stored in <file>.idx and contains for each block of
+// consecutive lines within the same minute the offset of its first line.
+// It allows to skip all blocks outside the requested time range. Note that
+// the minutes are not monotonous (the logs cover midnight, files written
+// by the daemons cover several days).
+
+struct IndexHeader
+{
+    char     magic[8];  // kIndexMagic
+    uint64_t size;      // number of bytes of the log file covered by the index
+    uint64_t inode;     // inode of the log file
+    uint64_t hash;      // hash of the beginning and the end of the covered bytes
+    uint64_t strip;     // color codes were removed before reading the time stamps
+};
+
+struct IndexEntry
+{
+    uint64_t offset;   // offset of the first line of the block
+    uint16_t minute;   // minute of the day of the lines in the block
+    uint16_t untimed;  // block contains lines without valid time stamp
+};
+
+// The entries are written to the index file as they are, so the
+// padding bytes are initialized, too
+IndexEntry MakeIndexEntry(uint64_t offset, uint16_t minute, uint16_t untimed)
+{
+    IndexEntry e{};
+    e.offset  = offset;
+    e.minute  = minute;
+    e.untimed = untimed;
+    return e;
+}
+
+static const char kIndexMagic[8] = { 'F', 'A', 'C', 'T', 'L', 'I', 'X', '2' };
+
+// FNV-1a hash of the first and last 4kB of the first size bytes of the
+// log file. The log file is only appended to, so the hash of the covered
+// bytes does not change unless the file was replaced.
+uint64_t HashLog(const char *data, uint64_t size)
+{
+    const uint64_t n = min<uint64_t>(size, 4096);
+
+    uint64_t hash = 14695981039346656037ull;
+    for (const char *p=data; p<data+n; p++)
+        hash = (hash^uint8_t(*p))*1099511628211ull;
+    for (const char *p=data+size-n; p<data+size; p++)
+        hash = (hash^uint8_t(*p))*1099511628211ull;
+
+    return hash;
+}
+
+// Returns the number of bytes of the log file covered by the index,
+// zero if no valid index is available
+uint64_t ReadIndex(const string &fname, const IndexHeader &log, const char *data, vector<IndexEntry> &index)
+{
+    index.clear();
+
+    ifstream fin(fname.c_str(), ios::binary);
+    if (!fin)
+        return 0;
+
+    IndexHeader hdr;
+    fin.read(reinterpret_cast<char*>(&hdr), sizeof(IndexHeader));
+
+    // The log file must not have been truncated or replaced and the time
+    // stamps must have been read in the same way
+    if (!fin || memcmp(hdr.magic, kIndexMagic, 8)!=0 || hdr.size>log.size ||
+        hdr.inode!=log.inode || hdr.strip!=log.strip || hdr.hash!=HashLog(data, hdr.size))
+        return 0;
+
+    IndexEntry entry;
+    while (fin.read(reinterpret_cast<char*>(&entry), sizeof(IndexEntry)))
+        index.push_back(entry);
+
+    if (index.empty() || index[0].offset!=0)
+    {
+        index.clear();
+        return 0;
+    }
+
+    return hdr.size;
+}
+
+// Writing the index is optional, i.e. it fails silently (e.g. if the
+// directory is not writable)
+void WriteIndex(const string &fname, const IndexHeader &hdr, const vector<IndexEntry> &index)
+{
+    const string tmp = fname+".tmp";
+
+    ofstream fout(tmp.c_str(), ios::binary);
+    if (!fout)
+        return;
+
+    fout.write(reinterpret_cast<const char*>(&hdr), sizeof(IndexHeader));
+    fout.write(reinterpret_cast<const char*>(index.data()), index.size()*sizeof(IndexEntry));
+    fout.close();
+
+    if (!fout || rename(tmp.c_str(), fname.c_str())<0)
+        unlink(tmp.c_str());
+}
+
+// ------------------------------------------------------------------------
+
+// The line must have been prepared by PrepareLine which returned its
+// time of day t. Time range [lo;hi] in microseconds of the day
+void ProcessLine(const string &buffer, int64_t t, WindowLog &log, int64_t lo, int64_t hi, int16_t severity, bool strip)
 {
-    // Alternatives
-    // \x1B\[[0-9;]*[mK]
-    // \x1B\[([0-9]{1,2}(;[0-9]{1,2})?)?[m|K]
-    // \x1B\[([0-9]{1,3}((;[0-9]{1,3})*)?)?[m|K]
-    const boost::regex reg("\x1B\[([0-9]{1,3}(;[0-9]{1,3})?[a-zA-Z]");
+    if (buffer.size()==0)
+        return;
+
+    // Lines without valid time stamp are always shown
+    if (t>=0 && (t<lo || t>hi))
+        return;
+
+    if (buffer.size()>1 && !strip)
+    {
+        int16_t lvl = -1;
+        switch (buffer[1])
+        {
+        case ' ': lvl = 7; break; // kDebug
+        case '#': lvl = 6; break; // kComment
+        case '-': lvl = 5; break; // kMessage
+        case '>': lvl = 4; break;
+        case 'I': lvl = 3; break; // kInfo
+        case 'W': lvl = 2; break; // kWarn
+        case 'E': lvl = 1; break; // kError/kAlarm
+        case '!': lvl = 0; break; // kFatal
+        }
+
+        if (lvl>severity)
+            return;
+
+        switch (buffer[1])
+        {
+        case ' ': log << kBlue;          break; // kDebug
+        case '#': log << kDefault;       break; // kComment
+        case '-': log << kDefault;       break; // kMessage
+        case '>': log << kBold;          break;
+        case 'I': log << kGreen;         break; // kInfo
+        case 'W': log << kYellow;        break; // kWarn
+        case 'E': log << kRed;           break; // kError/kAlarm
+        case '!': log << kRed << kBlink; break; // kFatal
+        }
+    }
+
+    (strip?cout:log) << buffer << endl;
+}
 
+void showlog(string fname, const Time &tbeg, const Time &tend, int16_t severity, bool color, bool strip, bool useindex)
+{
     const uint32_t night = atoi(fname.c_str());
     if (night>20000000 && night<21000000 &&to_string(night)==fname)
         fname = Tools::Form("/fact/aux/%04d/%02d/%02d/%d.log",
@@ -81,88 +326,164 @@ void showlog(string fname, const Time &tbeg, const Time &tend, int16_t severity,
     if (!fname.empty())
         cerr << "Reading " << fname << endl;
 
-    ifstream fin(fname.empty() ? "/dev/stdin" : fname.c_str());
-    if (!fin)
-        throw runtime_error(strerror(errno));
+    // The accepted range of the time of day. If the end is before
+    // the begin, both are swapped.
+    const int64_t tb = tbeg.IsValid() ? tbeg.time_of_day().total_microseconds() : -1;
+    const int64_t te = tend.IsValid() ? tend.time_of_day().total_microseconds() : -1;
+
+    int64_t lo = 0;
+    int64_t hi = INT64_MAX;
+    if (tb>=0 && te<0)
+        lo = tb;
+    if (te>=0 && tb<0)
+        hi = te;
+    if (tb>=0 && te>=0)
+    {
+        lo = min(tb, te);
+        hi = max(tb, te);
+    }
+
+    WindowLog log;
 
     string buffer;
 
-    WindowLog log;
+    // Regular files are mapped into memory, pipes are read line by line
+    const int fd = fname.empty() ? -1 : open(fname.c_str(), O_RDONLY);
+
+    struct stat st;
+    if (fd<0 || fstat(fd, &st)<0 || !S_ISREG(st.st_mode) || st.st_size==0)
+    {
+        if (fd>=0)
+            close(fd);
+
+        ifstream fin(fname.empty() ? "/dev/stdin" : fname.c_str());
+        if (!fin)
+            throw runtime_error(strerror(errno));
+
+        while (getline(fin, buffer, '\n'))
+        {
+            const int64_t t = PrepareLine(buffer, color || strip);
+            ProcessLine(buffer, t, log, lo, hi, severity, strip);
+        }
+
+        return;
+    }
+
+    const size_t fsize = st.st_size;
 
-    Time tprev;
+    char *data = static_cast<char*>(mmap(NULL, fsize, PROT_READ, MAP_PRIVATE, fd, 0));
+    close(fd);
 
-    while (getline(fin, buffer, '\n'))
+    if (data==MAP_FAILED)
+        throw runtime_error(strerror(errno));
+
+    madvise(data, fsize, MADV_SEQUENTIAL);
+
+    const char *end = data+fsize;
+
+    // The index is only needed if a time range was requested
+    const bool range = lo>0 || hi<INT64_MAX;
+    const string iname = fname+".idx";
+
+    // Identifies the log file and how its time stamps are read
+    IndexHeader hdr;
+    memcpy(hdr.magic, kIndexMagic, 8);
+    hdr.size  = fsize;
+    hdr.inode = st.st_ino;
+    hdr.hash  = 0;
+    hdr.strip = color || strip;
+
+    vector<IndexEntry> index;
+    const uint64_t indexed = useindex && range ? ReadIndex(iname, hdr, data, index) : 0;
+
+    // Blocks of the index which can contain lines in the time range.
+    // Adjacent blocks are merged.
+    vector<pair<uint64_t, uint64_t>> blocks;
+    for (size_t i=0; i<index.size(); i++)
     {
-        if (color || strip)
-            buffer = boost::regex_replace(buffer, reg, "");
+        const uint64_t first = index[i].offset;
+        const uint64_t last  = i+1<index.size() ? index[i+1].offset : indexed;
 
-        if (buffer.size()==0)
+        const int64_t t0 = int64_t(index[i].minute)*60000000;
+        const int64_t t1 = t0+60000000-1;
+
+        if (!index[i].untimed && (t1<lo || t0>hi))
             continue;
 
-        if (buffer.size()>18)
-        {
-            const string tm = buffer.substr(4, 15);
+        if (!blocks.empty() && blocks.back().second==first)
+            blocks.back().second = last;
+        else
+            blocks.emplace_back(first, last);
+    }
 
-            const Time t("1970-01-01 "+tm);
+    for (auto it=blocks.begin(); it!=blocks.end(); it++)
+    {
+        for (const char *ptr=data+it->first; ptr<data+it->second; )
+        {
+            const char *eol = static_cast<const char*>(memchr(ptr, '\n', data+it->second-ptr));
+            if (!eol)
+                eol = data+it->second;
 
-            if (tbeg.IsValid() && !tend.IsValid() && t<tbeg)
-                continue;
+            buffer.assign(ptr, eol);
 
-            if (tend.IsValid() && !tbeg.IsValid() && t>tend)
-                continue;
+            const int64_t t = PrepareLine(buffer, color || strip);
+            ProcessLine(buffer, t, log, lo, hi, severity, strip);
 
-            if (tbeg.IsValid() && tend.IsValid())
-            {
-                if (tend>tbeg)
-                {
-                    if (t<tbeg)
-                        continue;
-                    if (t>tend)
-                        continue;
-                }
-                else
-                {
-                    if (t>tbeg)
-                        continue;
-                    if (t<tend)
-                        continue;
-                }
-            }
+            ptr = eol+1;
         }
+    }
+
+    // Process everything which is not covered by the index and
+    // extend the index accordingly
+    const size_t nold = index.size();
+
+    uint64_t complete = indexed;
+    for (const char *ptr=data+indexed; ptr<end; )
+    {
+        const char *eol = static_cast<const char*>(memchr(ptr, '\n', end-ptr));
+
+        buffer.assign(ptr, eol ? eol : end);
 
-        if (buffer.size()>1 && !strip)
+        const int64_t t = PrepareLine(buffer, color || strip);
+
+        if (range && useindex)
         {
-            int16_t lvl = -1;
-            switch (buffer[1])
+            if (t<0)
             {
-            case ' ': lvl = 7; break; // kDebug
-            case '#': lvl = 6; break; // kComment
-            case '-': lvl = 5; break; // kMessage
-            case '>': lvl = 4; break;
-            case 'I': lvl = 3; break; // kInfo
-            case 'W': lvl = 2; break; // kWarn
-            case 'E': lvl = 1; break; // kError/kAlarm
-            case '!': lvl = 0; break; // kFatal
+                if (index.size()==nold)
+                    index.push_back(MakeIndexEntry(ptr-data, 0, 1));
+                else
+                    index.back().untimed = 1;
             }
-
-            if (lvl>severity)
-                continue;
-
-            switch (buffer[1])
+            else
             {
-            case ' ': log << kBlue;          break; // kDebug
-            case '#': log << kDefault;       break; // kComment
-            case '-': log << kDefault;       break; // kMessage
-            case '>': log << kBold;          break;
-            case 'I': log << kGreen;         break; // kInfo
-            case 'W': log << kYellow;        break; // kWarn
-            case 'E': log << kRed;           break; // kError/kAlarm
-            case '!': log << kRed << kBlink; break; // kFatal
+                const uint16_t minute = t/60000000;
+                if (index.size()==nold || index.back().minute!=minute || index.back().untimed)
+                    index.push_back(MakeIndexEntry(ptr-data, minute, 0));
             }
+
+            // Only complete lines are indexed (the file might still be written)
+            if (eol)
+                complete = eol+1-data;
         }
 
-        (strip?cout:log) << buffer << endl;
+        ProcessLine(buffer, t, log, lo, hi, severity, strip);
+
+        ptr = eol ? eol+1 : end;
+    }
+
+    // Remove the entries pointing to an incomplete last line
+    while (!index.empty() && index.back().offset>=complete)
+        index.pop_back();
+
+    if (index.size()>nold && !index.empty() && index[0].offset==0)
+    {
+        hdr.size = complete;
+        hdr.hash = HashLog(data, complete);
+        WriteIndex(iname, hdr, index);
     }
+
+    munmap(data, fsize);
 }
 
 int main(int argc, const char* argv[])
@@ -194,10 +515,10 @@ int main(int argc, const char* argv[])
     }
 
     if (files.size()==0)
-        showlog("", tbeg, tend, conf.Get<int16_t>("verbose"), conf.Get<bool>("color"), conf.Get<bool>("strip"));
+        showlog("", tbeg, tend, conf.Get<int16_t>("verbose"), conf.Get<bool>("color"), conf.Get<bool>("strip"), false);
 
     for (auto it=files.begin(); it!=files.end(); it++)
-        showlog(*it, tbeg, tend, conf.Get<int16_t>("verbose"), conf.Get<bool>("color"), conf.Get<bool>("strip"));
+        showlog(*it, tbeg, tend, conf.Get<int16_t>("verbose"), conf.Get<bool>("color"), conf.Get<bool>("strip"), !conf.Get<bool>("no-index"));
 
     return 0;
 }
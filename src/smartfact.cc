@@ -1334,11 +1334,7 @@ private:
 
         // Get the maximum of each patch
         vector<float> val(320, 0);
-        for (int i=0; i<320; i++)
-        {
-            const int idx = (fPixelMap.hv(i).hw()/9)*2+fPixelMap.hv(i).group();
-            val[idx] = ptr[i];
-        }
+        fPixelMap.HvToPatchGroup(ptr, val.data());
 
         // Write the 160 patch values to a file
         WriteCam(d, "cam-biascontrol-current", val, 100);
@@ -1446,15 +1442,7 @@ private:
 
         // Get the maximum of each patch
         vector<float> val(320, 0);
-        for (int i=0; i<320; i++)
-        {
-            const PixelMapEntry &hv = fPixelMap.hv(i);
-            if (!hv)
-                continue;
-
-            const int idx = (hv.hw()/9)*2+hv.group();
-            val[idx] = v[i];
-        }
+        fPixelMap.HvToPatchGroup(v.data(), val.data());
 
         // Write the 160 patch values to a file
         WriteCam(d, "cam-biascontrol-current", val, 1000);
@@ -1502,11 +1490,7 @@ private:
         fBiasControlVoltageMed = stat.med;
 
         vector<float> val(320, 0);
-        for (int i=0; i<320; i++)
-        {
-            const int idx = (fPixelMap.hv(i).hw()/9)*2+fPixelMap.hv(i).group();
-            val[idx] = fBiasControlVoltageVec[i];
-        }
+        fPixelMap.HvToPatchGroup(fBiasControlVoltageVec.data(), val.data());
 
         if (fDimBiasControl.state()==BIAS::State::kVoltageOn || fDimBiasControl.state()==BIAS::State::kRamping)
             WriteCam(d, "cam-biascontrol-voltage", val, 10, 65);
@@ -1989,11 +1973,7 @@ private:
         //const float rms = d.Get<float>(322*4);
 
         vector<double> tout(320);
-        for (int i=0; i<320; i++)
-        {
-            const int idx = (fPixelMap.hv(i).hw()/9)*2+fPixelMap.hv(i).group();
-            tout[idx] = ptr[i];
-        }
+        fPixelMap.HvToPatchGroup(ptr, tout.data());
 
         WriteCam(d, "cam-fsccontrol-temperature", tout, 3, avg-1.75);
 
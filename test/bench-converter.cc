@@ -0,0 +1,97 @@
+// **************************************************************************
+//
+// Microbenchmark of the Converter
+//
+// Times the outputs of the compiled format plan (text, boost::any, JSON,
+// typed spans, FITS rows, strings) for the formats of frequently logged
+// FACT services.
+//
+// Usage: bench-converter [iterations]
+//
+// **************************************************************************
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+
+#include "Converter.h"
+
+using namespace std;
+
+template<class F>
+double Measure(size_t n, F func)
+{
+    const auto start = chrono::steady_clock::now();
+    for (size_t i=0; i<n; i++)
+        func();
+    const auto stop = chrono::steady_clock::now();
+
+    return chrono::duration<double, micro>(stop-start).count()/n;
+}
+
+int main(int argc, const char *argv[])
+{
+    const size_t n = argc>1 ? atol(argv[1]) : 1000;
+
+    const pair<const char*, const char*> formats[] =
+    {
+        { "FEEDBACK/CALIBRATED_CURRENTS", "F:416;F:1;F:1;F:1;F:1;I:1;F:1;F:416;F:1;F:1" },
+        { "FTM_CONTROL/TRIGGER_RATES",    "X:1;X:1;I:1;F:1;F:40;F:160;F:1;F:1"          },
+        { "FAD_CONTROL/EVENT_DATA",       "I:1;I:1;F:1440;F:1440;F:1440;F:1440"         },
+        { "BIAS_CONTROL/VOLTAGE",         "F:416"                                       },
+        { "DRIVE_CONTROL/POINTING_POSITION", "D:1;D:1"                                  },
+        { "MAGIC_WEATHER/DATA",           "S:1;F:1;F:1;F:1;F:1;F:1;F:1;F:1"             },
+        { "SERVER/MESSAGE",               "C"                                           },
+    };
+
+    cout << "Service                          GetString  GetAny GetJson GetSpans ToFits ToStrings [us]" << endl;
+
+    for (const auto &f : formats)
+    {
+        const Converter conv(f.second);
+
+        // A string (if any) is the last element
+        const string text = "Some message as logged by every server";
+        const bool str = f.second[strlen(f.second)-1]=='C';
+
+        vector<char> data(conv.GetSize());
+        if (str)
+            data.insert(data.end(), text.c_str(), text.c_str()+text.size()+1);
+
+        // Fill the numbers with values of a typical magnitude
+        for (const Converter::Span &span : conv.GetSpans(data.data(), data.size()))
+        {
+            char *p = data.data() + (static_cast<const char*>(span.ptr)-data.data());
+            for (uint32_t i=0; i<span.count; i++)
+            {
+                switch (span.type)
+                {
+                case 'F': reinterpret_cast<float*>  (p)[i] = 12.345f*(i+1); break;
+                case 'D': reinterpret_cast<double*> (p)[i] = 123.456789*(i+1); break;
+                case 'I': reinterpret_cast<int32_t*>(p)[i] = 1000+i; break;
+                case 'S': reinterpret_cast<int16_t*>(p)[i] = 100+i; break;
+                case 'X': reinterpret_cast<int64_t*>(p)[i] = 1000000+i; break;
+                }
+            }
+        }
+
+        const void  *ptr  = data.data();
+        const size_t size = data.size();
+
+        vector<char> fits(size);
+
+        const double tstr  = Measure(n, [&]() { conv.GetString(ptr, size); });
+        const double tany  = Measure(n, [&]() { conv.GetAny(ptr, size);    });
+        const double tjson = Measure(n, [&]() { conv.GetJson(ptr, size);   });
+        const double tspan = Measure(n, [&]() { conv.GetSpans(ptr, size);  });
+
+        // Strings have no fixed size in a FITS row
+        const double tfits = str ? 0 : Measure(n, [&]() { conv.ToFits(fits.data(), ptr, size); });
+        const double tvec  = Measure(n, [&]() { conv.ToStrings(ptr); });
+
+        cout << setw(32) << left << f.first << right << fixed << setprecision(2)
+            << setw(10) << tstr << setw(8) << tany << setw(8) << tjson
+            << setw(9) << tspan << setw(7) << tfits << setw(10) << tvec << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,286 @@
+// **************************************************************************
+//
+// Benchmark of the SSE2 kernels of DrsCalibrate
+//
+// Times RemoveSpikes4, SlidingAverage, GetPixelStats and GetPixelMax for
+// 1440 pixels against the plain scalar loops they replaced, for a region
+// of interest of 300 and 1024 samples. The data is random noise with
+// spikes, NaNs and signed zeros. The program fails if any output is not
+// bit-identical to the output of the scalar loops.
+//
+// Usage: bench-drscalib [events]
+//
+// **************************************************************************
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <iostream>
+
+#include "externals/DrsCalib.h"
+
+using namespace std;
+
+// The scalar loops as they were before the SSE2 versions
+namespace Scalar
+{
+    void RemoveSpikes4(float *ptr, uint32_t roi)
+    {
+        if (roi<7)
+            return;
+
+        for (uint32_t i=0; i<roi-6; i++)
+        {
+            double d10, d21, d32, d43, d54;
+
+            d43 = ptr[i+4]-ptr[i+3];
+            d54 = ptr[i+5]-ptr[i+4];
+
+            if ((d43>35 && -d54>35) || (d43<-35 && -d54<-35))
+            {
+                ptr[i+4] = (ptr[i+3]+ptr[i+5])/2;
+            }
+
+            d32 = ptr[i+3]-ptr[i+2];
+            d54 = ptr[i+5]-ptr[i+4];
+
+            if (d32>9 && -d54>13 && d32-d54>31)
+            {
+                double avg0 = (ptr[i+2]+ptr[i+5])/2;
+                double avg1 = (ptr[i+3]+ptr[i+4])/2;
+
+                ptr[i+3] = ptr[i+3] - avg1+avg0;
+                ptr[i+4] = ptr[i+4] - avg1+avg0;
+            }
+
+            d21 = ptr[i+2]-ptr[i+1];
+            d54 = ptr[i+5]-ptr[i+4];
+
+            if (d21>15 && -d54>17)
+            {
+                double avg0 = (ptr[i+1]+ptr[i+5])/2;
+                double avg1 = (ptr[i+2]+ptr[i+3]+ptr[i+4])/3;
+
+                ptr[i+2] = ptr[i+2] - avg1+avg0;
+                ptr[i+3] = ptr[i+3] - avg1+avg0;
+                ptr[i+4] = ptr[i+4] - avg1+avg0;
+            }
+
+            d10 = ptr[i+1]-ptr[i];
+            d54 = ptr[i+5]-ptr[i+4];
+
+            if (d10>18 && -d54>20)
+            {
+                double avg0 = (ptr[i]+ptr[i+5])/2;
+                double avg1 = (ptr[i+1]+ptr[i+2]+ptr[i+3]+ptr[i+4])/4;
+
+                ptr[i+1] = ptr[i+1] - avg1+avg0;
+                ptr[i+2] = ptr[i+2] - avg1+avg0;
+                ptr[i+3] = ptr[i+3] - avg1+avg0;
+                ptr[i+4] = ptr[i+4] - avg1+avg0;
+            }
+        }
+    }
+
+    void SlidingAverage(float *const vec, const uint32_t roi, const uint16_t w)
+    {
+        if (w==0 || w>roi)
+            return;
+
+        for (float *pix=vec; pix<vec+1440*roi; pix += roi)
+        {
+            for (float *ptr=pix; ptr<pix+roi-w; ptr++)
+            {
+                for (float *p=ptr+1; p<ptr+w; p++)
+                    *ptr += *p;
+                *ptr /= w;
+            }
+        }
+    }
+
+    double GetPixelStats(float *ptr, const float *data, uint16_t roi, uint16_t begskip=0, uint16_t endskip=0)
+    {
+        if (roi==0)
+            return -1;
+
+        const uint beg = roi>begskip ? begskip : 0;
+        const uint end = roi-beg>endskip ? roi-endskip : roi;
+        const uint len = end-beg;
+
+        double max = 0;
+        double patch = 0;
+        for (uint i=0; i<1440; i++)
+        {
+            const float *vec = data+i*roi;
+
+            uint   pos  = beg;
+            double sum  = vec[beg];
+            double sum2 = vec[beg]*vec[beg];
+
+            for (uint j=beg+1; j<end; j++)
+            {
+                sum  += vec[j];
+                sum2 += vec[j]*vec[j];
+
+                if (vec[j]>vec[pos])
+                    pos = j;
+            }
+            sum  /= len;
+            sum2 /= len;
+            sum2 -= sum*sum;
+
+            if (i%9!=8)
+                patch += vec[pos];
+            else
+            {
+                if (patch > max)
+                    max = patch;
+                patch = 0;
+            }
+
+            *(ptr+0*1440+i) = sum;
+            *(ptr+1*1440+i) = sum2<0 ? 0 : sqrt(sum2);
+            *(ptr+2*1440+i) = vec[pos];
+            *(ptr+3*1440+i) = pos;
+        }
+
+        return max/8;
+    }
+
+    void GetPixelMax(float *max, const float *data, uint16_t roi, int32_t first, int32_t last)
+    {
+        if (roi==0 || first<0 || last<0 || first>=roi || last>=roi || last<first)
+            return;
+
+        for (int i=0; i<1440; i++)
+        {
+            const float *beg = data+i*roi+first;
+            const float *end = data+i*roi+last;
+
+            const float *pmax = beg;
+
+            for (const float *ptr=beg+1; ptr<=end; ptr++)
+                if (*ptr>*pmax)
+                    pmax = ptr;
+
+            max[i] = *pmax;
+        }
+    }
+}
+
+// Noise with a baseline, pulses and spikes of one to four samples,
+// some NaNs and signed zeros
+vector<float> Simulate(mt19937 &rnd, uint16_t roi)
+{
+    normal_distribution<float>    noise(0, 3);
+    uniform_int_distribution<int> dice(0, 999);
+
+    vector<float> data(1440*roi);
+    for (size_t i=0; i<data.size(); i++)
+    {
+        const int j = i%roi;
+
+        data[i] = noise(rnd) + (j>100 && j<115 ? 50 : 0);
+
+        const int d = dice(rnd);
+        if (d<10)
+            for (int k=0; k<=d%4 && i+k<data.size(); k++)
+                data[i+k] += d%2 ? 60 : -40;
+        if (d==10)
+            data[i] = NAN;
+        if (d==11)
+            data[i] = -0.f;
+    }
+
+    return data;
+}
+
+bool Identical(const vector<float> &a, const vector<float> &b)
+{
+    return memcmp(a.data(), b.data(), a.size()*sizeof(float))==0;
+}
+
+int main(int argc, const char *argv[])
+{
+    const size_t nevts = argc>1 ? atol(argv[1]) : 100;
+
+    mt19937 rnd(0);
+
+    bool ok = true;
+
+    cout << "Time per event [ms] (scalar -> SSE2)\n" << endl;
+    cout << " roi   RemoveSpikes4  SlidingAverage   GetPixelStats     GetPixelMax" << endl;
+
+    for (const uint16_t roi : { uint16_t(300), uint16_t(1024) })
+    {
+        double t[4][2] = { { 0 } };
+
+        for (size_t evt=0; evt<nevts; evt++)
+        {
+            const vector<float> data = Simulate(rnd, roi);
+
+            vector<float> v0 = data;
+            vector<float> v1 = data;
+
+            auto t0 = chrono::steady_clock::now();
+            for (uint i=0; i<1440; i++)
+                Scalar::RemoveSpikes4(v0.data()+i*roi, roi);
+            auto t1 = chrono::steady_clock::now();
+            for (uint i=0; i<1440; i++)
+                DrsCalibrate::RemoveSpikes4(v1.data()+i*roi, roi);
+            auto t2 = chrono::steady_clock::now();
+
+            t[0][0] += chrono::duration<double, milli>(t1-t0).count();
+            t[0][1] += chrono::duration<double, milli>(t2-t1).count();
+            ok &= Identical(v0, v1);
+
+            vector<float> s0(4*1440);
+            vector<float> s1(4*1440);
+
+            t0 = chrono::steady_clock::now();
+            const double m0 = Scalar::GetPixelStats(s0.data(), v0.data(), roi, 10, 10);
+            t1 = chrono::steady_clock::now();
+            const double m1 = DrsCalibrate::GetPixelStats(s1.data(), v1.data(), roi, 10, 10);
+            t2 = chrono::steady_clock::now();
+
+            t[2][0] += chrono::duration<double, milli>(t1-t0).count();
+            t[2][1] += chrono::duration<double, milli>(t2-t1).count();
+            ok &= Identical(s0, s1) && memcmp(&m0, &m1, sizeof(double))==0;
+
+            vector<float> x0(1440);
+            vector<float> x1(1440);
+
+            t0 = chrono::steady_clock::now();
+            Scalar::GetPixelMax(x0.data(), v0.data(), roi, 10, roi-10);
+            t1 = chrono::steady_clock::now();
+            DrsCalibrate::GetPixelMax(x1.data(), v1.data(), roi, 10, roi-10);
+            t2 = chrono::steady_clock::now();
+
+            t[3][0] += chrono::duration<double, milli>(t1-t0).count();
+            t[3][1] += chrono::duration<double, milli>(t2-t1).count();
+            ok &= Identical(x0, x1);
+
+            t0 = chrono::steady_clock::now();
+            Scalar::SlidingAverage(v0.data(), roi, 8);
+            t1 = chrono::steady_clock::now();
+            DrsCalibrate::SlidingAverage(v1.data(), roi, 8);
+            t2 = chrono::steady_clock::now();
+
+            t[1][0] += chrono::duration<double, milli>(t1-t0).count();
+            t[1][1] += chrono::duration<double, milli>(t2-t1).count();
+            ok &= Identical(v0, v1);
+        }
+
+        cout << setw(4) << roi << fixed << setprecision(1);
+        for (int i=0; i<4; i++)
+            cout << setw(8) << t[i][0]/nevts << " -> " << setw(4) << t[i][1]/nevts;
+        cout << endl;
+    }
+
+    if (!ok)
+    {
+        cerr << "\nThe results of the SSE2 versions differ from the scalar loops." << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,131 @@
+// **************************************************************************
+//
+// Benchmark of the preparation of the ADC display of the GUI (fact)
+//
+// Times PrepareEventTrace, which runs in the decoder thread, and (if
+// compiled with root) the filling of the histograms in the GUI thread
+// with the per-sample loops used before compared to handing over the
+// prepared bins. Both ways must result in identical bin contents.
+//
+// Usage: bench-eventtrace [iterations]
+//
+// **************************************************************************
+#include <chrono>
+#include <vector>
+#include <random>
+#include <iostream>
+
+#include "gui/EventTrace.h"
+
+#ifdef HAVE_ROOT
+#include "TH1.h"
+#endif
+
+using namespace std;
+
+template<class F>
+double Measure(size_t n, F func)
+{
+    const auto start = chrono::steady_clock::now();
+    for (size_t i=0; i<n; i++)
+        func(i);
+    const auto stop = chrono::steady_clock::now();
+
+    return chrono::duration<double, micro>(stop-start).count()/n;
+}
+
+int main(int argc, const char *argv[])
+{
+    const size_t n   = argc>1 ? atol(argv[1]) : 1000;
+    const int    roi = 1024;
+
+    // Event and calibration as published by fadctrl
+    vector<char> buffer(sizeof(EVENT)+roi*4*1440+roi*4*160);
+    EVENT &evt = *reinterpret_cast<EVENT*>(buffer.data());
+
+    const shared_ptr<vector<float>> calib = make_shared<vector<float>>(1440*1024*6+160*1024*2);
+
+    mt19937 rnd(0);
+    uniform_real_distribution<float> dist(-1000, 2000);
+
+    evt.Roi = roi;
+    for (int i=0; i<1440; i++)
+        evt.StartPix[i] = (i*37)%1024;
+
+    float *adc = reinterpret_cast<float*>(evt.Adc_Data);
+    for (int i=0; i<roi*1440; i++)
+        adc[i] = dist(rnd);
+
+    for (auto &c : *calib)
+        c = dist(rnd);
+
+    const shared_ptr<const vector<float>> cal = calib;
+
+    for (int physical=0; physical<2; physical++)
+    {
+        const double prep = Measure(n, [&](size_t i)
+        {
+            PrepareEventTrace(evt, i%1440, physical, cal);
+        });
+
+        cout << (physical?"physical":"logical ") << "  PrepareEventTrace: " << prep << "us" << endl;
+
+#ifdef HAVE_ROOT
+        const int p     = 123;
+        const int start = evt.StartPix[p];
+        const int nbins = physical ? 1024 : roi;
+
+        TH1F h0("h0", "", nbins, -0.5, nbins-0.5);
+        TH1F d0("d0", "", nbins, -0.5, nbins-0.5);
+        h0.SetDirectory(0);
+        d0.SetDirectory(0);
+
+        // As done by FactGui::DisplayEventData before
+        const double loop = Measure(n, [&](size_t)
+        {
+            h0.Reset();
+            d0.Reset();
+            d0.SetEntries(0);
+            for (int i=0; i<roi; i++)
+            {
+                const int ii = physical ? (i+start)%1024 : i;
+                h0.Fill(ii, adc[p*roi+i]);
+                d0.SetBinContent(ii+1, (*cal)[p*1024+(start+i)%1024]);
+                d0.SetBinError(ii+1,   (*cal)[1440*1024+p*1024+(start+i)%1024]);
+            }
+        });
+
+        const shared_ptr<EventTrace> trace = PrepareEventTrace(evt, p, physical, cal);
+
+        TH1F h1("h1", "", nbins, -0.5, nbins-0.5);
+        TH1F d1("d1", "", nbins, -0.5, nbins-0.5);
+        h1.SetDirectory(0);
+        d1.SetDirectory(0);
+
+        const double set = Measure(n, [&](size_t)
+        {
+            h1.SetContent(trace->adc.data());
+            h1.SetEntries(trace->roi);
+            d1.SetContent(trace->calib[0].data());
+            d1.SetError(trace->calib[1].data());
+            d1.SetEntries(trace->roi);
+        });
+
+        cout << (physical?"physical":"logical ") << "  Fill loops:        " << loop << "us" << endl;
+        cout << (physical?"physical":"logical ") << "  SetContent:        " << set  << "us" << endl;
+
+        for (int i=0; i<nbins+2; i++)
+        {
+            if (h0.GetBinContent(i)!=h1.GetBinContent(i) ||
+                d0.GetBinContent(i)!=d1.GetBinContent(i) ||
+                d0.GetBinError(i)  !=d1.GetBinError(i))
+            {
+                cerr << "Bin " << i << " differs." << endl;
+                return 1;
+            }
+        }
+#endif
+    }
+
+    return 0;
+}
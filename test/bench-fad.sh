@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# ==========================================================================
+# Benchmark of the event builder of fadctrl
+#
+# Starts a dim dns, the board emulator (fad) with 40 boards and fadctrl
+# connected to the emulated boards. The boards send events at the given
+# rate as long as fadctrl has their trigger lines enabled (see
+# bench-fad.dim). fadctrl prints the statistics of the event builder
+# (rate, cpu load, queue sizes and latencies) every stat-interval seconds.
+#
+# Usage: bench-fad.sh [rate [jitter [duration [stat-interval]]]]
+#
+#   rate           Trigger rate [Hz] (default: 100)
+#   jitter         Maximum random delay of each board [us] (default: 100)
+#   duration       Duration of the measurement [s] (default: 60)
+#   stat-interval  Interval of the statistics [s] (default: 10)
+#
+# The programs are taken from the directory in BIN (default: the current
+# directory), the script from the directory of this file.
+# ==========================================================================
+
+RATE=${1:-100}
+JITTER=${2:-100}
+DURATION=${3:-60}
+INTERVAL=${4:-10}
+
+BIN=${BIN:-.}
+DIR=`dirname "$0"`
+
+PORT=5000
+
+export DIM_DNS_NODE=localhost
+export DIM_HOST_NODE=127.0.0.1
+
+DATA=`mktemp -d`
+
+$BIN/dns > /dev/null 2>&1 &
+DNS=$!
+
+sleep 1
+
+$BIN/fad --port $PORT --num 40 --rate $RATE --jitter $JITTER --static-data > /dev/null &
+FAD=$!
+
+$BIN/fadctrl --console=1 --quit \
+   --debug-addr localhost:$PORT --debug-num 40 --start \
+   --stat-interval $INTERVAL --destination-folder $DATA \
+   --arg:duration=$((DURATION*1000)) --exec $DIR/bench-fad.dim
+RC=$?
+
+kill $FAD $DNS
+rm -rf $DATA
+
+exit $RC
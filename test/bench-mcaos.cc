@@ -0,0 +1,106 @@
+// **************************************************************************
+//
+// Benchmark of the ring fit of MCaos
+//
+// Synthetic frames: eight leds on a ring (radius 237.6 px, 0.3 px noise)
+// and up to five false led candidates in each search box around the leds
+// (recorded frames are not available). The centre is fitted with all
+// triples of leds (exhaustive) and with the RANSAC selection of the leds
+// on the ring, which is used for more than SetMaxExhaustive leds. The
+// mean distance from the true centre and the time per frame are printed.
+// The program fails if the RANSAC fit is less accurate than the
+// exhaustive one.
+//
+// Usage: bench-mcaos [frames]
+//
+// **************************************************************************
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <algorithm>
+#include <iostream>
+
+#include "MCaos.h"
+
+using namespace std;
+
+int main(int argc, const char *argv[])
+{
+    const size_t nframes = argc>1 ? atol(argv[1]) : 100;
+
+    const double cx = 384;
+    const double cy = 288;
+    const double r  = 237.6;
+
+    // Size of the search boxes of MCaos
+    const double box = 19;
+
+    mt19937 rnd(0);
+    normal_distribution<double>       noise(0, 0.3);
+    uniform_real_distribution<double> offset(-box, box);
+
+    MCaos exhaustive;
+    exhaustive.SetMinNumberLeds(3);
+    exhaustive.SetMaxExhaustive(UINT16_MAX);
+
+    MCaos ransac;
+    ransac.SetMinNumberLeds(3);
+
+    cout << "False       Exhaustive               RANSAC" << endl;
+    cout << "candidates  [px]   [ms/frame]        [px]   [ms/frame]" << endl;
+
+    bool ok = true;
+
+    for (const int nfalse : { 0, 8, 16, 24, 40 })
+    {
+        double dev[2]  = { 0, 0 };
+        double time[2] = { 0, 0 };
+
+        for (size_t frame=0; frame<nframes; frame++)
+        {
+            vector<Led> leds;
+            for (int i=0; i<8; i++)
+            {
+                const double phi = i*M_PI/4;
+                leds.emplace_back(cx+r*cos(phi)+noise(rnd), cy+r*sin(phi)+noise(rnd), phi, 100);
+            }
+
+            for (int i=0; i<nfalse; i++)
+            {
+                const Led &led = leds[i%8];
+                leds.emplace_back(led.GetX()+offset(rnd), led.GetY()+offset(rnd), led.GetPhi(), 100);
+            }
+
+            shuffle(leds.begin(), leds.end(), rnd);
+
+            MCaos *caos[2] = { &exhaustive, &ransac };
+            for (int i=0; i<2; i++)
+            {
+                vector<Led> copy = leds;
+
+                const auto t0 = chrono::steady_clock::now();
+                caos[i]->CalcRings(copy, 236.7, 238.6);
+                const auto t1 = chrono::steady_clock::now();
+
+                const Ring &center = caos[i]->GetCenter();
+
+                dev[i]  += hypot(center.GetX()-cx, center.GetY()-cy);
+                time[i] += chrono::duration<double, milli>(t1-t0).count();
+            }
+        }
+
+        cout << setw(10) << nfalse << fixed
+            << setw(8) << setprecision(2) << dev[0]/nframes << setw(11) << setprecision(3) << time[0]/nframes
+            << setw(14) << setprecision(2) << dev[1]/nframes << setw(11) << setprecision(3) << time[1]/nframes << endl;
+
+        ok &= dev[1]<=dev[0];
+    }
+
+    if (!ok)
+    {
+        cerr << "\nThe RANSAC fit is less accurate than the exhaustive one." << endl;
+        return 1;
+    }
+
+    return 0;
+}
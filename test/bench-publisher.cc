@@ -0,0 +1,129 @@
+// **************************************************************************
+//
+// Publisher for the benchmark of subscriptions in dimctrl
+//
+// Publishes three described services with the formats of the large
+// services subscribed by the scripts at a fixed rate:
+//
+//   BENCH_PUBLISHER/CALIBRATED_CURRENTS  (as FEEDBACK/CALIBRATED_CURRENTS)
+//   BENCH_PUBLISHER/TRIGGER_RATES        (as FTM_CONTROL/TRIGGER_RATES)
+//   BENCH_PUBLISHER/PIXEL                (F:1440, e.g. FAD_CONTROL/EVENT_DATA)
+//
+// Start it before test/bench-subscription.js is executed by dimctrl. The
+// number of updates published is printed every ten seconds, so that it
+// can be compared with the number of events handled by the script.
+//
+// Usage: bench-publisher [rate [dns]]
+//
+//   rate  Updates per second and service (default: 1000)
+//   dns   Address of the dim dns (default: DIM_DNS_NODE)
+//
+// **************************************************************************
+#include <chrono>
+#include <thread>
+#include <iostream>
+
+#include "Dim.h"
+#include "DimDescriptionService.h"
+
+using namespace std;
+
+int main(int argc, const char *argv[])
+{
+    const double rate = argc>1 ? atof(argv[1]) : 1000;
+
+    if (argc>2)
+        Dim::Setup(argv[2]);
+
+    struct Currents
+    {
+        float    I[416];
+        float    I_avg, I_rms, I_med, I_dev;
+        uint32_t N;
+        float    T_diff;
+        float    U_ov[416];
+        float    U_nom;
+        float    dU_temp;
+    } __attribute__((__packed__));
+
+    struct Rates
+    {
+        uint64_t timestamp;
+        uint64_t ontime;
+        uint32_t trigger_counter;
+        float    trigger_rate;
+        float    board_rate[40];
+        float    patch_rate[160];
+        float    elapsed_time;
+        float    old_trigger_rate;
+    } __attribute__((__packed__));
+
+    DimDescribedService currents("BENCH_PUBLISHER/CALIBRATED_CURRENTS", "F:416;F:1;F:1;F:1;F:1;I:1;F:1;F:416;F:1;F:1",
+                                 "Calibrated currents"
+                                 "|I[uA]:Calibrated currents per pixel"
+                                 "|I_avg[uA]:Average calibrated current (N channels)"
+                                 "|I_rms[uA]:Rms of calibrated current (N channels)"
+                                 "|I_med[uA]:Median calibrated current (N channels)"
+                                 "|I_dev[uA]:Deviation of calibrated current (N channels)"
+                                 "|N[uint16]:Number of valid values"
+                                 "|T_diff[s]:Time difference to calibration"
+                                 "|U_ov[V]:Calculated overvoltage w.r.t. operation voltage"
+                                 "|U_nom[V]:Nominal overvoltage w.r.t. operation voltage"
+                                 "|dU_temp[V]:Correction calculated from temperature");
+
+    DimDescribedService rates("BENCH_PUBLISHER/TRIGGER_RATES", "X:1;X:1;I:1;F:1;F:40;F:160;F:1;F:1",
+                              "Trigger rates"
+                              "|FTMtimeStamp[us]:Time in microseconds"
+                              "|OnTimeCounter[us]:Effective on-time"
+                              "|TriggerCounter[int]:Counter of triggers"
+                              "|TriggerRate[Hz]:Trigger rate"
+                              "|BoardRate[Hz]:Trigger rate of individual FTUs"
+                              "|PatchRate[Hz]:Trigger rate of individual patches"
+                              "|ElapsedTime[sec]:Time elapsed since previous report"
+                              "|OldTriggerRate[Hz]:Trigger rate of previous report");
+
+    DimDescribedService pixel("BENCH_PUBLISHER/PIXEL", "F:1440",
+                              "One value per pixel"
+                              "|Data[au]:Value per pixel");
+
+    DimServer::start("BENCH_PUBLISHER");
+
+    Currents c;
+    Rates    r;
+    vector<float> p(1440);
+
+    memset(&c, 0, sizeof(Currents));
+    memset(&r, 0, sizeof(Rates));
+
+    const auto interval = chrono::nanoseconds(rate>0 ? int64_t(1e9/rate) : 0);
+
+    auto next  = chrono::steady_clock::now();
+    auto print = next+chrono::seconds(10);
+
+    for (uint64_t n=1; ; n++)
+    {
+        for (int i=0; i<416; i++)
+            c.I[i] = c.U_ov[i] = n+i*0.1;
+        for (int i=0; i<160; i++)
+            r.patch_rate[i] = n+i;
+        for (int i=0; i<1440; i++)
+            p[i] = n+i*0.01;
+
+        r.trigger_counter = n;
+
+        currents.Update(c);
+        rates.Update(r);
+        pixel.Update(p);
+
+        if (chrono::steady_clock::now()>=print)
+        {
+            cout << n << " updates published." << endl;
+            print += chrono::seconds(10);
+        }
+
+        next += interval;
+        this_thread::sleep_until(next);
+    }
+
+    return 0;
+}
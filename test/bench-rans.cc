@@ -0,0 +1,143 @@
+// **************************************************************************
+//
+// Benchmark of the entropy coders of zofits (kFactHuffman16, kFactRans16)
+//
+// Compresses the events of a raw data file (column Data, with and
+// without kFactSmoothing) event by event and reports the compression
+// ratio and the speed of compression and decompression in MB/s. Without
+// a file, simulated noisy waveforms with pulses are used.
+//
+// Usage: bench-rans [file.fits[.fz] [events]]
+//
+// **************************************************************************
+#include <chrono>
+#include <random>
+#include <iomanip>
+#include <iostream>
+
+#include "externals/huffman.h"
+#include "externals/rans.h"
+#include "externals/factfits.h"
+
+using namespace std;
+
+typedef bool    (*Encoder)(string &, const uint16_t *, size_t);
+typedef int64_t (*Decoder)(const uint8_t *, size_t, uint16_t *, size_t &);
+
+void Smooth(vector<int16_t> &data)
+{
+    for (size_t j=data.size()-1; j>1; j--)
+        data[j] = data[j] - (data[j-1]+data[j-2])/2;
+}
+
+void Run(const vector<vector<int16_t>> &events, const char *name, Encoder encode, Decoder decode)
+{
+    size_t raw  = 0;
+    size_t comp = 0;
+
+    double tenc = 0;
+    double tdec = 0;
+
+    string buf;
+    vector<uint16_t> out;
+
+    for (const auto &evt : events)
+    {
+        const uint16_t *ptr = reinterpret_cast<const uint16_t*>(evt.data());
+
+        buf.clear();
+
+        const auto t0 = chrono::steady_clock::now();
+        encode(buf, ptr, evt.size());
+        const auto t1 = chrono::steady_clock::now();
+
+        out.resize(evt.size());
+        size_t count = out.size();
+
+        decode(reinterpret_cast<const uint8_t*>(buf.data()), buf.size(), out.data(), count);
+        const auto t2 = chrono::steady_clock::now();
+
+        if (count!=evt.size() || !equal(out.begin(), out.end(), ptr))
+            throw runtime_error(string(name)+": round trip failed.");
+
+        raw  += evt.size()*2;
+        comp += buf.size();
+
+        tenc += chrono::duration<double>(t1-t0).count();
+        tdec += chrono::duration<double>(t2-t1).count();
+    }
+
+    cout << setw(12) << left << name << right << fixed << setprecision(3)
+        << setw(8) << double(raw)/comp
+        << setw(10) << setprecision(0) << raw/tenc/1e6
+        << setw(10) << raw/tdec/1e6 << endl;
+}
+
+int main(int argc, const char *argv[])
+{
+    vector<vector<int16_t>> events;
+
+    if (argc>1)
+    {
+        factfits file(argv[1]);
+        if (!file)
+        {
+            cerr << "Opening " << argv[1] << " failed: " << strerror(errno) << endl;
+            return 1;
+        }
+
+        if (!file.HasColumn("Data"))
+        {
+            cerr << argv[1] << " has no column Data." << endl;
+            return 1;
+        }
+
+        const size_t nevts = argc>2 ? atol(argv[2]) : 100;
+        const size_t nrows = min(nevts, size_t(file.GetNumRows()));
+
+        vector<int16_t> data(file.GetN("Data"));
+        file.SetPtrAddress("Data", data.data(), data.size());
+
+        for (size_t row=0; row<nrows; row++)
+        {
+            if (!file.GetRow(row))
+                break;
+            events.push_back(data);
+        }
+    }
+    else
+    {
+        mt19937 rnd(0);
+        normal_distribution<double> noise(0, 4);
+
+        for (int i=0; i<50; i++)
+        {
+            vector<int16_t> data(1440*300);
+            for (size_t j=0; j<data.size(); j++)
+                data[j] = lround(-1000 + noise(rnd) + (j%300>50 && j%300<60 ? 100*(i%5) : 0));
+            events.push_back(data);
+        }
+    }
+
+    if (events.empty())
+    {
+        cerr << "No events." << endl;
+        return 1;
+    }
+
+    cout << events.size() << " events with " << events[0].size() << " samples" << endl;
+    cout << "\nRaw           Ratio  Enc MB/s  Dec MB/s" << endl;
+
+    Run(events, "Huffman16", Huffman::Encode, Huffman::Decode);
+    Run(events, "Rans16",    RANS::Encode,    RANS::Decode);
+
+    for (auto &evt : events)
+        Smooth(evt);
+
+    cout << "\nSmoothed      Ratio  Enc MB/s  Dec MB/s" << endl;
+
+    Run(events, "Huffman16", Huffman::Encode, Huffman::Decode);
+    Run(events, "Rans16",    RANS::Encode,    RANS::Decode);
+
+    return 0;
+}
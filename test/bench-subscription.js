@@ -0,0 +1,68 @@
+'use strict';
+
+/**
+ *
+ *  Benchmark of the events per second handled by a Subscription
+ *
+ *  Start test/bench-publisher (or use any other service with a high
+ *  update rate) and execute this script in dimctrl, e.g.
+ *
+ *     .js test/bench-subscription.js service=BENCH_PUBLISHER/PIXEL typed=true seconds=10
+ *
+ *  Arguments:
+ *     service   Service to subscribe (default: BENCH_PUBLISHER/CALIBRATED_CURRENTS)
+ *     typed     Receive arrays as typed arrays (default: false)
+ *     seconds   Duration of the measurement (default: 10)
+ *
+ *  The events are converted and the callback is executed in the thread
+ *  which receives them, so the number of events handled per second is
+ *  limited by the conversion. The number of events received by the
+ *  subscription is printed, too. If it is larger than the number of
+ *  events handled, updates were lost because the conversion was too slow.
+ *
+ */
+
+var service = $['service'] || "BENCH_PUBLISHER/CALIBRATED_CURRENTS";
+var typed   = $['typed']=='true';
+var seconds = parseFloat($['seconds'] || 10);
+
+var sub = new Subscription(service);
+sub.typed = typed;
+
+// Wait for the service description, otherwise the decoder is
+// compiled again for every event
+while (!sub.get(-1) || !sub.get().obj)
+    v8.sleep(100);
+
+var handled = 0;
+var sum     = 0;
+var first   = null;
+var last    = null;
+
+sub.onchange = function(evt)
+{
+    if (first===null)
+        first = evt.counter;
+    last = evt.counter;
+
+    // Access the data, so that a lazy conversion would not be favored
+    var arr = evt.data.length>0 && evt.data[0].length ? evt.data[0] : evt.data;
+    sum += arr[arr.length-1];
+
+    handled++;
+}
+
+var start = new Date();
+v8.sleep(seconds*1000);
+var stop = new Date();
+
+sub.onchange = undefined;
+
+var dt = (stop-start)/1000;
+
+console.out("Service:  "+service+(typed?" (typed)":""));
+console.out("Handled:  "+handled+" events in "+dt+"s ["+(handled/dt).toFixed(1)+"/s]");
+if (first!==null)
+    console.out("Received: "+(last-first+1)+" events ["+((last-first+1)/dt).toFixed(1)+"/s]");
+
+sub.close();
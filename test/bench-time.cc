@@ -0,0 +1,96 @@
+// **************************************************************************
+//
+// Benchmark of Time::Format and Time::Parse
+//
+// Times the formatting and parsing of the formats used in the tree
+// (SQL, ISO, the log prefix) with Format/Parse and with the stream
+// implementation (time facets) they replace.
+//
+// Usage: bench-time [iterations]
+//
+// **************************************************************************
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <iostream>
+
+#include "Time.h"
+
+using namespace std;
+
+template<class F>
+double Measure(size_t n, F func)
+{
+    const auto start = chrono::steady_clock::now();
+    for (size_t i=0; i<n; i++)
+        func(i);
+    const auto stop = chrono::steady_clock::now();
+
+    return chrono::duration<double, nano>(stop-start).count()/n;
+}
+
+int main(int argc, const char *argv[])
+{
+    const size_t n = argc>1 ? atol(argv[1]) : 100000;
+
+    const char *formats[] =
+    {
+        "%Y-%m-%d %H:%M:%S",     // Time::ssql
+        "%Y-%m-%d %H:%M:%S.%f",  // Time::sql
+        "%Y-%m-%dT%H:%M:%S%F%q", // Time::iso
+        "%H:%M:%S.%f",           // Log prefix
+    };
+
+    const Time t0(2016, 2, 29, 12, 34, 56, 123456);
+
+    size_t sum = 0;
+
+    cout << "Format [ns]          Stream   Format" << endl;
+    for (const char *fmt : formats)
+    {
+        const double stream = Measure(n/10, [&](size_t i)
+        {
+            ostringstream out;
+            out << Time::fmt(fmt) << Time(t0+boost::posix_time::seconds(i));
+            sum += out.str().size();
+        });
+
+        char buf[64];
+        const double format = Measure(n, [&](size_t i)
+        {
+            sum += Time(t0+boost::posix_time::seconds(i)).Format(buf, sizeof(buf), fmt);
+        });
+
+        cout << setw(22) << left << fmt << right << setw(7) << fixed << setprecision(0) << stream << "  " << setw(7) << format << endl;
+    }
+
+    cout << "\nParse [ns]           Stream    Parse" << endl;
+    for (const char *fmt : formats)
+    {
+        const string str = t0.GetAsStr(fmt);
+
+        // Parse does not support %f, it is left to the streams
+        Time test(Time::none);
+        if (!test.Parse(str.c_str(), fmt))
+            continue;
+
+        const double stream = Measure(n/10, [&](size_t)
+        {
+            Time t(Time::none);
+            stringstream in(str);
+            in >> Time::fmt(fmt) >> t;
+            sum += t.IsValid();
+        });
+
+        const double parse = Measure(n, [&](size_t)
+        {
+            Time t(Time::none);
+            sum += t.Parse(str.c_str(), fmt);
+        });
+
+        cout << setw(22) << left << fmt << right << setw(7) << stream << "  " << setw(7) << parse << endl;
+    }
+
+    // Prevent the compiler from optimizing the loops away
+    return sum==0;
+}
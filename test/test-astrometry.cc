@@ -0,0 +1,134 @@
+// **************************************************************************
+//
+// Test and benchmark of the batch transformations of Astrometry
+//
+// Transforms random J2000 positions at random times within one day, which
+// are at zenith distances below 70deg, to observed coordinates with Astrometry and with the full pal setup
+// (palMappa, palAoppa) for every single position, and back again. Fails
+// if the batch result deviates by more than 0.01 arcsec from the full
+// calculation or the round trip by more than 0.001 arcsec. The times of
+// both calculations are printed.
+//
+// Usage: test-astrometry [positions]
+//
+// **************************************************************************
+#include <chrono>
+#include <random>
+#include <iostream>
+
+#include "Astrometry.h"
+#include "pal.h"
+
+using namespace std;
+
+// Angular distance of two positions [arcsec] (haversine formula)
+double Distance(double lon1, double lat1, double lon2, double lat2)
+{
+    const double dlat = sin((lat2-lat1)/2);
+    const double dlon = sin((lon2-lon1)/2);
+
+    return 2*asin(sqrt(dlat*dlat + cos(lat1)*cos(lat2)*dlon*dlon))*180/M_PI*3600;
+}
+
+// The full transformation for a single position
+void MeanToObserved(const Astrometry::Site &site, double ra, double dec, double mjd, double &zd, double &az)
+{
+    const double tdb = mjd + palDtt(mjd)/3600/24;
+
+    double amprms[21];
+    palMappa(2000.0, tdb, amprms);
+
+    double aoprms[14];
+    palAoppa(mjd, 0, site.lng, site.lat, site.height, 0, 0,
+             273.155+site.temp, site.press, site.hum, site.wavelength, site.lapse, aoprms);
+
+    double r, d;
+    palMapqkz(ra, dec, amprms, &r, &d);
+
+    double ha, ob_dec, ob_ra;
+    palAopqk(r, d, aoprms, &az, &zd, &ha, &ob_dec, &ob_ra);
+}
+
+int main(int argc, const char *argv[])
+{
+    const size_t n = argc>1 ? atol(argv[1]) : 20000;
+
+    mt19937 rnd(0);
+    uniform_real_distribution<double> uni(0, 1);
+
+    const Astrometry astro;
+
+    const double lng = astro.GetSite().lng;
+    const double lat = astro.GetSite().lat;
+
+    // One day starting at 2020-01-01 12:00 UTC. Only positions in the
+    // range of the telescope are used, below the refraction is calculated
+    // rigorously (palRefro), which is slow in both calculations. The
+    // zenith distance is estimated with the earth rotation angle.
+    vector<double> ra(n), dec(n), mjd(n);
+    for (size_t i=0; i<n; i++)
+    {
+        mjd[i] = 58849.5 + double(i)/n;
+
+        const double lst = 2*M_PI*(0.7790572732640 + 1.00273781191135448*(mjd[i]-51544.5)) + lng;
+
+        double alt;
+        do
+        {
+            ra[i]  = uni(rnd)*2*M_PI;
+            dec[i] = asin(uni(rnd)*2-1);
+
+            alt = asin(sin(lat)*sin(dec[i]) + cos(lat)*cos(dec[i])*cos(lst-ra[i]));
+        }
+        while (alt<20*M_PI/180);
+    }
+
+    vector<double> zd, az;
+
+    auto t0 = chrono::steady_clock::now();
+    astro.MeanToObserved(ra, dec, mjd, zd, az);
+    auto t1 = chrono::steady_clock::now();
+
+    const double tbatch = chrono::duration<double, milli>(t1-t0).count();
+
+    vector<double> ref_zd(n), ref_az(n);
+
+    t0 = chrono::steady_clock::now();
+    for (size_t i=0; i<n; i++)
+        MeanToObserved(astro.GetSite(), ra[i], dec[i], mjd[i], ref_zd[i], ref_az[i]);
+    t1 = chrono::steady_clock::now();
+
+    const double tfull = chrono::duration<double, milli>(t1-t0).count();
+
+    vector<double> ra2, dec2;
+
+    t0 = chrono::steady_clock::now();
+    astro.ObservedToMean(zd, az, mjd, ra2, dec2);
+    t1 = chrono::steady_clock::now();
+
+    const double tinv = chrono::duration<double, milli>(t1-t0).count();
+
+    double maxdev  = 0;
+    double maxtrip = 0;
+    for (size_t i=0; i<n; i++)
+    {
+        maxdev = max(maxdev, Distance(az[i], M_PI/2-zd[i], ref_az[i], M_PI/2-ref_zd[i]));
+
+        maxtrip = max(maxtrip, Distance(ra[i], dec[i], ra2[i], dec2[i]));
+    }
+
+    cout << n << " positions within one day\n" << endl;
+    cout << "Full pal setup per position: " << tfull  << " ms" << endl;
+    cout << "Astrometry::MeanToObserved:  " << tbatch << " ms (" << tfull/tbatch << "x)" << endl;
+    cout << "Astrometry::ObservedToMean:  " << tinv   << " ms\n" << endl;
+    cout << "Maximum deviation:  " << maxdev  << " arcsec" << endl;
+    cout << "Maximum round trip: " << maxtrip << " arcsec" << endl;
+
+    if (maxdev>0.01 || maxtrip>0.001)
+    {
+        cerr << "\nThe deviation is too large." << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,172 @@
+// **************************************************************************
+//
+// Test of the vectorized FITS checksum
+//
+// Compares Checksum::add with the scalar loop it replaced for random
+// buffers at all alignments (0-31 bytes) and with lengths which are
+// multiples of 4 but not of the vector width, as well as lengths which
+// are split into several blocks of 2^18-4 bytes. The buffers are added in
+// one and in two calls, with and without big_endian. The program fails
+// if any checksum differs.
+//
+// Usage: test-checksum [buffers]
+//
+// **************************************************************************
+#include <random>
+#include <vector>
+#include <sstream>
+#include <iostream>
+#include <stdexcept>
+
+#include "externals/checksum.h"
+
+using namespace std;
+
+// The scalar implementation as it was before the vector loops
+namespace Scalar
+{
+    class Checksum
+    {
+    public:
+        uint64_t buffer;
+
+        Checksum() : buffer(0) { }
+
+        uint32_t val() const { return (((buffer&0xffff)<<16) | ((buffer>>32)&0xffff)); }
+
+        void HandleCarryBits()
+        {
+            while (1)
+            {
+                const uint64_t carry = ((buffer>>48)&0xffff) | ((buffer&0xffff0000)<<16);
+                if (!carry)
+                    break;
+
+                buffer = (buffer&0xffff0000ffff) + carry;
+            }
+        }
+
+        bool add(const char *buf, size_t len, bool big_endian = true)
+        {
+            // Avoid overflows in carry bits
+            if (len>262140) // 2^18-4
+            {
+                add(buf, 262140);
+                return add(buf+262140, len-262140);
+            }
+
+            if (len%4>0)
+                throw runtime_error("Length not dividable by 4");
+
+            const uint16_t *sbuf = reinterpret_cast<const uint16_t *>(buf);
+
+            uint32_t *hilo  = reinterpret_cast<uint32_t*>(&buffer);
+
+            const uint16_t *end = sbuf + len/2;
+
+            if (big_endian)
+                addLoopSwapping(sbuf, end, hilo);
+            else
+                addLoop(sbuf, end, hilo);
+
+            HandleCarryBits();
+
+            return true;
+        }
+
+        void addLoopSwapping(const uint16_t *sbuf, const uint16_t *end, uint32_t* hilo)
+        {
+            while (1)
+            {
+                if (sbuf==end)
+                    break;
+
+                hilo[0] += ntohs(*sbuf++);
+
+                if (sbuf==end)
+                    break;
+
+                hilo[1] += ntohs(*sbuf++);
+            }
+        }
+
+        void addLoop(const uint16_t *sbuf, const uint16_t *end, uint32_t* hilo)
+        {
+            while (1)
+            {
+                if (sbuf==end)
+                    break;
+
+                hilo[0] += ntohs(*sbuf++);
+
+                if (sbuf==end)
+                    break;
+
+                hilo[1] += ntohs(*sbuf++);
+            }
+        }
+    };
+}
+
+int main(int argc, const char *argv[])
+{
+    const size_t nbuf = argc>1 ? atol(argv[1]) : 200;
+
+    mt19937 rnd(0);
+    uniform_int_distribution<int>    byte(0, 255);
+    uniform_int_distribution<size_t> words(0, 300);
+    uniform_int_distribution<size_t> large(65535, 200000);
+
+    vector<char> data(4*200000+32);
+
+    size_t nerr = 0;
+    size_t ntot = 0;
+
+    for (size_t i=0; i<nbuf; i++)
+    {
+        // Mostly short buffers, every tenth is longer than one block
+        const size_t len = 4*(i%10==9 ? large(rnd) : words(rnd));
+
+        for (size_t j=0; j<len+32; j++)
+            data[j] = byte(rnd);
+
+        for (size_t align=0; align<32; align++)
+        {
+            const char *ptr = data.data()+align;
+
+            for (const bool big_endian : { true, false })
+            {
+                ::Checksum sum1;
+                Scalar::Checksum sum2;
+
+                sum1.add(ptr, len, big_endian);
+                sum2.add(ptr, len, big_endian);
+
+                // The same buffer in two calls, split at a multiple of 4
+                const size_t split = len==0 ? 0 : 4*(byte(rnd)%(len/4+1));
+
+                ::Checksum sum3(sum1);
+                Scalar::Checksum sum4(sum2);
+
+                sum3.add(ptr, split, big_endian);
+                sum3.add(ptr+split, len-split, big_endian);
+
+                sum4.add(ptr, split, big_endian);
+                sum4.add(ptr+split, len-split, big_endian);
+
+                ntot++;
+
+                if (sum1.buffer==sum2.buffer && sum3.buffer==sum4.buffer && sum1.val()==sum2.val())
+                    continue;
+
+                if (nerr++<10)
+                    cerr << "Length " << len << ", alignment " << align << (big_endian?"":" (little endian)")
+                        << ": " << hex << sum1.val() << " instead of " << sum2.val() << dec << endl;
+            }
+        }
+    }
+
+    cout << ntot << " checksums compared, " << nerr << " differ." << endl;
+
+    return nerr==0 ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// **************************************************************************
+//
+// Test of the parallel accumulation and solution of DrsCalibrateTime
+//
+// Simulates events of the time marker channels: a sine sampled by cells
+// of random width, starting at a random cell. The events are accumulated
+// by a single DrsCalibrateTime and, distributed round robin, by several
+// ones which are merged with operator+= afterwards (as drstimecalib does
+// with its threads). FillEmptyBins and CalcResult are then run with one
+// thread for the first and with several threads for the merged one. The
+// program fails if the offsets of both differ by more than 1e-9 samples.
+// Running the solution with one and several threads on the same sums
+// must give bit-identical offsets.
+//
+// Usage: test-drstimecalib [events [threads]]
+//
+// **************************************************************************
+#include <random>
+#include <iostream>
+
+#include "externals/DrsCalib.h"
+
+using namespace std;
+
+int main(int argc, const char *argv[])
+{
+    const size_t   nevts    = argc>1 ? atol(argv[1]) : 100;
+    const uint32_t nthreads = argc>2 ? atol(argv[2]) : 4;
+
+    mt19937 rnd(0);
+    uniform_real_distribution<double> width(0.8, 1.2);
+    uniform_real_distribution<double> phase(0, 2*M_PI);
+    uniform_int_distribution<int16_t> cell(0, 1023);
+    normal_distribution<double>       noise(0, 0.01);
+
+    // The true width of each cell of each chip
+    vector<double> widths(160*1024);
+    for (auto &w : widths)
+        w = width(rnd);
+
+    DrsCalibrateTime serial;
+    vector<DrsCalibrateTime> parts(nthreads);
+
+    vector<float>   data(1440*1024);
+    vector<int16_t> start(1440, -1);
+
+    for (size_t evt=0; evt<nevts; evt++)
+    {
+        for (int ch=0; ch<160; ch++)
+        {
+            const size_t tm = ch*9+8;
+
+            start[tm] = cell(rnd);
+
+            // About 50 periods within the 1024 samples
+            const double ph = phase(rnd);
+
+            double t = 0;
+            for (int i=0; i<1024; i++)
+            {
+                data[tm*1024+i] = sin(2*M_PI*t/20.48+ph) + noise(rnd);
+                t += widths[ch*1024+(start[tm]+i)%1024];
+            }
+        }
+
+        serial.AddT(data.data(), start.data());
+        parts[evt%nthreads].AddT(data.data(), start.data());
+    }
+
+    DrsCalibrateTime merged = parts[0];
+    for (uint32_t i=1; i<nthreads; i++)
+        merged += parts[i];
+
+    if (merged.fNumEntries!=serial.fNumEntries)
+    {
+        cerr << "Number of entries differs: " << merged.fNumEntries << " instead of " << serial.fNumEntries << endl;
+        return 1;
+    }
+
+    DrsCalibrateTime single = merged;
+
+    serial.FillEmptyBins(1);
+    serial.CalcResult(1);
+
+    single.FillEmptyBins(1);
+    single.CalcResult(1);
+
+    merged.FillEmptyBins(nthreads);
+    merged.CalcResult(nthreads);
+
+    double maxdev = 0;
+    double maxoff = 0;
+    bool identical = true;
+    for (size_t i=0; i<serial.fStat.size(); i++)
+    {
+        maxdev = max(maxdev, fabs(merged.Sum(i)-serial.Sum(i)));
+        maxoff = max(maxoff, fabs(serial.Sum(i)));
+
+        identical &= merged.fStat[i]==single.fStat[i];
+    }
+
+    cout << nevts << " events, " << nthreads << " threads\n" << endl;
+    cout << "Maximum offset:    " << maxoff << " samples" << endl;
+    cout << "Maximum deviation: " << maxdev << " samples" << endl;
+
+    bool ok = true;
+
+    // The offsets must not be trivially zero
+    if (maxoff<0.1)
+    {
+        cerr << "\nThe offsets are too small." << endl;
+        ok = false;
+    }
+
+    if (maxdev>1e-9)
+    {
+        cerr << "\nThe deviation is too large." << endl;
+        ok = false;
+    }
+
+    if (!identical)
+    {
+        cerr << "\nThe solution with " << nthreads << " threads differs from the one with one thread." << endl;
+        ok = false;
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,147 @@
+// **************************************************************************
+//
+// Round-trip test of the DRS offset calibration of factofits/factfits
+//
+// Writes events with a random offset calibration and reads them back.
+// The Data column is ordered by row and by column, followed by a column
+// with the other ordering or as the last column, so that the restoring of
+// the offsets while the tile is uncompressed (only for Data ordered by
+// row) and after a row is staged are both checked. The data is the offset
+// plus noise. With a large noise the compressed data is larger than the
+// raw data and the tile is stored uncompressed instead.
+//
+// Usage: test-factfits [file]
+//
+// **************************************************************************
+#include <random>
+#include <iostream>
+
+#include "externals/factofits.h"
+#include "externals/factfits.h"
+
+using namespace std;
+
+namespace
+{
+    const uint16_t kNumRoi  = 50;
+    const uint32_t kNumEvts = 25;
+
+    bool Check(const string &fname, FITS::RowOrdering_t order, bool last, int16_t noise)
+    {
+        const FITS::RowOrdering_t other = order==FITS::kOrderByRow ? FITS::kOrderByCol : FITS::kOrderByRow;
+
+        // Encoding each of the 1440*kNumRoi columns of a tile separately
+        // with huffman would take ages, so column ordered data is raw
+        const FITS::Compression comp(order==FITS::kOrderByRow ? FITS::kFactHuffman16 : FITS::kFactRaw, order);
+        const FITS::Compression next(FITS::kFactRaw, other);
+
+        mt19937 rnd(order+last+noise);
+        uniform_int_distribution<int16_t> adc(-2000, 2000);
+        uniform_int_distribution<int16_t> cell(0, 1023);
+        uniform_int_distribution<int16_t> err(-noise, noise);
+
+        vector<int16_t> offsets(1440*1024);
+        for (auto &o : offsets)
+            o = adc(rnd);
+
+        // EventNum, StartCellData, Data and (optionally) Trailer,
+        // without padding between the members
+        struct Event
+        {
+            uint32_t num;
+            int16_t  start[1440];
+            int16_t  data[1440*kNumRoi];
+            int16_t  trailer;
+        };
+
+        const size_t bytes = 4 + 2*1440 + 2*1440*kNumRoi + (last ? 0 : 2);
+
+        vector<Event> evts(kNumEvts);
+        for (uint32_t i=0; i<kNumEvts; i++)
+        {
+            evts[i].num = i;
+            for (auto &s : evts[i].start)
+                s = cell(rnd);
+            for (uint32_t j=0; j<1440*kNumRoi; j++)
+                evts[i].data[j] = offsets[j/kNumRoi*1024 + (evts[i].start[j/kNumRoi]+j%kNumRoi)%1024] + err(rnd);
+            evts[i].trailer = i;
+        }
+
+        {
+            factofits out(10, 7);
+            out.SetDrsCalibration(offsets);
+            out.open(fname.c_str());
+
+            out.AddColumnInt("EventNum");
+            out.AddColumnShort(1440, "StartCellData");
+            out.AddColumnShort(comp, 1440*kNumRoi, "Data");
+            if (!last)
+                out.AddColumnShort(next, "Trailer");
+
+            out.SetInt("NPIX", 1440);
+            out.SetInt("NROI", kNumRoi);
+
+            out.WriteTableHeader("Events");
+
+            for (const auto &evt : evts)
+                out.WriteRow(&evt, bytes);
+
+            if (!out.close())
+            {
+                cerr << "Writing " << fname << " failed." << endl;
+                return false;
+            }
+        }
+
+        factfits in(fname, "Events");
+        if (!in)
+        {
+            cerr << "Opening " << fname << " failed." << endl;
+            return false;
+        }
+
+        Event evt;
+        in.SetPtrAddress("EventNum",      &evt.num);
+        in.SetPtrAddress("StartCellData", evt.start, 1440);
+        in.SetPtrAddress("Data",          evt.data,  1440*kNumRoi);
+        if (!last)
+            in.SetPtrAddress("Trailer",   &evt.trailer);
+
+        for (uint32_t i=0; i<kNumEvts; i++)
+        {
+            if (!in.GetRow(i))
+            {
+                cerr << "Reading row " << i << " failed." << endl;
+                return false;
+            }
+
+            if (memcmp(evt.data, evts[i].data, sizeof(evt.data))!=0 ||
+                memcmp(evt.start, evts[i].start, sizeof(evt.start))!=0 ||
+                evt.num!=i || (!last && evt.trailer!=int16_t(i)))
+            {
+                cerr << "Data ordered by " << (order==FITS::kOrderByRow?"row":"column")
+                    << (last ? " (last column)" : "") << ", noise " << noise << ": event " << i << " differs." << endl;
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    const string fname = argc>1 ? argv[1] : "test-factfits.fits.fz";
+
+    bool ok = true;
+
+    ok &= Check(fname, FITS::kOrderByRow, false,   10);
+    ok &= Check(fname, FITS::kOrderByRow, false, 4000);
+    ok &= Check(fname, FITS::kOrderByCol, false,   10);
+    ok &= Check(fname, FITS::kOrderByRow, true,    10);
+    ok &= Check(fname, FITS::kOrderByCol, true,    10);
+
+    remove(fname.c_str());
+
+    return ok ? 0 : 1;
+}
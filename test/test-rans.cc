@@ -0,0 +1,123 @@
+// **************************************************************************
+//
+// Round-trip test of the rANS coder (kFactRans16)
+//
+// Encodes and decodes blocks of different sizes and distributions (empty,
+// a single symbol, all 65536 symbols, narrow and wide gaussians, smoothed
+// waveforms) and checks that the data is decoded identically, that the
+// whole block is consumed and that truncated blocks are rejected.
+//
+// **************************************************************************
+#include <random>
+#include <iostream>
+
+#include "externals/rans.h"
+
+using namespace std;
+
+namespace
+{
+    size_t gErrors = 0;
+
+    void Check(const vector<uint16_t> &data, const string &name)
+    {
+        string enc;
+        if (!RANS::Encode(enc, data.data(), data.size()))
+        {
+            cerr << name << " [" << data.size() << "]: encoding failed." << endl;
+            gErrors++;
+            return;
+        }
+
+        vector<uint16_t> dec(data.size()+1, 0xdead);
+        size_t count = dec.size();
+
+        const int64_t len = RANS::Decode(reinterpret_cast<const uint8_t*>(enc.data()), enc.size(), dec.data(), count);
+        dec.resize(count);
+
+        if (len!=int64_t(enc.size()) || dec!=data)
+        {
+            cerr << name << " [" << data.size() << "]: round trip failed (" << len << "/" << enc.size() << " bytes)." << endl;
+            gErrors++;
+            return;
+        }
+
+        // A truncated stream must not be accepted
+        if (enc.size()<sizeof(uint64_t)+1+4+4*2+8+2)
+            return;
+
+        try
+        {
+            count = data.size();
+            RANS::Decode(reinterpret_cast<const uint8_t*>(enc.data()), enc.size()-2, dec.data(), count);
+
+            cerr << name << " [" << data.size() << "]: truncated stream accepted." << endl;
+            gErrors++;
+        }
+        catch (const runtime_error &)
+        {
+        }
+    }
+}
+
+int main()
+{
+    mt19937 rnd(0);
+
+    const size_t sizes[] = { 0, 1, 2, 3, 4, 5, 7, 16, 100, 1023, 1024, 1025, 4096, 300*1440, 1024*1440 };
+
+    size_t n = 0;
+    for (const size_t size : sizes)
+    {
+        vector<uint16_t> data(size);
+
+        fill(data.begin(), data.end(), 0x1234);
+        Check(data, "Single symbol");
+
+        for (size_t i=0; i<size; i++)
+            data[i] = i%2 ? 0 : 0xffff;
+        Check(data, "Two symbols");
+
+        for (size_t i=0; i<size; i++)
+            data[i] = (i*40503)%65536;
+        Check(data, "All symbols");
+
+        for (const double sigma : { 0.5, 3., 20., 300., 5000. })
+        {
+            normal_distribution<double> dist(0, sigma);
+            for (auto &d : data)
+                d = int16_t(lround(dist(rnd)));
+            Check(data, "Gaussian");
+        }
+
+        // Noisy waveforms with pulses, smoothed as by kFactSmoothing
+        normal_distribution<double> noise(0, 4);
+        vector<int16_t> wave(size);
+        for (size_t i=0; i<size; i++)
+            wave[i] = int16_t(lround(-1000 + noise(rnd) + (i%300>50 && i%300<60 ? 500 : 0)));
+        for (size_t j=size-1; j>1 && j<size; j--)
+            wave[j] = wave[j] - (wave[j-1]+wave[j-2])/2;
+        copy(wave.begin(), wave.end(), data.begin());
+        Check(data, "Smoothed");
+
+        n += 9;
+    }
+
+    // The vector interface must not read the header of a too short stream
+    try
+    {
+        const uint8_t shortstream[4] = { 0 };
+        vector<uint16_t> dec;
+        RANS::Decode(shortstream, sizeof(shortstream), dec);
+
+        cerr << "Too short stream accepted." << endl;
+        gErrors++;
+    }
+    catch (const runtime_error &)
+    {
+    }
+
+    cout << n << " blocks checked, " << gErrors << " errors." << endl;
+
+    return gErrors ? 1 : 0;
+}
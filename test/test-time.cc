@@ -0,0 +1,155 @@
+// **************************************************************************
+//
+// Round-trip test of Time::Format and Time::Parse
+//
+// Checks for every day between 1970 and 2100 (with varying time of day
+// and fraction of seconds) and for every second of a single day that
+// the output of Format is read back identically by Parse, and that
+// both agree with the stream implementation (time facets) for the
+// formats used in the tree. Invalid input must be rejected by Parse.
+//
+// The streams are slow, so by default each time is compared for one
+// of the formats only (in turn). With the argument 'all' every time
+// is compared for all formats (takes about a minute).
+//
+// Usage: test-time [all]
+//
+// **************************************************************************
+#include <sstream>
+#include <iostream>
+
+#include "Time.h"
+
+using namespace std;
+
+namespace
+{
+    size_t gErrors = 0;
+
+    const char *gFormats[] =
+    {
+        "%Y-%m-%d %H:%M:%S",              // Time::ssql
+        "%Y-%m-%d %H:%M:%S.%f",           // Time::sql
+        "%Y-%m-%dT%H:%M:%S%F%q",          // Time::iso
+        "%Y %m %d %H %M %S %f",           // Time::magic
+        "%Y %m %d %H %M %S",              // Time::smagic
+        "%H:%M", "%H:%M:%S", "%H:%M:%S.%f", "%M:%S.%f",
+        "%Y-%m-%d", "%Y%m%d", "%Y%m%d_%H%M%S", "/%Y/%m/%d",
+        "%d/%m/%Y", "%d.%m.%Y %H:%M", "%Y=%m=%d %H=%M=%S.%f",
+        "100%% %Y",
+    };
+
+    // Formats which contain the full time, Parse must read them back
+    const char *gRoundTrip[] =
+    {
+        "%Y-%m-%d %H:%M:%S%F",
+        "%Y-%m-%dT%H:%M:%S%F%q",
+        "%Y%m%d_%H%M%S%F",
+        "%Y %m %d %H %M %S%F",
+    };
+
+    string StreamFormat(const Time &t, const char *fmt)
+    {
+        ostringstream out;
+        out << Time::fmt(fmt) << t;
+        return out.str();
+    }
+
+    void Error(const Time &t, const char *fmt, const string &what, const string &a, const string &b)
+    {
+        if (gErrors++<20)
+            cerr << t.Iso() << " [" << fmt << "] " << what << ": '" << a << "' vs '" << b << "'" << endl;
+    }
+
+    const size_t gNumFormats = sizeof(gFormats)/sizeof(*gFormats);
+
+    void Check(const Time &t, size_t idx, bool all)
+    {
+        char buf[128];
+
+        for (size_t i=0; i<gNumFormats; i++)
+        {
+            if (!all && i!=idx%gNumFormats)
+                continue;
+
+            const char *fmt = gFormats[i];
+
+            const size_t n = t.Format(buf, sizeof(buf), fmt);
+            const string ref = StreamFormat(t, fmt);
+
+            if (n==0 || ref!=string(buf, n))
+                Error(t, fmt, "Format", n==0 ? "<failed>" : string(buf, n), ref);
+
+            // Where Parse succeeds, it must agree with the streams
+            Time parsed(Time::none);
+            if (!parsed.Parse(buf, fmt))
+                continue;
+
+            Time streamed(Time::none);
+            stringstream in(ref);
+            in >> Time::fmt(fmt) >> streamed;
+
+            if (parsed!=streamed)
+                Error(t, fmt, "Parse", parsed.Iso(), streamed.Iso());
+        }
+
+        for (const char *fmt : gRoundTrip)
+        {
+            const size_t n = t.Format(buf, sizeof(buf), fmt);
+
+            Time parsed(Time::none);
+            if (n==0 || !parsed.Parse(buf, fmt) || parsed!=t)
+                Error(t, fmt, "Round trip", buf, t.Iso());
+        }
+    }
+
+    void CheckInvalid(const char *str, const char *fmt)
+    {
+        Time t(Time::none);
+        if (t.Parse(str, fmt))
+        {
+            if (gErrors++<20)
+                cerr << "'" << str << "' [" << fmt << "] accepted by Parse." << endl;
+        }
+    }
+}
+
+int main(int argc, const char *argv[])
+{
+    const bool all = argc>1 && string(argv[1])=="all";
+
+    size_t n = 0;
+
+    // Every day, with a time of day and fraction which vary from day to day
+    for (Time t(1970, 1, 1); t<Time(2101, 1, 1); t+=boost::posix_time::hours(24))
+    {
+        const uint32_t s  = (n*7919)%86400;
+        const uint32_t us = (n*104729)%1000000;
+
+        Check(Time(t.Y(), t.M(), t.D(), s/3600, (s/60)%60, s%60, us%1000 ? us : 0), n, all);
+        n++;
+    }
+
+    // Every second of a single day, with and without fraction
+    for (uint32_t s=0; s<86400; s++)
+    {
+        Check(Time(2016, 2, 29, s/3600, (s/60)%60, s%60, s%2 ? 0 : s*11%1000000), n, all);
+        n++;
+    }
+
+    // Input which must be left to the stream implementation
+    CheckInvalid("2016-02-30 12:00:00", "%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2015-02-29 12:00:00", "%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2016-13-01 12:00:00", "%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2016-01-01 24:00:00", "%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2016-01-01 12:60:00", "%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2016-1-01 12:00:00",  "%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2016-01-01 12:00:00x","%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2016-01-01 12:00",    "%Y-%m-%d %H:%M:%S");
+    CheckInvalid("2016-01-01T12:00:00.","%Y-%m-%dT%H:%M:%S%F%q");
+    CheckInvalid("12:00:00",            "%H:%M:%S %p");
+
+    cout << n << " times checked, " << gErrors << " errors." << endl;
+
+    return gErrors ? 1 : 0;
+}